@@ -63,6 +63,9 @@ typedef enum {
   kDashToHlsStatus_BadDashContents,
   kDashToHlsStatus_BadConfiguration,
   kDashToHlsStatus_ClearContent,
+  // Returned by an HLS_OutputSink that cannot accept data right now.  The
+  // data is kept and offered again on the next flush.
+  kDashToHlsStatus_Backpressure,
   kDashToHlsStatus_Last
 } DashToHlsStatus;
 
@@ -118,9 +121,9 @@ DashToHlsStatus DashToHls_ParseSidx(struct DashToHlsSession* session,
 // The pssh is usually handled out of band.  To simplify things this call
 // only extracts a pssh and calls the pssh callback.
 //
-// pssh requests should be cached, so when DashToHls_ParseLive is called
-// the pssh handler will be expected to ignore the request as already
-// completed.
+// The session remembers the pssh boxes the handler has taken, so when
+// DashToHls_ParseLive sees them again in every segment the handler is not
+// called.  Only new boxes, such as those of a rotated key, are passed on.
 DashToHlsStatus DashToHls_ParseLivePssh(struct DashToHlsSession* session,
                                         const uint8_t* bytes, uint64_t length);
 
@@ -135,6 +138,39 @@ DashToHlsStatus DashToHls_ParseLive(struct DashToHlsSession* session,
                                     const uint8_t** hls_segment,
                                     size_t* hls_length);
 
+// Low-latency HLS.  Live CMAF segments arrive as a run of small moof/mdat
+// chunks, and each one can go out as an EXT-X-PART as soon as it arrives
+// instead of waiting for the whole segment.  |chunk| is one moof/mdat pair,
+// the first chunk of a segment may also carry the styp and moov.  The moov
+// must come before the first moof, either in a chunk or through
+// DashToHls_ParseLive.
+//
+// In the transport stream format one TransportStreamOut carries on from
+// part to part, so the continuity counters are continuous and the parts of
+// a segment concatenated are the segment.  |hls_part| is owned by |session|
+// and valid until the next call.  An output sink gets the part instead.
+typedef struct {
+  // Seconds, for the DURATION attribute.
+  double duration;
+  // Non zero if the part starts with a sync sample, INDEPENDENT=YES.
+  int independent;
+} DashToHlsPart;
+DashToHlsStatus DashToHls_ConvertLiveChunk(struct DashToHlsSession* session,
+                                           const uint8_t* chunk,
+                                           size_t chunk_length,
+                                           const uint8_t** hls_part,
+                                           size_t* hls_length,
+                                           DashToHlsPart* part);
+
+// The EXT-X-PART line for the last part from DashToHls_ConvertLiveChunk,
+// served at |uri|, e.g.
+// #EXT-X-PART:DURATION=0.50000,URI="part12.0.ts",INDEPENDENT=YES
+// |tag| is owned by |session| and valid until the next call.
+DashToHlsStatus DashToHls_GetPartTag(struct DashToHlsSession* session,
+                                     const char* uri,
+                                     const char** tag,
+                                     size_t* tag_length);
+
 // Takes one moof/mdat section and converts it to an HLS ts segment.  The
 // |hls_segment| is owned by the |session| and freed when ReleaseHlsSegment
 // or ReleaseSession is called.
@@ -158,16 +194,302 @@ DashToHlsStatus DashToHls_ConvertDashSegmentData(
     const uint8_t** hls_segment,
     size_t* hls_length);
 
+// HLS segments of a target duration, whatever the duration of the DASH
+// segments.  Short DASH segments are stitched together and long ones are
+// split at sync samples, so each planned segment starts with a keyframe.
+//
+// Every DASH segment in the index is taken to start with a sync sample.
+// Sync samples within a segment are found from the trun sample flags of
+// the segments passed to DashToHls_AddSegmentToPlan, DASH segments that
+// were not added are not split.  DashToHls_PlanSegments then returns the
+// planned segments, and DashToHls_ConvertPlannedSegment converts each one
+// from the DASH bytes at |location| and |length|, which span all of the
+// DASH segments it covers.  The samples of a planned segment go through
+// one TransportStreamOut, so the continuity counters and timestamps run on
+// across the stitched moofs.
+//
+// Only transport stream and program stream output can be planned.
+struct DashToHlsPlannedSegment {
+  uint64_t start_time;
+  uint64_t duration;
+  uint32_t timescale;
+  uint64_t location;
+  uint64_t length;
+  // The DASH segments the planned segment takes samples from.
+  uint32_t first_dash_segment;
+  uint32_t last_dash_segment;
+};
+
+// Memory is owned by the DashToHlsSession and is valid until the next
+// DashToHls_PlanSegments call or ReleaseSession.
+struct DashToHlsPlan {
+  uint32_t segment_count;
+  const struct DashToHlsPlannedSegment* segments;
+};
+
+// Finds the sync samples of DASH segment |segment_number| of the index.
+// |dash_segment| is the whole segment, as for DashToHls_ConvertDashSegment.
+DashToHlsStatus DashToHls_AddSegmentToPlan(struct DashToHlsSession* session,
+                                           uint32_t segment_number,
+                                           const uint8_t* dash_segment,
+                                           size_t dash_segment_size);
+
+// Plans segments as close to |target_duration| seconds as the sync samples
+// allow.  Can be called again as more segments are added.
+DashToHlsStatus DashToHls_PlanSegments(struct DashToHlsSession* session,
+                                       double target_duration,
+                                       struct DashToHlsPlan** plan);
+
+// Converts planned segment |planned_segment_number| of the last plan.
+// |dash_segments| holds the |length| bytes at |location| of the planned
+// segment.  The |hls_segment| is owned by |session| and freed by
+// DashToHls_ReleaseHlsSegment(session, planned_segment_number), so planned
+// and DASH segment numbers should not be mixed in one session.
+DashToHlsStatus DashToHls_ConvertPlannedSegment(
+    struct DashToHlsSession* session,
+    uint32_t planned_segment_number,
+    const uint8_t* dash_segments,
+    size_t dash_segments_size,
+    const uint8_t** hls_segment,
+    size_t* hls_length);
+
+// Single file output, so an origin can keep a whole title as one TS file
+// and serve its segments with ranged reads.  DashToHls_AppendToSingleFile
+// converts the segments of the index in order, starting with segment 0, and
+// returns the bytes to write at the end of the file.  Every segment goes
+// through the same TransportStreamOut, so the continuity counters run on
+// through the file, and each one still starts with a PAT/PMT and a
+// keyframe.  |hls_data| is owned by |session| and valid until the next
+// call.
+//
+// Only transport stream and program stream output can be written this way,
+// and not through an output sink.
+DashToHlsStatus DashToHls_AppendToSingleFile(struct DashToHlsSession* session,
+                                             uint32_t segment_number,
+                                             const uint8_t* dash_segment,
+                                             size_t dash_segment_size,
+                                             const uint8_t** hls_data,
+                                             size_t* hls_length);
+
+// The media playlist for the single file at |uri|, with an EXTINF and an
+// EXT-X-BYTERANGE for each segment appended so far, taken from the bytes
+// actually written.  The playlist ends with EXT-X-ENDLIST once every
+// segment of the index has been appended.  |playlist| is owned by
+// |session| and valid until the next call.
+DashToHlsStatus DashToHls_GetByteRangePlaylist(
+    struct DashToHlsSession* session,
+    const char* uri,
+    const char** playlist,
+    size_t* playlist_length);
+
+// Trick play.  DashToHls_AppendIFrames extracts only the sync samples of a
+// video segment, found from the trun sample flags, and packetizes each one
+// as a PAT, a PMT and one PES.  Other samples are never decrypted or
+// copied.  As with DashToHls_AppendToSingleFile the segments of the index
+// are appended in order and the returned bytes go at the end of one
+// I-frame file, with continuity counters running through it.  With a key
+// from DashToHls_SetHlsEncryptionKey each I-frame's byte range is
+// encrypted and padded on its own.  |hls_data| is owned by |session| and
+// valid until the next call.
+DashToHlsStatus DashToHls_AppendIFrames(struct DashToHlsSession* session,
+                                        uint32_t segment_number,
+                                        const uint8_t* dash_segment,
+                                        size_t dash_segment_size,
+                                        const uint8_t** hls_data,
+                                        size_t* hls_length);
+
+// The I-frame playlist for the I-frame file at |uri|, for the
+// EXT-X-I-FRAME-STREAM-INF tag of the master playlist.  Each I-frame gets
+// an EXTINF up to the next I-frame and an EXT-X-BYTERANGE of its bytes.
+// |playlist| is owned by |session| and valid until the next call.
+DashToHlsStatus DashToHls_GetIFramePlaylist(struct DashToHlsSession* session,
+                                            const char* uri,
+                                            const char** playlist,
+                                            size_t* playlist_length);
+
+// Converts the same time range of a video and an audio session into one TS
+// segment carrying both, so a player makes one request per segment instead
+// of two.  Each segment is passed exactly as to DashToHls_ConvertDashSegment
+// for its own session.  Samples are interleaved by decode time under a
+// single PMT with video on PID 0x21, which also carries the PCR, and audio
+// on PID 0x22.  Audio frames are grouped into PES packets of about 100ms.
+// Returns kDashToHlsStatus_NeedMoreData until both segments are whole.
+//
+// The |hls_segment| is owned by |video_session| and freed by
+// DashToHls_ReleaseHlsSegment(video_session, video_segment_number) or
+// ReleaseSession.  An output sink on |video_session| gets the whole segment
+// once it is complete.
+DashToHlsStatus DashToHls_ConvertMuxedSegment(
+    struct DashToHlsSession* video_session,
+    uint32_t video_segment_number,
+    const uint8_t* video_segment,
+    size_t video_segment_size,
+    struct DashToHlsSession* audio_session,
+    uint32_t audio_segment_number,
+    const uint8_t* audio_segment,
+    size_t audio_segment_size,
+    const uint8_t** hls_segment,
+    size_t* hls_length);
+
+// HLS segments can be MPEG-2 transport streams, the default, or fragmented
+// mp4 (CMAF).  In fmp4 mode DashToHls_ConvertDashSegment,
+// DashToHls_ConvertDashSegmentData and DashToHls_ParseLive return one
+// moof/mdat pair per DASH moof/mdat.  The samples are copied as they are,
+// decrypted if needed, so no NALU rewriting or packetization takes place.
+// The segments need the init segment from DashToHls_GetInitSegment, which
+// goes in the playlist's EXT-X-MAP tag.
+//
+// kDashToHlsFormat_EncryptedFmp4 is fmp4 for players that decrypt CENC
+// themselves.  Encrypted samples are passed through without calling the
+// decryption handler, and the tenc, pssh and sample encryption data (senc,
+// saio, saiz) are kept, so no callbacks are needed.  'cbcs' content keeps
+// its scheme, pattern and constant IV.  The playlist tags come from
+// DashToHls_GetKeyTags.  Clear content comes out as plain fmp4.
+//
+// kDashToHlsFormat_CbcsFmp4 is fmp4 for players that only accept the 'cbcs'
+// scheme.  The samples are converted from AES-CTR to AES-CBC with the keys
+// from DashToHls_SetCbcsKeys instead of going through the callbacks, and are
+// never in the clear in memory.
+//
+// kDashToHlsFormat_ProgramStream is an MPEG-2 program stream for clients
+// that accept it instead of a transport stream.  It goes through the same
+// NALU rewriting and ADTS framing, but each sample is one pack instead of
+// a run of 188 byte packets, which saves about 2% on typical content.
+// Segments start with a system header and PSM, and no init segment is
+// needed.
+//
+// DashToHls_ConvertMuxedSegment always produces a transport stream.
+typedef enum {
+  kDashToHlsFormat_TransportStream = 0,
+  kDashToHlsFormat_Fmp4,
+  kDashToHlsFormat_EncryptedFmp4,
+  kDashToHlsFormat_CbcsFmp4,
+  kDashToHlsFormat_ProgramStream,
+  kDashToHlsFormat_Last
+} DashToHlsFormat;
+DashToHlsStatus DashToHls_SetOutputFormat(struct DashToHlsSession* session,
+                                          DashToHlsFormat format);
+
+// Builds the fmp4 init segment (ftyp and moov) from the moov parsed by
+// DashToHls_ParseDash or DashToHls_ParseLive.  It describes clear content
+// even when the DASH content is encrypted, as the fmp4 segments are
+// decrypted, except with kDashToHlsFormat_EncryptedFmp4 where it keeps the
+// protection scheme and the pssh boxes.  |init_segment| is owned by
+// |session| and valid until the next call or ReleaseSession.
+DashToHlsStatus DashToHls_GetInitSegment(struct DashToHlsSession* session,
+                                         const uint8_t** init_segment,
+                                         size_t* init_length);
+
+// Keys for kDashToHlsFormat_CbcsFmp4, all 16 bytes.  |cenc_key| is the
+// content key of the DASH stream's default key id, fragments rotated to
+// another key fail with kDashToHlsStatus_BadConfiguration.  The output is
+// encrypted with |cbcs_key| and the constant |cbcs_iv|, and signals
+// |cbcs_key_id|.  Video uses the 1:9 pattern, 1 block in 10 is encrypted,
+// audio is encrypted in full.  Must be called after DashToHls_ParseDash or
+// DashToHls_ParseLive.
+DashToHlsStatus DashToHls_SetCbcsKeys(struct DashToHlsSession* session,
+                                      const uint8_t* cenc_key,
+                                      const uint8_t* cbcs_key_id,
+                                      const uint8_t* cbcs_key,
+                                      const uint8_t* cbcs_iv);
+
+// Encrypts every segment |session| converts from now on for
+// #EXT-X-KEY:METHOD=AES-128, AES-128-CBC with PKCS7 padding, with the 16
+// byte |key| and |iv|, see DashToHls_GetHlsKeyTag for the playlist tag.
+// Segments are encrypted in place as they are packetized and grow by 1 to
+// 16 bytes of padding.  Encrypted content in kDashToHlsFormat_EncryptedFmp4
+// or kDashToHlsFormat_CbcsFmp4 keeps its own encryption.  Each I-frame of
+// an I-frame file is encrypted as a segment of its own.  With an output
+// sink each segment is handed over whole.  Replaces a
+// DashToHls_SetSampleAesKey key.  A nullptr |key| turns encryption off.
+DashToHlsStatus DashToHls_SetHlsEncryptionKey(
+    struct DashToHlsSession* session,
+    const uint8_t* key,
+    const uint8_t* iv);
+
+// Encrypts every kDashToHlsFormat_TransportStream segment |session|
+// converts from now on for #EXT-X-KEY:METHOD=SAMPLE-AES with the 16 byte
+// |key| and |iv|.  Only H.264 slices and AAC frames are encrypted, while
+// they are framed, so segments keep their size and still stream through an
+// output sink.  The PMT and the packed audio ID3 tag describe the encrypted
+// streams.  Other output formats fail with kDashToHlsStatus_BadConfiguration.
+// I-frame files are encrypted the same way.  Muxed segments use the video
+// session's key.  Replaces a DashToHls_SetHlsEncryptionKey key.  A nullptr
+// |key| turns encryption off.
+DashToHlsStatus DashToHls_SetSampleAesKey(struct DashToHlsSession* session,
+                                          const uint8_t* key,
+                                          const uint8_t* iv);
+
+// The playlist tag for segments encrypted by DashToHls_SetHlsEncryptionKey
+// or DashToHls_SetSampleAesKey, with the key at |uri|, e.g.
+// #EXT-X-KEY:METHOD=SAMPLE-AES,URI="https://...",IV=0x...
+// Returns kDashToHlsStatus_ClearContent if segments are not encrypted.
+// |tag| is owned by |session| and valid until the next call or
+// ReleaseSession.
+DashToHlsStatus DashToHls_GetHlsKeyTag(struct DashToHlsSession* session,
+                                       const char* uri,
+                                       const char** tag,
+                                       size_t* tag_length);
+
+// Playlist tags for encrypted content, one line per pssh box, for
+// kDashToHlsFormat_EncryptedFmp4.  The URI is a data URI holding the whole
+// pssh box, KEYFORMAT is the DRM system id and KEYID the default key id,
+// e.g.
+// #EXT-X-KEY:METHOD=SAMPLE-AES-CTR,URI="data:text/plain;base64,...",
+//   KEYID=0x...,KEYFORMAT="urn:uuid:...",KEYFORMATVERSIONS="1"
+// The METHOD is SAMPLE-AES for 'cbcs' content and kDashToHlsFormat_CbcsFmp4.
+// Returns kDashToHlsStatus_ClearContent if there is no pssh.  |tags| is
+// owned by |session| and valid until the next call or ReleaseSession.
+typedef enum {
+  kDashToHlsKeyTag_Key = 0,  // EXT-X-KEY, for media playlists.
+  kDashToHlsKeyTag_SessionKey  // EXT-X-SESSION-KEY, for master playlists.
+} DashToHlsKeyTag;
+DashToHlsStatus DashToHls_GetKeyTags(struct DashToHlsSession* session,
+                                     DashToHlsKeyTag tag,
+                                     const char** tags,
+                                     size_t* tags_length);
+
 // Optional call to free up some memory without destroying the entire
 // |session|.
 DashToHlsStatus DashToHls_ReleaseHlsSegment(struct DashToHlsSession* session,
                                             uint32_t hls_segment_number);
 
 typedef void* DashToHlsContext;
+
+// Optional streaming output.  Without a sink the converted segment is only
+// available once DashToHls_ConvertDashSegment (or ConvertDashSegmentData or
+// ParseLive) returns.  With a sink the converter hands over runs of complete
+// 188 byte TS packets (or ADTS frames for audio) as soon as at least
+// |flush_size| bytes are ready, so the PAT/PMT and the first GOP can be sent
+// while later samples are still being decrypted and packetized.  Whatever is
+// left when the segment is done is flushed before the call returns.
+//
+// The sink either takes all of |data| and returns kDashToHlsStatus_OK, or
+// takes none of it and returns kDashToHlsStatus_Backpressure.  Refused data
+// stays buffered and is offered again, with anything produced since, on the
+// next flush.  Data still refused at the end of the segment is returned in
+// |hls_segment| and |hls_length| as usual.  Any other status aborts the
+// conversion and is returned to the caller.
+//
+// A |flush_size| of 0 flushes after every sample.  Passing a nullptr |sink|
+// turns streaming off again.
+//
+// Streaming is not available while re-encrypting the output, in that case
+// the whole segment is delivered to the sink once it has been encrypted.
+typedef DashToHlsStatus (*HLS_OutputSink)(DashToHlsContext context,
+                                          const uint8_t* data,
+                                          size_t length);
+DashToHlsStatus DashToHls_SetOutputSink(struct DashToHlsSession* session,
+                                        DashToHlsContext context,
+                                        HLS_OutputSink sink,
+                                        size_t flush_size);
 // Common Encryption callbacks.  Common encryption (CENC) at Google is handled
 // by a module called the CDM.  Other implementations may use their own DRM
 // code to handle the decryption.  This library will call the CENC_PsshHandler
 // whenever a pssh box is seen with the entire contents of the box (no header).
+// A box is passed once per session: it is not passed again after the handler
+// returns kDashToHlsStatus_OK for it.  Setting the handler again forgets the
+// boxes, for a license that has to be requested again.
 //
 // Encrypted samples will be passed as just the encrypted portions.  See
 // ISO 23001-7 for an explanation of how subsample encryption works.  Or,
@@ -183,7 +505,9 @@ DashToHlsStatus DashToHls_SetCenc_PsshHandler(struct DashToHlsSession* session,
 
 // There are two modes for decrypting.  If useSampleEntries are set then the
 // entire data block, clear and encrypted, are sent to the callback with the
-// samples set to an array of SampleEntrySize SampleEntrys.
+// samples set to an array of SampleEntrySize SampleEntrys.  The callback
+// writes the whole sample to clear, clear bytes included.  Bytes after the
+// last SampleEntry are clear.
 // If use_sample_entries is false then the DashToHls library will concatenate
 // all encrypted data, pass just the encrypted data, and reinsert the clear
 // content.  If use_sample_entries is false then samples will be nullptr.
@@ -209,6 +533,144 @@ DashToHls_SetCenc_DecryptSample(struct DashToHlsSession* session,
                                 CENC_DecryptionHandler decryption_handler,
                                 bool use_sample_entries);
 
+// Optional in-place decryption, used instead of the DecryptSample handler,
+// which is then not required.  Each sample is copied once into the buffer
+// the transmuxer reads and the handler decrypts the ranges of buffer in
+// place.  The ranges are the encrypted bytes of the sample in order, and
+// the cipher runs through them as one stream starting at iv, exactly as if
+// they were concatenated.  This saves the gather, decrypt and scatter
+// copies of DashToHls_SetCenc_DecryptSample.
+struct DecryptRange {
+  size_t offset;
+  size_t length;
+};
+
+typedef DashToHlsStatus (*CENC_DecryptInPlaceHandler)(
+    DashToHlsContext context,
+    uint8_t* buffer,
+    size_t length,
+    const uint8_t* iv,  // iv is always 16 bytes.
+    const uint8_t* key_id,  // key_id is always 16 bytes.
+    const struct DecryptRange* ranges,
+    size_t range_count);
+DashToHlsStatus
+DashToHls_SetCenc_DecryptInPlace(
+    struct DashToHlsSession* session,
+    DashToHlsContext context,
+    CENC_DecryptInPlaceHandler decrypt_in_place_handler);
+
+// Optional batch decryption.  With a fragment handler set, all the samples
+// of a moof/mdat are decrypted in one call instead of one call per sample.
+// encrypted is the run of samples in the mdat, length bytes, and the
+// handler writes all of clear, clear bytes included.  Each of the
+// sample_count samples gives its place in encrypted, its IV and its
+// SampleEntrys, one covering the whole sample if it has no subsamples.
+// The samples are only valid during the call.
+// A DecryptSample or DecryptInPlace handler is still required.  I-frame
+// extraction keeps using it so that only sync samples are decrypted.
+struct FragmentSample {
+  size_t offset;
+  size_t length;
+  uint8_t iv[16];
+  const struct SampleEntry* entries;
+  size_t entry_count;
+};
+
+typedef DashToHlsStatus (*CENC_DecryptFragmentHandler)(
+    DashToHlsContext context,
+    const uint8_t* encrypted,
+    uint8_t* clear,
+    size_t length,
+    const uint8_t* key_id,  // key_id is always 16 bytes.
+    const struct FragmentSample* samples,
+    size_t sample_count);
+DashToHlsStatus
+DashToHls_SetCenc_DecryptFragment(
+    struct DashToHlsSession* session,
+    DashToHlsContext context,
+    CENC_DecryptFragmentHandler decrypt_fragment_handler);
+
+// Optional asynchronous decryption, used instead of the DecryptSample and
+// DecryptInPlace handlers by the TS, PS and fMP4 conversions.  The handler
+// starts decrypting a whole sample, like DecryptSample with
+// use_sample_entries, and returns without waiting for it.  Once clear is
+// written, on any thread, it calls DashToHls_FinishDecryption with
+// decryption.  Up to max_in_flight samples are started before the
+// conversion waits for the oldest, so the CDM works on the next samples
+// while the finished ones are converted.  encrypted, entries and clear stay
+// valid until the sample is finished.  A handler that returns an error must
+// not finish the sample.  Every sample it returns kDashToHlsStatus_OK for has
+// to be finished, the conversion waits for them even if it fails.
+// A DecryptSample or DecryptInPlace handler is still required, the other
+// conversions keep using it.
+struct DashToHlsDecryption;
+
+typedef DashToHlsStatus (*CENC_DecryptAsyncHandler)(
+    DashToHlsContext context,
+    const uint8_t* encrypted,
+    uint8_t* clear,
+    size_t length,
+    const uint8_t* iv,  // iv is always 16 bytes.
+    const uint8_t* key_id,  // key_id is always 16 bytes.
+    const struct SampleEntry* entries,
+    size_t entry_count,
+    struct DashToHlsDecryption* decryption);
+DashToHlsStatus
+DashToHls_SetCenc_DecryptAsync(
+    struct DashToHlsSession* session,
+    DashToHlsContext context,
+    CENC_DecryptAsyncHandler decrypt_async_handler,
+    size_t max_in_flight);
+// Finishes a sample started by the CENC_DecryptAsyncHandler.  status is
+// kDashToHlsStatus_OK if clear has been written.
+DashToHlsStatus DashToHls_FinishDecryption(
+    struct DashToHlsDecryption* decryption,
+    DashToHlsStatus status);
+
+// Optional key lookup.  With a key context handler set, the CDM looks up
+// the key of a key id once instead of for every sample.  The handler is
+// called the first time a fragment uses a key id, also when keys rotate
+// from fragment to fragment, and sets key_context to what the
+// DecryptSample, DecryptInPlace, DecryptFragment and DecryptAsync handlers
+// are then passed for its samples instead of their own contexts.  The
+// key_id is still passed to them.  The session remembers the last 16 key
+// ids, a key id the handler fails on is tried again with the next
+// fragment.  Key ids with a content key are not passed to the handler.
+typedef DashToHlsStatus (*CENC_KeyContextHandler)(
+    DashToHlsContext context,
+    const uint8_t* key_id,  // key_id is always 16 bytes.
+    DashToHlsContext* key_context);
+// Hands back a key_context the session no longer uses, so the CDM can free
+// it.  That is when a 17th key id pushes out the oldest, when the key
+// context handler or a content key is set again, and in
+// DashToHls_ReleaseSession.  Contexts of failed lookups are never kept.
+// Optional, may be nullptr.
+typedef void (*CENC_ReleaseKeyContextHandler)(
+    DashToHlsContext context,
+    DashToHlsContext key_context);
+DashToHlsStatus
+DashToHls_SetCenc_KeyContextHandler(
+    struct DashToHlsSession* session,
+    DashToHlsContext context,
+    CENC_KeyContextHandler key_context_handler,
+    CENC_ReleaseKeyContextHandler release_key_context_handler);
+
+// Optional built-in AES-128-CTR decryption for content whose key is already
+// known, such as our own packaged content and test content.  Samples with
+// key_id are decrypted with key, both 16 bytes, instead of by the CENC
+// callbacks.  With a content key set the callbacks are not required.
+// Setting the same key_id again replaces its key.  Set the keys before
+// DashToHls_ParseDash or DashToHls_ParseLive.
+//
+// Content in the 'cbcs' scheme, AES-CBC with a pattern as signalled by the
+// schm and tenc boxes, can only be decrypted with a content key, as the
+// callbacks above are AES-CTR only, and only to clear output formats.  Only
+// the encrypted blocks of the pattern are decrypted, in place.
+DashToHlsStatus
+DashToHls_SetCenc_ContentKey(struct DashToHlsSession* session,
+                             const uint8_t* key_id,
+                             const uint8_t* key);
+
 // Optional Callback for diagnostic messages.  Returns a structured JSON
 // object (C string) with detailed information.
 // TODO(justsomeguy) Document json object.
@@ -47,14 +47,26 @@
       'sources': [
         '../include/DashToHlsApi.h',
         '../include/DashToHlsApiAVFramework.h',
+        'async_decrypter.cc',
+        'async_decrypter.h',
+        'byte_buffer.cc',
+        'byte_buffer.h',
+        'clock_rescaler.cc',
+        'clock_rescaler.h',
         'dash_to_hls_api.cc',
         'dash_to_hls_session.h',
+        'sample_encryption_table.cc',
+        'sample_encryption_table.h',
+        'segment_planner.cc',
+        'segment_planner.h',
         'utilities.cc',
         'utilities.h',
       ],
       'dependencies': [
+        'DashToHlsCrypto',
         'DashToHlsDash',
         'DashToHlsDefaultDiagnosticCallback',
+        'DashToHlsFmp4',
         'DashToHlsPs',
         'DashToHlsTs',
       ],
@@ -117,6 +129,48 @@
         'ts/transport_stream_out.h',
       ],
     },
+    {
+      'target_name': 'DashToHlsCrypto',
+      'type': 'static_library',
+      'xcode_settings': {
+        'GCC_PREFIX_HEADER': 'DashToHls_osx.pch',
+        'CLANG_CXX_LIBRARY': 'libc++',
+      },
+      'include_dirs': [
+        '..',
+      ],
+      'sources': [
+        'crypto/aes.cc',
+        'crypto/aes.h',
+        'crypto/aes_ctr.cc',
+        'crypto/aes_ctr.h',
+        'crypto/cbcs_decrypter.cc',
+        'crypto/cbcs_decrypter.h',
+        'crypto/cbcs_transcrypter.cc',
+        'crypto/cbcs_transcrypter.h',
+        'crypto/hls_encrypter.cc',
+        'crypto/hls_encrypter.h',
+        'crypto/sample_aes_encrypter.cc',
+        'crypto/sample_aes_encrypter.h',
+      ],
+    },
+    {
+      'target_name': 'DashToHlsFmp4',
+      'type': 'static_library',
+      'xcode_settings': {
+        'GCC_PREFIX_HEADER': 'DashToHls_osx.pch',
+        'CLANG_CXX_LIBRARY': 'libc++',
+      },
+      'include_dirs': [
+        '..',
+      ],
+      'sources': [
+        'fmp4/box_writer.cc',
+        'fmp4/box_writer.h',
+        'fmp4/fmp4_out.cc',
+        'fmp4/fmp4_out.h',
+      ],
+    },
     # Note: If you depend on any of the sub-libraries here, you either need to
     # depend on this to implement the DashToHlsDefaultDiagnosticCallback
     # function, or, implement it yourself. Otherwise, the project will fail to
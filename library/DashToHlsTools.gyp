@@ -191,11 +191,20 @@
         '<@(test_content)',
       ],
       'sources': [
+        'adts/adts_out_test.cc',
+        'crypto/aes_ctr_test.cc',
+        'crypto/aes_test.cc',
+        'crypto/cbcs_decrypter_test.cc',
+        'crypto/cbcs_transcrypter_test.cc',
+        'crypto/hls_encrypter_test.cc',
+        'crypto/sample_aes_encrypter_test.cc',
         'dash/box_contents_test.cc',
         'dash/box_test.cc',
         'dash/box_type_test.cc',
         'dash/dash_parser_test.cc',
         'dash_to_hls_api_test.cc',
+        'fmp4/box_writer_test.cc',
+        'fmp4/fmp4_out_test.cc',
         'mac_test_files.mm',
         'mac_test_files.h',
         'ps/nalu_test.cc',
@@ -206,7 +215,12 @@
         'ts/transport_stream_out_test.cc',
         'utilities_gmock.h',
         'utilities_test.cc',
+        'async_decrypter_test.cc',
         'bit_reader_test.cc',
+        'byte_buffer_test.cc',
+        'clock_rescaler_test.cc',
+        'sample_encryption_table_test.cc',
+        'segment_planner_test.cc',
         '<(gtest_main)',
       ],
     },
@@ -19,8 +19,13 @@
 #include "library/utilities.h"
 
 namespace {
-  const size_t kAudioFrameHeaderSize = 7;
-  const size_t kMaxAudioFrameLength = 8191;
+// The 13 bit frame length starts in the low 2 bits of byte 3.
+const size_t kFrameLengthOffset = 3;
+const uint8_t kFrameLengthHighMask = 0x03;
+const uint8_t kFrameLengthLowMask = 0xe0;
+// The ID3 tag size is synchsafe, the tags here are short enough for the low
+// byte alone.
+const size_t kID3TagSizeOffset = 9;
 }  // namespace
 
 namespace dash2hls {
@@ -41,33 +46,48 @@ const uint8_t AdtsOut::kID3AudioTimeTag[73] = {
 };
 const size_t kID3AudioTimeTagTimeOffsetFromEnd = 8;
 
-void AdtsOut::AddTimestamp(uint64_t pts, std::vector<uint8_t>* out) {
+// The PRIV frame holding the SAMPLE-AES audio_setup_information: 'zaac', no
+// priming, version 1 and the 2 byte AudioSpecificConfig, filled in by
+// AddTimestamp.
+const uint8_t AdtsOut::kID3AudioDescription[kID3AudioDescriptionSize] = {
+  0x50, 0x52, 0x49, 0x56, 0x00, 0x00, 0x00, 0x2f,
+  0x00, 0x00, 0x63, 0x6f, 0x6d, 0x2e, 0x61, 0x70,
+  0x70, 0x6c, 0x65, 0x2e, 0x73, 0x74, 0x72, 0x65,
+  0x61, 0x6d, 0x69, 0x6e, 0x67, 0x2e, 0x61, 0x75,
+  0x64, 0x69, 0x6f, 0x44, 0x65, 0x73, 0x63, 0x72,
+  0x69, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x00, 0x7a,
+  0x61, 0x61, 0x63, 0x00, 0x00, 0x01, 0x02, 0x00,
+  0x00
+};
+const size_t kID3AudioConfigOffsetFromEnd = 2;
+
+void AdtsOut::AddTimestamp(uint64_t pts, ByteBuffer* out) const {
   size_t out_size = out->size();
   out->resize(out_size + sizeof(kID3AudioTimeTag));
   memcpy(&(*out)[out_size], kID3AudioTimeTag, sizeof(kID3AudioTimeTag));
   htonllToBuffer(pts,
                  &(*out)[out->size() - kID3AudioTimeTagTimeOffsetFromEnd]);
+  if (!sample_aes_) {
+    return;
+  }
+  (*out)[out_size + kID3TagSizeOffset] += sizeof(kID3AudioDescription);
+  out->append(kID3AudioDescription, sizeof(kID3AudioDescription));
+  uint16_t audio_config = (audio_object_type_ << 11) |
+      (sampling_frequency_index_ << 7) | (channel_config_ << 3);
+  htonsToBuffer(audio_config,
+                &(*out)[out->size() - kID3AudioConfigOffsetFromEnd]);
 }
 
 // TODO(justsomeguy) Code copied from the Widevine tree has quite a few
 // magic numbers.  This is because it builds up the header by adding bits
 // and shifting, adding bits and shifting.  I want to rewrite this to build
 // in place and use constants.
-void AdtsOut::ProcessSample(const uint8_t* input, size_t input_length,
-                                       std::vector<uint8_t>* out) {
-  size_t frame_size = input_length + kAudioFrameHeaderSize;
-  if (frame_size > kMaxAudioFrameLength) {
-    DASH_LOG("Bad audio sample",
-             "Audio frames larger than 8191 bytes not supported.",
-             DumpMemory(input, input_length).c_str());
-    return;
-  }
-  out->resize(frame_size);
+void AdtsOut::UpdateHeader() {
   uint64_t adts_header = 0xfff;
   adts_header <<= 4;
   adts_header |= 0x01;
   adts_header <<= 2;
-  adts_header |= (audio_object_type_ - 1);
+  adts_header |= (audio_object_type_ - 1) & 0x03;
   adts_header <<= 4;
   adts_header |= sampling_frequency_index_;
   adts_header <<= 4;
@@ -75,12 +95,43 @@ void AdtsOut::ProcessSample(const uint8_t* input, size_t input_length,
   adts_header <<= 4;
   adts_header |= 0x0c;
   adts_header <<= 13;
-  adts_header |= frame_size;
+  // The frame length goes here.
   adts_header <<= 11;
   adts_header |= 0x7ff;
   adts_header <<=2;
   adts_header <<= 8;
-  htonllToBuffer(adts_header, &(*out)[0]);
-  memcpy(&(*out)[kAudioFrameHeaderSize], input, input_length);
+  uint8_t buffer[sizeof(adts_header)];
+  htonllToBuffer(adts_header, buffer);
+  memcpy(header_, buffer, sizeof(header_));
+}
+
+size_t AdtsOut::WriteFrame(const uint8_t* input, size_t input_length,
+                           uint8_t* out) const {
+  size_t frame_size = input_length + kHeaderSize;
+  if (frame_size > kMaxFrameLength) {
+    DASH_LOG("Bad audio sample",
+             "Audio frames larger than 8191 bytes not supported.",
+             DumpMemory(input, input_length).c_str());
+    return 0;
+  }
+  memcpy(out, header_, kHeaderSize);
+  out[kFrameLengthOffset] |= static_cast<uint8_t>(frame_size >> 11) &
+      kFrameLengthHighMask;
+  out[kFrameLengthOffset + 1] = static_cast<uint8_t>(frame_size >> 3);
+  out[kFrameLengthOffset + 2] |= static_cast<uint8_t>(frame_size << 5) &
+      kFrameLengthLowMask;
+  memcpy(out + kHeaderSize, input, input_length);
+  if (sample_aes_) {
+    sample_aes_->EncryptAdtsFrame(out, frame_size);
+  }
+  return frame_size;
+}
+
+void AdtsOut::ProcessSample(const uint8_t* input, size_t input_length,
+                                       ByteBuffer* out) const {
+  out->resize(input_length + kHeaderSize);
+  if (!WriteFrame(input, input_length, out->data())) {
+    out->clear();
+  }
 }
 }  // namespace dash2hls
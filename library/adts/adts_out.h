@@ -19,12 +19,21 @@
 
 // AdtsOut takes mp4 samples and turns them into ADTS samples.
 //
-// Expected usage is to call AdtsOut::ProcessSample.
-// All other routines are exposed for unit testing.
+// The ADTS header only depends on the audio config and the frame length, so
+// the setters build a header template and each frame copies it and patches
+// the 13 bit length.  WriteFrame writes into memory the caller has already
+// sized, see GetPackedSize, so a whole segment is one allocation and one
+// memcpy per frame.  ProcessSample is the ByteBuffer convenience version.
+//
+// With set_sample_aes each frame is encrypted for SAMPLE-AES as it is
+// written and the ID3 tag also carries the audio description the player
+// needs to set up the decoder.
 
 #include <vector>
 
 #include "include/DashToHlsApi.h"
+#include "library/byte_buffer.h"
+#include "library/crypto/sample_aes_encrypter.h"
 #include "library/dash/box_type.h"
 #include "library/dash/full_box_contents.h"
 #include "library/ps/nalu.h"
@@ -34,25 +43,72 @@ namespace dash2hls {
 
 class AdtsOut {
 public:
-  void AddTimestamp(uint64_t pts, std::vector<uint8_t>* out);
+  enum {
+    kHeaderSize = 7,
+    kMaxFrameLength = 8191,
+  };
+
+  AdtsOut() : audio_object_type_(0),
+              sampling_frequency_index_(0),
+              channel_config_(0),
+              sample_aes_(nullptr) {
+    UpdateHeader();
+  }
+
+  void AddTimestamp(uint64_t pts, ByteBuffer* out) const;
+  // Bytes AddTimestamp plus a WriteFrame for each of |frame_count| samples
+  // holding |payload_size| bytes in total produce, without SAMPLE-AES.
+  static size_t GetPackedSize(size_t frame_count, size_t payload_size) {
+    return sizeof(kID3AudioTimeTag) + frame_count * kHeaderSize +
+        payload_size;
+  }
+  // Bytes AddTimestamp adds for SAMPLE-AES.
+  size_t get_audio_description_size() const {
+    return sample_aes_ ? kID3AudioDescriptionSize : 0;
+  }
+  // Writes the header and |input| to |out|, which has room for
+  // |input_length| + kHeaderSize bytes.  Returns the bytes written, 0 if
+  // the frame is too large for ADTS.
+  size_t WriteFrame(const uint8_t* input, size_t input_length,
+                    uint8_t* out) const;
   // TODO(justsomeguy) this interface requires an extra copy of input because
   // it's const.  See about doing it in place.
   void ProcessSample(const uint8_t* input, size_t input_length,
-                     std::vector<uint8_t>* out);
+                     ByteBuffer* out) const;
 
-  void set_audio_object_type(uint8_t type) {audio_object_type_ = type;}
-  void set_channel_config(uint8_t config) {channel_config_ = config;}
+  void set_audio_object_type(uint8_t type) {
+    audio_object_type_ = type;
+    UpdateHeader();
+  }
+  void set_channel_config(uint8_t config) {
+    channel_config_ = config;
+    UpdateHeader();
+  }
   void set_sampling_frequency_index(uint8_t index) {
     sampling_frequency_index_ = index;
+    UpdateHeader();
+  }
+  // |encrypter| must outlive the AdtsOut, nullptr writes clear frames.
+  void set_sample_aes(const SampleAesEncrypter* encrypter) {
+    sample_aes_ = encrypter;
   }
 
 protected:
+  enum {
+    kID3AudioDescriptionSize = 57,
+  };
   static const uint8_t kID3AudioTimeTag[73];
+  static const uint8_t kID3AudioDescription[kID3AudioDescriptionSize];
 
 private:
+  void UpdateHeader();
+
   uint8_t audio_object_type_;
   uint8_t sampling_frequency_index_;
   uint8_t channel_config_;
+  const SampleAesEncrypter* sample_aes_;
+  // Header with a frame length of 0.
+  uint8_t header_[kHeaderSize];
 };
 }  // namespace dash2hls
 
@@ -0,0 +1,105 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include "library/adts/adts_out.h"
+
+namespace dash2hls {
+
+namespace {
+// AAC LC, 44100Hz, stereo.
+void SetAacLcStereo(AdtsOut* adts_out) {
+  adts_out->set_audio_object_type(2);
+  adts_out->set_sampling_frequency_index(4);
+  adts_out->set_channel_config(2);
+}
+}  // namespace
+
+TEST(AdtsOut, WriteFrame) {
+  const uint8_t kShortHeader[] = {0xff, 0xf1, 0x50, 0xb0, 0x0d, 0x7f, 0xfc};
+  const uint8_t kLongHeader[] = {0xff, 0xf1, 0x50, 0xb1, 0xf4, 0xff, 0xfc};
+  AdtsOut adts_out;
+  SetAacLcStereo(&adts_out);
+
+  std::vector<uint8_t> sample(4000, 0xa5);
+  std::vector<uint8_t> out(sample.size() + AdtsOut::kHeaderSize);
+  EXPECT_EQ(107u, adts_out.WriteFrame(&sample[0], 100, &out[0]));
+  EXPECT_EQ(0, memcmp(kShortHeader, &out[0], sizeof(kShortHeader)));
+  EXPECT_EQ(0, memcmp(&sample[0], &out[AdtsOut::kHeaderSize], 100));
+
+  // The template must not keep the length bits of the previous frame.
+  EXPECT_EQ(4007u, adts_out.WriteFrame(&sample[0], sample.size(), &out[0]));
+  EXPECT_EQ(0, memcmp(kLongHeader, &out[0], sizeof(kLongHeader)));
+  EXPECT_EQ(0, memcmp(&sample[0], &out[AdtsOut::kHeaderSize],
+                      sample.size()));
+}
+
+TEST(AdtsOut, FrameTooLarge) {
+  AdtsOut adts_out;
+  SetAacLcStereo(&adts_out);
+  std::vector<uint8_t> sample(AdtsOut::kMaxFrameLength);
+  std::vector<uint8_t> out(sample.size() + AdtsOut::kHeaderSize);
+  EXPECT_EQ(0u, adts_out.WriteFrame(&sample[0], sample.size(), &out[0]));
+
+  ByteBuffer processed;
+  adts_out.ProcessSample(&sample[0], sample.size(), &processed);
+  EXPECT_EQ(0u, processed.size());
+}
+
+TEST(AdtsOut, PackedSize) {
+  AdtsOut adts_out;
+  SetAacLcStereo(&adts_out);
+  const uint8_t kSample[] = {1, 2, 3, 4, 5};
+  ByteBuffer out;
+  adts_out.AddTimestamp(90000, &out);
+  for (size_t count = 0; count < 3; ++count) {
+    ByteBuffer frame;
+    adts_out.ProcessSample(kSample, sizeof(kSample), &frame);
+    out.append(frame.data(), frame.size());
+  }
+  EXPECT_EQ(AdtsOut::GetPackedSize(3, 3 * sizeof(kSample)), out.size());
+}
+
+TEST(AdtsOut, SampleAes) {
+  const uint8_t kKey[16] = {1};
+  const uint8_t kIv[16] = {2};
+  SampleAesEncrypter encrypter;
+  encrypter.Init(kKey, kIv);
+  AdtsOut adts_out;
+  SetAacLcStereo(&adts_out);
+  adts_out.set_sample_aes(&encrypter);
+
+  // The ID3 tag grows by the audio description, ending in the
+  // AudioSpecificConfig.
+  ByteBuffer out;
+  adts_out.AddTimestamp(90000, &out);
+  ASSERT_EQ(AdtsOut::GetPackedSize(0, 0) +
+            adts_out.get_audio_description_size(), out.size());
+  EXPECT_EQ(out.size() - 10, out[9]);
+  EXPECT_EQ(0x12, out[out.size() - 2]);
+  EXPECT_EQ(0x10, out[out.size() - 1]);
+
+  // The header and the first 16 bytes stay clear.
+  std::vector<uint8_t> sample(100, 0xa5);
+  std::vector<uint8_t> frame(sample.size() + AdtsOut::kHeaderSize);
+  EXPECT_EQ(frame.size(),
+            adts_out.WriteFrame(&sample[0], sample.size(), &frame[0]));
+  EXPECT_EQ(0xff, frame[0]);
+  EXPECT_EQ(0, memcmp(&sample[0], &frame[AdtsOut::kHeaderSize], 16));
+  EXPECT_NE(0, memcmp(&sample[16], &frame[AdtsOut::kHeaderSize + 16], 16));
+}
+}  // namespace dash2hls
@@ -0,0 +1,107 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/async_decrypter.h"
+
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+AsyncDecrypter::AsyncDecrypter(CENC_DecryptAsyncHandler handler,
+                               size_t max_in_flight)
+    : handler_(handler), slots_(max_in_flight), oldest_(0), in_flight_(0) {
+  for (size_t count = 0; count < slots_.size(); ++count) {
+    slots_[count].owner = this;
+    slots_[count].done = false;
+    slots_[count].status = kDashToHlsStatus_OK;
+  }
+}
+
+AsyncDecrypter::~AsyncDecrypter() {
+  // The handler still writes to the slots of unfinished samples.
+  const uint8_t* clear = nullptr;
+  size_t length = 0;
+  while (!empty()) {
+    Finish(&clear, &length);
+  }
+}
+
+bool AsyncDecrypter::Start(DashToHlsContext context,
+                           const uint8_t* encrypted, size_t length,
+                           const uint8_t* iv, const uint8_t* key_id,
+                           const SampleEntry* entries, size_t entry_count) {
+  if (full()) {
+    DASH_LOG("Too many decryptions.", "Finish a sample first.", "");
+    return false;
+  }
+  Slot& slot = slots_[(oldest_ + in_flight_) % slots_.size()];
+  slot.clear.resize(length);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.done = false;
+  }
+  ++in_flight_;
+  // The handler can finish the sample before it returns.
+  DashToHlsStatus status =
+      handler_(context, encrypted, slot.clear.data(), length, iv, key_id,
+               entries, entry_count,
+               reinterpret_cast<DashToHlsDecryption*>(&slot));
+  if (status != kDashToHlsStatus_OK) {
+    --in_flight_;
+    DASH_LOG("Decryption failed.", "The async handler refused a sample.",
+             "");
+    return false;
+  }
+  return true;
+}
+
+bool AsyncDecrypter::Finish(const uint8_t** clear, size_t* length) {
+  if (empty()) {
+    DASH_LOG("No decryption.", "No sample was started.", "");
+    return false;
+  }
+  Slot& slot = slots_[oldest_];
+  DashToHlsStatus status;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!slot.done) {
+      completed_.wait(lock);
+    }
+    status = slot.status;
+  }
+  oldest_ = (oldest_ + 1) % slots_.size();
+  --in_flight_;
+  if (status != kDashToHlsStatus_OK) {
+    DASH_LOG("Decryption failed.", "The async handler failed a sample.", "");
+    return false;
+  }
+  *clear = slot.clear.data();
+  *length = slot.clear.size();
+  return true;
+}
+
+void AsyncDecrypter::Complete(DashToHlsDecryption* decryption,
+                              DashToHlsStatus status) {
+  Slot* slot = reinterpret_cast<Slot*>(decryption);
+  AsyncDecrypter* owner = slot->owner;
+  std::lock_guard<std::mutex> lock(owner->mutex_);
+  slot->status = status;
+  slot->done = true;
+  // Notified under the lock, the owner can go away as soon as it sees the
+  // sample done.
+  owner->completed_.notify_all();
+}
+}  // namespace dash2hls
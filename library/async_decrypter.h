@@ -0,0 +1,95 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Keeps up to a limit of samples being decrypted by a
+// CENC_DecryptAsyncHandler at once and hands them back in the order they
+// were started.  The handler finishes them on any thread with
+// DashToHls_FinishDecryption, the converting thread only waits when the
+// oldest sample is not done yet, so the CDM works on the next samples while
+// the finished ones are converted.
+//
+// EXAMPLE:
+//   AsyncDecrypter decrypter(handler, max_in_flight);
+//   for (each sample) {
+//     while (!decrypter.full() && samples left to start) {
+//       decrypter.Start(context, encrypted, length, iv, key_id, entries,
+//                       entry_count);
+//     }
+//     decrypter.Finish(&clear, &clear_length);
+//     Convert(clear, clear_length);
+//   }
+//   // The destructor waits for any samples still in flight.
+
+#ifndef DASHTOHLS_ASYNC_DECRYPTER_H_
+#define DASHTOHLS_ASYNC_DECRYPTER_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "include/DashToHlsApi.h"
+#include "library/byte_buffer.h"
+
+namespace dash2hls {
+class AsyncDecrypter {
+ public:
+  // Up to |max_in_flight| samples are handed to |handler| before the
+  // oldest is waited for.
+  AsyncDecrypter(CENC_DecryptAsyncHandler handler, size_t max_in_flight);
+  ~AsyncDecrypter();
+
+  bool full() const {return in_flight_ == slots_.size();}
+  bool empty() const {return in_flight_ == 0;}
+
+  // Hands the |length| bytes at |encrypted| to the handler.  |encrypted|,
+  // |entries| and the clear buffer have to stay valid until the sample is
+  // finished.  Returns false if the handler refused it.
+  bool Start(DashToHlsContext context, const uint8_t* encrypted,
+             size_t length, const uint8_t* iv, const uint8_t* key_id,
+             const SampleEntry* entries, size_t entry_count);
+  // Waits for the oldest sample started.  |*clear| is valid until the next
+  // Start or Finish.  Returns false if it could not be decrypted.
+  bool Finish(const uint8_t** clear, size_t* length);
+
+  // See DashToHls_FinishDecryption.  Safe on any thread.
+  static void Complete(DashToHlsDecryption* decryption,
+                       DashToHlsStatus status);
+
+ private:
+  struct Slot {
+    AsyncDecrypter* owner;
+    ByteBuffer clear;
+    // Set by Complete, under |mutex_|.
+    bool done;
+    DashToHlsStatus status;
+  };
+
+  // The slots are a ring, the oldest in flight is |oldest_|.  They are
+  // never reallocated, the handler holds pointers to them.
+  CENC_DecryptAsyncHandler handler_;
+  std::vector<Slot> slots_;
+  size_t oldest_;
+  size_t in_flight_;
+  std::mutex mutex_;
+  std::condition_variable completed_;
+
+  AsyncDecrypter(const AsyncDecrypter&) = delete;
+  AsyncDecrypter& operator=(const AsyncDecrypter&) = delete;
+};  // class AsyncDecrypter
+}  // namespace dash2hls
+#endif  // DASHTOHLS_ASYNC_DECRYPTER_H_
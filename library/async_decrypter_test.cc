@@ -0,0 +1,137 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/async_decrypter.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace dash2hls {
+namespace {
+// Keeps the samples it is given without finishing them.
+struct PendingSample {
+  const uint8_t* encrypted;
+  uint8_t* clear;
+  size_t length;
+  DashToHlsDecryption* decryption;
+};
+
+struct Pending {
+  std::vector<PendingSample> samples;
+  DashToHlsStatus status;
+};
+
+DashToHlsStatus KeepSample(DashToHlsContext context,
+                           const uint8_t* encrypted, uint8_t* clear,
+                           size_t length, const uint8_t* iv,
+                           const uint8_t* key_id, const SampleEntry* entries,
+                           size_t entry_count,
+                           DashToHlsDecryption* decryption) {
+  Pending* pending = reinterpret_cast<Pending*>(context);
+  if (pending->status == kDashToHlsStatus_OK) {
+    PendingSample sample = {encrypted, clear, length, decryption};
+    pending->samples.push_back(sample);
+  }
+  return pending->status;
+}
+
+// "Decrypts" by adding 1 to every byte.
+void Decrypt(const PendingSample& sample) {
+  for (size_t count = 0; count < sample.length; ++count) {
+    sample.clear[count] = sample.encrypted[count] + 1;
+  }
+}
+}  // namespace
+
+TEST(Dash2HLS, AsyncDecrypterInOrder) {
+  const uint8_t kSamples[3][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+  Pending pending;
+  pending.status = kDashToHlsStatus_OK;
+  AsyncDecrypter decrypter(KeepSample, 2);
+  EXPECT_TRUE(decrypter.empty());
+  EXPECT_TRUE(decrypter.Start(&pending, kSamples[0], 4, nullptr, nullptr,
+                              nullptr, 0));
+  EXPECT_TRUE(decrypter.Start(&pending, kSamples[1], 3, nullptr, nullptr,
+                              nullptr, 0));
+  EXPECT_TRUE(decrypter.full());
+  EXPECT_FALSE(decrypter.Start(&pending, kSamples[2], 4, nullptr, nullptr,
+                               nullptr, 0));
+  ASSERT_EQ(2u, pending.samples.size());
+
+  // Finished out of order on another thread, handed back in order.
+  std::thread worker([&pending]() {
+    for (size_t count = pending.samples.size(); count > 0; --count) {
+      Decrypt(pending.samples[count - 1]);
+      AsyncDecrypter::Complete(pending.samples[count - 1].decryption,
+                               kDashToHlsStatus_OK);
+    }
+  });
+  const uint8_t* clear = nullptr;
+  size_t length = 0;
+  ASSERT_TRUE(decrypter.Finish(&clear, &length));
+  ASSERT_EQ(4u, length);
+  EXPECT_EQ(2, clear[0]);
+  EXPECT_EQ(5, clear[3]);
+  ASSERT_TRUE(decrypter.Finish(&clear, &length));
+  ASSERT_EQ(3u, length);
+  EXPECT_EQ(6, clear[0]);
+  worker.join();
+  EXPECT_TRUE(decrypter.empty());
+  EXPECT_FALSE(decrypter.Finish(&clear, &length));
+
+  // The slots are used again.
+  EXPECT_TRUE(decrypter.Start(&pending, kSamples[2], 4, nullptr, nullptr,
+                              nullptr, 0));
+  ASSERT_EQ(3u, pending.samples.size());
+  Decrypt(pending.samples[2]);
+  AsyncDecrypter::Complete(pending.samples[2].decryption,
+                           kDashToHlsStatus_OK);
+  ASSERT_TRUE(decrypter.Finish(&clear, &length));
+  EXPECT_EQ(13, clear[3]);
+}
+
+TEST(Dash2HLS, AsyncDecrypterFailures) {
+  const uint8_t kSample[4] = {1, 2, 3, 4};
+  Pending pending;
+  pending.status = kDashToHlsStatus_BadConfiguration;
+  AsyncDecrypter decrypter(KeepSample, 2);
+  // Refused samples are not in flight.
+  EXPECT_FALSE(decrypter.Start(&pending, kSample, 4, nullptr, nullptr,
+                               nullptr, 0));
+  EXPECT_TRUE(decrypter.empty());
+
+  pending.status = kDashToHlsStatus_OK;
+  EXPECT_TRUE(decrypter.Start(&pending, kSample, 4, nullptr, nullptr,
+                              nullptr, 0));
+  AsyncDecrypter::Complete(pending.samples[0].decryption,
+                           kDashToHlsStatus_BadDashContents);
+  const uint8_t* clear = nullptr;
+  size_t length = 0;
+  EXPECT_FALSE(decrypter.Finish(&clear, &length));
+  EXPECT_TRUE(decrypter.empty());
+
+  // Going away waits for the sample still in flight.
+  EXPECT_TRUE(decrypter.Start(&pending, kSample, 4, nullptr, nullptr,
+                              nullptr, 0));
+  ASSERT_EQ(2u, pending.samples.size());
+  std::thread worker([&pending]() {
+    AsyncDecrypter::Complete(pending.samples[1].decryption,
+                             kDashToHlsStatus_OK);
+  });
+  worker.join();
+}
+}  // namespace dash2hls
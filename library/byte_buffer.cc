@@ -0,0 +1,103 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/byte_buffer.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+namespace {
+// Small buffers, like a single TS packet, are common.  Skip the first few
+// doublings.
+const size_t kMinimumCapacity = 256;
+}  // namespace
+
+namespace dash2hls {
+
+ByteBuffer::ByteBuffer(const uint8_t* data, size_t length)
+    : data_(nullptr), size_(0), capacity_(0) {
+  reserve_exact(length);
+  append(data, length);
+}
+
+ByteBuffer::ByteBuffer(ByteBuffer&& other)
+    : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.capacity_ = 0;
+}
+
+ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) {
+  if (this != &other) {
+    free(data_);
+    data_ = other.data_;
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+  }
+  return *this;
+}
+
+ByteBuffer::~ByteBuffer() {
+  free(data_);
+}
+
+void ByteBuffer::reserve_exact(size_t capacity) {
+  if (capacity <= capacity_) {
+    return;
+  }
+  uint8_t* data = static_cast<uint8_t*>(realloc(data_, capacity));
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  data_ = data;
+  capacity_ = capacity;
+}
+
+void ByteBuffer::Grow(size_t size) {
+  size_t capacity = capacity_ * 2;
+  if (capacity < kMinimumCapacity) {
+    capacity = kMinimumCapacity;
+  }
+  if (capacity < size) {
+    capacity = size;
+  }
+  reserve_exact(capacity);
+}
+
+void ByteBuffer::swap(ByteBuffer& other) {
+  uint8_t* data = data_;
+  size_t size = size_;
+  size_t capacity = capacity_;
+  data_ = other.data_;
+  size_ = other.size_;
+  capacity_ = other.capacity_;
+  other.data_ = data;
+  other.size_ = size;
+  other.capacity_ = capacity;
+}
+
+uint8_t* ByteBuffer::Release() {
+  uint8_t* data = data_;
+  data_ = nullptr;
+  size_ = 0;
+  capacity_ = 0;
+  return data;
+}
+}  // namespace dash2hls
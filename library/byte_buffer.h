@@ -0,0 +1,107 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Growable output buffer for the writers.  The interface is the subset of
+// std::vector<uint8_t> the writers use, with two differences:
+//
+// resize() does not initialize the new bytes.  Every writer resizes and then
+// overwrites the whole range, so the zero fill std::vector does first is
+// wasted bandwidth roughly equal to the size of the output.
+//
+// Storage comes from malloc/realloc, so growing a large segment can often
+// extend the block in place instead of copying it.  reserve_exact() is for
+// callers who know the final size; reserve() and resize() grow
+// geometrically.
+//
+// Release() hands the storage to the caller, who owns it and must free() it.
+//
+// EXAMPLE:
+//   ByteBuffer out;
+//   out.resize(kTsPacketSize);
+//   memcpy(out.data(), packet, kTsPacketSize);
+//   out.append(pes_bytes, pes_length);
+
+#ifndef DASHTOHLS_BYTE_BUFFER_H_
+#define DASHTOHLS_BYTE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace dash2hls {
+
+class ByteBuffer {
+ public:
+  ByteBuffer() : data_(nullptr), size_(0), capacity_(0) {}
+  ByteBuffer(const uint8_t* data, size_t length);
+  ByteBuffer(ByteBuffer&& other);
+  ByteBuffer& operator=(ByteBuffer&& other);
+  ~ByteBuffer();
+
+  uint8_t* data() {return data_;}
+  const uint8_t* data() const {return data_;}
+  size_t size() const {return size_;}
+  size_t capacity() const {return capacity_;}
+  bool empty() const {return size_ == 0;}
+  uint8_t* begin() {return data_;}
+  const uint8_t* begin() const {return data_;}
+  uint8_t* end() {return data_ + size_;}
+  const uint8_t* end() const {return data_ + size_;}
+  uint8_t& operator[](size_t index) {return data_[index];}
+  const uint8_t& operator[](size_t index) const {return data_[index];}
+
+  // New bytes are not initialized.
+  void resize(size_t size) {
+    if (size > capacity_) {
+      Grow(size);
+    }
+    size_ = size;
+  }
+  void reserve(size_t capacity) {
+    if (capacity > capacity_) {
+      Grow(capacity);
+    }
+  }
+  // Grows the capacity to exactly |capacity|, no slack for later appends.
+  void reserve_exact(size_t capacity);
+  void clear() {size_ = 0;}
+  void append(const uint8_t* data, size_t length) {
+    size_t old_size = size_;
+    resize(size_ + length);
+    memcpy(data_ + old_size, data, length);
+  }
+  void push_back(uint8_t value) {
+    resize(size_ + 1);
+    data_[size_ - 1] = value;
+  }
+  void swap(ByteBuffer& other);
+  // Returns the storage, which the caller must free(), and leaves the buffer
+  // empty.  Returns nullptr if nothing was ever allocated.
+  uint8_t* Release();
+
+ private:
+  void Grow(size_t size);
+
+  uint8_t* data_;
+  size_t size_;
+  size_t capacity_;
+
+  ByteBuffer(const ByteBuffer&) = delete;
+  ByteBuffer& operator=(const ByteBuffer&) = delete;
+};
+}  // namespace dash2hls
+
+#endif  // DASHTOHLS_BYTE_BUFFER_H_
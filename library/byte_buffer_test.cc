@@ -0,0 +1,85 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "library/byte_buffer.h"
+
+#include <stdlib.h>
+
+#include <gtest/gtest.h>
+
+namespace dash2hls {
+
+TEST(Dash2HLS, ByteBufferGrow) {
+  ByteBuffer buffer;
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(nullptr, buffer.data());
+  const uint8_t kData[] = {1, 2, 3, 4, 5};
+  buffer.append(kData, sizeof(kData));
+  ASSERT_EQ(sizeof(kData), buffer.size());
+  EXPECT_LE(buffer.size(), buffer.capacity());
+  // Growing keeps what was already written.
+  for (size_t count = 0; count < 10000; ++count) {
+    buffer.push_back(static_cast<uint8_t>(count));
+  }
+  ASSERT_EQ(sizeof(kData) + 10000, buffer.size());
+  EXPECT_EQ(0, memcmp(kData, buffer.data(), sizeof(kData)));
+  EXPECT_EQ(static_cast<uint8_t>(9999), buffer[buffer.size() - 1]);
+  EXPECT_EQ(buffer.data() + buffer.size(), buffer.end());
+
+  size_t capacity = buffer.capacity();
+  buffer.clear();
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(capacity, buffer.capacity());
+  buffer.resize(capacity);
+  EXPECT_EQ(capacity, buffer.capacity());
+}
+
+TEST(Dash2HLS, ByteBufferReserveExact) {
+  ByteBuffer buffer;
+  buffer.reserve_exact(1000);
+  EXPECT_EQ(1000u, buffer.capacity());
+  EXPECT_EQ(0u, buffer.size());
+  // Never shrinks.
+  buffer.reserve_exact(10);
+  EXPECT_EQ(1000u, buffer.capacity());
+  buffer.resize(1000);
+  EXPECT_EQ(1000u, buffer.capacity());
+  // reserve grows geometrically.
+  buffer.reserve(1001);
+  EXPECT_LE(2000u, buffer.capacity());
+}
+
+TEST(Dash2HLS, ByteBufferSwapAndRelease) {
+  const uint8_t kData[] = {9, 8, 7};
+  ByteBuffer first(kData, sizeof(kData));
+  ByteBuffer second;
+  second.swap(first);
+  EXPECT_TRUE(first.empty());
+  ASSERT_EQ(sizeof(kData), second.size());
+
+  ByteBuffer moved(std::move(second));
+  EXPECT_TRUE(second.empty());
+  ASSERT_EQ(sizeof(kData), moved.size());
+
+  size_t size = moved.size();
+  uint8_t* released = moved.Release();
+  EXPECT_TRUE(moved.empty());
+  EXPECT_EQ(0u, moved.capacity());
+  EXPECT_EQ(0, memcmp(kData, released, size));
+  free(released);
+}
+}  // namespace dash2hls
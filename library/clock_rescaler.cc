@@ -0,0 +1,71 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/clock_rescaler.h"
+
+namespace dash2hls {
+namespace {
+uint64_t GreatestCommonDivisor(uint64_t a, uint64_t b) {
+  while (b) {
+    uint64_t temp = a % b;
+    a = b;
+    b = temp;
+  }
+  return a;
+}
+}  // namespace
+
+ClockRescaler::ClockRescaler(uint64_t timescale, uint64_t clock)
+    : numerator_(clock), denominator_(timescale), quotient_(0),
+      remainder_(0), next_offset_step_(0) {
+  uint64_t divisor = GreatestCommonDivisor(numerator_, denominator_);
+  if (divisor > 1) {
+    numerator_ /= divisor;
+    denominator_ /= divisor;
+  }
+  if (denominator_ == 0) {
+    // Callers reject a timescale of 0, this just avoids dividing by 0.
+    denominator_ = 1;
+  }
+  SetStep(0, &duration_step_);
+  for (size_t count = 0; count < kOffsetSteps; ++count) {
+    SetStep(0, &offset_steps_[count]);
+  }
+}
+
+void ClockRescaler::Reset(uint64_t time) {
+  Step step;
+  SetStep(time, &step);
+  quotient_ = step.quotient;
+  remainder_ = step.remainder;
+}
+
+uint64_t ClockRescaler::Rescale(uint64_t value) const {
+  Step step;
+  SetStep(value, &step);
+  return step.quotient;
+}
+
+// Splitting |value| first keeps value * numerator_ from overflowing for any
+// 64 bit time as long as the clock and timescale fit in 32 bits.
+void ClockRescaler::SetStep(uint64_t value, Step* step) const {
+  uint64_t whole = value / denominator_;
+  uint64_t part = (value % denominator_) * numerator_;
+  step->value = value;
+  step->quotient = whole * numerator_ + part / denominator_;
+  step->remainder = part % denominator_;
+}
+}  // namespace dash2hls
@@ -0,0 +1,112 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Converts timestamps from a track's timescale to another clock, usually
+// the 90kHz MPEG clock.  The ratio clock / timescale is kept as a reduced
+// fraction and the converted time as a quotient and remainder, so stepping
+// forward by a duration costs an add and a compare instead of two 64 bit
+// divisions, and the result is always exactly time * clock / timescale
+// rounded down.  Adding rounded durations instead drifts by up to one tick
+// per sample whenever the clock is not a multiple of the timescale.
+//
+// The last duration and the last few composition offsets are cached, a new
+// value costs one division.
+//
+// EXAMPLE:
+//   ClockRescaler clock(timescale, 90000);
+//   clock.Reset(tfdt->get_base_media_decode_time());
+//   for (each sample) {
+//     uint64_t dts = clock.get_time();
+//     uint64_t pts = clock.OffsetTime(composition_offset);
+//     clock.Advance(sample_duration);
+//   }
+
+#ifndef DASHTOHLS_CLOCK_RESCALER_H_
+#define DASHTOHLS_CLOCK_RESCALER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dash2hls {
+class ClockRescaler {
+ public:
+  ClockRescaler(uint64_t timescale, uint64_t clock);
+
+  // Starts converting at |time|, in timescale units.
+  void Reset(uint64_t time);
+
+  // Moves the current time forward by |duration| timescale units.
+  void Advance(uint64_t duration) {
+    if (duration != duration_step_.value) {
+      SetStep(duration, &duration_step_);
+    }
+    quotient_ += duration_step_.quotient;
+    remainder_ += duration_step_.remainder;
+    // Branch free carry, remainder_ is always less than 2 * denominator_.
+    uint64_t carry = remainder_ >= denominator_;
+    quotient_ += carry;
+    remainder_ -= carry * denominator_;
+  }
+
+  // Current time in the output clock.
+  uint64_t get_time() const {return quotient_;}
+
+  // Current time plus |offset| timescale units, in the output clock.  Used
+  // for the pts, which is the dts plus the composition offset.
+  uint64_t OffsetTime(uint64_t offset) {
+    const Step& step = GetOffsetStep(offset);
+    return quotient_ + step.quotient +
+        (remainder_ + step.remainder >= denominator_);
+  }
+
+  // Converts a single value, rounding down.
+  uint64_t Rescale(uint64_t value) const;
+
+ private:
+  // |value| * numerator_ / denominator_ split into quotient and remainder.
+  struct Step {
+    uint64_t value;
+    uint64_t quotient;
+    uint64_t remainder;
+  };
+  void SetStep(uint64_t value, Step* step) const;
+
+  // Composition offsets cycle through a few values with B frames, so a few
+  // of them are kept.
+  const Step& GetOffsetStep(uint64_t offset) {
+    for (size_t count = 0; count < kOffsetSteps; ++count) {
+      if (offset_steps_[count].value == offset) {
+        return offset_steps_[count];
+      }
+    }
+    Step& step = offset_steps_[next_offset_step_];
+    next_offset_step_ = (next_offset_step_ + 1) % kOffsetSteps;
+    SetStep(offset, &step);
+    return step;
+  }
+
+  static const size_t kOffsetSteps = 4;
+
+  uint64_t numerator_;
+  uint64_t denominator_;
+  uint64_t quotient_;
+  uint64_t remainder_;
+  Step duration_step_;
+  Step offset_steps_[kOffsetSteps];
+  size_t next_offset_step_;
+};  // class ClockRescaler
+}  // namespace dash2hls
+#endif  // DASHTOHLS_CLOCK_RESCALER_H_
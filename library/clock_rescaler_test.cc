@@ -0,0 +1,73 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "library/clock_rescaler.h"
+
+#include <gtest/gtest.h>
+
+namespace dash2hls {
+
+TEST(Dash2HLS, ClockRescalerExactRatio) {
+  // 30000/1001 content, every frame is exactly 3003 ticks at 90kHz.
+  ClockRescaler clock(30000, 90000);
+  clock.Reset(1001 * 10);
+  EXPECT_EQ(30030u, clock.get_time());
+  clock.Advance(1001);
+  EXPECT_EQ(33033u, clock.get_time());
+  EXPECT_EQ(33033u + 6006u, clock.OffsetTime(2002));
+  EXPECT_EQ(3003u, clock.Rescale(1001));
+}
+
+TEST(Dash2HLS, ClockRescalerNoDrift) {
+  // 44.1kHz AAC frames are 2089.795... ticks at 90kHz.  Adding rounded
+  // durations loses almost a tick per frame, the rescaler must not.
+  const uint64_t kTimescale = 44100;
+  const uint64_t kFrame = 1024;
+  ClockRescaler clock(kTimescale, 90000);
+  clock.Reset(0);
+  uint64_t rounded = 0;
+  for (uint64_t frame = 1; frame <= 10000; ++frame) {
+    clock.Advance(kFrame);
+    rounded += clock.Rescale(kFrame);
+    EXPECT_EQ(frame * kFrame * 90000 / kTimescale, clock.get_time());
+  }
+  EXPECT_LT(rounded + 7000, clock.get_time());
+}
+
+TEST(Dash2HLS, ClockRescalerOffsets) {
+  // Composition offsets round as if added to the time before converting.
+  ClockRescaler clock(15360, 90000);
+  clock.Reset(0);
+  for (uint64_t time = 0; time < 15360 * 4; time += 257) {
+    for (uint64_t offset = 0; offset < 1024; offset += 127) {
+      EXPECT_EQ((time + offset) * 90000 / 15360, clock.OffsetTime(offset));
+    }
+    clock.Advance(257);
+  }
+}
+
+TEST(Dash2HLS, ClockRescalerLargeTimes) {
+  // A day and a half of 90kHz timestamps in a 1GHz timescale does not fit
+  // time * clock in 64 bits.
+  ClockRescaler clock(1000000000, 90000);
+  const uint64_t kTime = 129600ull * 1000000000ull;
+  clock.Reset(kTime);
+  EXPECT_EQ(129600ull * 90000ull, clock.get_time());
+  clock.Advance(1000000000);
+  EXPECT_EQ(129601ull * 90000ull, clock.get_time());
+}
+}  // namespace dash2hls
@@ -0,0 +1,245 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/crypto/aes.h"
+
+#include <string.h>
+
+#include "library/utilities.h"
+
+namespace {
+uint8_t Multiply2(uint8_t value) {
+  return static_cast<uint8_t>((value << 1) ^ ((value & 0x80) ? 0x1b : 0));
+}
+
+uint8_t Multiply(uint8_t value, uint8_t factor) {
+  uint8_t result = 0;
+  for (; factor; factor >>= 1) {
+    if (factor & 1) {
+      result ^= value;
+    }
+    value = Multiply2(value);
+  }
+  return result;
+}
+
+uint32_t RotateRight8(uint32_t value) {
+  return (value >> 8) | (value << 24);
+}
+
+// The S-boxes and the round tables that combine SubBytes, ShiftRows and
+// MixColumns, or their inverses, for one byte of a column, built once from
+// GF(2^8) arithmetic instead of being typed in.
+struct AesTables {
+  AesTables() {
+    // Walk GF(2^8) with the generator 3 so each inverse is one lookup.
+    uint8_t power[255];
+    uint8_t log[256];
+    uint8_t value = 1;
+    for (int count = 0; count < 255; ++count) {
+      power[count] = value;
+      log[value] = static_cast<uint8_t>(count);
+      value ^= Multiply2(value);
+    }
+    for (int count = 0; count < 256; ++count) {
+      uint8_t inverse = count ? power[(255 - log[count]) % 255] : 0;
+      uint8_t result = inverse;
+      for (int shift = 1; shift < 5; ++shift) {
+        result ^= static_cast<uint8_t>((inverse << shift) |
+                                       (inverse >> (8 - shift)));
+      }
+      sbox[count] = result ^ 0x63;
+      inverse_sbox[sbox[count]] = static_cast<uint8_t>(count);
+    }
+    for (int count = 0; count < 256; ++count) {
+      uint8_t s = sbox[count];
+      uint8_t s2 = Multiply2(s);
+      uint32_t column = (static_cast<uint32_t>(s2) << 24) |
+          (static_cast<uint32_t>(s) << 16) | (static_cast<uint32_t>(s) << 8) |
+          static_cast<uint32_t>(s2 ^ s);
+      round[0][count] = column;
+      round[1][count] = RotateRight8(round[0][count]);
+      round[2][count] = RotateRight8(round[1][count]);
+      round[3][count] = RotateRight8(round[2][count]);
+    }
+    for (int count = 0; count < 256; ++count) {
+      uint8_t s = inverse_sbox[count];
+      uint32_t column = (static_cast<uint32_t>(Multiply(s, 0x0e)) << 24) |
+          (static_cast<uint32_t>(Multiply(s, 0x09)) << 16) |
+          (static_cast<uint32_t>(Multiply(s, 0x0d)) << 8) |
+          static_cast<uint32_t>(Multiply(s, 0x0b));
+      inverse_round[0][count] = column;
+      inverse_round[1][count] = RotateRight8(inverse_round[0][count]);
+      inverse_round[2][count] = RotateRight8(inverse_round[1][count]);
+      inverse_round[3][count] = RotateRight8(inverse_round[2][count]);
+    }
+  }
+
+  uint8_t sbox[256];
+  uint8_t inverse_sbox[256];
+  uint32_t round[4][256];
+  uint32_t inverse_round[4][256];
+};
+
+const AesTables& GetTables() {
+  static const AesTables tables;
+  return tables;
+}
+
+uint32_t SubWord(const AesTables& tables, uint32_t word) {
+  return (static_cast<uint32_t>(tables.sbox[word >> 24]) << 24) |
+      (static_cast<uint32_t>(tables.sbox[(word >> 16) & 0xff]) << 16) |
+      (static_cast<uint32_t>(tables.sbox[(word >> 8) & 0xff]) << 8) |
+      static_cast<uint32_t>(tables.sbox[word & 0xff]);
+}
+
+// The inverse round tables include SubBytes, which InvMixColumns alone
+// undoes with the forward S-box.
+uint32_t InverseMixColumn(const AesTables& tables, uint32_t word) {
+  return tables.inverse_round[0][tables.sbox[word >> 24]] ^
+      tables.inverse_round[1][tables.sbox[(word >> 16) & 0xff]] ^
+      tables.inverse_round[2][tables.sbox[(word >> 8) & 0xff]] ^
+      tables.inverse_round[3][tables.sbox[word & 0xff]];
+}
+}  // namespace
+
+namespace dash2hls {
+
+Aes128::Aes128() {
+  memset(round_keys_, 0, sizeof(round_keys_));
+  memset(inverse_round_keys_, 0, sizeof(inverse_round_keys_));
+}
+
+void Aes128::SetKey(const uint8_t* key) {
+  const AesTables& tables = GetTables();
+  for (size_t count = 0; count < 4; ++count) {
+    round_keys_[count] = ntohlFromBuffer(key + count * sizeof(uint32_t));
+  }
+  uint8_t round_constant = 1;
+  for (size_t count = 4; count < (kRounds + 1) * 4; ++count) {
+    uint32_t word = round_keys_[count - 1];
+    if (count % 4 == 0) {
+      word = SubWord(tables, (word << 8) | (word >> 24)) ^
+          (static_cast<uint32_t>(round_constant) << 24);
+      round_constant = Multiply2(round_constant);
+    }
+    round_keys_[count] = round_keys_[count - 4] ^ word;
+  }
+  for (size_t round = 0; round <= kRounds; ++round) {
+    for (size_t count = 0; count < 4; ++count) {
+      uint32_t word = round_keys_[(kRounds - round) * 4 + count];
+      if (round != 0 && round != kRounds) {
+        word = InverseMixColumn(tables, word);
+      }
+      inverse_round_keys_[round * 4 + count] = word;
+    }
+  }
+}
+
+void Aes128::EncryptBlock(const uint8_t* in, uint8_t* out) const {
+  const AesTables& tables = GetTables();
+  const uint32_t* key = round_keys_;
+  uint32_t s0 = ntohlFromBuffer(in) ^ key[0];
+  uint32_t s1 = ntohlFromBuffer(in + 4) ^ key[1];
+  uint32_t s2 = ntohlFromBuffer(in + 8) ^ key[2];
+  uint32_t s3 = ntohlFromBuffer(in + 12) ^ key[3];
+  for (size_t count = 1; count < kRounds; ++count) {
+    key += 4;
+    uint32_t t0 = tables.round[0][s0 >> 24] ^
+        tables.round[1][(s1 >> 16) & 0xff] ^
+        tables.round[2][(s2 >> 8) & 0xff] ^
+        tables.round[3][s3 & 0xff] ^ key[0];
+    uint32_t t1 = tables.round[0][s1 >> 24] ^
+        tables.round[1][(s2 >> 16) & 0xff] ^
+        tables.round[2][(s3 >> 8) & 0xff] ^
+        tables.round[3][s0 & 0xff] ^ key[1];
+    uint32_t t2 = tables.round[0][s2 >> 24] ^
+        tables.round[1][(s3 >> 16) & 0xff] ^
+        tables.round[2][(s0 >> 8) & 0xff] ^
+        tables.round[3][s1 & 0xff] ^ key[2];
+    uint32_t t3 = tables.round[0][s3 >> 24] ^
+        tables.round[1][(s0 >> 16) & 0xff] ^
+        tables.round[2][(s1 >> 8) & 0xff] ^
+        tables.round[3][s2 & 0xff] ^ key[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  // The last round has no MixColumns.
+  key += 4;
+  uint32_t state[4] = {s0, s1, s2, s3};
+  for (size_t count = 0; count < 4; ++count) {
+    uint32_t word =
+        (static_cast<uint32_t>(tables.sbox[state[count] >> 24]) << 24) |
+        (static_cast<uint32_t>(
+            tables.sbox[(state[(count + 1) % 4] >> 16) & 0xff]) << 16) |
+        (static_cast<uint32_t>(
+            tables.sbox[(state[(count + 2) % 4] >> 8) & 0xff]) << 8) |
+        static_cast<uint32_t>(tables.sbox[state[(count + 3) % 4] & 0xff]);
+    htonlToBuffer(word ^ key[count], out + count * sizeof(uint32_t));
+  }
+}
+
+void Aes128::DecryptBlock(const uint8_t* in, uint8_t* out) const {
+  const AesTables& tables = GetTables();
+  const uint32_t* key = inverse_round_keys_;
+  uint32_t s0 = ntohlFromBuffer(in) ^ key[0];
+  uint32_t s1 = ntohlFromBuffer(in + 4) ^ key[1];
+  uint32_t s2 = ntohlFromBuffer(in + 8) ^ key[2];
+  uint32_t s3 = ntohlFromBuffer(in + 12) ^ key[3];
+  // InvShiftRows takes row r of a column from the column r to the left.
+  for (size_t count = 1; count < kRounds; ++count) {
+    key += 4;
+    uint32_t t0 = tables.inverse_round[0][s0 >> 24] ^
+        tables.inverse_round[1][(s3 >> 16) & 0xff] ^
+        tables.inverse_round[2][(s2 >> 8) & 0xff] ^
+        tables.inverse_round[3][s1 & 0xff] ^ key[0];
+    uint32_t t1 = tables.inverse_round[0][s1 >> 24] ^
+        tables.inverse_round[1][(s0 >> 16) & 0xff] ^
+        tables.inverse_round[2][(s3 >> 8) & 0xff] ^
+        tables.inverse_round[3][s2 & 0xff] ^ key[1];
+    uint32_t t2 = tables.inverse_round[0][s2 >> 24] ^
+        tables.inverse_round[1][(s1 >> 16) & 0xff] ^
+        tables.inverse_round[2][(s0 >> 8) & 0xff] ^
+        tables.inverse_round[3][s3 & 0xff] ^ key[2];
+    uint32_t t3 = tables.inverse_round[0][s3 >> 24] ^
+        tables.inverse_round[1][(s2 >> 16) & 0xff] ^
+        tables.inverse_round[2][(s1 >> 8) & 0xff] ^
+        tables.inverse_round[3][s0 & 0xff] ^ key[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  // The last round has no InvMixColumns.
+  key += 4;
+  uint32_t state[4] = {s0, s1, s2, s3};
+  for (size_t count = 0; count < 4; ++count) {
+    uint32_t word =
+        (static_cast<uint32_t>(
+            tables.inverse_sbox[state[count] >> 24]) << 24) |
+        (static_cast<uint32_t>(
+            tables.inverse_sbox[(state[(count + 3) % 4] >> 16) & 0xff])
+         << 16) |
+        (static_cast<uint32_t>(
+            tables.inverse_sbox[(state[(count + 2) % 4] >> 8) & 0xff]) << 8) |
+        static_cast<uint32_t>(
+            tables.inverse_sbox[state[(count + 1) % 4] & 0xff]);
+    htonlToBuffer(word ^ key[count], out + count * sizeof(uint32_t));
+  }
+}
+}  // namespace dash2hls
@@ -0,0 +1,61 @@
+#ifndef _DASH2HLS_AES_H_
+#define _DASH2HLS_AES_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Aes128 is a portable AES-128 block cipher, FIPS-197, so the library can
+// encrypt without OpenSSL or CommonCrypto.  CTR decryption and CBC
+// encryption use the forward cipher, cbcs decryption the inverse cipher.
+//
+// EXAMPLE:
+//   Aes128 aes;
+//   aes.SetKey(key);
+//   aes.EncryptBlock(counter, keystream);
+//   aes.DecryptBlock(cbc_block, clear_block);
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace dash2hls {
+
+class Aes128 {
+ public:
+  enum {
+    kBlockSize = 16,
+    kKeySize = 16,
+    kRounds = 10,
+  };
+
+  Aes128();
+
+  // |key| is kKeySize bytes.
+  void SetKey(const uint8_t* key);
+  // |in| and |out| are kBlockSize bytes and may be the same block.
+  void EncryptBlock(const uint8_t* in, uint8_t* out) const;
+  void DecryptBlock(const uint8_t* in, uint8_t* out) const;
+  // (kRounds + 1) * 4 words, each read big endian from the key bytes.
+  const uint32_t* get_round_keys() const {return round_keys_;}
+
+ private:
+  uint32_t round_keys_[(kRounds + 1) * 4];
+  // The round keys in reverse order for the equivalent inverse cipher,
+  // with InvMixColumns applied to all but the first and last.
+  uint32_t inverse_round_keys_[(kRounds + 1) * 4];
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_AES_H_
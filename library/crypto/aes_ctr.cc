@@ -0,0 +1,200 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "library/crypto/aes_ctr.h"
+
+#include <string.h>
+
+#include "library/utilities.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || defined(__GNUC__))
+#define DASH2HLS_AES_NI 1
+#include <cpuid.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace {
+const size_t kBlockSize = dash2hls::Aes128::kBlockSize;
+const size_t kRounds = dash2hls::Aes128::kRounds;
+const size_t kPipelineBlocks = dash2hls::AesCtr::kPipelineBlocks;
+// The block counter is the low 64 bits of the counter block.
+const size_t kCounterOffset = 8;
+
+#ifdef DASH2HLS_AES_NI
+bool CpuHasAesNi() {
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ecx & bit_AES) && (ecx & bit_SSE4_1);
+}
+
+// The block counter is kept as a number in the high lane of |next| and
+// byte swapped into the counter block next to the nonce.
+__attribute__((target("aes,sse4.1")))
+inline __m128i NextCounterBlock(__m128i* next, __m128i nonce_block) {
+  const __m128i swap_counter = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,
+                                            -1, -1, -1, -1, -1, -1, -1, -1);
+  __m128i block = _mm_or_si128(_mm_shuffle_epi8(*next, swap_counter),
+                               nonce_block);
+  *next = _mm_add_epi64(*next, _mm_set_epi64x(1, 0));
+  return block;
+}
+
+__attribute__((target("aes,sse4.1")))
+inline void XorBlock(const uint8_t* in, uint8_t* out, __m128i keystream) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                   _mm_xor_si128(_mm_loadu_si128(
+                       reinterpret_cast<const __m128i*>(in)), keystream));
+}
+
+// XORs the keystream of |blocks| consecutive counter blocks, starting at
+// |counter|, into |in| to |out|.  The rounds of kPipelineBlocks blocks are
+// interleaved so each block only waits for its own previous round.  The
+// blocks are separate variables so they stay in registers.
+__attribute__((target("aes,sse4.1")))
+void CryptAesNi(const uint8_t* round_keys, const uint8_t* nonce,
+                uint64_t counter, size_t blocks, const uint8_t* in,
+                uint8_t* out) {
+  __m128i keys[kRounds + 1];
+  for (size_t round = 0; round <= kRounds; ++round) {
+    keys[round] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(round_keys + round * kBlockSize));
+  }
+  int64_t low;
+  memcpy(&low, nonce, sizeof(low));
+  const __m128i nonce_block = _mm_set_epi64x(0, low);
+  __m128i next = _mm_set_epi64x(static_cast<int64_t>(counter), 0);
+  for (; blocks >= kPipelineBlocks; blocks -= kPipelineBlocks) {
+    __m128i s0 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s1 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s2 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s3 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s4 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s5 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s6 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    __m128i s7 = _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    for (size_t round = 1; round < kRounds; ++round) {
+      const __m128i key = keys[round];
+      s0 = _mm_aesenc_si128(s0, key);
+      s1 = _mm_aesenc_si128(s1, key);
+      s2 = _mm_aesenc_si128(s2, key);
+      s3 = _mm_aesenc_si128(s3, key);
+      s4 = _mm_aesenc_si128(s4, key);
+      s5 = _mm_aesenc_si128(s5, key);
+      s6 = _mm_aesenc_si128(s6, key);
+      s7 = _mm_aesenc_si128(s7, key);
+    }
+    const __m128i key = keys[kRounds];
+    XorBlock(in, out, _mm_aesenclast_si128(s0, key));
+    XorBlock(in + 16, out + 16, _mm_aesenclast_si128(s1, key));
+    XorBlock(in + 32, out + 32, _mm_aesenclast_si128(s2, key));
+    XorBlock(in + 48, out + 48, _mm_aesenclast_si128(s3, key));
+    XorBlock(in + 64, out + 64, _mm_aesenclast_si128(s4, key));
+    XorBlock(in + 80, out + 80, _mm_aesenclast_si128(s5, key));
+    XorBlock(in + 96, out + 96, _mm_aesenclast_si128(s6, key));
+    XorBlock(in + 112, out + 112, _mm_aesenclast_si128(s7, key));
+    in += kPipelineBlocks * kBlockSize;
+    out += kPipelineBlocks * kBlockSize;
+  }
+  for (; blocks > 0; --blocks) {
+    __m128i state =
+        _mm_xor_si128(NextCounterBlock(&next, nonce_block), keys[0]);
+    for (size_t round = 1; round < kRounds; ++round) {
+      state = _mm_aesenc_si128(state, keys[round]);
+    }
+    XorBlock(in, out, _mm_aesenclast_si128(state, keys[kRounds]));
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+}
+#endif  // DASH2HLS_AES_NI
+}  // namespace
+
+namespace dash2hls {
+
+AesCtr::AesCtr(const Aes128& aes, const uint8_t* iv, size_t iv_size)
+    : aes_(aes), use_aes_ni_(HasAesNi()), counter_(0), used_(kBlockSize) {
+  memcpy(nonce_, iv, kCounterOffset);
+  if (iv_size == kBlockSize) {
+    counter_ = ntohllFromBuffer(iv + kCounterOffset);
+  }
+  if (use_aes_ni_) {
+    const uint32_t* words = aes.get_round_keys();
+    for (size_t count = 0; count < (kRounds + 1) * 4; ++count) {
+      htonlToBuffer(words[count], round_keys_ + count * sizeof(uint32_t));
+    }
+  }
+}
+
+bool AesCtr::HasAesNi() {
+#ifdef DASH2HLS_AES_NI
+  static const bool has_aes_ni = CpuHasAesNi();
+  return has_aes_ni;
+#else
+  return false;
+#endif  // DASH2HLS_AES_NI
+}
+
+void AesCtr::CryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) {
+#ifdef DASH2HLS_AES_NI
+  if (use_aes_ni_) {
+    CryptAesNi(round_keys_, nonce_, counter_, blocks, in, out);
+    counter_ += blocks;
+    return;
+  }
+#endif  // DASH2HLS_AES_NI
+  uint8_t counter_block[kBlockSize];
+  uint8_t keystream[kBlockSize];
+  memcpy(counter_block, nonce_, kCounterOffset);
+  for (size_t block = 0; block < blocks; ++block) {
+    htonllToBuffer(counter_++, counter_block + kCounterOffset);
+    aes_.EncryptBlock(counter_block, keystream);
+    for (size_t count = 0; count < kBlockSize; ++count) {
+      out[count] = in[count] ^ keystream[count];
+    }
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+}
+
+void AesCtr::Apply(const uint8_t* in, uint8_t* out, size_t length) {
+  // Finish the keystream block a previous call started.
+  while (length && used_ < kBlockSize) {
+    *out++ = *in++ ^ keystream_[used_++];
+    --length;
+  }
+  size_t blocks = length / kBlockSize;
+  CryptBlocks(in, out, blocks);
+  in += blocks * kBlockSize;
+  out += blocks * kBlockSize;
+  length -= blocks * kBlockSize;
+  if (length) {
+    // Keeps the rest of the keystream block for the next call.
+    memset(keystream_, 0, sizeof(keystream_));
+    CryptBlocks(keystream_, keystream_, 1);
+    for (used_ = 0; used_ < length; ++used_) {
+      out[used_] = in[used_] ^ keystream_[used_];
+    }
+  }
+}
+}  // namespace dash2hls
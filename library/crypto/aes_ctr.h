@@ -0,0 +1,81 @@
+#ifndef _DASH2HLS_AES_CTR_H_
+#define _DASH2HLS_AES_CTR_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// AesCtr is the cenc AES-128-CTR keystream of one sample, so the library
+// can decrypt content whose key it holds without a CENC callback.
+//
+// The counter block is the IV followed by a 64 bit big endian block counter
+// starting at 0, the layout DecryptSample builds from an 8 byte IV.  A 16
+// byte IV is the whole first counter block.  Either way only the low 64
+// bits count.
+//
+// On x86 CPUs with AES-NI and SSE4.1 the keystream is generated
+// kPipelineBlocks blocks at a time so the AESENC latencies of independent
+// blocks overlap.  Other CPUs use the portable Aes128.
+//
+// EXAMPLE:
+//   Aes128 aes;
+//   aes.SetKey(content_key);
+//   AesCtr ctr(aes, iv, 8);
+//   ctr.Apply(encrypted, clear, length);
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "library/crypto/aes.h"
+
+namespace dash2hls {
+
+class AesCtr {
+ public:
+  enum {
+    kPipelineBlocks = 8,
+  };
+
+  // |aes| holds the key and must outlive the AesCtr.  |iv| is 8 or 16
+  // bytes.
+  AesCtr(const Aes128& aes, const uint8_t* iv, size_t iv_size);
+
+  // Decrypts, or encrypts, the next |length| bytes from |in| to |out|,
+  // which may be the same.  The keystream runs on across calls, so the
+  // encrypted subsamples of a sample are one call each.
+  void Apply(const uint8_t* in, uint8_t* out, size_t length);
+
+  // Uses Aes128 even if the CPU has AES-NI, for tests and benchmarks.
+  void DisableAesNi() {use_aes_ni_ = false;}
+  static bool HasAesNi();
+
+ private:
+  // XORs |blocks| whole blocks of keystream into |in| to |out| and moves
+  // the counter past them.
+  void CryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks);
+
+  const Aes128& aes_;
+  bool use_aes_ni_;
+  // The key schedule of |aes_| in byte order, for AES-NI.
+  uint8_t round_keys_[(Aes128::kRounds + 1) * Aes128::kBlockSize];
+  // The first 8 bytes of the counter block and the block counter.
+  uint8_t nonce_[8];
+  uint64_t counter_;
+  uint8_t keystream_[Aes128::kBlockSize];
+  size_t used_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_AES_CTR_H_
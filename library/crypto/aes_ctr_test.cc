@@ -0,0 +1,129 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+#include "library/crypto/aes_ctr.h"
+
+namespace dash2hls {
+
+namespace {
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+// Encrypts |length| bytes of zeros one block at a time with Aes128, the
+// counter in the low 64 bits of |iv|.
+std::vector<uint8_t> ReferenceKeystream(const Aes128& aes, const uint8_t* iv,
+                                        size_t length) {
+  uint8_t counter[Aes128::kBlockSize];
+  memcpy(counter, iv, sizeof(counter));
+  std::vector<uint8_t> keystream(length + Aes128::kBlockSize);
+  for (size_t position = 0; position < length;
+       position += Aes128::kBlockSize) {
+    aes.EncryptBlock(counter, &keystream[position]);
+    for (size_t count = Aes128::kBlockSize - 1; count >= 8; --count) {
+      if (++counter[count]) {
+        break;
+      }
+    }
+  }
+  keystream.resize(length);
+  return keystream;
+}
+}  // namespace
+
+// NIST SP 800-38A F.5.1 and F.5.2, CTR-AES128.
+TEST(AesCtr, Sp800_38a) {
+  const uint8_t kCounter[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+                              0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+  const uint8_t kPlaintext[] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+  const uint8_t kCiphertext[] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+    0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+    0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+    0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+    0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee};
+  Aes128 aes;
+  aes.SetKey(kKey);
+  for (int portable = 0; portable < 2; ++portable) {
+    uint8_t out[sizeof(kPlaintext)];
+    AesCtr encrypt(aes, kCounter, sizeof(kCounter));
+    if (portable) {
+      encrypt.DisableAesNi();
+    }
+    encrypt.Apply(kPlaintext, out, sizeof(out));
+    EXPECT_EQ(0, memcmp(kCiphertext, out, sizeof(out)));
+    // Decrypting in place, in pieces that do not line up with the blocks.
+    AesCtr decrypt(aes, kCounter, sizeof(kCounter));
+    if (portable) {
+      decrypt.DisableAesNi();
+    }
+    decrypt.Apply(out, out, 5);
+    decrypt.Apply(out + 5, out + 5, 20);
+    decrypt.Apply(out + 25, out + 25, sizeof(out) - 25);
+    EXPECT_EQ(0, memcmp(kPlaintext, out, sizeof(out)));
+  }
+}
+
+TEST(AesCtr, LongRuns) {
+  Aes128 aes;
+  aes.SetKey(kKey);
+  // An 8 byte IV counts from 0, and the low 64 bits wrap without carrying
+  // into the IV.
+  const uint8_t kIv[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                         0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfd};
+  const uint8_t kShortIv[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                              0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  const size_t kLength = 1000;
+  const size_t kPieces[] = {1, 15, 16, 17, 128, 129, 300};
+  for (int short_iv = 0; short_iv < 2; ++short_iv) {
+    const uint8_t* iv = short_iv ? kShortIv : kIv;
+    std::vector<uint8_t> expected = ReferenceKeystream(aes, iv, kLength);
+    for (int portable = 0; portable < 2; ++portable) {
+      std::vector<uint8_t> keystream(kLength, 0);
+      AesCtr ctr(aes, iv, short_iv ? 8 : 16);
+      if (portable) {
+        ctr.DisableAesNi();
+      }
+      size_t position = 0;
+      for (size_t piece = 0; position < kLength; ++piece) {
+        size_t length = kPieces[piece % (sizeof(kPieces) / sizeof(size_t))];
+        if (length > kLength - position) {
+          length = kLength - position;
+        }
+        ctr.Apply(&keystream[position], &keystream[position], length);
+        position += length;
+      }
+      EXPECT_EQ(expected, keystream);
+    }
+  }
+}
+}  // namespace dash2hls
@@ -0,0 +1,190 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/crypto/cbcs_decrypter.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "library/crypto/aes_ctr.h"
+#include "library/utilities.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || defined(__GNUC__))
+#define DASH2HLS_AES_NI 1
+#include <wmmintrin.h>
+#endif
+
+namespace {
+const size_t kBlockSize = dash2hls::Aes128::kBlockSize;
+const size_t kRounds = dash2hls::Aes128::kRounds;
+const size_t kPipelineBlocks = dash2hls::CbcsDecrypter::kPipelineBlocks;
+
+#ifdef DASH2HLS_AES_NI
+__attribute__((target("aes")))
+inline __m128i LoadBlock(const uint8_t* block) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+// AESDEC implements the equivalent inverse cipher, so the middle round
+// keys need InvMixColumns.
+__attribute__((target("aes")))
+void InverseKeysAesNi(const uint8_t* round_keys, uint8_t* inverse_keys) {
+  for (size_t round = 0; round <= kRounds; ++round) {
+    __m128i key = LoadBlock(round_keys + (kRounds - round) * kBlockSize);
+    if (round != 0 && round != kRounds) {
+      key = _mm_aesimc_si128(key);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(
+        inverse_keys + round * kBlockSize), key);
+  }
+}
+
+__attribute__((target("aes")))
+inline void StoreClear(__m128i state, __m128i previous, uint8_t* block) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(block),
+                   _mm_xor_si128(state, previous));
+}
+
+// Decrypts the kPipelineBlocks chained blocks at |blocks| and returns the
+// last ciphertext block.  The clear blocks are stored last to first so each
+// ciphertext block is still in memory when the block after it needs it,
+// which keeps the states and the key within the 16 XMM registers.
+__attribute__((target("aes"), always_inline))
+inline __m128i DecryptPipelineAesNi(const __m128i* keys,
+                                    uint8_t* const* blocks, __m128i chain) {
+  const __m128i last = LoadBlock(blocks[7]);
+  __m128i s0 = _mm_xor_si128(LoadBlock(blocks[0]), keys[0]);
+  __m128i s1 = _mm_xor_si128(LoadBlock(blocks[1]), keys[0]);
+  __m128i s2 = _mm_xor_si128(LoadBlock(blocks[2]), keys[0]);
+  __m128i s3 = _mm_xor_si128(LoadBlock(blocks[3]), keys[0]);
+  __m128i s4 = _mm_xor_si128(LoadBlock(blocks[4]), keys[0]);
+  __m128i s5 = _mm_xor_si128(LoadBlock(blocks[5]), keys[0]);
+  __m128i s6 = _mm_xor_si128(LoadBlock(blocks[6]), keys[0]);
+  __m128i s7 = _mm_xor_si128(last, keys[0]);
+  for (size_t round = 1; round < kRounds; ++round) {
+    const __m128i key = keys[round];
+    s0 = _mm_aesdec_si128(s0, key);
+    s1 = _mm_aesdec_si128(s1, key);
+    s2 = _mm_aesdec_si128(s2, key);
+    s3 = _mm_aesdec_si128(s3, key);
+    s4 = _mm_aesdec_si128(s4, key);
+    s5 = _mm_aesdec_si128(s5, key);
+    s6 = _mm_aesdec_si128(s6, key);
+    s7 = _mm_aesdec_si128(s7, key);
+  }
+  const __m128i key = keys[kRounds];
+  StoreClear(_mm_aesdeclast_si128(s7, key), LoadBlock(blocks[6]), blocks[7]);
+  StoreClear(_mm_aesdeclast_si128(s6, key), LoadBlock(blocks[5]), blocks[6]);
+  StoreClear(_mm_aesdeclast_si128(s5, key), LoadBlock(blocks[4]), blocks[5]);
+  StoreClear(_mm_aesdeclast_si128(s4, key), LoadBlock(blocks[3]), blocks[4]);
+  StoreClear(_mm_aesdeclast_si128(s3, key), LoadBlock(blocks[2]), blocks[3]);
+  StoreClear(_mm_aesdeclast_si128(s2, key), LoadBlock(blocks[1]), blocks[2]);
+  StoreClear(_mm_aesdeclast_si128(s1, key), LoadBlock(blocks[0]), blocks[1]);
+  StoreClear(_mm_aesdeclast_si128(s0, key), chain, blocks[0]);
+  return last;
+}
+
+// Decrypts the encrypted blocks of the |range_blocks| whole blocks at
+// |data|, kPipelineBlocks at a time and the rest one by one.
+__attribute__((target("aes")))
+void DecryptRangeAesNi(const uint8_t* inverse_keys, const uint8_t* iv,
+                       size_t crypt_byte_block, size_t pattern_length,
+                       uint8_t* data, size_t range_blocks) {
+  __m128i keys[kRounds + 1];
+  for (size_t round = 0; round <= kRounds; ++round) {
+    keys[round] = LoadBlock(inverse_keys + round * kBlockSize);
+  }
+  __m128i chain = LoadBlock(iv);
+  uint8_t* blocks[kPipelineBlocks];
+  size_t count = 0;
+  for (size_t start = 0; start < range_blocks; start += pattern_length) {
+    size_t end = std::min(start + crypt_byte_block, range_blocks);
+    for (size_t block = start; block < end; ++block) {
+      blocks[count++] = data + block * kBlockSize;
+      if (count == kPipelineBlocks) {
+        chain = DecryptPipelineAesNi(keys, blocks, chain);
+        count = 0;
+      }
+    }
+  }
+  for (size_t block = 0; block < count; ++block) {
+    const __m128i cipher = LoadBlock(blocks[block]);
+    __m128i state = _mm_xor_si128(cipher, keys[0]);
+    for (size_t round = 1; round < kRounds; ++round) {
+      state = _mm_aesdec_si128(state, keys[round]);
+    }
+    StoreClear(_mm_aesdeclast_si128(state, keys[kRounds]), chain,
+               blocks[block]);
+    chain = cipher;
+  }
+}
+#endif  // DASH2HLS_AES_NI
+}  // namespace
+
+namespace dash2hls {
+
+CbcsDecrypter::CbcsDecrypter(const Aes128& aes, const uint8_t* iv,
+                             size_t iv_size, uint8_t crypt_byte_block,
+                             uint8_t skip_byte_block)
+    : aes_(aes), use_aes_ni_(AesCtr::HasAesNi()),
+      crypt_byte_block_(crypt_byte_block),
+      pattern_length_(crypt_byte_block + skip_byte_block) {
+  memset(iv_, 0, sizeof(iv_));
+  memcpy(iv_, iv, std::min(iv_size, sizeof(iv_)));
+  if (skip_byte_block == 0) {
+    crypt_byte_block_ = 1;
+    pattern_length_ = 1;
+  }
+#ifdef DASH2HLS_AES_NI
+  if (use_aes_ni_) {
+    uint8_t round_keys[sizeof(round_keys_)];
+    const uint32_t* words = aes.get_round_keys();
+    for (size_t count = 0; count < (kRounds + 1) * 4; ++count) {
+      htonlToBuffer(words[count], round_keys + count * sizeof(uint32_t));
+    }
+    InverseKeysAesNi(round_keys, round_keys_);
+  }
+#endif  // DASH2HLS_AES_NI
+}
+
+void CbcsDecrypter::DecryptRange(uint8_t* data, size_t length) const {
+  const size_t range_blocks = length / kBlockSize;
+#ifdef DASH2HLS_AES_NI
+  if (use_aes_ni_) {
+    DecryptRangeAesNi(round_keys_, iv_, crypt_byte_block_, pattern_length_,
+                      data, range_blocks);
+    return;
+  }
+#endif  // DASH2HLS_AES_NI
+  uint8_t chain[kBlockSize];
+  memcpy(chain, iv_, sizeof(chain));
+  for (size_t start = 0; start < range_blocks; start += pattern_length_) {
+    size_t end = std::min(start + crypt_byte_block_, range_blocks);
+    for (size_t block = start; block < end; ++block) {
+      uint8_t* position = data + block * kBlockSize;
+      uint8_t cipher[kBlockSize];
+      memcpy(cipher, position, kBlockSize);
+      aes_.DecryptBlock(cipher, position);
+      for (size_t count = 0; count < kBlockSize; ++count) {
+        position[count] ^= chain[count];
+      }
+      memcpy(chain, cipher, kBlockSize);
+    }
+  }
+}
+}  // namespace dash2hls
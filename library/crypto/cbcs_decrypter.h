@@ -0,0 +1,78 @@
+#ifndef _DASH2HLS_CBCS_DECRYPTER_H_
+#define _DASH2HLS_CBCS_DECRYPTER_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// CbcsDecrypter decrypts samples encrypted with the 'cbcs' scheme, AES-CBC
+// with a pattern, in place.
+//
+// Only the blocks the pattern encrypts are touched.  With the usual 1:9
+// pattern that is a tenth of the blocks of a protected range, the skipped
+// blocks and the partial block at the end of a range are already clear.
+// The CBC chain runs over the encrypted blocks only and restarts from the
+// IV at every protected range.
+//
+// CBC decryption of one range has no dependency between blocks, so on x86
+// CPUs with AES-NI kPipelineBlocks encrypted blocks are decrypted at a time
+// with their rounds interleaved.  Other CPUs use the portable Aes128.
+//
+// EXAMPLE:
+//   Aes128 aes;
+//   aes.SetKey(content_key);
+//   CbcsDecrypter decrypter(aes, constant_iv, 16, 1, 9);
+//   decrypter.DecryptRange(sample + clear_bytes, protected_bytes);
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "library/crypto/aes.h"
+
+namespace dash2hls {
+
+class CbcsDecrypter {
+ public:
+  enum {
+    kPipelineBlocks = 8,
+  };
+
+  // |aes| holds the key and must outlive the CbcsDecrypter.  |iv| is 8 or
+  // 16 bytes, an 8 byte IV is zero extended.  Of every |crypt_byte_block| +
+  // |skip_byte_block| blocks the first |crypt_byte_block| are encrypted, a
+  // |skip_byte_block| of 0 encrypts every block.
+  CbcsDecrypter(const Aes128& aes, const uint8_t* iv, size_t iv_size,
+                uint8_t crypt_byte_block, uint8_t skip_byte_block);
+
+  // Decrypts the encrypted blocks of the |length| byte protected range at
+  // |data|.
+  void DecryptRange(uint8_t* data, size_t length) const;
+
+  // Uses Aes128 even if the CPU has AES-NI, for tests and benchmarks.
+  void DisableAesNi() {use_aes_ni_ = false;}
+
+ private:
+  const Aes128& aes_;
+  bool use_aes_ni_;
+  // The AES-NI key schedule of the equivalent inverse cipher in byte
+  // order.
+  uint8_t round_keys_[(Aes128::kRounds + 1) * Aes128::kBlockSize];
+  uint8_t iv_[Aes128::kBlockSize];
+  size_t crypt_byte_block_;
+  size_t pattern_length_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_CBCS_DECRYPTER_H_
@@ -0,0 +1,123 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_decrypter.h"
+
+namespace dash2hls {
+
+namespace {
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                       0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+// Straightforward cbcs encryption of one protected range.
+void CbcsEncrypt(const Aes128& aes, size_t crypt_byte_block,
+                 size_t skip_byte_block, uint8_t* data, size_t length) {
+  uint8_t chain[Aes128::kBlockSize];
+  memcpy(chain, kIv, sizeof(chain));
+  for (size_t block = 0; block < length / sizeof(chain); ++block) {
+    if (block % (crypt_byte_block + skip_byte_block) < crypt_byte_block) {
+      uint8_t* position = data + block * sizeof(chain);
+      for (size_t count = 0; count < sizeof(chain); ++count) {
+        position[count] ^= chain[count];
+      }
+      aes.EncryptBlock(position, position);
+      memcpy(chain, position, sizeof(chain));
+    }
+  }
+}
+}  // namespace
+
+// NIST SP 800-38A F.2.2, CBC-AES128.Decrypt.
+TEST(CbcsDecrypter, Sp800_38a) {
+  const uint8_t kPlaintext[] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+  const uint8_t kCiphertext[] = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7};
+  Aes128 aes;
+  aes.SetKey(kKey);
+  for (int portable = 0; portable < 2; ++portable) {
+    uint8_t data[sizeof(kCiphertext)];
+    memcpy(data, kCiphertext, sizeof(data));
+    // A skip of 0 is plain CBC.
+    CbcsDecrypter decrypter(aes, kIv, sizeof(kIv), 1, 0);
+    if (portable) {
+      decrypter.DisableAesNi();
+    }
+    decrypter.DecryptRange(data, sizeof(data));
+    EXPECT_EQ(0, memcmp(kPlaintext, data, sizeof(data)));
+  }
+}
+
+TEST(CbcsDecrypter, Patterns) {
+  Aes128 aes;
+  aes.SetKey(kKey);
+  // Long enough for several batches of kPipelineBlocks encrypted blocks
+  // and a partial batch, with a partial block at the end.
+  std::vector<uint8_t> clear(3000 + 7);
+  for (size_t count = 0; count < clear.size(); ++count) {
+    clear[count] = static_cast<uint8_t>(count * 7);
+  }
+  const size_t kPatterns[][2] = {{1, 9}, {5, 5}, {2, 0}, {9, 1}};
+  for (size_t pattern = 0; pattern < 4; ++pattern) {
+    const size_t crypt = kPatterns[pattern][0];
+    const size_t skip = kPatterns[pattern][1];
+    std::vector<uint8_t> encrypted(clear);
+    CbcsEncrypt(aes, crypt, skip, &encrypted[0], encrypted.size());
+    if (skip) {
+      // Skipped blocks and the partial block stay clear.
+      EXPECT_EQ(0, memcmp(&clear[crypt * 16], &encrypted[crypt * 16], 16));
+      EXPECT_NE(0, memcmp(&clear[0], &encrypted[0], 16));
+    }
+    EXPECT_EQ(0, memcmp(&clear[3000], &encrypted[3000], 7));
+    for (int portable = 0; portable < 2; ++portable) {
+      std::vector<uint8_t> data(encrypted);
+      CbcsDecrypter decrypter(aes, kIv, sizeof(kIv),
+                              static_cast<uint8_t>(crypt),
+                              static_cast<uint8_t>(skip));
+      if (portable) {
+        decrypter.DisableAesNi();
+      }
+      decrypter.DecryptRange(&data[0], data.size());
+      EXPECT_EQ(clear, data);
+      // Every range starts again from the IV.
+      data = encrypted;
+      decrypter.DecryptRange(&data[0], data.size());
+      EXPECT_EQ(clear, data);
+    }
+  }
+}
+}  // namespace dash2hls
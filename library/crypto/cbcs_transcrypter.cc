@@ -0,0 +1,147 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/crypto/cbcs_transcrypter.h"
+
+#include <string.h>
+
+#include "library/utilities.h"
+
+namespace {
+const size_t kBlockSize = dash2hls::Aes128::kBlockSize;
+// The cenc block counter is the low 64 bits of the counter block.
+const size_t kCounterOffset = 8;
+
+// The cenc keystream of one sample.  It runs on across subsamples, so a
+// protected range can start part way into a keystream block.
+class CtrKeystream {
+ public:
+  CtrKeystream(const dash2hls::Aes128& aes, const uint8_t* iv,
+               size_t iv_size) : aes_(aes), used_(kBlockSize) {
+    memset(counter_, 0, sizeof(counter_));
+    memcpy(counter_, iv, iv_size);
+  }
+
+  // Decrypts |length| bytes from |in| to |out|.
+  void Apply(const uint8_t* in, uint8_t* out, size_t length) {
+    // Whole blocks on a block boundary, the common case.
+    if (used_ == kBlockSize && length == kBlockSize) {
+      NextBlock();
+      for (size_t count = 0; count < kBlockSize; ++count) {
+        out[count] = in[count] ^ keystream_[count];
+      }
+      used_ = kBlockSize;
+      return;
+    }
+    for (size_t count = 0; count < length; ++count) {
+      if (used_ == kBlockSize) {
+        NextBlock();
+        used_ = 0;
+      }
+      out[count] = in[count] ^ keystream_[used_++];
+    }
+  }
+
+ private:
+  void NextBlock() {
+    aes_.EncryptBlock(counter_, keystream_);
+    for (size_t position = kBlockSize - 1; position >= kCounterOffset;
+         --position) {
+      if (++counter_[position]) {
+        break;
+      }
+    }
+  }
+
+
+  const dash2hls::Aes128& aes_;
+  uint8_t counter_[kBlockSize];
+  uint8_t keystream_[kBlockSize];
+  size_t used_;
+};
+}  // namespace
+
+namespace dash2hls {
+
+CbcsTranscrypter::CbcsTranscrypter() : is_initialized_(false),
+                                       crypt_byte_block_(0),
+                                       skip_byte_block_(0) {
+  memset(cbcs_iv_, 0, sizeof(cbcs_iv_));
+}
+
+void CbcsTranscrypter::Init(const uint8_t* cenc_key, const uint8_t* cbcs_key,
+                            const uint8_t* cbcs_iv, uint8_t crypt_byte_block,
+                            uint8_t skip_byte_block) {
+  cenc_aes_.SetKey(cenc_key);
+  cbcs_aes_.SetKey(cbcs_key);
+  memcpy(cbcs_iv_, cbcs_iv, sizeof(cbcs_iv_));
+  crypt_byte_block_ = crypt_byte_block;
+  skip_byte_block_ = skip_byte_block;
+  is_initialized_ = true;
+}
+
+bool CbcsTranscrypter::TranscryptSample(
+    const uint8_t* iv, size_t iv_size,
+    const SaizContents::SaizRecord* subsamples, size_t subsample_count,
+    uint8_t* sample, size_t sample_size) const {
+  if (iv_size != kCounterOffset && iv_size != kBlockSize) {
+    DASH_LOG("Bad IV.", "cenc IVs are 8 or 16 bytes.",
+             PrettyPrintValue(iv_size).c_str());
+    return false;
+  }
+  CtrKeystream keystream(cenc_aes_, iv, iv_size);
+  size_t pattern_length = crypt_byte_block_ + skip_byte_block_;
+  size_t position = 0;
+  size_t ranges = subsamples ? subsample_count : 1;
+  for (size_t range = 0; range < ranges; ++range) {
+    size_t clear_bytes = subsamples ? subsamples[range].clear_bytes() : 0;
+    size_t protected_bytes = subsamples ?
+        subsamples[range].encrypted_bytes() : sample_size;
+    if (clear_bytes > sample_size - position ||
+        protected_bytes > sample_size - position - clear_bytes) {
+      DASH_LOG("Bad subsamples.", "Subsamples run past the end of the sample.",
+               PrettyPrintValue(sample_size).c_str());
+      return false;
+    }
+    position += clear_bytes;
+    uint8_t* data = sample + position;
+    uint8_t chain[kBlockSize];
+    memcpy(chain, cbcs_iv_, sizeof(chain));
+    size_t pattern_position = 0;
+    for (size_t blocks = protected_bytes / kBlockSize; blocks > 0; --blocks) {
+      uint8_t block[kBlockSize];
+      keystream.Apply(data, block, kBlockSize);
+      if (skip_byte_block_ == 0 || pattern_position < crypt_byte_block_) {
+        for (size_t count = 0; count < kBlockSize; ++count) {
+          block[count] ^= chain[count];
+        }
+        cbcs_aes_.EncryptBlock(block, chain);
+        memcpy(data, chain, kBlockSize);
+      } else {
+        memcpy(data, block, kBlockSize);
+      }
+      if (++pattern_position == pattern_length) {
+        pattern_position = 0;
+      }
+      data += kBlockSize;
+    }
+    // cbcs leaves the partial block at the end of a range clear.
+    keystream.Apply(data, data, protected_bytes % kBlockSize);
+    position += protected_bytes;
+  }
+  return true;
+}
+}  // namespace dash2hls
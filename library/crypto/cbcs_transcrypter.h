@@ -0,0 +1,76 @@
+#ifndef _DASH2HLS_CBCS_TRANSCRYPTER_H_
+#define _DASH2HLS_CBCS_TRANSCRYPTER_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// CbcsTranscrypter turns samples encrypted with the 'cenc' scheme (AES-CTR)
+// into the 'cbcs' scheme (AES-CBC with a pattern and a constant IV), in
+// place, for players that only accept cbcs.
+//
+// Each protected range is walked once a block at a time.  A block is
+// CTR-decrypted and, if the pattern says so, immediately CBC-encrypted again
+// while it is still in registers, so the clear sample never exists in
+// memory.  Blocks the pattern skips, and the partial block at the end of a
+// range, are left clear as cbcs requires.  The CBC chain and the pattern
+// restart at every subsample, the CTR keystream runs on across them.
+//
+// EXAMPLE:
+//   CbcsTranscrypter transcrypter;
+//   transcrypter.Init(content_key, cbcs_key, cbcs_iv, 1, 9);
+//   transcrypter.TranscryptSample(iv, 8, records, record_count, sample,
+//                                 sample_size);
+
+#include "library/crypto/aes.h"
+#include "library/dash/saiz_contents.h"
+
+namespace dash2hls {
+
+class CbcsTranscrypter {
+ public:
+  CbcsTranscrypter();
+
+  // |cenc_key| decrypts the input, |cbcs_key| and |cbcs_iv| encrypt the
+  // output, all Aes128::kKeySize bytes.  Of every |crypt_byte_block| +
+  // |skip_byte_block| blocks the first |crypt_byte_block| are encrypted, a
+  // |skip_byte_block| of 0 encrypts every block.
+  void Init(const uint8_t* cenc_key, const uint8_t* cbcs_key,
+            const uint8_t* cbcs_iv, uint8_t crypt_byte_block,
+            uint8_t skip_byte_block);
+  bool is_initialized() const {return is_initialized_;}
+  const uint8_t* get_cbcs_iv() const {return cbcs_iv_;}
+  uint8_t get_crypt_byte_block() const {return crypt_byte_block_;}
+  uint8_t get_skip_byte_block() const {return skip_byte_block_;}
+
+  // |iv| is the per sample cenc IV, 8 or 16 bytes.  |subsamples| is the
+  // sample's subsample map from the senc, or nullptr if the whole sample is
+  // protected.  Returns false if the map does not fit the sample.
+  bool TranscryptSample(const uint8_t* iv, size_t iv_size,
+                        const SaizContents::SaizRecord* subsamples,
+                        size_t subsample_count, uint8_t* sample,
+                        size_t sample_size) const;
+
+ private:
+  bool is_initialized_;
+  Aes128 cenc_aes_;
+  Aes128 cbcs_aes_;
+  uint8_t cbcs_iv_[Aes128::kBlockSize];
+  uint8_t crypt_byte_block_;
+  uint8_t skip_byte_block_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_CBCS_TRANSCRYPTER_H_
@@ -0,0 +1,166 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_transcrypter.h"
+#include "library/utilities.h"
+
+namespace {
+// NIST SP 800-38A F.5.1 and F.2.1 share the key and the plaintext, so the
+// CTR ciphertext must transcrypt to the CBC ciphertext.
+const uint8_t kNistKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                            0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kNistCounter[] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
+                                0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd,
+                                0xfe, 0xff};
+const uint8_t kNistCbcIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                              0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+const uint8_t kNistCtrCiphertext[] = {
+  0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+  0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+  0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+  0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff};
+const uint8_t kNistCbcCiphertext[] = {
+  0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+  0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+  0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+  0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2};
+
+const uint8_t kCencKey[] = {0x6f, 0xc9, 0x6f, 0xe6, 0x28, 0xa2, 0x65, 0xb1,
+                            0x3a, 0xed, 0xde, 0xc0, 0xbc, 0x42, 0x1f, 0x4d};
+const uint8_t kCbcsKey[] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                            0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10};
+const uint8_t kCencIv[] = {0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8};
+
+void MakeRecord(uint16_t clear_bytes, uint32_t encrypted_bytes,
+                dash2hls::SaizContents::SaizRecord* record) {
+  dash2hls::htonsToBuffer(clear_bytes, record->storage);
+  dash2hls::htonlToBuffer(encrypted_bytes, record->storage + 2);
+}
+
+// Straightforward cenc encryption: one keystream over the protected ranges.
+void CencEncrypt(const std::vector<dash2hls::SaizContents::SaizRecord>& map,
+                 std::vector<uint8_t>* sample) {
+  dash2hls::Aes128 aes;
+  aes.SetKey(kCencKey);
+  uint8_t counter[dash2hls::Aes128::kBlockSize] = {0};
+  memcpy(counter, kCencIv, sizeof(kCencIv));
+  uint8_t keystream[dash2hls::Aes128::kBlockSize];
+  size_t keystream_position = 0;
+  size_t position = 0;
+  for (size_t range = 0; range < map.size(); ++range) {
+    position += map[range].clear_bytes();
+    for (size_t count = 0; count < map[range].encrypted_bytes(); ++count) {
+      if (keystream_position % sizeof(keystream) == 0) {
+        dash2hls::htonllToBuffer(keystream_position / sizeof(keystream),
+                                 counter + sizeof(kCencIv));
+        aes.EncryptBlock(counter, keystream);
+      }
+      (*sample)[position++] ^=
+          keystream[keystream_position++ % sizeof(keystream)];
+    }
+  }
+}
+
+// Straightforward cbcs encryption of the clear sample.
+void CbcsEncrypt(const std::vector<dash2hls::SaizContents::SaizRecord>& map,
+                 size_t crypt_byte_block, size_t skip_byte_block,
+                 std::vector<uint8_t>* sample) {
+  dash2hls::Aes128 aes;
+  aes.SetKey(kCbcsKey);
+  size_t position = 0;
+  for (size_t range = 0; range < map.size(); ++range) {
+    position += map[range].clear_bytes();
+    uint8_t chain[dash2hls::Aes128::kBlockSize];
+    memcpy(chain, kNistCbcIv, sizeof(chain));
+    size_t blocks = map[range].encrypted_bytes() / sizeof(chain);
+    for (size_t block = 0; block < blocks; ++block) {
+      uint8_t* data = &(*sample)[position + block * sizeof(chain)];
+      if (block % (crypt_byte_block + skip_byte_block) < crypt_byte_block) {
+        for (size_t count = 0; count < sizeof(chain); ++count) {
+          data[count] ^= chain[count];
+        }
+        aes.EncryptBlock(data, data);
+        memcpy(chain, data, sizeof(chain));
+      }
+    }
+    position += map[range].encrypted_bytes();
+  }
+}
+}  // namespace
+
+namespace dash2hls {
+
+TEST(CbcsTranscrypter, NistVectors) {
+  CbcsTranscrypter transcrypter;
+  EXPECT_FALSE(transcrypter.is_initialized());
+  transcrypter.Init(kNistKey, kNistKey, kNistCbcIv, 1, 0);
+  EXPECT_TRUE(transcrypter.is_initialized());
+  uint8_t sample[sizeof(kNistCtrCiphertext)];
+  memcpy(sample, kNistCtrCiphertext, sizeof(sample));
+  ASSERT_TRUE(transcrypter.TranscryptSample(kNistCounter,
+                                            sizeof(kNistCounter), nullptr, 0,
+                                            sample, sizeof(sample)));
+  EXPECT_EQ(0, memcmp(kNistCbcCiphertext, sample, sizeof(sample)));
+}
+
+TEST(CbcsTranscrypter, PatternAndSubsamples) {
+  // The first range ends part way into a keystream block, and the second is
+  // long enough for the pattern to come round again.
+  std::vector<SaizContents::SaizRecord> map(3);
+  MakeRecord(5, 37, &map[0]);
+  MakeRecord(3, 250, &map[1]);
+  MakeRecord(20, 0, &map[2]);
+  std::vector<uint8_t> clear(5 + 37 + 3 + 250 + 20);
+  for (size_t count = 0; count < clear.size(); ++count) {
+    clear[count] = static_cast<uint8_t>(count * 7);
+  }
+  std::vector<uint8_t> sample(clear);
+  CencEncrypt(map, &sample);
+  std::vector<uint8_t> expected(clear);
+  CbcsEncrypt(map, 1, 9, &expected);
+
+  CbcsTranscrypter transcrypter;
+  transcrypter.Init(kCencKey, kCbcsKey, kNistCbcIv, 1, 9);
+  ASSERT_TRUE(transcrypter.TranscryptSample(kCencIv, sizeof(kCencIv),
+                                            &map[0], map.size(), &sample[0],
+                                            sample.size()));
+  EXPECT_EQ(expected, sample);
+  // Blocks 1 to 9 of the second range, and both partial blocks, are clear.
+  EXPECT_EQ(0, memcmp(&clear[45 + 16], &sample[45 + 16], 9 * 16));
+  EXPECT_EQ(0, memcmp(&clear[5 + 32], &sample[5 + 32], 5));
+  EXPECT_EQ(0, memcmp(&clear[45 + 240], &sample[45 + 240], 10));
+  EXPECT_NE(0, memcmp(&clear[45 + 160], &sample[45 + 160], 16));
+}
+
+TEST(CbcsTranscrypter, BadSubsamples) {
+  std::vector<SaizContents::SaizRecord> map(1);
+  MakeRecord(10, 100, &map[0]);
+  std::vector<uint8_t> sample(100);
+  CbcsTranscrypter transcrypter;
+  transcrypter.Init(kCencKey, kCbcsKey, kNistCbcIv, 1, 9);
+  EXPECT_FALSE(transcrypter.TranscryptSample(kCencIv, sizeof(kCencIv),
+                                             &map[0], map.size(), &sample[0],
+                                             sample.size()));
+  EXPECT_FALSE(transcrypter.TranscryptSample(kCencIv, 4, nullptr, 0,
+                                             &sample[0], sample.size()));
+}
+}  // namespace dash2hls
@@ -0,0 +1,131 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/crypto/hls_encrypter.h"
+
+#include <string.h>
+
+#include "library/crypto/aes_ctr.h"
+#include "library/utilities.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || defined(__GNUC__))
+#define DASH2HLS_AES_NI 1
+#include <wmmintrin.h>
+#endif
+
+namespace {
+const size_t kBlockSize = dash2hls::Aes128::kBlockSize;
+const size_t kRounds = dash2hls::Aes128::kRounds;
+
+#ifdef DASH2HLS_AES_NI
+__attribute__((target("aes")))
+inline __m128i LoadBlock(const uint8_t* block) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+// Each block waits for the one before it, so this runs at the latency of
+// the AESENC chain.  The round keys are loaded once for the whole run.
+__attribute__((target("aes")))
+void EncryptBlocksAesNi(const uint8_t* round_keys, uint8_t* chain,
+                        uint8_t* data, size_t blocks) {
+  __m128i keys[kRounds + 1];
+  for (size_t round = 0; round <= kRounds; ++round) {
+    keys[round] = LoadBlock(round_keys + round * kBlockSize);
+  }
+  __m128i state = LoadBlock(chain);
+  for (size_t block = 0; block < blocks; ++block) {
+    uint8_t* position = data + block * kBlockSize;
+    state = _mm_xor_si128(_mm_xor_si128(LoadBlock(position), state),
+                          keys[0]);
+    for (size_t round = 1; round < kRounds; ++round) {
+      state = _mm_aesenc_si128(state, keys[round]);
+    }
+    state = _mm_aesenclast_si128(state, keys[kRounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(position), state);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(chain), state);
+}
+#endif  // DASH2HLS_AES_NI
+}  // namespace
+
+namespace dash2hls {
+
+HlsEncrypter::HlsEncrypter() : is_initialized_(false), use_aes_ni_(false),
+                               encrypted_end_(0) {
+  memset(round_keys_, 0, sizeof(round_keys_));
+  memset(iv_, 0, sizeof(iv_));
+  memset(chain_, 0, sizeof(chain_));
+}
+
+void HlsEncrypter::Init(const uint8_t* key, const uint8_t* iv) {
+  aes_.SetKey(key);
+  memcpy(iv_, iv, sizeof(iv_));
+  use_aes_ni_ = AesCtr::HasAesNi();
+  const uint32_t* words = aes_.get_round_keys();
+  for (size_t count = 0; count < (kRounds + 1) * 4; ++count) {
+    htonlToBuffer(words[count], round_keys_ + count * sizeof(uint32_t));
+  }
+  is_initialized_ = true;
+  StartSegment(0);
+}
+
+void HlsEncrypter::StartSegment(size_t start) {
+  memcpy(chain_, iv_, sizeof(chain_));
+  encrypted_end_ = start;
+}
+
+void HlsEncrypter::EncryptAppended(uint8_t* output, size_t length) {
+  if (length <= encrypted_end_) {
+    return;
+  }
+  size_t blocks = (length - encrypted_end_) / kBlockSize;
+  EncryptBlocks(output + encrypted_end_, blocks);
+  encrypted_end_ += blocks * kBlockSize;
+}
+
+size_t HlsEncrypter::get_padded_length(size_t length) const {
+  // Whole blocks are encrypted as they come, so only the partial block
+  // after |encrypted_end_| is left.  A full block of padding is added if
+  // there is no partial block.
+  return encrypted_end_ +
+      ((length - encrypted_end_) / kBlockSize + 1) * kBlockSize;
+}
+
+void HlsEncrypter::FinishSegment(uint8_t* output, size_t length) {
+  size_t padded_length = get_padded_length(length);
+  uint8_t padding = static_cast<uint8_t>(padded_length - length);
+  memset(output + length, padding, padding);
+  EncryptAppended(output, padded_length);
+}
+
+void HlsEncrypter::EncryptBlocks(uint8_t* data, size_t blocks) {
+#ifdef DASH2HLS_AES_NI
+  if (use_aes_ni_) {
+    EncryptBlocksAesNi(round_keys_, chain_, data, blocks);
+    return;
+  }
+#endif  // DASH2HLS_AES_NI
+  for (size_t block = 0; block < blocks; ++block) {
+    uint8_t* position = data + block * kBlockSize;
+    for (size_t count = 0; count < kBlockSize; ++count) {
+      position[count] ^= chain_[count];
+    }
+    aes_.EncryptBlock(position, position);
+    memcpy(chain_, position, kBlockSize);
+  }
+}
+}  // namespace dash2hls
@@ -0,0 +1,91 @@
+#ifndef _DASH2HLS_HLS_ENCRYPTER_H_
+#define _DASH2HLS_HLS_ENCRYPTER_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// HlsEncrypter encrypts whole HLS segments for #EXT-X-KEY:METHOD=AES-128,
+// AES-128-CBC with PKCS7 padding, in place while they are being written.
+//
+// After each sample the whole blocks appended to the output since the last
+// call are encrypted, while the packets are still in cache, and the partial
+// block at the end waits for the next call.  FinishSegment pads that last
+// block, so the segment grows by 1 to 16 bytes only at the end.
+//
+// CBC encryption chains every block to the one before, so there is nothing
+// to pipeline.  On x86 CPUs with AES-NI the key stays in registers for the
+// whole run of blocks.  Other CPUs use the portable Aes128.
+//
+// EXAMPLE:
+//   HlsEncrypter encrypter;
+//   encrypter.Init(key, iv);
+//   encrypter.StartSegment(0);
+//   ... append a sample to output ...
+//   encrypter.EncryptAppended(output.data(), output.size());
+//   size_t length = output.size();
+//   output.resize(encrypter.get_padded_length(length));
+//   encrypter.FinishSegment(output.data(), length);
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "library/crypto/aes.h"
+
+namespace dash2hls {
+
+class HlsEncrypter {
+ public:
+  HlsEncrypter();
+
+  // |key| and |iv| are Aes128::kKeySize bytes.
+  void Init(const uint8_t* key, const uint8_t* iv);
+  bool is_initialized() const {return is_initialized_;}
+  const uint8_t* get_iv() const {return iv_;}
+
+  // The segment starts |start| bytes into the output, anything before it
+  // is left alone.  The CBC chain restarts from the IV.
+  void StartSegment(size_t start);
+  // The output holds |length| bytes, of which everything up to
+  // get_encrypted_end() is already encrypted.  Encrypts the whole blocks
+  // after that in place.
+  void EncryptAppended(uint8_t* output, size_t length);
+  // The output length once the segment of |length| bytes is padded.
+  size_t get_padded_length(size_t length) const;
+  // Pads the segment ending at |length|, the output must already have room
+  // for get_padded_length(length) bytes, and encrypts the rest of it.
+  void FinishSegment(uint8_t* output, size_t length);
+  size_t get_encrypted_end() const {return encrypted_end_;}
+
+  // Uses Aes128 even if the CPU has AES-NI, for tests and benchmarks.
+  void DisableAesNi() {use_aes_ni_ = false;}
+
+ private:
+  // CBC encrypts |blocks| whole blocks at |data| in place and moves the
+  // chain past them.
+  void EncryptBlocks(uint8_t* data, size_t blocks);
+
+  bool is_initialized_;
+  bool use_aes_ni_;
+  Aes128 aes_;
+  // The key schedule of |aes_| in byte order, for AES-NI.
+  uint8_t round_keys_[(Aes128::kRounds + 1) * Aes128::kBlockSize];
+  uint8_t iv_[Aes128::kBlockSize];
+  uint8_t chain_[Aes128::kBlockSize];
+  size_t encrypted_end_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_HLS_ENCRYPTER_H_
@@ -0,0 +1,139 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_decrypter.h"
+#include "library/crypto/hls_encrypter.h"
+
+namespace dash2hls {
+
+namespace {
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                       0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+// Appends |length| bytes of |data| to |output| and encrypts what it can.
+void Append(const uint8_t* data, size_t length, HlsEncrypter* encrypter,
+            std::vector<uint8_t>* output) {
+  output->insert(output->end(), data, data + length);
+  encrypter->EncryptAppended(&(*output)[0], output->size());
+}
+
+void Finish(HlsEncrypter* encrypter, std::vector<uint8_t>* output) {
+  size_t length = output->size();
+  output->resize(encrypter->get_padded_length(length));
+  encrypter->FinishSegment(&(*output)[0], length);
+}
+}  // namespace
+
+// NIST SP 800-38A F.2.1, CBC-AES128.Encrypt, written in uneven pieces.
+TEST(HlsEncrypter, Sp800_38a) {
+  const uint8_t kPlaintext[] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+  const uint8_t kCiphertext[] = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7};
+  Aes128 aes;
+  aes.SetKey(kKey);
+  for (int portable = 0; portable < 2; ++portable) {
+    HlsEncrypter encrypter;
+    encrypter.Init(kKey, kIv);
+    if (portable) {
+      encrypter.DisableAesNi();
+    }
+    std::vector<uint8_t> output;
+    Append(kPlaintext, 5, &encrypter, &output);
+    EXPECT_EQ(0u, encrypter.get_encrypted_end());
+    Append(kPlaintext + 5, 20, &encrypter, &output);
+    EXPECT_EQ(16u, encrypter.get_encrypted_end());
+    Append(kPlaintext + 25, sizeof(kPlaintext) - 25, &encrypter, &output);
+    EXPECT_EQ(sizeof(kPlaintext), encrypter.get_encrypted_end());
+    EXPECT_EQ(0, memcmp(kCiphertext, &output[0], sizeof(kCiphertext)));
+    // A whole block of padding after a whole number of blocks.
+    Finish(&encrypter, &output);
+    ASSERT_EQ(sizeof(kPlaintext) + 16, output.size());
+    uint8_t padding[16];
+    aes.DecryptBlock(&output[sizeof(kPlaintext)], padding);
+    for (size_t count = 0; count < sizeof(padding); ++count) {
+      EXPECT_EQ(16, padding[count] ^ kCiphertext[48 + count]);
+    }
+  }
+}
+
+TEST(HlsEncrypter, Padding) {
+  Aes128 aes;
+  aes.SetKey(kKey);
+  std::vector<uint8_t> clear(3 * 188 + 7);
+  for (size_t count = 0; count < clear.size(); ++count) {
+    clear[count] = static_cast<uint8_t>(count * 7);
+  }
+  const uint8_t kPrefix[] = {1, 2, 3};
+  for (size_t length = 0; length < 40; ++length) {
+    for (int portable = 0; portable < 2; ++portable) {
+      HlsEncrypter encrypter;
+      encrypter.Init(kKey, kIv);
+      if (portable) {
+        encrypter.DisableAesNi();
+      }
+      // The segment starts after what is already in the output, and
+      // every segment starts again from the IV.
+      std::vector<uint8_t> output(kPrefix, kPrefix + sizeof(kPrefix));
+      for (int segment = 0; segment < 2; ++segment) {
+        output.resize(sizeof(kPrefix));
+        encrypter.StartSegment(sizeof(kPrefix));
+        Append(&clear[0], length, &encrypter, &output);
+        Append(&clear[length], clear.size() - 2 * length, &encrypter,
+               &output);
+        Append(&clear[clear.size() - length], length, &encrypter, &output);
+        Finish(&encrypter, &output);
+        ASSERT_EQ(0u, (output.size() - sizeof(kPrefix)) % 16);
+        EXPECT_EQ(0, memcmp(kPrefix, &output[0], sizeof(kPrefix)));
+
+        std::vector<uint8_t> data(output.begin() + sizeof(kPrefix),
+                                  output.end());
+        CbcsDecrypter decrypter(aes, kIv, sizeof(kIv), 1, 0);
+        decrypter.DecryptRange(&data[0], data.size());
+        uint8_t padding = data.back();
+        ASSERT_GE(16, padding);
+        ASSERT_LT(0, padding);
+        ASSERT_EQ(clear.size() + padding, data.size());
+        EXPECT_EQ(0, memcmp(&clear[0], &data[0], clear.size()));
+        for (size_t count = clear.size(); count < data.size(); ++count) {
+          EXPECT_EQ(padding, data[count]);
+        }
+      }
+    }
+  }
+}
+}  // namespace dash2hls
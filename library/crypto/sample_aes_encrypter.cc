@@ -0,0 +1,190 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/crypto/sample_aes_encrypter.h"
+
+#include <string.h>
+
+#include "library/crypto/aes_ctr.h"
+#include "library/ps/nalu.h"
+#include "library/utilities.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || defined(__GNUC__))
+#define DASH2HLS_AES_NI 1
+#include <wmmintrin.h>
+#endif
+
+namespace {
+const size_t kBlockSize = dash2hls::Aes128::kBlockSize;
+const size_t kRounds = dash2hls::Aes128::kRounds;
+// Slices this long or shorter are not encrypted at all.
+const size_t kMinEncryptedNaluSize = 48;
+const size_t kAdtsHeaderSize = 7;
+const size_t kAdtsHeaderWithCrcSize = 9;
+const uint8_t kAdtsProtectionAbsent = 0x01;
+const uint8_t kEmulationPrevention = 0x03;
+
+#ifdef DASH2HLS_AES_NI
+__attribute__((target("aes")))
+inline __m128i LoadBlock(const uint8_t* block) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+__attribute__((target("aes")))
+void EncryptPatternAesNi(const uint8_t* round_keys, const uint8_t* iv,
+                         uint8_t* data, size_t length, size_t stride) {
+  __m128i keys[kRounds + 1];
+  for (size_t round = 0; round <= kRounds; ++round) {
+    keys[round] = LoadBlock(round_keys + round * kBlockSize);
+  }
+  __m128i state = LoadBlock(iv);
+  for (size_t offset = 0; offset + kBlockSize <= length; offset += stride) {
+    uint8_t* position = data + offset;
+    state = _mm_xor_si128(_mm_xor_si128(LoadBlock(position), state),
+                          keys[0]);
+    for (size_t round = 1; round < kRounds; ++round) {
+      state = _mm_aesenc_si128(state, keys[round]);
+    }
+    state = _mm_aesenclast_si128(state, keys[kRounds]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(position), state);
+  }
+}
+#endif  // DASH2HLS_AES_NI
+
+// Adds start code emulation prevention to the bytes of |buffer| from
+// |start| to |end|, moving everything after them along.  Encrypted slices
+// rarely need any, so memchr skips to the zero bytes and nothing moves
+// unless it has to.
+void AddEmulationPrevention(std::vector<uint8_t>* buffer, size_t start,
+                            size_t end) {
+  std::vector<size_t> positions;
+  const uint8_t* data = &(*buffer)[0];
+  const uint8_t* position = data + start;
+  const uint8_t* last = data + end;
+  while (last - position > 2) {
+    const uint8_t* zero = static_cast<const uint8_t*>(
+        memchr(position, 0, last - position - 2));
+    if (!zero) {
+      break;
+    }
+    if (zero[1]) {
+      position = zero + 1;
+    } else if (zero[2] <= kEmulationPrevention) {
+      // The byte after the inserted one may start the next zero run.
+      positions.push_back(zero + 2 - data);
+      position = zero + 2;
+    } else {
+      position = zero + 3;
+    }
+  }
+  if (positions.empty()) {
+    return;
+  }
+  size_t moved_end = buffer->size();
+  buffer->resize(moved_end + positions.size());
+  uint8_t* moved = &(*buffer)[0];
+  for (size_t count = positions.size(); count > 0; --count) {
+    size_t moved_start = positions[count - 1];
+    memmove(moved + moved_start + count, moved + moved_start,
+            moved_end - moved_start);
+    moved[moved_start + count - 1] = kEmulationPrevention;
+    moved_end = moved_start;
+  }
+}
+}  // namespace
+
+namespace dash2hls {
+
+SampleAesEncrypter::SampleAesEncrypter() : is_initialized_(false),
+                                           use_aes_ni_(false) {
+  memset(round_keys_, 0, sizeof(round_keys_));
+  memset(iv_, 0, sizeof(iv_));
+}
+
+void SampleAesEncrypter::Init(const uint8_t* key, const uint8_t* iv) {
+  aes_.SetKey(key);
+  memcpy(iv_, iv, sizeof(iv_));
+  use_aes_ni_ = AesCtr::HasAesNi();
+  const uint32_t* words = aes_.get_round_keys();
+  for (size_t count = 0; count < (kRounds + 1) * 4; ++count) {
+    htonlToBuffer(words[count], round_keys_ + count * sizeof(uint32_t));
+  }
+  is_initialized_ = true;
+}
+
+bool SampleAesEncrypter::EncryptNalus(std::vector<uint8_t>* nalus) const {
+  size_t position = 0;
+  while (position < nalus->size()) {
+    if (nalus->size() - position < sizeof(uint32_t)) {
+      return false;
+    }
+    uint8_t* nalu = &(*nalus)[position];
+    size_t nalu_length = ntohlFromBuffer(nalu);
+    position += sizeof(uint32_t);
+    if (!nalu_length || (nalu_length > nalus->size() - position)) {
+      return false;
+    }
+    memcpy(nalu, "\000\000\000\001", sizeof(uint32_t));
+    uint8_t type = nalu[sizeof(uint32_t)] & nalu::kNaluTypeMask;
+    if ((nalu_length > kMinEncryptedNaluSize) &&
+        ((type == nalu::kNaluType_UnpartitionedNonIdrSlice) ||
+         (type == nalu::kNaluType_IdrSlice))) {
+      // The last block is only encrypted if at least a byte follows it.
+      EncryptPattern(nalu + sizeof(uint32_t) + kNaluClearLeader,
+                     nalu_length - kNaluClearLeader - 1,
+                     kNaluPatternLength);
+      size_t size = nalus->size();
+      AddEmulationPrevention(nalus, position, position + nalu_length);
+      nalu_length += nalus->size() - size;
+    }
+    position += nalu_length;
+  }
+  return true;
+}
+
+void SampleAesEncrypter::EncryptAdtsFrame(uint8_t* frame,
+                                          size_t length) const {
+  size_t header_size = kAdtsHeaderWithCrcSize;
+  if ((length > 1) && (frame[1] & kAdtsProtectionAbsent)) {
+    header_size = kAdtsHeaderSize;
+  }
+  if (length <= header_size + kAdtsClearLeader) {
+    return;
+  }
+  EncryptPattern(frame + header_size + kAdtsClearLeader,
+                 length - header_size - kAdtsClearLeader, kBlockSize);
+}
+
+void SampleAesEncrypter::EncryptPattern(uint8_t* data, size_t length,
+                                        size_t stride) const {
+#ifdef DASH2HLS_AES_NI
+  if (use_aes_ni_) {
+    EncryptPatternAesNi(round_keys_, iv_, data, length, stride);
+    return;
+  }
+#endif  // DASH2HLS_AES_NI
+  const uint8_t* chain = iv_;
+  for (size_t offset = 0; offset + kBlockSize <= length; offset += stride) {
+    uint8_t* position = data + offset;
+    for (size_t count = 0; count < kBlockSize; ++count) {
+      position[count] ^= chain[count];
+    }
+    aes_.EncryptBlock(position, position);
+    chain = position;
+  }
+}
+}  // namespace dash2hls
@@ -0,0 +1,92 @@
+#ifndef _DASH2HLS_SAMPLE_AES_ENCRYPTER_H_
+#define _DASH2HLS_SAMPLE_AES_ENCRYPTER_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// SampleAesEncrypter encrypts samples for #EXT-X-KEY:METHOD=SAMPLE-AES, the
+// Apple "MPEG-2 Stream Encryption Format for HTTP Live Streaming".  Only
+// the media data is encrypted, the TS packets, PES headers, ADTS headers
+// and parameter sets stay clear.
+//
+// H.264: only slices (nalu types 1 and 5) longer than 48 bytes.  After 32
+// clear bytes, the first of every 10 blocks is encrypted with AES-128-CBC,
+// a final block with nothing after it stays clear.  The encrypted nalu
+// then gets start code emulation prevention on top of its own, which the
+// player removes before decrypting.
+//
+// AAC: after the ADTS header and 16 clear bytes, every whole block is
+// encrypted with AES-128-CBC.
+//
+// The CBC chain restarts from the IV with every nalu and every frame.
+//
+// EXAMPLE:
+//   SampleAesEncrypter encrypter;
+//   encrypter.Init(key, iv);
+//   std::vector<uint8_t> pes_data(sample, sample + sample_size);
+//   encrypter.EncryptNalus(&pes_data);
+//   encrypter.EncryptAdtsFrame(adts_frame, frame_size);
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+
+namespace dash2hls {
+
+class SampleAesEncrypter {
+ public:
+  enum {
+    kNaluClearLeader = 32,
+    kNaluPatternLength = 10 * Aes128::kBlockSize,
+    kAdtsClearLeader = 16,
+  };
+
+  SampleAesEncrypter();
+
+  // |key| and |iv| are Aes128::kKeySize bytes.
+  void Init(const uint8_t* key, const uint8_t* iv);
+  bool is_initialized() const {return is_initialized_;}
+  const uint8_t* get_iv() const {return iv_;}
+
+  // Replaces the 4 byte length in front of each nalu of |nalus| with a
+  // start code, as nalu::ReplaceLengthWithStartCode does, and encrypts the
+  // slices in place on the way.  Emulation prevention can grow |nalus|.
+  // Returns false if the lengths do not fit.
+  bool EncryptNalus(std::vector<uint8_t>* nalus) const;
+  // Encrypts the |length| byte ADTS frame at |frame| in place.
+  void EncryptAdtsFrame(uint8_t* frame, size_t length) const;
+
+  // Uses Aes128 even if the CPU has AES-NI, for tests and benchmarks.
+  void DisableAesNi() {use_aes_ni_ = false;}
+
+ private:
+  // CBC encrypts, from the IV, the whole block at the start of every
+  // |stride| bytes of the |length| bytes at |data|.
+  void EncryptPattern(uint8_t* data, size_t length, size_t stride) const;
+
+  bool is_initialized_;
+  bool use_aes_ni_;
+  Aes128 aes_;
+  // The key schedule of |aes_| in byte order, for AES-NI.
+  uint8_t round_keys_[(Aes128::kRounds + 1) * Aes128::kBlockSize];
+  uint8_t iv_[Aes128::kBlockSize];
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_SAMPLE_AES_ENCRYPTER_H_
@@ -0,0 +1,188 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_decrypter.h"
+#include "library/crypto/sample_aes_encrypter.h"
+#include "library/ps/nalu.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+namespace {
+const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                       0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+// Appends a nalu of |type| and |length| bytes, with its length in front.
+// The bytes after the header never hold a start code.
+void AddNalu(uint8_t type, size_t length, std::vector<uint8_t>* nalus) {
+  uint8_t size[sizeof(uint32_t)];
+  htonlToBuffer(static_cast<uint32_t>(length), size);
+  nalus->insert(nalus->end(), size, size + sizeof(size));
+  nalus->push_back(0x60 | type);
+  for (size_t count = 1; count < length; ++count) {
+    nalus->push_back(static_cast<uint8_t>(count * 7 + 1) | 0x01);
+  }
+}
+
+// Removes the emulation prevention added after encryption the way a player
+// does, 00 00 03 loses the 03 if anything follows it.
+std::vector<uint8_t> RemoveEmulationPrevention(const uint8_t* data,
+                                               size_t length) {
+  std::vector<uint8_t> result;
+  size_t count = 0;
+  while (count < length) {
+    if ((length - count > 3) && !data[count] && !data[count + 1] &&
+        (data[count + 2] == 0x03)) {
+      result.push_back(data[count]);
+      result.push_back(data[count + 1]);
+      count += 3;
+    } else {
+      result.push_back(data[count]);
+      ++count;
+    }
+  }
+  return result;
+}
+
+// Splits start code separated nalus.  None of the test nalus hold
+// 00 00 00 01 themselves.
+std::vector<std::vector<uint8_t> > SplitNalus(
+    const std::vector<uint8_t>& stream) {
+  std::vector<std::vector<uint8_t> > result;
+  size_t count = 0;
+  while (count + 4 <= stream.size()) {
+    if (!stream[count] && !stream[count + 1] && !stream[count + 2] &&
+        (stream[count + 3] == 0x01)) {
+      result.push_back(std::vector<uint8_t>());
+      count += 4;
+    } else {
+      result.back().push_back(stream[count]);
+      ++count;
+    }
+  }
+  while (count < stream.size()) {
+    result.back().push_back(stream[count]);
+    ++count;
+  }
+  return result;
+}
+}  // namespace
+
+TEST(SampleAesEncrypter, Nalus) {
+  std::vector<uint8_t> nalus;
+  AddNalu(nalu::kNaluType_SequenceParamterSet, 100, &nalus);
+  AddNalu(nalu::kNaluType_IdrSlice, 48, &nalus);
+  AddNalu(nalu::kNaluType_IdrSlice, 49, &nalus);
+  AddNalu(nalu::kNaluType_UnpartitionedNonIdrSlice, 400, &nalus);
+  // The encrypted slice is escaped again, on top of its own escaping.
+  const size_t kEscaped = 4 + 100 + 4 + 48 + 4 + 49 + 4 + 10;
+  nalus[kEscaped] = 0x00;
+  nalus[kEscaped + 1] = 0x00;
+  nalus[kEscaped + 2] = 0x03;
+  const size_t kLengths[] = {100, 48, 49, 400};
+
+  Aes128 aes;
+  aes.SetKey(kKey);
+  std::vector<uint8_t> expected_stream;
+  for (int portable = 0; portable < 2; ++portable) {
+    SampleAesEncrypter encrypter;
+    encrypter.Init(kKey, kIv);
+    if (portable) {
+      encrypter.DisableAesNi();
+    }
+    std::vector<uint8_t> stream(nalus.begin(), nalus.end());
+    ASSERT_TRUE(encrypter.EncryptNalus(&stream));
+    if (portable) {
+      EXPECT_EQ(expected_stream, stream);
+      continue;
+    }
+    expected_stream = stream;
+
+    std::vector<std::vector<uint8_t> > split = SplitNalus(stream);
+    ASSERT_EQ(4u, split.size());
+    // The parameter set and the short slice stay as they are.
+    const uint8_t* original = &nalus[sizeof(uint32_t)];
+    EXPECT_EQ(0, memcmp(original, &split[0][0], kLengths[0]));
+    original += kLengths[0] + sizeof(uint32_t);
+    ASSERT_EQ(kLengths[1], split[1].size());
+    EXPECT_EQ(0, memcmp(original, &split[1][0], kLengths[1]));
+    original += kLengths[1] + sizeof(uint32_t);
+    ASSERT_EQ(kLengths[3] + 1, split[3].size());
+    EXPECT_EQ(0x03, split[3][12]);
+    EXPECT_EQ(0x03, split[3][13]);
+
+    // 49 bytes encrypt the one block after the 32 byte leader.
+    for (size_t slice = 2; slice < 4; ++slice) {
+      std::vector<uint8_t> clear =
+          RemoveEmulationPrevention(&split[slice][0], split[slice].size());
+      ASSERT_EQ(kLengths[slice], clear.size());
+      EXPECT_EQ(0, memcmp(original, &clear[0], 32));
+      EXPECT_NE(0, memcmp(original + 32, &clear[32], 16));
+      EXPECT_EQ(original[kLengths[slice] - 1], clear.back());
+      CbcsDecrypter decrypter(aes, kIv, sizeof(kIv), 1, 9);
+      decrypter.DecryptRange(&clear[32], kLengths[slice] - 33);
+      EXPECT_EQ(0, memcmp(original, &clear[0], kLengths[slice]));
+      original += kLengths[slice] + sizeof(uint32_t);
+    }
+  }
+
+  // A length running past the end fails.
+  std::vector<uint8_t> stream(nalus.begin(), nalus.end() - 1);
+  SampleAesEncrypter encrypter;
+  encrypter.Init(kKey, kIv);
+  EXPECT_FALSE(encrypter.EncryptNalus(&stream));
+}
+
+TEST(SampleAesEncrypter, AdtsFrame) {
+  Aes128 aes;
+  aes.SetKey(kKey);
+  for (int portable = 0; portable < 2; ++portable) {
+    SampleAesEncrypter encrypter;
+    encrypter.Init(kKey, kIv);
+    if (portable) {
+      encrypter.DisableAesNi();
+    }
+    // 7 byte header, 16 clear bytes, 2 encrypted blocks and 8 clear bytes.
+    std::vector<uint8_t> frame(7 + 16 + 40);
+    for (size_t count = 0; count < frame.size(); ++count) {
+      frame[count] = static_cast<uint8_t>(count);
+    }
+    frame[0] = 0xff;
+    frame[1] = 0xf1;
+    std::vector<uint8_t> original = frame;
+    encrypter.EncryptAdtsFrame(&frame[0], frame.size());
+    EXPECT_EQ(0, memcmp(&original[0], &frame[0], 23));
+    EXPECT_NE(0, memcmp(&original[23], &frame[23], 32));
+    EXPECT_EQ(0, memcmp(&original[55], &frame[55], 8));
+    CbcsDecrypter decrypter(aes, kIv, sizeof(kIv), 1, 0);
+    decrypter.DecryptRange(&frame[23], 40);
+    EXPECT_EQ(original, frame);
+
+    // Frames with no whole block after the leader stay clear.
+    frame.resize(7 + 16 + 15);
+    original.assign(frame.begin(), frame.end());
+    encrypter.EncryptAdtsFrame(&frame[0], frame.size());
+    EXPECT_EQ(original, frame);
+  }
+}
+}  // namespace dash2hls
@@ -34,6 +34,10 @@ limitations under the License.
 #include "library/dash/pssh_contents.h"
 #include "library/dash/saio_contents.h"
 #include "library/dash/saiz_contents.h"
+#include "library/dash/sbgp_contents.h"
+#include "library/dash/schm_contents.h"
+#include "library/dash/senc_contents.h"
+#include "library/dash/sgpd_contents.h"
 #include "library/dash/sidx_contents.h"
 #include "library/dash/stsd_contents.h"
 #include "library/dash/stsz_contents.h"
@@ -119,6 +123,9 @@ void Box::CreateContentsObject() {
     case BoxType::kBox_mvhd:
       contents_.reset(new MvhdContents(stream_position_));
       break;
+    case BoxType::kBox_schm:
+      contents_.reset(new SchmContents(stream_position_));
+      break;
     case BoxType::kBox_sidx:
       contents_.reset(new SidxContents(stream_position_));
       break;
@@ -131,6 +138,15 @@ void Box::CreateContentsObject() {
     case BoxType::kBox_saiz:
       contents_.reset(new SaizContents(stream_position_));
       break;
+    case BoxType::kBox_sbgp:
+      contents_.reset(new SbgpContents(stream_position_));
+      break;
+    case BoxType::kBox_senc:
+      contents_.reset(new SencContents(stream_position_));
+      break;
+    case BoxType::kBox_sgpd:
+      contents_.reset(new SgpdContents(stream_position_));
+      break;
     case BoxType::kBox_stsd:
       contents_.reset(new StsdContents(stream_position_));
       break;
@@ -40,11 +40,13 @@ class BoxType {
     kBox_avc1 = 'avc1',
     kBox_avcC = 'avcC',
     kBox_dinf = 'dinf',
+    kBox_dref = 'dref',
     kBox_edts = 'edts',
     kBox_elst = 'elst',
     kBox_enca = 'enca',
     kBox_encv = 'encv',
     kBox_esds = 'esds',
+    kBox_frma = 'frma',
     kBox_ftyp = 'ftyp',
     kBox_hdlr = 'hdlr',
     kBox_mdat = 'mdat',
@@ -60,7 +62,11 @@ class BoxType {
     kBox_pssh = 'pssh',
     kBox_saio = 'saio',
     kBox_saiz = 'saiz',
+    kBox_sbgp = 'sbgp',
     kBox_schi = 'schi',
+    kBox_schm = 'schm',
+    kBox_senc = 'senc',
+    kBox_sgpd = 'sgpd',
     kBox_sidx = 'sidx',
     kBox_sinf = 'sinf',
     kBox_smhd = 'smhd',
@@ -79,6 +85,7 @@ class BoxType {
     kBox_trak = 'trak',
     kBox_trex = 'trex',
     kBox_trun = 'trun',
+    kBox_url = 'url ',
     kBox_vmhd = 'vmhd',
     kBox_NoNe = '....',  // Not a real box, useful for testing.
   };
@@ -41,6 +41,8 @@ class FullBoxContents : public BoxContents {
   virtual size_t Parse(const uint8_t* buffer, size_t length);
   virtual std::string PrettyPrint(std::string indent) const;
 
+  Version get_version() const {return version_;}
+
  protected:
   Version version_;
   uint32_t flags_;
@@ -32,6 +32,10 @@ namespace dash2hls {
 
 class PsshContents : public FullBoxContents {
  public:
+  enum {
+    kSystemIdSize = 16,
+  };
+
   explicit PsshContents(uint64_t stream_position)
       : FullBoxContents(BoxType::kBox_pssh, stream_position) {}
 
@@ -40,14 +44,15 @@ class PsshContents : public FullBoxContents {
     return "ProtectionSystemSpecificHeader";
   }
 
-  const std::vector<uint8_t> get_full_box() const {return full_box_;}
+  const std::vector<uint8_t>& get_full_box() const {return full_box_;}
   const std::vector<uint8_t> get_contents() const {return contents_;}
+  const uint8_t* get_system_id() const {return system_id_;}
 
  protected:
   virtual size_t Parse(const uint8_t* buffer, size_t length);
 
  private:
-  uint8_t system_id_[16];
+  uint8_t system_id_[kSystemIdSize];
   std::vector<uint8_t> full_box_;
   std::vector<uint8_t> data_;
   std::vector<uint8_t> contents_;
@@ -0,0 +1,89 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/dash/sbgp_contents.h"
+
+#include "library/dash/box.h"
+#include "library/dash/dash_parser.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+// See ISO 14496-12 for details.
+// aligned(8) class SampleToGroupBox extends FullBox(‘sbgp’, version, 0)
+// {
+//   unsigned int(32) grouping_type;
+//   if (version == 1) {
+//     unsigned int(32) grouping_type_parameter;
+//   }
+//   unsigned int(32) entry_count;
+//   for (i=1; i <= entry_count; i++) {
+//     unsigned int(32) sample_count;
+//     unsigned int(32) group_description_index;
+//   }
+// }
+size_t SbgpContents::Parse(const uint8_t* buffer, size_t length) {
+  const uint8_t* ptr = buffer + FullBoxContents::Parse(buffer, length);
+  size_t header_size = sizeof(uint32_t) * (version_ == kVersion1 ? 3 : 2);
+  if ((ptr == buffer) ||
+      !EnoughBytesToParse(ptr - buffer, header_size, length)) {
+    DASH_LOG((BoxName() + " too short").c_str(),
+             "Not enough bytes for the grouping type and entry count",
+             DumpMemory(buffer, length).c_str());
+    return DashParser::kParseFailure;
+  }
+  grouping_type_ = ntohlFromBuffer(ptr);
+  ptr += sizeof(uint32_t);
+  if (version_ == kVersion1) {
+    grouping_type_parameter_ = ntohlFromBuffer(ptr);
+    ptr += sizeof(uint32_t);
+  }
+  uint32_t entry_count = ntohlFromBuffer(ptr);
+  ptr += sizeof(uint32_t);
+  if (!EnoughBytesToParse(ptr - buffer,
+                          entry_count * 2 * sizeof(uint32_t), length)) {
+    DASH_LOG((BoxName() + " too short").c_str(),
+             "Not enough data for entries",
+             DumpMemory(buffer, length).c_str());
+    return DashParser::kParseFailure;
+  }
+  entries_.resize(entry_count);
+  for (uint32_t count = 0; count < entry_count; ++count) {
+    entries_[count].sample_count = ntohlFromBuffer(ptr);
+    ptr += sizeof(uint32_t);
+    entries_[count].group_description_index = ntohlFromBuffer(ptr);
+    ptr += sizeof(uint32_t);
+  }
+  return ptr - buffer;
+}
+
+std::string SbgpContents::PrettyPrint(std::string indent) const {
+  std::string result = FullBoxContents::PrettyPrint(indent);
+  result += " Type:" + PrettyPrintValue(grouping_type_);
+  if (version_ == kVersion1) {
+    result += " Parameter:" + PrettyPrintValue(grouping_type_parameter_);
+  }
+  result += " Entries:" + PrettyPrintValue(entries_.size());
+  if (g_verbose_pretty_print) {
+    for (size_t count = 0; count < entries_.size(); ++count) {
+      result += "\n" + indent + "  " +
+          PrettyPrintValue(entries_[count].sample_count) + " samples in " +
+          PrettyPrintValue(entries_[count].group_description_index);
+    }
+  }
+  return result;
+}
+}  // namespace dash2hls
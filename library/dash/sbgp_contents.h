@@ -0,0 +1,65 @@
+#ifndef _DASH2HLS_SBGP_CONTENTS_H_
+#define _DASH2HLS_SBGP_CONTENTS_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Sample To Group Box assigns runs of samples to the entries of the sgpd
+// with the same grouping type.  An index of 0 is no group, indexes above
+// kFragmentLocalIndex are entries of the sgpd in the same traf, counted
+// from kFragmentLocalIndex + 1.
+
+#include <string>
+#include <vector>
+
+#include "library/dash/box_type.h"
+#include "library/dash/full_box_contents.h"
+
+namespace dash2hls {
+
+class SbgpContents : public FullBoxContents {
+ public:
+  enum {
+    kFragmentLocalIndex = 0x10000,
+  };
+  struct Entry {
+    uint32_t sample_count;
+    uint32_t group_description_index;
+  };
+
+  explicit SbgpContents(uint64_t stream_position)
+      : FullBoxContents(BoxType::kBox_sbgp, stream_position),
+        grouping_type_(0), grouping_type_parameter_(0) {}
+  virtual std::string PrettyPrint(std::string indent) const;
+  virtual std::string BoxName() const {return "SampleToGroupBox";}
+
+  uint32_t get_grouping_type() const {return grouping_type_;}
+  uint32_t get_grouping_type_parameter() const {
+    return grouping_type_parameter_;
+  }
+  const std::vector<Entry>& get_entries() const {return entries_;}
+
+ protected:
+  virtual size_t Parse(const uint8_t* buffer, size_t length);
+
+ private:
+  uint32_t grouping_type_;
+  uint32_t grouping_type_parameter_;
+  std::vector<Entry> entries_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_SBGP_CONTENTS_H_
@@ -0,0 +1,73 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/dash/schm_contents.h"
+
+#include "library/dash/box.h"
+#include "library/dash/dash_parser.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+// See ISO 14496-12 for details.
+// aligned(8) class SchemeTypeBox extends FullBox('schm', 0, flags) {
+//   unsigned int(32) scheme_type;
+//   unsigned int(32) scheme_version;
+//   if (flags & 0x000001) {
+//     unsigned int(8) scheme_uri[];
+//   }
+// }
+size_t SchmContents::Parse(const uint8_t* buffer, size_t length) {
+  const uint8_t* ptr = buffer + FullBoxContents::Parse(buffer, length);
+  if ((ptr == buffer) ||
+      !EnoughBytesToParse(ptr - buffer, 2 * sizeof(uint32_t), length)) {
+    DASH_LOG((BoxName() + " too short").c_str(),
+             "At least 12 bytes are required",
+             DumpMemory(buffer, length).c_str());
+    return DashParser::kParseFailure;
+  }
+  scheme_type_ = ntohlFromBuffer(ptr);
+  ptr += sizeof(scheme_type_);
+  scheme_version_ = ntohlFromBuffer(ptr);
+  ptr += sizeof(scheme_version_);
+  scheme_uri_.clear();
+  if (flags_ & kSchemeUriPresent) {
+    // A null terminated string that runs to the end of the box.
+    const uint8_t* end = buffer + length;
+    const uint8_t* uri = ptr;
+    while (ptr < end && *ptr) {
+      ++ptr;
+    }
+    scheme_uri_.assign(reinterpret_cast<const char*>(uri), ptr - uri);
+    ptr = end;
+  }
+  return ptr - buffer;
+}
+
+std::string SchmContents::PrettyPrint(std::string indent) const {
+  std::string result = FullBoxContents::PrettyPrint(indent);
+  const char scheme[] = {static_cast<char>(scheme_type_ >> 24),
+                         static_cast<char>(scheme_type_ >> 16),
+                         static_cast<char>(scheme_type_ >> 8),
+                         static_cast<char>(scheme_type_), '\0'};
+  result += " Scheme:" + std::string(scheme);
+  result += " Version:" + PrettyPrintValue(scheme_version_);
+  if (!scheme_uri_.empty()) {
+    result += " URI:" + scheme_uri_;
+  }
+  return result;
+}
+}  // namespace dash2hls
@@ -0,0 +1,57 @@
+#ifndef _DASH2HLS_SCHM_CONTENTS_H_
+#define _DASH2HLS_SCHM_CONTENTS_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Scheme Type Box names the protection scheme of an encrypted track, 'cenc'
+// or 'cbcs' for the schemes the library decrypts.
+
+#include <string>
+
+#include "library/dash/box_type.h"
+#include "library/dash/full_box_contents.h"
+
+namespace dash2hls {
+
+class SchmContents : public FullBoxContents {
+ public:
+  enum {
+    kSchemeCenc = 0x63656e63,  // 'cenc'
+    kSchemeCbcs = 0x63626373,  // 'cbcs'
+    kSchemeUriPresent = 0x000001,
+  };
+  explicit SchmContents(uint64_t stream_position)
+      : FullBoxContents(BoxType::kBox_schm, stream_position) {}
+
+  uint32_t get_scheme_type() const {return scheme_type_;}
+  uint32_t get_scheme_version() const {return scheme_version_;}
+  const std::string& get_scheme_uri() const {return scheme_uri_;}
+
+  virtual std::string PrettyPrint(std::string indent) const;
+  virtual std::string BoxName() const {return "Scheme Type Box";}
+
+ protected:
+  virtual size_t Parse(const uint8_t* buffer, size_t length);
+
+ private:
+  uint32_t scheme_type_;
+  uint32_t scheme_version_;
+  std::string scheme_uri_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_SCHM_CONTENTS_H_
@@ -0,0 +1,99 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/dash/senc_contents.h"
+
+#include "library/dash/box.h"
+#include "library/dash/dash_parser.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+bool SencContents::IsSubsamplePresent() const {
+  return flags_ & kUseSubSampleEncryptionMask;
+}
+
+bool SencContents::IsOverridePresent() const {
+  return flags_ & kOverrideTrackEncryptionBoxParametersMask;
+}
+
+// See ISO 23001-7 for details.  The override is from PIFF 1.1, which
+// has the same box as a uuid.
+// aligned(8) class SampleEncryptionBox extends FullBox(‘senc’, version=0,
+//                                                      flags)
+// {
+//   if (flags & 0x000001) {
+//     unsigned int(24) AlgorithmID;
+//     unsigned int(8) IV_size;
+//     unsigned int(8)[16] KID;
+//   }
+//   unsigned int(32) sample_count;
+//   {
+//     unsigned int(Per_Sample_IV_Size*8) InitializationVector;
+//     if (flags & 0x000002) {
+//       unsigned int(16) subsample_count;
+//       {
+//         unsigned int(16) BytesOfClearData;
+//         unsigned int(32) BytesOfProtectedData;
+//       } [subsample_count]
+//     }
+//   } [sample_count]
+// }
+size_t SencContents::Parse(const uint8_t* buffer, size_t length) {
+  const uint8_t* ptr = buffer + FullBoxContents::Parse(buffer, length);
+  if (ptr == buffer) {
+    return DashParser::kParseFailure;
+  }
+  if (IsOverridePresent()) {
+    if (!EnoughBytesToParse(ptr - buffer, sizeof(uint32_t) + kKidSize,
+                            length)) {
+      DASH_LOG((BoxName() + " too short").c_str(),
+               "At least 20 bytes are required for the override",
+               DumpMemory(buffer, length).c_str());
+      return DashParser::kParseFailure;
+    }
+    override_iv_size_ = ptr[sizeof(uint32_t) - 1];
+    ptr += sizeof(uint32_t);
+    memcpy(override_kid_, ptr, kKidSize);
+    ptr += kKidSize;
+  }
+  if (!EnoughBytesToParse(ptr - buffer, sizeof(uint32_t), length)) {
+    DASH_LOG((BoxName() + " too short").c_str(),
+             "At least 4 bytes are required for the sample count",
+             DumpMemory(buffer, length).c_str());
+    return DashParser::kParseFailure;
+  }
+  sample_count_ = ntohlFromBuffer(ptr);
+  ptr += sizeof(uint32_t);
+  sample_data_ = ptr;
+  sample_data_length_ = length - (ptr - buffer);
+  return length;
+}
+
+std::string SencContents::PrettyPrint(std::string indent) const {
+  std::string result = FullBoxContents::PrettyPrint(indent);
+  if (IsOverridePresent()) {
+    result += " IV size:" + PrettyPrintValue(override_iv_size_);
+    result += " KID:" + PrettyPrintBuffer(override_kid_, kKidSize);
+  }
+  if (IsSubsamplePresent()) {
+    result += " Subsamples";
+  }
+  result += " Samples:" + PrettyPrintValue(sample_count_);
+  result += " " + PrettyPrintValue(sample_data_length_) + " bytes";
+  return result;
+}
+}  // namespace dash2hls
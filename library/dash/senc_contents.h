@@ -0,0 +1,73 @@
+#ifndef _DASH2HLS_SENC_CONTENTS_H_
+#define _DASH2HLS_SENC_CONTENTS_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Sample Encryption Box has the IV and subsample map of every sample of a
+// traf, the same bytes the saio and saiz describe.  The size of the IVs is
+// in the tenc unless the box overrides it, so the samples are only found
+// and split up by SampleEncryptionTable.
+
+#include <string>
+
+#include "library/dash/box_type.h"
+#include "library/dash/full_box_contents.h"
+
+namespace dash2hls {
+
+class SencContents : public FullBoxContents {
+ public:
+  enum {
+    kKidSize = 16,
+  };
+  explicit SencContents(uint64_t stream_position)
+      : FullBoxContents(BoxType::kBox_senc, stream_position),
+        sample_count_(0), override_iv_size_(0),
+        sample_data_(nullptr), sample_data_length_(0) {}
+  virtual std::string PrettyPrint(std::string indent) const;
+  virtual std::string BoxName() const {return "Sample Encryption Box";}
+
+  // Every sample has a subsample map after its IV.
+  bool IsSubsamplePresent() const;
+  // The box has its own IV size and key id instead of the tenc ones.
+  bool IsOverridePresent() const;
+  size_t get_override_iv_size() const {return override_iv_size_;}
+  const uint8_t* get_override_kid() const {return override_kid_;}
+
+  uint32_t get_sample_count() const {return sample_count_;}
+  // The per sample information, pointing into the parsed buffer like an
+  // mdat.
+  const uint8_t* get_sample_data() const {return sample_data_;}
+  size_t get_sample_data_length() const {return sample_data_length_;}
+
+ protected:
+  static const uint32_t kOverrideTrackEncryptionBoxParametersMask = 0x000001;
+  static const uint32_t kUseSubSampleEncryptionMask = 0x000002;
+
+ protected:
+  virtual size_t Parse(const uint8_t* buffer, size_t length);
+
+ private:
+  uint32_t sample_count_;
+  size_t override_iv_size_;
+  uint8_t override_kid_[kKidSize];
+  const uint8_t* sample_data_;
+  size_t sample_data_length_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_SENC_CONTENTS_H_
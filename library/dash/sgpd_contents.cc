@@ -0,0 +1,161 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/dash/sgpd_contents.h"
+
+#include "library/dash/box.h"
+#include "library/dash/dash_parser.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+namespace {
+// Everything up to the constant IV.
+const size_t kSeigEntrySize = 20;
+
+// See ISO 23001-7 for details, the fields are those of a tenc.
+// aligned(8) class CencSampleEncryptionInformationGroupEntry
+// extends SampleGroupEntry(‘seig’)
+// {
+//   unsigned int(8) reserved = 0;
+//   unsigned int(4) crypt_byte_block;
+//   unsigned int(4) skip_byte_block;
+//   unsigned int(8) isProtected;
+//   unsigned int(8) Per_Sample_IV_Size;
+//   unsigned int(8)[16] KID;
+//   if (isProtected ==1 && Per_Sample_IV_Size == 0) {
+//     unsigned int(8) constant_IV_size;
+//     unsigned int(8)[constant_IV_size] constant_IV;
+//   }
+// }
+//
+// Returns the size of the entry at |buffer| or 0 if it is bad.
+size_t ParseSeigEntry(const uint8_t* buffer, size_t length,
+                      SgpdContents::SeigEntry* entry) {
+  if (!EnoughBytesToParse(0, kSeigEntrySize, length)) {
+    return 0;
+  }
+  entry->crypt_byte_block = buffer[1] >> 4;
+  entry->skip_byte_block = buffer[1] & 0x0f;
+  entry->is_protected = buffer[2] == 1;
+  entry->iv_size = buffer[3];
+  memcpy(entry->kid, buffer + 4, sizeof(entry->kid));
+  entry->constant_iv_size = 0;
+  size_t size = kSeigEntrySize;
+  if (entry->is_protected && entry->iv_size == 0) {
+    if (!EnoughBytesToParse(size, sizeof(uint8_t), length) ||
+        (buffer[size] != 8 &&
+         buffer[size] != SgpdContents::kMaxConstantIvSize) ||
+        !EnoughBytesToParse(size, sizeof(uint8_t) + buffer[size], length)) {
+      return 0;
+    }
+    entry->constant_iv_size = buffer[size];
+    memcpy(entry->constant_iv, buffer + size + 1, entry->constant_iv_size);
+    size += sizeof(uint8_t) + entry->constant_iv_size;
+  }
+  return size;
+}
+}  // namespace
+
+// See ISO 14496-12 for details.
+// aligned(8) class SampleGroupDescriptionBox (unsigned int(32) handler_type)
+// extends FullBox(‘sgpd’, version, 0)
+// {
+//   unsigned int(32) grouping_type;
+//   if (version==1) {
+//     unsigned int(32) default_length;
+//   }
+//   unsigned int(32) entry_count;
+//   for (i = 1 ; i <= entry_count ; i++) {
+//     if (version==1 && default_length==0) {
+//       unsigned int(32) description_length;
+//     }
+//     SampleGroupEntry(grouping_type);
+//   }
+// }
+size_t SgpdContents::Parse(const uint8_t* buffer, size_t length) {
+  const uint8_t* ptr = buffer + FullBoxContents::Parse(buffer, length);
+  size_t header_size = sizeof(uint32_t) * (version_ == kVersion1 ? 3 : 2);
+  if ((ptr == buffer) ||
+      !EnoughBytesToParse(ptr - buffer, header_size, length)) {
+    DASH_LOG((BoxName() + " too short").c_str(),
+             "Not enough bytes for the grouping type and entry count",
+             DumpMemory(buffer, length).c_str());
+    return DashParser::kParseFailure;
+  }
+  grouping_type_ = ntohlFromBuffer(ptr);
+  ptr += sizeof(uint32_t);
+  uint32_t default_length = 0;
+  if (version_ == kVersion1) {
+    default_length = ntohlFromBuffer(ptr);
+    ptr += sizeof(uint32_t);
+  }
+  uint32_t entry_count = ntohlFromBuffer(ptr);
+  ptr += sizeof(uint32_t);
+  if (grouping_type_ != kGroupingSeig) {
+    return length;
+  }
+  for (uint32_t count = 0; count < entry_count; ++count) {
+    // Version 0 entries are as long as their fields say.
+    size_t entry_length = length - (ptr - buffer);
+    bool entry_fits = true;
+    if (version_ == kVersion1) {
+      entry_length = default_length;
+      if (entry_length == 0) {
+        entry_fits =
+            EnoughBytesToParse(ptr - buffer, sizeof(uint32_t), length);
+        if (entry_fits) {
+          entry_length = ntohlFromBuffer(ptr);
+          ptr += sizeof(uint32_t);
+        }
+      }
+      entry_fits = entry_fits &&
+          EnoughBytesToParse(ptr - buffer, entry_length, length);
+    }
+    SeigEntry entry;
+    size_t entry_size =
+        entry_fits ? ParseSeigEntry(ptr, entry_length, &entry) : 0;
+    if (entry_size == 0) {
+      DASH_LOG((BoxName() + " bad seig").c_str(),
+               "Entry does not fit or has a bad constant IV",
+               DumpMemory(buffer, length).c_str());
+      return DashParser::kParseFailure;
+    }
+    seig_entries_.push_back(entry);
+    ptr += version_ == kVersion1 ? entry_length : entry_size;
+  }
+  return ptr - buffer;
+}
+
+std::string SgpdContents::PrettyPrint(std::string indent) const {
+  std::string result = FullBoxContents::PrettyPrint(indent);
+  result += " Type:" + PrettyPrintValue(grouping_type_);
+  for (size_t count = 0; count < seig_entries_.size(); ++count) {
+    const SeigEntry& entry = seig_entries_[count];
+    result += "\n" + indent + "  IsProtected:" +
+        PrettyPrintValue(static_cast<uint8_t>(entry.is_protected));
+    result += " IV size:" + PrettyPrintValue(entry.iv_size);
+    result += " KID:" + PrettyPrintBuffer(entry.kid, kKidSize);
+    result += " Pattern:" + PrettyPrintValue(entry.crypt_byte_block) + ":" +
+        PrettyPrintValue(entry.skip_byte_block);
+    if (entry.constant_iv_size) {
+      result += " Constant IV:" + PrettyPrintBuffer(entry.constant_iv,
+                                                   entry.constant_iv_size);
+    }
+  }
+  return result;
+}
+}  // namespace dash2hls
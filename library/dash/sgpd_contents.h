@@ -0,0 +1,75 @@
+#ifndef _DASH2HLS_SGPD_CONTENTS_H_
+#define _DASH2HLS_SGPD_CONTENTS_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Sample Group Description Box has the entries an sbgp assigns samples to.
+// Only 'seig' entries are kept, they override the tenc defaults for the
+// samples of a group, usually a fragment with a rotated key or in the
+// clear.  Other grouping types are skipped.
+
+#include <string>
+#include <vector>
+
+#include "library/dash/box_type.h"
+#include "library/dash/full_box_contents.h"
+
+namespace dash2hls {
+
+class SgpdContents : public FullBoxContents {
+ public:
+  enum {
+    kGroupingSeig = 'seig',
+    kKidSize = 16,
+    kMaxConstantIvSize = 16,
+  };
+  // CencSampleEncryptionInformationGroupEntry, the same fields as a tenc.
+  struct SeigEntry {
+    uint8_t crypt_byte_block;
+    uint8_t skip_byte_block;
+    bool is_protected;
+    uint8_t iv_size;
+    uint8_t kid[kKidSize];
+    // Only present if iv_size is 0.
+    uint8_t constant_iv_size;
+    uint8_t constant_iv[kMaxConstantIvSize];
+  };
+
+  explicit SgpdContents(uint64_t stream_position)
+      : FullBoxContents(BoxType::kBox_sgpd, stream_position),
+        grouping_type_(0) {}
+  virtual std::string PrettyPrint(std::string indent) const;
+  virtual std::string BoxName() const {
+    return "SampleGroupDescriptionBox";
+  }
+
+  uint32_t get_grouping_type() const {return grouping_type_;}
+  // Empty unless the grouping type is kGroupingSeig.
+  const std::vector<SeigEntry>& get_seig_entries() const {
+    return seig_entries_;
+  }
+
+ protected:
+  virtual size_t Parse(const uint8_t* buffer, size_t length);
+
+ private:
+  uint32_t grouping_type_;
+  std::vector<SeigEntry> seig_entries_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_SGPD_CONTENTS_H_
@@ -23,38 +23,79 @@ limitations under the License.
 namespace dash2hls {
 
 // See ISO 23001-7 for details.
-// aligned(8) class TrackEncryptionBox extends FullBox(‘tenc’, version=0,
+// aligned(8) class TrackEncryptionBox extends FullBox(‘tenc’, version,
 //                                                     flags=0)
 // {
-//   unsigned int(24) default_IsEncrypted;
-//   unsigned int(8) default_IV_size;
+//   unsigned int(8) reserved = 0;
+//   if (version==0) {
+//     unsigned int(8) reserved = 0;
+//   } else {
+//     unsigned int(4) default_crypt_byte_block;
+//     unsigned int(4) default_skip_byte_block;
+//   }
+//   unsigned int(8) default_isProtected;
+//   unsigned int(8) default_Per_Sample_IV_Size;
 //   unsigned int(8)[16] default_KID;
+//   if (default_isProtected ==1 && default_Per_Sample_IV_Size == 0) {
+//     unsigned int(8) default_constant_IV_size;
+//     unsigned int(8)[default_constant_IV_size] default_constant_IV;
+//   }
 // }
 size_t TencContents::Parse(const uint8_t* buffer, size_t length) {
   const uint8_t* ptr = buffer + FullBoxContents::Parse(buffer, length);
   if ((ptr == buffer) ||
-      !EnoughBytesToParse(ptr - buffer,
-                          kDefaultIsEncryptedSize + sizeof(uint8_t) +
-                          kKidSize, length)) {
+      !EnoughBytesToParse(ptr - buffer, 4 * sizeof(uint8_t) + kKidSize,
+                          length)) {
     DASH_LOG((BoxName() + " too short").c_str(),
              "At least 20 bytes are required",
              DumpMemory(buffer, length).c_str());
     return DashParser::kParseFailure;
   }
-  default_is_encrypted_ = ntohlFromBuffer(ptr) >> kDefaultShift;
-  ptr += kDefaultIsEncryptedSize;
+  ++ptr;
+  default_crypt_byte_block_ = 0;
+  default_skip_byte_block_ = 0;
+  if (version_ != kVersion0) {
+    default_crypt_byte_block_ = *ptr >> 4;
+    default_skip_byte_block_ = *ptr & 0x0f;
+  }
+  ++ptr;
+  default_is_protected_ = *ptr;
+  ++ptr;
   default_iv_size_ = *ptr;
   ++ptr;
   memcpy(default_kid_, ptr, kKidSize);
   ptr += kKidSize;
+  default_constant_iv_size_ = 0;
+  if (default_is_protected_ == 1 && default_iv_size_ == 0) {
+    if (!EnoughBytesToParse(ptr - buffer, sizeof(uint8_t), length) ||
+        (*ptr != 8 && *ptr != kMaxConstantIvSize) ||
+        !EnoughBytesToParse(ptr - buffer, sizeof(uint8_t) + *ptr, length)) {
+      DASH_LOG((BoxName() + " bad constant IV").c_str(),
+               "A constant IV of 8 or 16 bytes is required",
+               DumpMemory(buffer, length).c_str());
+      return DashParser::kParseFailure;
+    }
+    default_constant_iv_size_ = *ptr;
+    ++ptr;
+    memcpy(default_constant_iv_, ptr, default_constant_iv_size_);
+    ptr += default_constant_iv_size_;
+  }
   return ptr - buffer;
 }
 
 std::string TencContents::PrettyPrint(std::string indent) const {
   std::string result = FullBoxContents::PrettyPrint(indent);
-  result += " IsEncrypted: " + PrettyPrintValue(default_is_encrypted_);
+  result += " IsProtected: " + PrettyPrintValue(default_is_protected_);
   result += " IV size:" + PrettyPrintValue(default_iv_size_);
   result += " Default KID:" + PrettyPrintBuffer(default_kid_, kKidSize);
+  if (version_ != kVersion0) {
+    result += " Pattern:" + PrettyPrintValue(default_crypt_byte_block_) +
+        ":" + PrettyPrintValue(default_skip_byte_block_);
+  }
+  if (default_constant_iv_size_) {
+    result += " Constant IV:" + PrettyPrintBuffer(default_constant_iv_,
+                                                 default_constant_iv_size_);
+  }
   return result;
 }
 }  // namespace dash2hls
@@ -17,7 +17,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-// Sample Table Box contains a list of all samples.
+// Track Encryption Box has the default encryption parameters of a track.
+// Version 1 adds the cbcs pattern, and a track without per sample IVs
+// carries a constant IV instead.
 
 #include <string>
 #include <vector>
@@ -31,23 +33,41 @@ class TencContents : public FullBoxContents {
  public:
   enum {
     kKidSize = 16,
-    kDefaultShift = 8,
-    kDefaultIsEncryptedSize = 3,
+    kMaxConstantIvSize = 16,
   };
   explicit TencContents(uint64_t stream_position)
-      : FullBoxContents(BoxType::kBox_stsz, stream_position) {}
+      : FullBoxContents(BoxType::kBox_tenc, stream_position) {}
   virtual std::string PrettyPrint(std::string indent) const;
   virtual std::string BoxName() const {return "Track Encryption Box";}
   size_t get_default_iv_size() const {return default_iv_size_;}
   const uint8_t* get_default_kid() const {return default_kid_;}
+  bool get_default_is_protected() const {return default_is_protected_ != 0;}
+  // Both 0 in version 0 boxes, which have no pattern.
+  uint8_t get_default_crypt_byte_block() const {
+    return default_crypt_byte_block_;
+  }
+  uint8_t get_default_skip_byte_block() const {
+    return default_skip_byte_block_;
+  }
+  // Only present, and then 8 or 16 bytes, if get_default_iv_size() is 0.
+  size_t get_default_constant_iv_size() const {
+    return default_constant_iv_size_;
+  }
+  const uint8_t* get_default_constant_iv() const {
+    return default_constant_iv_;
+  }
 
  protected:
   virtual size_t Parse(const uint8_t* buffer, size_t length);
 
  private:
-  uint32_t default_is_encrypted_;
+  uint8_t default_crypt_byte_block_;
+  uint8_t default_skip_byte_block_;
+  uint8_t default_is_protected_;
   size_t default_iv_size_;
   uint8_t default_kid_[kKidSize];
+  size_t default_constant_iv_size_;
+  uint8_t default_constant_iv_[kMaxConstantIvSize];
 };
 }  // namespace dash2hls
 
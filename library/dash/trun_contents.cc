@@ -46,6 +46,17 @@ bool TrunContents::IsSampleCompositionPresent() const {
   return flags_ & kSampleCompositionPresentMask;
 }
 
+uint32_t TrunContents::GetSampleFlags(size_t index,
+                                      uint32_t default_sample_flags) const {
+  if (IsSampleFlagsPresent()) {
+    return track_runs_[index].sample_flags_;
+  }
+  if ((index == 0) && IsFirstSampleFlagsPresent()) {
+    return first_sample_flags_;
+  }
+  return default_sample_flags;
+}
+
 // Currently only parses version 1 of a sidx box.
 //
 // See ISO 14496-12 for details.
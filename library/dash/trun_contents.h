@@ -53,6 +53,14 @@ class TrunContents : public FullBoxContents {
 
   const std::vector<TrackRun>& get_track_runs() const {return track_runs_;}
   int32_t get_data_offset() const {return data_offset_;}
+  uint32_t get_first_sample_flags() const {return first_sample_flags_;}
+  // Flags of the sample at |index|, from the trun if it has them, otherwise
+  // |default_sample_flags| from the tfhd or trex.
+  uint32_t GetSampleFlags(size_t index, uint32_t default_sample_flags) const;
+  bool IsSyncSample(size_t index, uint32_t default_sample_flags) const {
+    return !(GetSampleFlags(index, default_sample_flags) &
+             kSampleIsNonSyncSampleMask);
+  }
 
   virtual std::string PrettyPrint(std::string indent) const;
   std::string PrettyPrintTrackRun(const TrackRun& run) const;
@@ -65,6 +73,8 @@ class TrunContents : public FullBoxContents {
   static const uint32_t kSampleSizePresentMask = 0x000200;
   static const uint32_t kSampleFlagsPresentMask = 0x000400;
   static const uint32_t kSampleCompositionPresentMask = 0x00800;
+  // sample_is_non_sync_sample in the sample flags.
+  static const uint32_t kSampleIsNonSyncSampleMask = 0x00010000;
 
  protected:
   virtual size_t Parse(const uint8_t* buffer, size_t length);
@@ -32,6 +32,14 @@ class VideoSampleEntryContents : public SampleEntryContents {
   virtual std::string PrettyPrint(std::string indent) const;
   virtual std::string BoxName() const {return "SampleEntry";}
 
+  uint16_t get_width() const {
+    return width_;
+  }
+
+  uint16_t get_height() const {
+    return height_;
+  }
+
  protected:
   virtual size_t Parse(const uint8_t* buffer, size_t length);
 
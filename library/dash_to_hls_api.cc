@@ -18,8 +18,20 @@ limitations under the License.
 #include "library/dash_to_hls_api_avframework.h"
 #endif
 
+#include <algorithm>
+#include <limits>
+
 #include "include/DashToHlsApi.h"
 #include "library/adts/adts_out.h"
+#include "library/async_decrypter.h"
+#include "library/byte_buffer.h"
+#include "library/clock_rescaler.h"
+#include "library/crypto/aes.h"
+#include "library/crypto/aes_ctr.h"
+#include "library/crypto/cbcs_decrypter.h"
+#include "library/crypto/cbcs_transcrypter.h"
+#include "library/crypto/hls_encrypter.h"
+#include "library/dash/avc1_contents.h"
 #include "library/dash/avcc_contents.h"
 #include "library/dash/box.h"
 #include "library/dash/box_type.h"
@@ -31,20 +43,41 @@ limitations under the License.
 #include "library/dash/pssh_contents.h"
 #include "library/dash/saio_contents.h"
 #include "library/dash/saiz_contents.h"
+#include "library/dash/sbgp_contents.h"
+#include "library/dash/schm_contents.h"
+#include "library/dash/senc_contents.h"
+#include "library/dash/sgpd_contents.h"
 #include "library/dash/sidx_contents.h"
 #include "library/dash/tfdt_contents.h"
 #include "library/dash/tfhd_contents.h"
 #include "library/dash/trex_contents.h"
 #include "library/dash/trun_contents.h"
 #include "library/dash_to_hls_session.h"
+#include "library/fmp4/fmp4_out.h"
+#include "library/ps/program_stream_out.h"
+#include "library/sample_encryption_table.h"
+#include "library/segment_planner.h"
 #include "library/ts/transport_stream_out.h"
 #include "utilities.h"
 
 namespace {
 const size_t kIvSize = 16;
-const size_t kIvCounterOffset = 8;
-const size_t kIvCounterSize = 8;
 const size_t kDtsClock = 90000;
+const size_t kTsPacketSize = 188;
+const size_t kTsPayloadSize = 184;
+const size_t kTsPsiPackets = 2;
+const size_t kVideoSampleOverhead = 32;
+// Pack header, PES header and an AUD or ADTS header.
+const size_t kPsSampleOverhead = 48;
+// Longest audio PES in muxed output, in 90kHz ticks, see
+// TransportStreamOut::set_audio_aggregation_duration.
+const uint64_t kMuxedAudioPesDuration = 9000;
+// moof, traf, tfhd, tfdt, trun and mdat headers, and a trun entry per sample.
+const size_t kFmp4FragmentOverhead = 128;
+const size_t kFmp4SampleOverhead = 16;
+// The cbcs pattern for video, 1 encrypted block in 10.
+const uint8_t kCbcsCryptByteBlock = 1;
+const uint8_t kCbcsVideoSkipByteBlock = 9;
 }  // namespace
 
 namespace dash2hls {
@@ -78,7 +111,7 @@ DashToHlsStatus ProcessAvcc(const AvcCContents* avcc,
 }
 
 // Duration of a sample can be either in the individual trun or it can
-// use the default set in the tfhd.
+// use the default set in the tfhd.  Returns 0 if there is no duration.
 uint64_t GetDuration(const TrunContents* trun,
                      const TrunContents::TrackRun* track_run,
                      const TfhdContents* tfhd,
@@ -102,7 +135,6 @@ uint64_t GetDuration(const TrunContents* trun,
                (trun->BoxName() + ":" + trun->PrettyPrint("") + " " +
                 PrettyPrintValue(trex_default_sample_duration)).c_str());
     }
-    return kDashToHlsStatus_BadDashContents;
   }
   return duration;
 }
@@ -113,10 +145,97 @@ void ProcessPsshBoxes(Session* session,
     const PsshContents* pssh =
         reinterpret_cast<const PsshContents*>((*iter)->get_contents());
     session->is_encrypted_ = true;
-    session->pssh_handler_(session->pssh_context_,
-                           pssh->get_full_box().data(),
-                           pssh->get_full_box().size());
+    // Sessions that never call the decryption handler have no use for the
+    // license.
+    if (!session->pssh_handler_) {
+      continue;
+    }
+    const std::vector<uint8_t>& box = pssh->get_full_box();
+    uint32_t crc = static_cast<uint32_t>(
+        wvcrc32(box.data(), static_cast<int>(box.size())));
+    if (session->IsPsshHandled(crc, box)) {
+      continue;
+    }
+    // A box the handler failed on is passed again the next time it is seen.
+    if (session->pssh_handler_(session->pssh_context_, box.data(),
+                               box.size()) == kDashToHlsStatus_OK) {
+      session->AddHandledPssh(crc, box);
+    }
+  }
+}
+
+// Takes the protection scheme from the schm box, if there is one, and the
+// key id, IV size, pattern and constant IV from |tenc|.  cbcs content is only
+// decrypted, with a content key.
+DashToHlsStatus ProcessProtectionScheme(Session* session,
+                                        const TencContents* tenc) {
+  session->protection_scheme_ = SchmContents::kSchemeCenc;
+  const Box* box = session->parser_.FindDeep(BoxType::kBox_schm);
+  if (box) {
+    session->protection_scheme_ = reinterpret_cast<const SchmContents*>(
+        box->get_contents())->get_scheme_type();
+  }
+  if (session->protection_scheme_ != SchmContents::kSchemeCenc &&
+      !session->is_cbcs()) {
+    DASH_LOG("Unsupported scheme.", "Only cenc and cbcs are supported.",
+             box->PrettyPrint("").c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  size_t iv_size = tenc->get_default_iv_size();
+  if (iv_size != 8 && iv_size != kIvSize &&
+      !(iv_size == 0 && tenc->get_default_constant_iv_size())) {
+    DASH_LOG("Bad IV.", "IVs are 8 or 16 bytes, or a constant IV.",
+             PrettyPrintValue(iv_size).c_str());
+    return kDashToHlsStatus_BadDashContents;
+  }
+  // cbcs content is passed through as it is, or decrypted with a content
+  // key.
+  if (session->is_cbcs() && !session->is_passthrough()) {
+    if (session->output_format_ == kDashToHlsFormat_CbcsFmp4) {
+      DASH_LOG("Bad Configuration.",
+               "cbcs content is passed through, not transcrypted.",
+               "See kDashToHlsFormat_EncryptedFmp4.");
+      return kDashToHlsStatus_BadConfiguration;
+    }
+    if (session->content_keys_.empty()) {
+      DASH_LOG("Bad Configuration.",
+               "cbcs content needs DashToHls_SetCenc_ContentKey.", "");
+      return kDashToHlsStatus_BadConfiguration;
+    }
+  }
+  memcpy(session->key_id_, tenc->get_default_kid(), sizeof(session->key_id_));
+  session->default_iv_size_ = iv_size;
+  session->crypt_byte_block_ = tenc->get_default_crypt_byte_block();
+  session->skip_byte_block_ = tenc->get_default_skip_byte_block();
+  session->constant_iv_size_ = tenc->get_default_constant_iv_size();
+  memcpy(session->constant_iv_, tenc->get_default_constant_iv(),
+         session->constant_iv_size_);
+  return kDashToHlsStatus_OK;
+}
+
+// Hands the track settings to the writers kept in the session.
+void ConfigureSampleWriters(Session* session) {
+  ProgramStreamOut& ps_out = session->ps_out_;
+  ps_out.set_has_video(session->is_video_);
+  ps_out.set_has_audio(!session->is_video_);
+  if (session->is_video_) {
+    ps_out.set_sps_pps(session->sps_pps_);
+    ps_out.set_nalu_length(session->nalu_length_);
+    session->live_ts_out_.set_sps_pps(session->sps_pps_);
+    session->live_ts_out_.set_nalu_length(session->nalu_length_);
+    session->single_file_ts_out_.set_sps_pps(session->sps_pps_);
+    session->single_file_ts_out_.set_nalu_length(session->nalu_length_);
+    session->iframe_ts_out_.set_sps_pps(session->sps_pps_);
+    session->iframe_ts_out_.set_nalu_length(session->nalu_length_);
+    return;
   }
+  session->adts_out_.set_audio_object_type(session->audio_object_type_);
+  session->adts_out_.set_sampling_frequency_index(
+      session->sampling_frequency_index_);
+  session->adts_out_.set_channel_config(session->channel_config_);
+  ps_out.set_audio_object_type(session->audio_object_type_);
+  ps_out.set_sampling_frequency_index(session->sampling_frequency_index_);
+  ps_out.set_channel_config(session->channel_config_);
 }
 }  // namespace internal
 
@@ -131,6 +250,7 @@ DashToHls_CreateSession(DashToHlsSession** session) {
 extern "C" DashToHlsStatus
 DashToHls_ReleaseSession(DashToHlsSession* session) {
   Session* dash_session = reinterpret_cast<Session*>(session);
+  dash_session->ClearDecryptionKeys();
   delete dash_session;
   return kDashToHlsStatus_OK;
 }
@@ -155,6 +275,7 @@ DashToHls_ParseDash(DashToHlsSession* session, const uint8_t* bytes,
   dash_session->index_.index_count = static_cast<uint32_t>(locations.size());
   dash_session->index_.segments = &locations[0];
   *index = &dash_session->index_;
+  dash_session->planner_.Clear();
 
   const MvhdContents* mvhd = nullptr;
   box = dash_session->parser_.FindDeep(BoxType::kBox_mvhd);
@@ -182,6 +303,8 @@ DashToHls_ParseDash(DashToHlsSession* session, const uint8_t* bytes,
         reinterpret_cast<const TrexContents*>(box->get_contents());
     dash_session->trex_default_sample_duration_ =
         trex->get_default_sample_duration();
+    dash_session->trex_default_sample_flags_ =
+        trex->get_default_sample_flags();
   }
 
   // See if we have an video box.
@@ -219,6 +342,7 @@ DashToHls_ParseDash(DashToHlsSession* session, const uint8_t* bytes,
     dash_session->audio_config_[0] = mp4a->get_audio_config()[0];
     dash_session->audio_config_[1] = mp4a->get_audio_config()[1];
   }
+  internal::ConfigureSampleWriters(dash_session);
 
   // Check for CENC.
   box = dash_session->parser_.FindDeep(BoxType::kBox_tenc);
@@ -235,23 +359,17 @@ DashToHls_ParseDash(DashToHlsSession* session, const uint8_t* bytes,
     return kDashToHlsStatus_BadConfiguration;
   }
 
-  if (!dash_session->pssh_handler_ || !dash_session->decryption_handler_) {
+  if (dash_session->needs_cenc_callbacks() && !dash_session->can_decrypt()) {
     DASH_LOG("Bad Configuration.", "Missing required callback for CENC",
              "");
     return kDashToHlsStatus_BadConfiguration;
   }
-  internal::ProcessPsshBoxes(dash_session, pssh_boxes);
-
-  // TODO(justsomeguy) support more lengths than 8.
-  if (tenc->get_default_iv_size() != 8) {
-    DASH_LOG("Unimplemented.",
-             "Currently only implements a default IV of 8.",
-             "");
+  DashToHlsStatus status =
+      internal::ProcessProtectionScheme(dash_session, tenc);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
   }
-  dash_session->default_iv_size_ = tenc->get_default_iv_size();
-  memcpy(dash_session->key_id_, tenc->get_default_kid(),
-         TencContents::kKidSize);
-
+  internal::ProcessPsshBoxes(dash_session, pssh_boxes);
 
   return kDashToHlsStatus_OK;
 }
@@ -346,322 +464,1526 @@ DashToHlsStatus GetNeededBoxes(bool is_encrypted,
       }
     }
 
+    // The tenc belongs to the track, not the fragment, it is only there
+    // when the moov was parsed with the fragments.
     if (tenc) {
-      std::vector<const Box*> boxes = parser.FindDeepAll(BoxType::kBox_tenc);
-      if (boxes.size() > index) {
-        *tenc = reinterpret_cast<const TencContents*>(
-            boxes[index]->get_contents());
-      } else {
-        *tenc = nullptr;
-      }
+      const Box* box = parser.FindDeep(BoxType::kBox_tenc);
+      *tenc = box ?
+          reinterpret_cast<const TencContents*>(box->get_contents()) : nullptr;
     }
   }
 
   return kDashToHlsStatus_OK;
 }
 
-// TODO(justsomeguy) The audio samples have a size of 8 and that's making
-// this routine ugly.  Need to clean it up and make it pretty.
-//
-// TODO(justsomeguy) Clean up this routine so it's easy to understand.  Right
-// now it looks like magic.
-bool DecryptSample(const Session* session, uint32_t sample_number,
-                   const SaizContents* saiz, const SaioContents* saio,
-                   const uint8_t* key_id,
-                   const MdatContents* mdat, uint64_t mdat_offset,
-                   uint32_t sample_size, uint64_t* saio_position,
-                   std::vector<uint8_t>* out) {
-  if (saiz->get_sizes().size() <= sample_number) {
-    DASH_LOG("Unsupported saiz.",
-             "Only supports CENC for ALL samples.",
-             "");
-    return false;
-  }
-  if (session->default_iv_size_ != kIvSize - kIvCounterOffset) {
-    DASH_LOG("Bad IV.",
-             "Unexpected default_iv_size_ size.",
-             "");
-    return false;
-  }
-  uint8_t iv[kIvSize];
-  size_t size = saiz->get_sizes()[sample_number];
-  if ((size != 8) &&
-      ((size - 8 - sizeof(uint16_t)) % SaizContents::SaizRecordSize)) {
-    DASH_LOG("Bad saiz.",
-             "saiz box must be a multiple of SaizRecord sizes.",
-             "");
-    return false;
+// Decrypts sample |sample_number| of |table|, the |sample_size| bytes at
+// |sample|, into the |sample_size| bytes at |out|.  A content key decrypts
+// it straight from the mdat, cbcs samples in place after one copy.  An
+// in-place handler decrypts the ranges of |out| after the sample is copied
+// there once.  With use_sample_entries the handler gets the whole sample
+// and its subsample map, otherwise the encrypted ranges are gathered into
+// one buffer for it and scattered back afterwards.  The table checked that
+// the subsamples fit in the sample.
+bool DecryptSample(const Session* session, SampleEncryptionTable* table,
+                   uint32_t sample_number, const Session::DecryptionKey& key,
+                   const uint8_t* sample, uint32_t sample_size,
+                   uint8_t* out) {
+  const SampleEntry* entries = table->get_entries(sample_number);
+  const size_t entry_count = table->get_entry_count(sample_number);
+  const uint8_t* iv = table->get_iv(sample_number);
+  const uint8_t* key_id = key.key_id;
+  const Aes128* content_key = key.content_key;
+  if (session->is_cbcs()) {
+    if (!content_key) {
+      DASH_LOG("Missing content key.",
+               "cbcs samples are only decrypted with a content key.",
+               PrettyPrintBuffer(key_id, TencContents::kKidSize).c_str());
+      return false;
+    }
+    // Copied once, then only the blocks the pattern encrypts are touched.
+    memcpy(out, sample, sample_size);
+    CbcsDecrypter decrypter(*content_key, iv, kIvSize,
+                            session->crypt_byte_block_,
+                            session->skip_byte_block_);
+    size_t sample_position = 0;
+    for (size_t count = 0; count < entry_count; ++count) {
+      sample_position += entries[count].clear_bytes;
+      decrypter.DecryptRange(out + sample_position,
+                             entries[count].cipher_bytes);
+      sample_position += entries[count].cipher_bytes;
+    }
+    return true;
   }
-  const uint8_t* mdat_end = mdat->get_raw_data() + mdat->get_raw_data_length();
-  const uint8_t* mdat_data = mdat->get_raw_data();
-  if (mdat_data + *saio_position + session->default_iv_size_ > mdat_end) {
-    DASH_LOG("Bad saio.",
-             "saio position would run off the end.",
-             "");
-    return false;
+  if (content_key) {
+    AesCtr ctr(*content_key, iv, kIvSize);
+    size_t sample_position = 0;
+    for (size_t count = 0; count < entry_count; ++count) {
+      memcpy(out + sample_position, sample + sample_position,
+             entries[count].clear_bytes);
+      sample_position += entries[count].clear_bytes;
+      ctr.Apply(sample + sample_position, out + sample_position,
+                entries[count].cipher_bytes);
+      sample_position += entries[count].cipher_bytes;
+    }
+    memcpy(out + sample_position, sample + sample_position,
+           sample_size - sample_position);
+    return true;
   }
-  memcpy(iv, mdat_data + *saio_position, session->default_iv_size_);
-  memset(iv + kIvCounterOffset, 0, kIvCounterSize);
-  *saio_position += session->default_iv_size_;
-  size_t saio_records = 1;
-  if (size > 8) {
-    if (mdat_data + *saio_position + sizeof(uint16_t) > mdat_end) {
-      DASH_LOG("Bad saio.",
-               "saio position would run off the end.",
-               "");
-      return false;
+  if (session->decrypt_in_place_handler_) {
+    memcpy(out, sample, sample_size);
+    std::vector<DecryptRange> ranges;
+    ranges.reserve(entry_count);
+    size_t sample_position = 0;
+    for (size_t count = 0; count < entry_count; ++count) {
+      sample_position += entries[count].clear_bytes;
+      if (entries[count].cipher_bytes) {
+        DecryptRange range = {
+          sample_position, static_cast<size_t>(entries[count].cipher_bytes)};
+        ranges.push_back(range);
+      }
+      sample_position += entries[count].cipher_bytes;
+    }
+    if (ranges.empty()) {
+      return true;
     }
-    saio_records = ntohsFromBuffer(mdat_data + *saio_position);
-    *saio_position += sizeof(uint16_t);
+    return session->decrypt_in_place_handler_(
+        session->GetDecryptionContext(key,
+                                      session->decrypt_in_place_context_),
+        out, sample_size, iv,
+        key_id, &ranges[0], ranges.size()) == kDashToHlsStatus_OK;
   }
-
-  const SaizContents::SaizRecord* record = reinterpret_cast<
-      const SaizContents::SaizRecord*>(mdat_data + *saio_position);
-  if (mdat_data + *saio_position +
-      (sizeof(SaizContents::SaizRecord) * saio_records) > mdat_end) {
-    DASH_LOG("Bad saio.",
-             "saio records are not in mdat.",
-             "");
+  if (!session->decryption_handler_) {
+    DASH_LOG("Missing content key.",
+             "No content key or CENC callback for the key id.",
+             PrettyPrintBuffer(key_id, TencContents::kKidSize).c_str());
     return false;
   }
-  size_t encrypted_position = 0;
-  size_t mdat_position = mdat_offset;
-  std::vector<uint8_t> encrypted_buffer;
+  // The handler takes a writable IV.
+  uint8_t sample_iv[kIvSize];
+  memcpy(sample_iv, iv, sizeof(sample_iv));
+  DashToHlsContext context =
+      session->GetDecryptionContext(key, session->decryption_context_);
+  if (session->use_sample_entries_) {
+    return session->decryption_handler_(context,
+                                        sample, out, sample_size,
+                                        sample_iv, sizeof(sample_iv), key_id,
+                                        table->get_entries(sample_number),
+                                        entry_count) == kDashToHlsStatus_OK;
+  }
+  ByteBuffer encrypted_buffer;
   encrypted_buffer.resize(sample_size);
-  // TODO(justsomeguy) don't walk off the end.
-  for (size_t count = 0; count < saio_records; ++count) {
-    size_t clear_bytes = 0;
-    size_t encrypted_bytes = sample_size;
-    if (size > 8) {
-      clear_bytes = record[count].clear_bytes();
-      encrypted_bytes = record[count].encrypted_bytes();
-    }
-    mdat_position += clear_bytes;
-    if (mdat_position + encrypted_bytes > mdat->get_raw_data_length()) {
-      std::string error_msg =
-          "mdat_position(" + std::to_string(mdat_position) +
-          ") + encrypted_bytes(" + std::to_string(encrypted_bytes) + ") > " +
-          "mdat->get_raw_data_length(" +
-          std::to_string(mdat->get_raw_data_length()) + ")";
-      DASH_LOG("Buffer overrun.", error_msg.c_str(), "");
-      return false;
-    }
-    if (encrypted_position + encrypted_bytes > sample_size) {
-      DASH_LOG("Bad saio.",
-               "Encrypted bytes cause a buffer overlow.",
-               "");
-      return false;
-    }
-    memcpy(&encrypted_buffer[encrypted_position], mdat_data + mdat_position,
-           encrypted_bytes);
-    mdat_position += encrypted_bytes;
-    encrypted_position += encrypted_bytes;
-    if (size >8) {
-      *saio_position += SaizContents::SaizRecordSize;
-    }
+  size_t encrypted_position = 0;
+  size_t sample_position = 0;
+  for (size_t count = 0; count < entry_count; ++count) {
+    sample_position += entries[count].clear_bytes;
+    memcpy(&encrypted_buffer[encrypted_position], sample + sample_position,
+           entries[count].cipher_bytes);
+    sample_position += entries[count].cipher_bytes;
+    encrypted_position += entries[count].cipher_bytes;
   }
-  std::vector<uint8_t> clear_buffer;
+  ByteBuffer clear_buffer;
   clear_buffer.resize(encrypted_position);
-  if (session->decryption_handler_(session->decryption_context_,
+  if (session->decryption_handler_(context,
                                    &encrypted_buffer[0], &clear_buffer[0],
-                                   encrypted_position, iv, sizeof(iv),
-                                   key_id, nullptr, 0) !=
+                                   encrypted_position, sample_iv,
+                                   sizeof(sample_iv), key_id, nullptr, 0) !=
       kDashToHlsStatus_OK) {
     return false;
   }
-  out->resize(sample_size);
-
-  // Putting things back should not be able to cause a buffer overflow.
-
-  size_t decrypted_position = 0;
+  // Bytes after the last subsample are clear.
   encrypted_position = 0;
-  mdat_position = mdat_offset;
-  for (size_t count = 0; count < saio_records; ++count) {
-    size_t clear_bytes = 0;
-    size_t encrypted_bytes = sample_size;
-    if (size > 8) {
-      clear_bytes = record[count].clear_bytes();
-      encrypted_bytes = record[count].encrypted_bytes();
-    }
-    if (mdat_position + clear_bytes > mdat->get_raw_data_length()) {
-      std::string error_msg =
-          "mdat_position(" + std::to_string(mdat_position) +
-          ") + clear_bytes(" + std::to_string(clear_bytes) + ") > " +
-          "mdat->get_raw_data_length(" +
-          std::to_string(mdat->get_raw_data_length()) + ")";
-      DASH_LOG("Buffer overrun.", error_msg.c_str(), "");
-      return false;
-    }
-    memcpy(&(*out)[decrypted_position], mdat_data + mdat_position,
-           clear_bytes);
-    mdat_position += clear_bytes;
-    decrypted_position += clear_bytes;
-    memcpy(&(*out)[decrypted_position], &clear_buffer[encrypted_position],
-           encrypted_bytes);
-    mdat_position += encrypted_bytes;
-    encrypted_position += encrypted_bytes;
-    decrypted_position += encrypted_bytes;
+  sample_position = 0;
+  for (size_t count = 0; count < entry_count; ++count) {
+    memcpy(out + sample_position, sample + sample_position,
+           entries[count].clear_bytes);
+    sample_position += entries[count].clear_bytes;
+    memcpy(out + sample_position, &clear_buffer[encrypted_position],
+           entries[count].cipher_bytes);
+    sample_position += entries[count].cipher_bytes;
+    encrypted_position += entries[count].cipher_bytes;
   }
+  memcpy(out + sample_position, sample + sample_position,
+         sample_size - sample_position);
   return true;
 }
 
-bool Reencrypt(const Session* dash_session, std::vector<uint8_t>* ts_output) {
+// Decrypts samples |first_sample| up to |end_sample| of a moof/mdat, which
+// start at |mdat_offset|, with a single call to the session's fragment
+// handler.  The clear samples are appended to |out| back to back.
+bool DecryptFragment(const Session* session, const TrunContents* trun,
+                     const SampleEncryptionTable& table,
+                     const Session::DecryptionKey& key,
+                     const MdatContents* mdat,
+                     uint64_t mdat_offset, uint32_t first_sample,
+                     uint32_t end_sample, ByteBuffer* out) {
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  std::vector<FragmentSample> samples(end_sample - first_sample);
+  size_t length = 0;
+  for (uint32_t sample_number = first_sample; sample_number < end_sample;
+       ++sample_number) {
+    FragmentSample& sample = samples[sample_number - first_sample];
+    memcpy(sample.iv, table.get_iv(sample_number), sizeof(sample.iv));
+    sample.offset = length;
+    sample.length = track_run[sample_number].sample_size_;
+    sample.entries = table.get_entries(sample_number);
+    sample.entry_count = table.get_entry_count(sample_number);
+    length += sample.length;
+  }
+  if (mdat_offset + length > mdat->get_raw_data_length()) {
+    DASH_LOG("Buffer overrun.", "Samples would be past the end of the mdat.",
+             "");
+    return false;
+  }
+  if (samples.empty()) {
+    return true;
+  }
+  size_t out_start = out->size();
+  out->resize(out_start + length);
+  return session->decrypt_fragment_handler_(
+      session->GetDecryptionContext(key, session->decrypt_fragment_context_),
+      mdat->get_raw_data() + mdat_offset, out->data() + out_start, length,
+      key.key_id, &samples[0], samples.size()) == kDashToHlsStatus_OK;
+}
+
+// Hands everything in |output| to the session's output sink.  Data the sink
+// refuses with kDashToHlsStatus_Backpressure stays in |output| so it is
+// offered again on the next flush, or returned to the caller if the segment
+// is finished.
+DashToHlsStatus FlushToSink(const Session* dash_session,
+                            ByteBuffer* output) {
+  if (output->empty()) {
+    return kDashToHlsStatus_OK;
+  }
+  DashToHlsStatus status =
+      dash_session->output_sink_(dash_session->output_sink_context_,
+                                 &(*output)[0], output->size());
+  switch (status) {
+    case kDashToHlsStatus_OK:
+      // clear() keeps the capacity for the next run of packets.
+      output->clear();
+      return kDashToHlsStatus_OK;
+    case kDashToHlsStatus_Backpressure:
+      return kDashToHlsStatus_OK;
+    default:
+      DASH_LOG("Output sink failed.", "Sink did not accept the output.",
+               PrettyPrintValue(static_cast<uint32_t>(status)).c_str());
+      return status;
+  }
+}
+
+// Segments are encrypted for #EXT-X-KEY:METHOD=AES-128 once the session
+// has a key, see DashToHls_SetHlsEncryptionKey.  The padding at the end is
+// only known when the segment is done, so they are never streamed.
+bool IsEncryptingSegments(const Session* dash_session) {
 #ifdef USE_AVFRAMEWORK
-  return Encrypt(reinterpret_cast<const DashToHlsSession*>(dash_session),
-                 ts_output);
-#endif
+  if (is_encrypting()) {
+    return true;
+  }
+#endif  // USE_AVFRAMEWORK
+  return dash_session->hls_encrypter_.is_initialized();
+}
+
+// Sets up |encrypter| for a segment that starts at the end of |output|.  It
+// is left uninitialized if the session does not encrypt segments.  Returns
+// false if it should but there is no key.
+bool StartEncryption(const Session* dash_session, const ByteBuffer& output,
+                     HlsEncrypter* encrypter) {
+  if (dash_session->hls_encrypter_.is_initialized()) {
+    *encrypter = dash_session->hls_encrypter_;
+  } else {
+#ifdef USE_AVFRAMEWORK
+    if (is_encrypting()) {
+      uint8_t key[Aes128::kKeySize];
+      uint8_t iv[Aes128::kBlockSize];
+      if (!GetEncryptionKey(key, iv)) {
+        DASH_LOG("Bad Configuration.", "No key to encrypt segments.", "");
+        return false;
+      }
+      encrypter->Init(key, iv);
+    }
+#endif  // USE_AVFRAMEWORK
+    if (!encrypter->is_initialized()) {
+      return true;
+    }
+  }
+  encrypter->StartSegment(output.size());
   return true;
 }
 
-DashToHlsStatus TransmuxToTS(const Session* dash_session,
-                             const MdatContents* mdat,
-                             const BoxContents* moof,
-                             const TfdtContents* tfdt,
-                             const TfhdContents* tfhd,
-                             const TrunContents* trun,
-                             const SaioContents* saio,
-                             const SaizContents* saiz,
-                             const TencContents* tenc,
-                             std::vector<uint8_t>* ts_output) {
-  ts_output->erase(ts_output->begin(), ts_output->end());
+// Encrypts the whole blocks added to |output| since the last call, in
+// place.  Called after every sample, while its packets are still in cache.
+void EncryptAppended(HlsEncrypter* encrypter, ByteBuffer* output) {
+  if (encrypter && encrypter->is_initialized()) {
+    encrypter->EncryptAppended(output->data(), output->size());
+  }
+}
 
-  TransportStreamOut ts_out;
-  AdtsOut adts_out;
-  if (dash_session->is_video_) {
-    ts_out.set_sps_pps(dash_session->sps_pps_);
-    ts_out.set_nalu_length(dash_session->nalu_length_);
-  } else {
-    adts_out.set_audio_object_type(dash_session->audio_object_type_);
-    adts_out.set_sampling_frequency_index(
-        dash_session->sampling_frequency_index_);
-    adts_out.set_channel_config(dash_session->channel_config_);
+// Pads and encrypts the end of the segment.
+void FinishEncryption(HlsEncrypter* encrypter, ByteBuffer* output) {
+  if (!encrypter || !encrypter->is_initialized()) {
+    return;
+  }
+  size_t length = output->size();
+  output->resize(encrypter->get_padded_length(length));
+  encrypter->FinishSegment(output->data(), length);
+}
+
+// Everything the per-sample loop needs for one moof/mdat.
+struct TransmuxFragment {
+  const MdatContents* mdat;
+  // Where the samples are read from, the mdat or the fragment decrypted in
+  // one batch.
+  const uint8_t* mdat_data;
+  uint64_t mdat_length;
+  const TrunContents* trun;
+  // Whether the samples are still encrypted, with their IVs and subsample
+  // maps in |encryption|.
+  bool is_encrypted;
+  SampleEncryptionTable encryption;
+  const uint8_t* key_id;
+  // The IVs of the samples of key_id, from the tenc unless the senc or a
+  // 'seig' sample group overrides them.
+  size_t iv_size;
+  const uint8_t* constant_iv;
+  size_t constant_iv_size;
+  // How the samples of key_id are decrypted, when they are.
+  Session::DecryptionKey key;
+  // nullptr unless the samples are decrypted by the async handler, which
+  // runs ahead of the conversion from async_sample, at async_offset.
+  AsyncDecrypter* async;
+  uint32_t async_sample;
+  uint64_t async_offset;
+  uint64_t mdat_offset;
+  // Used when the trun has no per-sample durations.
+  uint64_t default_duration;
+  // The samples to convert, from first_sample up to end_sample.
+  uint32_t first_sample;
+  uint32_t end_sample;
+  // False for a live part that starts mid GOP, so the first sample gets no
+  // PAT/PMT or parameter sets.
+  bool first_sample_is_sync;
+  ClockRescaler* clock;
+  TransportStreamOut* ts_out;
+  const AdtsOut* adts_out;
+  bool streaming;
+  ByteBuffer* ts_output;
+  // nullptr unless segments are encrypted.
+  HlsEncrypter* encrypter;
+};
+
+// Finds the 'seig' sample group entry the samples of the traf in |moof|
+// belong to, nullptr if they use the tenc defaults.  Only one group for
+// all |sample_count| samples, from the sgpd of the traf, is supported.
+DashToHlsStatus FindSeigEntry(const BoxContents* moof, size_t sample_count,
+                              const SgpdContents::SeigEntry** seig) {
+  *seig = nullptr;
+  if (!moof->get_dash_parser()) {
+    return kDashToHlsStatus_OK;
+  }
+  const SbgpContents* sbgp = nullptr;
+  std::vector<const Box*> boxes =
+      moof->get_dash_parser()->FindDeepAll(BoxType::kBox_sbgp);
+  for (auto iter = boxes.begin(); iter != boxes.end(); ++iter) {
+    const SbgpContents* contents =
+        reinterpret_cast<const SbgpContents*>((*iter)->get_contents());
+    if (contents->get_grouping_type() == SgpdContents::kGroupingSeig) {
+      sbgp = contents;
+    }
+  }
+  if (!sbgp) {
+    return kDashToHlsStatus_OK;
+  }
+  // Samples past the entries are in no group, index 0.
+  uint32_t index = 0;
+  uint64_t samples = 0;
+  bool one_group = true;
+  const std::vector<SbgpContents::Entry>& entries = sbgp->get_entries();
+  for (size_t count = 0; count < entries.size() && samples < sample_count;
+       ++count) {
+    if (entries[count].sample_count == 0) {
+      continue;
+    }
+    if (samples == 0) {
+      index = entries[count].group_description_index;
+    }
+    one_group = one_group && entries[count].group_description_index == index;
+    samples += entries[count].sample_count;
+  }
+  if (!one_group || (index != 0 && samples < sample_count)) {
+    DASH_LOG("Unsupported sbgp.",
+             "Only one seig group per fragment is supported.", "");
+    return kDashToHlsStatus_BadDashContents;
+  }
+  if (index == 0) {
+    return kDashToHlsStatus_OK;
+  }
+  if (index <= SbgpContents::kFragmentLocalIndex) {
+    DASH_LOG("Unsupported sbgp.",
+             "Only seig groups in the traf are supported.",
+             PrettyPrintValue(index).c_str());
+    return kDashToHlsStatus_BadDashContents;
+  }
+  index -= SbgpContents::kFragmentLocalIndex + 1;
+  boxes = moof->get_dash_parser()->FindDeepAll(BoxType::kBox_sgpd);
+  for (auto iter = boxes.begin(); iter != boxes.end(); ++iter) {
+    const SgpdContents* sgpd =
+        reinterpret_cast<const SgpdContents*>((*iter)->get_contents());
+    if (sgpd->get_grouping_type() == SgpdContents::kGroupingSeig &&
+        index < sgpd->get_seig_entries().size()) {
+      *seig = &sgpd->get_seig_entries()[index];
+      return kDashToHlsStatus_OK;
+    }
   }
+  DASH_LOG("Bad sbgp.", "No seig entry for the group.",
+           PrettyPrintValue(index).c_str());
+  return kDashToHlsStatus_BadDashContents;
+}
 
-  uint64_t saio_position = 0;
+// Fills fragment->encryption with the IVs and subsample maps of every
+// sample of the trun, from the senc of the traf or, without one, from the
+// auxiliary information the saio and saiz describe.  That has to be in the
+// mdat, in one block or at an offset per sample.  A 'seig' sample group
+// overrides the key id and IVs, or marks the samples as clear.
+DashToHlsStatus InitEncryptionTable(const Session* dash_session,
+                                    const MdatContents* mdat,
+                                    const BoxContents* moof,
+                                    const SaioContents* saio,
+                                    const SaizContents* saiz,
+                                    TransmuxFragment* fragment) {
+  const SencContents* senc = nullptr;
+  if (dash_session->is_encrypted_ && moof->get_dash_parser()) {
+    const Box* box = moof->get_dash_parser()->FindDeep(BoxType::kBox_senc);
+    if (box) {
+      senc = reinterpret_cast<const SencContents*>(box->get_contents());
+    }
+  }
   // Not all segments are encrypted, there can be a clear lead.
-  if (saio && saiz) {
-    if (saio->get_offsets().size() != 1) {
-      DASH_LOG("Bad Saio.",
-               "Only supports contiguous offsets.",
+  fragment->is_encrypted = senc || (saio && saiz);
+  if (!fragment->is_encrypted) {
+    return kDashToHlsStatus_OK;
+  }
+  const std::vector<TrunContents::TrackRun>& track_run =
+      fragment->trun->get_track_runs();
+  const SgpdContents::SeigEntry* seig = nullptr;
+  DashToHlsStatus status = FindSeigEntry(moof, track_run.size(), &seig);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  if (seig && !seig->is_protected) {
+    fragment->is_encrypted = false;
+    return kDashToHlsStatus_OK;
+  }
+  SampleEncryptionTable* table = &fragment->encryption;
+  if (seig) {
+    fragment->key_id = seig->kid;
+    fragment->iv_size = seig->iv_size;
+    fragment->constant_iv = seig->constant_iv;
+    fragment->constant_iv_size = seig->constant_iv_size;
+  }
+  if (senc && senc->IsOverridePresent()) {
+    fragment->iv_size = senc->get_override_iv_size();
+    fragment->key_id = senc->get_override_kid();
+  }
+  size_t iv_size = fragment->iv_size;
+  if (iv_size != 8 && iv_size != kIvSize &&
+      !(iv_size == 0 && fragment->constant_iv_size)) {
+    DASH_LOG("Bad IV.", "IVs are 8 or 16 bytes, or a constant IV.",
+             PrettyPrintValue(iv_size).c_str());
+    return kDashToHlsStatus_BadDashContents;
+  }
+  table->Init(track_run.size(), iv_size, fragment->constant_iv,
+              fragment->constant_iv_size);
+  if (senc) {
+    if (senc->get_sample_count() < track_run.size()) {
+      DASH_LOG("Unsupported senc.", "Only supports CENC for ALL samples.",
                "");
       return kDashToHlsStatus_BadDashContents;
     }
-    saio_position = moof->get_stream_position() + saio->get_offsets()[0] -
-      sizeof(uint32_t) * 2 - mdat->get_stream_position();
+    const uint8_t* info = senc->get_sample_data();
+    const uint8_t* end = info + senc->get_sample_data_length();
+    table->set_aux_info(info);
+    for (size_t count = 0; count < track_run.size(); ++count) {
+      if (!table->AddSample(&info, end, senc->IsSubsamplePresent(),
+                            track_run[count].sample_size_)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+    return kDashToHlsStatus_OK;
   }
-  const std::vector<TrunContents::TrackRun>& track_run =
-      trun->get_track_runs();
 
-  uint64_t dts = (tfdt->get_base_media_decode_time() * kDtsClock) /
-      dash_session->timescale_;
-  std::vector<uint8_t> output;
-  if (!dash_session->is_video_) {
-    adts_out.AddTimestamp(dts, ts_output);
+  const std::vector<uint8_t>& sizes = saiz->get_sizes();
+  const std::vector<uint32_t>& offsets = saio->get_offsets();
+  if (sizes.size() < track_run.size()) {
+    DASH_LOG("Unsupported saiz.", "Only supports CENC for ALL samples.", "");
+    return kDashToHlsStatus_BadDashContents;
+  }
+  if (offsets.size() != 1 && offsets.size() != sizes.size()) {
+    DASH_LOG("Bad saio.", "Needs one offset or one per sample.",
+             PrettyPrintValue(offsets.size()).c_str());
+    return kDashToHlsStatus_BadDashContents;
+  }
+  // The offsets are from the start of the moof, the mdat data starts after
+  // its header.
+  const uint64_t mdat_start =
+      mdat->get_stream_position() + sizeof(uint32_t) * 2;
+  const uint8_t* mdat_data = mdat->get_raw_data();
+  const uint8_t* mdat_end = mdat_data + mdat->get_raw_data_length();
+  const uint8_t* info = nullptr;
+  for (size_t count = 0; count < track_run.size(); ++count) {
+    if (count == 0 || offsets.size() != 1) {
+      uint64_t position = moof->get_stream_position() + offsets[count];
+      if (position < mdat_start ||
+          position - mdat_start > mdat->get_raw_data_length()) {
+        DASH_LOG("Bad saio.",
+                 "Auxiliary information without a senc must be in the mdat.",
+                 "");
+        return kDashToHlsStatus_BadDashContents;
+      }
+      info = mdat_data + (position - mdat_start);
+      if (offsets.size() == 1) {
+        table->set_aux_info(info);
+      }
+    }
+    if (static_cast<size_t>(mdat_end - info) < sizes[count]) {
+      DASH_LOG("Bad saio.", "saio position would run off the end.", "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+    const uint8_t* end = info + sizes[count];
+    if (!table->AddSample(&info, end, sizes[count] > iv_size,
+                          track_run[count].sample_size_)) {
+      return kDashToHlsStatus_BadDashContents;
+    }
+    if (info != end) {
+      DASH_LOG("Bad saiz.",
+               "saiz box must be a multiple of SaizRecord sizes.", "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// Finds how the samples of |key_id| are decrypted, its content key or the
+// context from the key context handler, the first time a fragment uses it.
+// Failures are not kept, the next fragment tries again.
+DashToHlsStatus ResolveDecryptionKey(const Session* dash_session,
+                                     const uint8_t* key_id,
+                                     Session::DecryptionKey* key) {
+  const Session::DecryptionKey* found =
+      dash_session->FindDecryptionKey(key_id);
+  if (found) {
+    *key = *found;
+    return kDashToHlsStatus_OK;
+  }
+  memcpy(key->key_id, key_id, sizeof(key->key_id));
+  key->content_key = dash_session->FindContentKey(key_id);
+  key->context = nullptr;
+  key->has_key_context = false;
+  // The CENC callbacks cannot decrypt cbcs.
+  if (!key->content_key && dash_session->key_context_handler_ &&
+      !dash_session->is_cbcs()) {
+    DashToHlsStatus status = dash_session->key_context_handler_(
+        dash_session->key_context_context_, key_id, &key->context);
+    if (status != kDashToHlsStatus_OK) {
+      DASH_LOG("Key lookup failed.", "The key context handler failed.",
+               PrettyPrintBuffer(key_id, TencContents::kKidSize).c_str());
+      return status;
+    }
+    key->has_key_context = true;
+  }
+  // The fragments that used the oldest key are already converted.
+  if (dash_session->decryption_keys_.size() == Session::kMaxDecryptionKeys) {
+    dash_session->DropDecryptionKeys(1);
+  }
+  dash_session->decryption_keys_.push_back(*key);
+  return kDashToHlsStatus_OK;
+}
+
+// Fills in the parts of |fragment| that come from the boxes.
+DashToHlsStatus InitTransmuxFragment(const Session* dash_session,
+                                     const MdatContents* mdat,
+                                     const BoxContents* moof,
+                                     const TfhdContents* tfhd,
+                                     const TrunContents* trun,
+                                     const SaioContents* saio,
+                                     const SaizContents* saiz,
+                                     const TencContents* tenc,
+                                     TransmuxFragment* fragment) {
+  fragment->mdat = mdat;
+  fragment->mdat_data = mdat->get_raw_data();
+  fragment->mdat_length = mdat->get_raw_data_length();
+  fragment->trun = trun;
+  fragment->key_id = tenc ? tenc->get_default_kid() : dash_session->key_id_;
+  fragment->iv_size = dash_session->default_iv_size_;
+  fragment->constant_iv = dash_session->constant_iv_;
+  fragment->constant_iv_size = dash_session->constant_iv_size_;
+  DashToHlsStatus status = InitEncryptionTable(dash_session, mdat, moof,
+                                               saio, saiz, fragment);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  if (fragment->is_encrypted && dash_session->needs_cenc_callbacks()) {
+    status = ResolveDecryptionKey(dash_session, fragment->key_id,
+                                  &fragment->key);
+    if (status != kDashToHlsStatus_OK) {
+      return status;
+    }
+  }
+  fragment->encrypter = nullptr;
+  fragment->async = nullptr;
+  fragment->first_sample = 0;
+  fragment->end_sample = static_cast<uint32_t>(trun->get_track_runs().size());
+  fragment->first_sample_is_sync = true;
+  fragment->default_duration = 0;
+  if (!trun->IsSampleDurationPresent()) {
+    fragment->default_duration =
+        internal::GetDuration(trun, nullptr, tfhd,
+                              dash_session->trex_default_sample_duration_);
+    if (fragment->default_duration == 0) {
+      return kDashToHlsStatus_BadDashContents;
+    }
   }
   // Complicated way to get the value that's almost always going to be 0.
   // The definition of the start of the samples is the data offset in the
   // trun plus the start of the moof after the header (sizeof(uint32_t)*2).
   // TODO(justsomeguy) The tfhd can set the base-data-offset to something
   // besides the start of the moof.
-  uint64_t mdat_offset =
+  fragment->mdat_offset =
       moof->get_stream_position() + trun->get_data_offset() -
       sizeof(uint32_t) * 2 -
       mdat->get_stream_position();
-  const uint8_t* mdat_data = mdat->get_raw_data();
-  uint32_t sample_number = 0;
+  return kDashToHlsStatus_OK;
+}
+
+// Moves the clock and mdat position of |fragment| past the samples before
+// fragment->first_sample without converting them.
+void SkipSamples(TransmuxFragment* fragment) {
+  const TrunContents* trun = fragment->trun;
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  for (uint32_t sample_number = 0; sample_number < fragment->first_sample;
+       ++sample_number) {
+    fragment->clock->Advance(trun->IsSampleDurationPresent() ?
+                             track_run[sample_number].sample_duration_ :
+                             fragment->default_duration);
+    fragment->mdat_offset += track_run[sample_number].sample_size_;
+  }
+}
+
+// Has the async handler decrypt |fragment|'s samples when the session has
+// one for its key, with the samples from fragment->mdat_offset on started
+// by DecryptNextSample.
+void StartAsyncDecryption(const Session* dash_session,
+                          TransmuxFragment* fragment,
+                          AsyncDecrypter* async) {
+  if (fragment->is_encrypted &&
+      dash_session->uses_async_handler(fragment->key)) {
+    fragment->async = async;
+    fragment->async_sample = fragment->first_sample;
+    fragment->async_offset = fragment->mdat_offset;
+  }
+}
+
+// Decrypts sample |sample_number| of |fragment|, the |*sample_size| bytes
+// at |*sample|, into |decrypted| and points |*sample| and |*sample_size| at
+// the clear sample.  With the async handler the samples after it are
+// started first, up to the in-flight limit, and the clear sample is the
+// oldest in flight, which is |sample_number| as the loops go in order.
+// |decrypted| is a ByteBuffer, or the std::vector the TS writer rewrites
+// video samples in.
+template <typename Buffer>
+bool DecryptNextSample(const Session* dash_session,
+                       TransmuxFragment* fragment, uint32_t sample_number,
+                       Buffer* decrypted, const uint8_t** sample,
+                       size_t* sample_size) {
+  AsyncDecrypter* async = fragment->async;
+  if (!async) {
+    decrypted->resize(*sample_size);
+    if (!DecryptSample(dash_session, &fragment->encryption, sample_number,
+                       fragment->key, *sample,
+                       static_cast<uint32_t>(*sample_size),
+                       decrypted->data())) {
+      return false;
+    }
+    *sample = decrypted->data();
+    return true;
+  }
+  const std::vector<TrunContents::TrackRun>& track_run =
+      fragment->trun->get_track_runs();
+  const SampleEncryptionTable& table = fragment->encryption;
+  DashToHlsContext context = dash_session->GetDecryptionContext(
+      fragment->key, dash_session->decrypt_async_context_);
+  while (!async->full() && fragment->async_sample < fragment->end_sample) {
+    uint32_t next_sample = fragment->async_sample;
+    uint32_t next_size = track_run[next_sample].sample_size_;
+    if (fragment->async_offset + next_size > fragment->mdat_length) {
+      // Reported by the loop when it gets to the sample.
+      break;
+    }
+    if (!async->Start(context, fragment->mdat_data + fragment->async_offset,
+                      next_size, table.get_iv(next_sample),
+                      fragment->key.key_id, table.get_entries(next_sample),
+                      table.get_entry_count(next_sample))) {
+      return false;
+    }
+    ++fragment->async_sample;
+    fragment->async_offset += next_size;
+  }
+  return async->Finish(sample, sample_size);
+}
+
+// The per-sample loop of TransmuxToTS.  Whether the track is video, whether
+// the fragment is encrypted and which optional trun fields are present can
+// only change between fragments, so they are template parameters and each
+// combination gets its own loop without per-sample tests.  Audio only uses
+// the time at the start of the fragment, so the audio loops never touch the
+// clock.
+template <bool kVideo, bool kEncrypted, bool kComposition,
+          bool kSampleDuration>
+DashToHlsStatus TransmuxSamples(const Session* dash_session,
+                                TransmuxFragment* fragment) {
+  const std::vector<TrunContents::TrackRun>& track_run =
+      fragment->trun->get_track_runs();
+  const uint8_t* mdat_data = fragment->mdat_data;
+  const uint64_t mdat_length = fragment->mdat_length;
+  uint64_t mdat_offset = fragment->mdat_offset;
+  uint64_t duration = fragment->default_duration;
+  ByteBuffer output;
+  ByteBuffer decrypted;
+  // Video samples are decrypted or copied here once, and their NALUs are
+  // rewritten in place.
+  std::vector<uint8_t> pes_data;
+  uint32_t sample_number = fragment->first_sample;
+  const std::vector<TrunContents::TrackRun>::const_iterator end =
+      track_run.begin() + fragment->end_sample;
   for (std::vector<TrunContents::TrackRun>::const_iterator
-           iter = track_run.begin(); iter != track_run.end(); ++iter) {
-    uint64_t duration =
-        (internal::GetDuration(trun, &(*iter), tfhd,
-                               dash_session->trex_default_sample_duration_)
-         * kDtsClock) / dash_session->timescale_;
-    if (duration == 0) {
-      return kDashToHlsStatus_BadDashContents;
+           iter = track_run.begin() + sample_number; iter != end; ++iter) {
+    if (kSampleDuration) {
+      duration = iter->sample_duration_;
+      if (duration == 0) {
+        DASH_LOG("No Duration", "Duration must be greater than 0",
+                 (fragment->trun->BoxName() + ":" +
+                  fragment->trun->PrettyPrintTrackRun(*iter)).c_str());
+        return kDashToHlsStatus_BadDashContents;
+      }
     }
-    uint64_t pts = dts;
-    if (trun->IsSampleCompositionPresent()) {
-      // Handle overflow of multiplying large 32 bit ints.
-      uint64_t offset =
-          static_cast<uint64_t>(iter->sample_composition_time_offset_) *
-          static_cast<uint64_t>(kDtsClock) /
-          static_cast<uint64_t>(dash_session->timescale_);
-      pts += offset;
-    }
-    if (mdat_offset + iter->sample_size_ > mdat->get_raw_data_length()) {
+    if (mdat_offset + iter->sample_size_ > mdat_length) {
       DASH_LOG("Buffer overrun.", "Offset would be past the end of the mdat.",
                "");
       return kDashToHlsStatus_BadDashContents;
     }
-    std::vector<uint8_t> decrypted;
-    if (saio && saiz) {
-      const uint8_t* key_id = nullptr;
-      if (tenc) {
-        key_id = tenc->get_default_kid();
-      } else {
-        key_id = dash_session->key_id_;
-      }
-
-      if (!DecryptSample(dash_session, sample_number, saiz, saio, key_id, mdat,
-                         mdat_offset, iter->sample_size_, &saio_position,
-                         &decrypted)) {
+    const uint8_t* sample = mdat_data + mdat_offset;
+    size_t sample_size = iter->sample_size_;
+    if (kEncrypted) {
+      bool is_decrypted = kVideo ?
+          DecryptNextSample(dash_session, fragment, sample_number,
+                            &pes_data, &sample, &sample_size) :
+          DecryptNextSample(dash_session, fragment, sample_number,
+                            &decrypted, &sample, &sample_size);
+      if (!is_decrypted) {
         return kDashToHlsStatus_BadDashContents;
       }
-      if (dash_session->is_video_) {
-        ts_out.ProcessSample(decrypted.data(), decrypted.size(),
-                             dash_session->is_video_, sample_number == 0,
-                             pts, dts, dts, duration, &output);
-      } else {
-        adts_out.ProcessSample(decrypted.data(), decrypted.size(), &output);
+    }
+    if (kVideo) {
+      // Clear samples and those from the async handler still need the copy.
+      if (sample != pes_data.data()) {
+        pes_data.assign(sample, sample + sample_size);
+      }
+      uint64_t dts = fragment->clock->get_time();
+      uint64_t pts = dts;
+      if (kComposition) {
+        pts = fragment->clock->OffsetTime(
+            iter->sample_composition_time_offset_);
       }
+      fragment->clock->Advance(duration);
+      fragment->ts_out->ProcessSample(&pes_data, true,
+                                      sample_number ==
+                                      fragment->first_sample &&
+                                      fragment->first_sample_is_sync,
+                                      pts, dts, dts,
+                                      fragment->clock->get_time() - dts,
+                                      &output);
+      fragment->ts_output->append(output.data(), output.size());
     } else {
-      if (dash_session->is_video_) {
-        ts_out.ProcessSample(mdat_data + mdat_offset, iter->sample_size_,
-                             dash_session->is_video_, sample_number == 0,
-                             pts, dts, dts, duration, &output);
-      } else {
-        adts_out.ProcessSample(mdat_data + mdat_offset, iter->sample_size_,
-                               &output);
+      // The output was sized for every frame, so this never reallocates.
+      ByteBuffer* ts_output = fragment->ts_output;
+      size_t position = ts_output->size();
+      ts_output->resize(position + sample_size + AdtsOut::kHeaderSize);
+      if (!fragment->adts_out->WriteFrame(sample, sample_size,
+                                          ts_output->data() + position)) {
+        ts_output->resize(position);
       }
     }
     ++sample_number;
-    ts_output->insert(ts_output->end(), output.begin(), output.end());
     mdat_offset += iter->sample_size_;
-    dts += duration;
+    EncryptAppended(fragment->encrypter, fragment->ts_output);
+    if (fragment->streaming &&
+        fragment->ts_output->size() >= dash_session->output_sink_flush_size_) {
+      DashToHlsStatus status = FlushToSink(dash_session, fragment->ts_output);
+      if (status != kDashToHlsStatus_OK) {
+        return status;
+      }
+    }
   }
-#ifdef USE_AVFRAMEWORK
-  if (is_encrypting()) {
-    if (!Reencrypt(dash_session, ts_output)) {
-      return kDashToHlsStatus_BadConfiguration;
+  return kDashToHlsStatus_OK;
+}
+
+// The per-sample loop for kDashToHlsFormat_ProgramStream.  Each sample is
+// its own pack, with the system header and PSM cached in the session ahead
+// of the first one, so audio uses the clock as well.
+DashToHlsStatus ProgramStreamSamples(const Session* dash_session,
+                                     TransmuxFragment* fragment) {
+  const TrunContents* trun = fragment->trun;
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  const uint8_t* mdat_data = fragment->mdat_data;
+  const uint64_t mdat_length = fragment->mdat_length;
+  const bool is_encrypted = fragment->is_encrypted;
+  uint64_t mdat_offset = fragment->mdat_offset;
+  uint64_t duration = fragment->default_duration;
+  ByteBuffer decrypted;
+  uint32_t sample_number = fragment->first_sample;
+  const std::vector<TrunContents::TrackRun>::const_iterator end =
+      track_run.begin() + fragment->end_sample;
+  for (std::vector<TrunContents::TrackRun>::const_iterator
+           iter = track_run.begin() + sample_number; iter != end; ++iter) {
+    if (trun->IsSampleDurationPresent()) {
+      duration = iter->sample_duration_;
+      if (duration == 0) {
+        DASH_LOG("No Duration", "Duration must be greater than 0",
+                 (trun->BoxName() + ":" +
+                  trun->PrettyPrintTrackRun(*iter)).c_str());
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+    if (mdat_offset + iter->sample_size_ > mdat_length) {
+      DASH_LOG("Buffer overrun.", "Offset would be past the end of the mdat.",
+               "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+    const uint8_t* sample = mdat_data + mdat_offset;
+    size_t sample_size = iter->sample_size_;
+    if (is_encrypted) {
+      if (!DecryptNextSample(dash_session, fragment, sample_number,
+                             &decrypted, &sample, &sample_size)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+    uint64_t dts = fragment->clock->get_time();
+    uint64_t pts = dts;
+    if (trun->IsSampleCompositionPresent()) {
+      pts = fragment->clock->OffsetTime(iter->sample_composition_time_offset_);
+    }
+    fragment->clock->Advance(duration);
+    // The mux rate divides by the duration, which can round down to 0 on
+    // the 90kHz clock.
+    uint64_t pack_duration = fragment->clock->get_time() - dts;
+    if (pack_duration == 0) {
+      pack_duration = 1;
+    }
+    dash_session->ps_out_.AppendSample(sample, sample_size,
+                                       dash_session->is_video_,
+                                       sample_number ==
+                                       fragment->first_sample &&
+                                       fragment->first_sample_is_sync,
+                                       pts, dts, dts,
+                                       pack_duration, fragment->ts_output);
+    ++sample_number;
+    mdat_offset += iter->sample_size_;
+    EncryptAppended(fragment->encrypter, fragment->ts_output);
+    if (fragment->streaming &&
+        fragment->ts_output->size() >= dash_session->output_sink_flush_size_) {
+      DashToHlsStatus status = FlushToSink(dash_session, fragment->ts_output);
+      if (status != kDashToHlsStatus_OK) {
+        return status;
+      }
     }
   }
-#endif  // AVFRAMEWORK
   return kDashToHlsStatus_OK;
 }
-}  // namespace
 
-extern "C" DashToHlsStatus
-DashToHls_ParseSidx(DashToHlsSession* session, const uint8_t* bytes,
-                    uint64_t length, DashToHlsIndex** index) {
-  Session* dash_session = reinterpret_cast<Session*>(session);
-  if (dash_session->parser_.Parse(bytes, length) == 0) {
-    DASH_LOG("Bad Dash Content.", "Unable to parse for sidx", "");
-    return kDashToHlsStatus_BadDashContents;
+typedef DashToHlsStatus (*TransmuxSamplesLoop)(const Session* dash_session,
+                                               TransmuxFragment* fragment);
+
+TransmuxSamplesLoop SelectTransmuxSamplesLoop(bool is_video,
+                                              bool is_encrypted,
+                                              bool has_composition,
+                                              bool has_sample_duration) {
+  static const TransmuxSamplesLoop kLoops[] = {
+    &TransmuxSamples<false, false, false, false>,
+    &TransmuxSamples<false, false, false, true>,
+    &TransmuxSamples<false, false, true, false>,
+    &TransmuxSamples<false, false, true, true>,
+    &TransmuxSamples<false, true, false, false>,
+    &TransmuxSamples<false, true, false, true>,
+    &TransmuxSamples<false, true, true, false>,
+    &TransmuxSamples<false, true, true, true>,
+    &TransmuxSamples<true, false, false, false>,
+    &TransmuxSamples<true, false, false, true>,
+    &TransmuxSamples<true, false, true, false>,
+    &TransmuxSamples<true, false, true, true>,
+    &TransmuxSamples<true, true, false, false>,
+    &TransmuxSamples<true, true, false, true>,
+    &TransmuxSamples<true, true, true, false>,
+    &TransmuxSamples<true, true, true, true>,
+  };
+  return kLoops[(is_video ? 8 : 0) + (is_encrypted ? 4 : 0) +
+                (has_composition ? 2 : 0) + (has_sample_duration ? 1 : 0)];
+}
+
+// Upper bound on the output for one moof/mdat so the segment is allocated
+// once.  Video samples get a PES header, an AUD and possibly SPS/PPS, and
+// end in a partly filled TS packet.  Guessing low is harmless, the buffer
+// grows.  Packed audio is exact: the ID3 tag and an ADTS header per sample.
+// SAMPLE-AES slices can grow by their emulation prevention, which is rare
+// enough to leave out.
+size_t EstimateOutputSize(const Session* dash_session,
+                          const MdatContents* mdat,
+                          const TrunContents* trun) {
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  size_t samples = track_run.size();
+  if (dash_session->is_video_) {
+    size_t payload = mdat->get_raw_data_length() +
+        samples * kVideoSampleOverhead + dash_session->sps_pps_.size();
+    return (payload / kTsPayloadSize + samples + kTsPsiPackets) *
+        kTsPacketSize;
   }
-  const Box* box = dash_session->parser_.Find(BoxType::kBox_sidx);
-  if (!box) {
-    DASH_LOG("Bad Dash Content.", "Missing sidx box", "");
-    return kDashToHlsStatus_BadDashContents;
+  size_t payload = 0;
+  for (size_t count = 0; count < samples; ++count) {
+    payload += track_run[count].sample_size_;
   }
-  const SidxContents* sidx =
-      reinterpret_cast<const SidxContents*>(box->get_contents());
-  if (!sidx) {
-    DASH_LOG("Bad Dash Content.", "Could not retrieve SidxContents", "");
+  return AdtsOut::GetPackedSize(samples, payload) +
+      dash_session->adts_out_.get_audio_description_size();
+}
+
+// Upper bound on the kDashToHlsFormat_ProgramStream output for one
+// moof/mdat.
+size_t EstimateProgramStreamSize(const Session* dash_session,
+                                 const MdatContents* mdat,
+                                 const TrunContents* trun) {
+  return mdat->get_raw_data_length() +
+      trun->get_track_runs().size() * kPsSampleOverhead +
+      dash_session->sps_pps_.size() +
+      dash_session->ps_out_.get_sync_headers_size();
+}
+
+// Which samples of a moof/mdat TransmuxToTS converts and where the output
+// goes.  By default every sample is converted into a new stream.
+struct TransmuxRange {
+  TransmuxRange()
+      : ts_out(nullptr), encrypter(nullptr), first_sample(0),
+        end_sample(std::numeric_limits<uint32_t>::max()),
+        first_sample_is_sync(true), starts_segment(true) {}
+  // Carries the TS state over from the previous call, in which case the
+  // output is appended and the caller clears it.
+  TransportStreamOut* ts_out;
+  // Carries the segment encryption over with |ts_out|.  The caller starts
+  // and finishes it, nullptr leaves the output clear.
+  HlsEncrypter* encrypter;
+  uint32_t first_sample;
+  uint32_t end_sample;
+  bool first_sample_is_sync;
+  // Packed audio only has the ID3 timestamp at the start of a segment.
+  bool starts_segment;
+};
+
+// Also writes kDashToHlsFormat_ProgramStream, which only differs in the
+// per-sample loop.
+DashToHlsStatus TransmuxToTS(const Session* dash_session,
+                             const MdatContents* mdat,
+                             const BoxContents* moof,
+                             const TfdtContents* tfdt,
+                             const TfhdContents* tfhd,
+                             const TrunContents* trun,
+                             const SaioContents* saio,
+                             const SaizContents* saiz,
+                             const TencContents* tenc,
+                             const TransmuxRange& range,
+                             ByteBuffer* ts_output) {
+  bool streaming = dash_session->output_sink_ != nullptr &&
+      !IsEncryptingSegments(dash_session);
+  // When streaming, anything still in |ts_output| was refused by the sink
+  // and has to be offered again before the new data.
+  if (!streaming && !range.ts_out) {
+    ts_output->clear();
+  }
+  HlsEncrypter encrypter;
+  HlsEncrypter* segment_encrypter = range.encrypter;
+  if (!range.ts_out) {
+    if (!StartEncryption(dash_session, *ts_output, &encrypter)) {
+      return kDashToHlsStatus_BadConfiguration;
+    }
+    segment_encrypter = &encrypter;
+  }
+
+  TransportStreamOut ts_out;
+  if (!range.ts_out && dash_session->is_video_) {
+    ts_out.set_sps_pps(dash_session->sps_pps_);
+    ts_out.set_nalu_length(dash_session->nalu_length_);
+  }
+  ts_out.set_sample_aes(dash_session->get_sample_aes());
+
+  TransmuxFragment fragment;
+  DashToHlsStatus status = InitTransmuxFragment(dash_session, mdat, moof,
+                                                tfhd, trun, saio, saiz, tenc,
+                                                &fragment);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  fragment.first_sample = std::min(range.first_sample, fragment.end_sample);
+  fragment.end_sample = std::min(range.end_sample, fragment.end_sample);
+  fragment.first_sample_is_sync = range.first_sample_is_sync;
+
+  bool is_program_stream =
+      dash_session->output_format_ == kDashToHlsFormat_ProgramStream;
+  if (is_program_stream && dash_session->get_sample_aes()) {
+    DASH_LOG("Bad Configuration.", "SAMPLE-AES needs TS output.",
+             "See DashToHls_SetSampleAesKey.");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (!streaming) {
+    // Room for the padding as well.
+    ts_output->reserve_exact(
+        ts_output->size() +
+        (is_program_stream ?
+         EstimateProgramStreamSize(dash_session, mdat, trun) :
+         EstimateOutputSize(dash_session, mdat, trun)) +
+        Aes128::kBlockSize);
+  }
+
+  ClockRescaler clock(dash_session->timescale_, kDtsClock);
+  clock.Reset(tfdt->get_base_media_decode_time());
+  fragment.clock = &clock;
+  SkipSamples(&fragment);
+  ByteBuffer clear_samples;
+  if (fragment.is_encrypted &&
+      dash_session->uses_fragment_handler(fragment.key)) {
+    if (!DecryptFragment(dash_session, trun, fragment.encryption,
+                         fragment.key, mdat, fragment.mdat_offset,
+                         fragment.first_sample, fragment.end_sample,
+                         &clear_samples)) {
+      return kDashToHlsStatus_BadDashContents;
+    }
+    // The rest of the fragment is converted as if it were clear.
+    fragment.mdat_data = clear_samples.data();
+    fragment.mdat_length = clear_samples.size();
+    fragment.mdat_offset = 0;
+    fragment.is_encrypted = false;
+  }
+  if (!dash_session->is_video_ && !is_program_stream &&
+      range.starts_segment) {
+    dash_session->adts_out_.AddTimestamp(clock.get_time(), ts_output);
+  }
+  fragment.ts_out = range.ts_out ? range.ts_out : &ts_out;
+  fragment.adts_out = &dash_session->adts_out_;
+  fragment.streaming = streaming;
+  fragment.ts_output = ts_output;
+  fragment.encrypter = segment_encrypter;
+  // Waits for the samples still being decrypted when it goes.
+  AsyncDecrypter async(dash_session->decrypt_async_handler_,
+                       dash_session->decrypt_async_limit_);
+  StartAsyncDecryption(dash_session, &fragment, &async);
+
+  TransmuxSamplesLoop transmux_samples = &ProgramStreamSamples;
+  if (!is_program_stream) {
+    transmux_samples =
+        SelectTransmuxSamplesLoop(dash_session->is_video_,
+                                  fragment.is_encrypted,
+                                  trun->IsSampleCompositionPresent(),
+                                  trun->IsSampleDurationPresent());
+  }
+  status = transmux_samples(dash_session, &fragment);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  if (!range.ts_out) {
+    FinishEncryption(&encrypter, ts_output);
+  } else if (segment_encrypter && segment_encrypter->is_initialized()) {
+    // The caller flushes the segment once it is finished.
+    return kDashToHlsStatus_OK;
+  }
+  if (dash_session->output_sink_) {
+    return FlushToSink(dash_session, ts_output);
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// Copies the sample auxiliary information without the per sample IVs,
+// leaving the subsample maps.
+bool StripIvs(const uint8_t* aux_info,
+              const std::vector<uint8_t>& aux_info_sizes, size_t iv_size,
+              ByteBuffer* stripped, std::vector<uint8_t>* stripped_sizes) {
+  stripped_sizes->resize(aux_info_sizes.size());
+  for (size_t count = 0; count < aux_info_sizes.size(); ++count) {
+    size_t size = aux_info_sizes[count];
+    if (size < iv_size) {
+      DASH_LOG("Bad saiz.", "Sample auxiliary information is too short.",
+               PrettyPrintValue(size).c_str());
+      return false;
+    }
+    stripped->append(aux_info + iv_size, size - iv_size);
+    (*stripped_sizes)[count] = static_cast<uint8_t>(size - iv_size);
+    aux_info += size;
+  }
+  return true;
+}
+
+// Converts the samples of |track_run|, back to back in |samples|, from cenc
+// to cbcs in place using the |iv_size| byte IVs and subsample maps in
+// |aux_info|.
+bool TranscryptSamples(const Session* dash_session,
+                       const std::vector<TrunContents::TrackRun>& track_run,
+                       const uint8_t* aux_info,
+                       const std::vector<uint8_t>& aux_info_sizes,
+                       size_t iv_size, uint8_t* samples) {
+  if (aux_info_sizes.size() != track_run.size()) {
+    DASH_LOG("Unsupported saiz.", "Only supports CENC for ALL samples.", "");
+    return false;
+  }
+  for (size_t count = 0; count < track_run.size(); ++count) {
+    size_t size = aux_info_sizes[count];
+    const SaizContents::SaizRecord* subsamples = nullptr;
+    size_t subsample_count = 0;
+    if (size > iv_size) {
+      subsample_count = size >= iv_size + sizeof(uint16_t) ?
+          ntohsFromBuffer(aux_info + iv_size) : 0;
+      if (size != iv_size + sizeof(uint16_t) +
+          subsample_count * SaizContents::SaizRecordSize) {
+        DASH_LOG("Bad saiz.",
+                 "saiz box must be a multiple of SaizRecord sizes.", "");
+        return false;
+      }
+      subsamples = reinterpret_cast<const SaizContents::SaizRecord*>(
+          aux_info + iv_size + sizeof(uint16_t));
+    }
+    if (!dash_session->cbcs_transcrypter_.TranscryptSample(
+            aux_info, iv_size, subsamples, subsample_count, samples,
+            track_run[count].sample_size_)) {
+      return false;
+    }
+    aux_info += size;
+    samples += track_run[count].sample_size_;
+  }
+  return true;
+}
+
+// Whether fmp4 output keeps the samples encrypted, passed through or
+// transcrypted to cbcs, in which case the segments are not encrypted again.
+bool KeepsSamplesEncrypted(const Session* dash_session) {
+  return dash_session->is_encrypted_ &&
+      (dash_session->is_passthrough() ||
+       dash_session->output_format_ == kDashToHlsFormat_CbcsFmp4);
+}
+
+// fmp4 counterpart of TransmuxToTS.  The moof is rewritten for the output
+// and the samples are copied into the mdat unchanged, in one block when they
+// are clear or passed through still encrypted.  With a |segment_encrypter|
+// the fragment is one of several in a segment, as with TransmuxRange: the
+// output is appended, and the caller clears it, starts and finishes the
+// encryption.
+DashToHlsStatus RemuxToFmp4(const Session* dash_session,
+                            uint32_t sequence_number,
+                            const MdatContents* mdat,
+                            const BoxContents* moof,
+                            const TfdtContents* tfdt,
+                            const TfhdContents* tfhd,
+                            const TrunContents* trun,
+                            const SaioContents* saio,
+                            const SaizContents* saiz,
+                            const TencContents* tenc,
+                            HlsEncrypter* segment_encrypter,
+                            ByteBuffer* output) {
+  bool streaming = dash_session->output_sink_ != nullptr &&
+      !IsEncryptingSegments(dash_session);
+  if (!streaming && !segment_encrypter) {
+    output->clear();
+  }
+  if (dash_session->get_sample_aes()) {
+    DASH_LOG("Bad Configuration.", "SAMPLE-AES needs TS output.",
+             "See DashToHls_SetSampleAesKey.");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+
+  TransmuxFragment fragment;
+  DashToHlsStatus status = InitTransmuxFragment(dash_session, mdat, moof,
+                                                tfhd, trun, saio, saiz, tenc,
+                                                &fragment);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  uint64_t payload_size = 0;
+  for (std::vector<TrunContents::TrackRun>::const_iterator
+           iter = track_run.begin(); iter != track_run.end(); ++iter) {
+    payload_size += iter->sample_size_;
+  }
+  if (fragment.mdat_offset + payload_size > mdat->get_raw_data_length()) {
+    DASH_LOG("Buffer overrun.", "Samples would be past the end of the mdat.",
+             "");
+    return kDashToHlsStatus_BadDashContents;
+  }
+
+  if (!streaming) {
+    output->reserve_exact(output->size() + payload_size +
+                          kFmp4FragmentOverhead +
+                          track_run.size() * kFmp4SampleOverhead +
+                          Aes128::kBlockSize);
+  }
+  const uint8_t* mdat_data = mdat->get_raw_data();
+  bool passthrough = dash_session->is_passthrough() &&
+      dash_session->is_encrypted_;
+  bool transcrypt =
+      dash_session->output_format_ == kDashToHlsFormat_CbcsFmp4 &&
+      dash_session->is_encrypted_;
+  if (transcrypt && !dash_session->cbcs_transcrypter_.is_initialized()) {
+    DASH_LOG("Bad Configuration.", "Missing cbcs keys",
+             "See DashToHls_SetCbcsKeys.");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (transcrypt && dash_session->is_cbcs()) {
+    DASH_LOG("Bad Configuration.",
+             "cbcs content is passed through, not transcrypted.",
+             "See kDashToHlsFormat_EncryptedFmp4.");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  // Samples that are still encrypted are not encrypted again.
+  HlsEncrypter encrypter;
+  if (!segment_encrypter) {
+    if (!KeepsSamplesEncrypted(dash_session) &&
+        !StartEncryption(dash_session, *output, &encrypter)) {
+      return kDashToHlsStatus_BadConfiguration;
+    }
+    segment_encrypter = &encrypter;
+  }
+  Fmp4Out fmp4_out;
+  const uint8_t* aux_info = nullptr;
+  const std::vector<uint8_t>* aux_info_sizes = nullptr;
+  ByteBuffer cbcs_aux_info;
+  std::vector<uint8_t> cbcs_aux_info_sizes;
+  if ((passthrough || transcrypt) && fragment.is_encrypted) {
+    // Kept as it is, so it has to be in one block.
+    aux_info = fragment.encryption.get_aux_info();
+    aux_info_sizes = &fragment.encryption.get_aux_info_sizes();
+    if (!aux_info) {
+      DASH_LOG("Bad Saio.",
+               "Only supports contiguous offsets.",
+               "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+  }
+  const uint8_t* out_aux_info = aux_info;
+  if (passthrough) {
+    // The init segment has the tenc defaults, a rotated key goes in a
+    // sample group.
+    fmp4_out.set_encryption(dash_session->key_id_,
+                            static_cast<uint8_t>(
+                                dash_session->default_iv_size_));
+    if (dash_session->is_cbcs()) {
+      fmp4_out.set_cbcs(dash_session->constant_iv_,
+                        dash_session->constant_iv_size_,
+                        dash_session->crypt_byte_block_,
+                        dash_session->skip_byte_block_);
+    }
+    fmp4_out.set_fragment_encryption(
+        fragment.key_id, static_cast<uint8_t>(fragment.iv_size),
+        fragment.constant_iv, fragment.constant_iv_size);
+  } else if (transcrypt) {
+    // The cenc key of DashToHls_SetCbcsKeys only decrypts the default key
+    // id, not a key rotated to through a sample group.
+    if (fragment.is_encrypted &&
+        memcmp(fragment.key_id, dash_session->key_id_,
+               sizeof(dash_session->key_id_)) != 0) {
+      DASH_LOG("Bad Configuration.", "No cenc key for the key id.",
+               PrettyPrintBuffer(fragment.key_id,
+                                 TencContents::kKidSize).c_str());
+      return kDashToHlsStatus_BadConfiguration;
+    }
+    // The aux info has no IV to decrypt the cenc samples with.
+    if (fragment.is_encrypted && fragment.iv_size == 0) {
+      DASH_LOG("Unsupported IV.",
+               "Constant IV cenc cannot be transcrypted to cbcs.", "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+    const CbcsTranscrypter& transcrypter = dash_session->cbcs_transcrypter_;
+    fmp4_out.set_encryption(dash_session->cbcs_key_id_, 0);
+    fmp4_out.set_cbcs(transcrypter.get_cbcs_iv(), Fmp4Out::kConstantIvSize,
+                      transcrypter.get_crypt_byte_block(),
+                      transcrypter.get_skip_byte_block());
+    if (aux_info) {
+      // cbcs uses the constant IV, the senc keeps only the subsamples.
+      if (!StripIvs(aux_info, *aux_info_sizes, fragment.iv_size,
+                    &cbcs_aux_info, &cbcs_aux_info_sizes)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+      out_aux_info = cbcs_aux_info.data();
+      aux_info_sizes = &cbcs_aux_info_sizes;
+    }
+  }
+  if (!fmp4_out.WriteFragmentHeader(
+          sequence_number, tfdt->get_base_media_decode_time(), *tfhd, *trun,
+          static_cast<uint32_t>(fragment.default_duration),
+          static_cast<uint32_t>(payload_size), out_aux_info, aux_info_sizes,
+          output)) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+
+  if (fragment.is_encrypted && !passthrough && !transcrypt &&
+      dash_session->uses_fragment_handler(fragment.key)) {
+    // Decrypted straight into the output, after the fragment header.
+    if (!DecryptFragment(dash_session, trun, fragment.encryption,
+                         fragment.key, mdat, fragment.mdat_offset, 0,
+                         static_cast<uint32_t>(track_run.size()), output)) {
+      return kDashToHlsStatus_BadDashContents;
+    }
+  } else if (fragment.is_encrypted && !passthrough && !transcrypt) {
+    uint64_t mdat_offset = fragment.mdat_offset;
+    uint32_t sample_number = 0;
+    ByteBuffer decrypted;
+    AsyncDecrypter async(dash_session->decrypt_async_handler_,
+                         dash_session->decrypt_async_limit_);
+    StartAsyncDecryption(dash_session, &fragment, &async);
+    for (std::vector<TrunContents::TrackRun>::const_iterator
+             iter = track_run.begin(); iter != track_run.end(); ++iter) {
+      const uint8_t* sample = mdat_data + mdat_offset;
+      size_t sample_size = iter->sample_size_;
+      if (!DecryptNextSample(dash_session, &fragment, sample_number,
+                             &decrypted, &sample, &sample_size)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+      output->append(sample, sample_size);
+      mdat_offset += iter->sample_size_;
+      ++sample_number;
+      EncryptAppended(segment_encrypter, output);
+      if (streaming &&
+          output->size() >= dash_session->output_sink_flush_size_) {
+        status = FlushToSink(dash_session, output);
+        if (status != kDashToHlsStatus_OK) {
+          return status;
+        }
+      }
+    }
+  } else {
+    size_t payload_start = output->size();
+    output->append(mdat_data + fragment.mdat_offset, payload_size);
+    if (transcrypt && aux_info) {
+      if (!TranscryptSamples(dash_session, track_run, aux_info,
+                             fragment.encryption.get_aux_info_sizes(),
+                             fragment.iv_size,
+                             output->data() + payload_start)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+  }
+  if (segment_encrypter == &encrypter) {
+    FinishEncryption(&encrypter, output);
+  } else if (segment_encrypter->is_initialized()) {
+    EncryptAppended(segment_encrypter, output);
+    // The caller flushes the segment once it is finished.
+    return kDashToHlsStatus_OK;
+  }
+  if (dash_session->output_sink_) {
+    return FlushToSink(dash_session, output);
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// Converts one moof/mdat in the session's output format.  |sequence_number|
+// is only used by fmp4.
+DashToHlsStatus ConvertFragment(const Session* dash_session,
+                                uint32_t sequence_number,
+                                const MdatContents* mdat,
+                                const BoxContents* moof,
+                                const TfdtContents* tfdt,
+                                const TfhdContents* tfhd,
+                                const TrunContents* trun,
+                                const SaioContents* saio,
+                                const SaizContents* saiz,
+                                const TencContents* tenc,
+                                ByteBuffer* output) {
+  if (dash_session->output_format_ != kDashToHlsFormat_TransportStream &&
+      dash_session->output_format_ != kDashToHlsFormat_ProgramStream) {
+    return RemuxToFmp4(dash_session, sequence_number, mdat, moof, tfdt, tfhd,
+                       trun, saio, saiz, tenc, nullptr, output);
+  }
+  return TransmuxToTS(dash_session, mdat, moof, tfdt, tfhd, trun, saio, saiz,
+                      tenc, TransmuxRange(), output);
+}
+
+// One sample of a track being muxed, with times on the 90kHz clock.
+struct MuxSample {
+  uint64_t dts;
+  uint64_t pts;
+  uint64_t duration;
+  bool is_sync;
+  // Points into the mdat for clear samples.  Decrypted samples are in
+  // MuxTrack::decrypted at |offset| and |data| is nullptr.
+  const uint8_t* data;
+  size_t offset;
+  size_t size;
+};
+
+struct MuxTrack {
+  DashParser parser;
+  std::vector<MuxSample> samples;
+  ByteBuffer decrypted;
+};
+
+// Parses segment |segment_number| of |dash_session|'s sidx index the same
+// way DashToHls_ConvertDashSegment does.
+DashToHlsStatus ParseIndexedSegment(const Session* dash_session,
+                                    uint32_t segment_number,
+                                    const uint8_t* dash_segment,
+                                    DashParser* parser) {
+  if (segment_number >= dash_session->index_.index_count) {
+    DASH_LOG("Bad segment number.", "Segment is not in the index.",
+             PrettyPrintValue(segment_number).c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  const DashToHlsSegment& segment =
+      dash_session->index_.segments[segment_number];
+  // The parser relies on offsets from the beginning of the file.
+  parser->set_current_position(segment.location);
+  if (parser->Parse(dash_segment, segment.length) == 0) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// Timestamps and, for encrypted content, decrypts every sample of every
+// moof/mdat in |track|'s parser.  The first sample of each video fragment is
+// the sync sample, as in TransmuxToTS.
+DashToHlsStatus CollectSamples(const Session* dash_session, MuxTrack* track) {
+  const MdatContents* mdat = nullptr;
+  const BoxContents* moof = nullptr;
+  const TfdtContents* tfdt = nullptr;
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  const SaioContents* saio = nullptr;
+  const SaizContents* saiz = nullptr;
+  const TencContents* tenc = nullptr;
+  ByteBuffer decrypted;
+  for (size_t index = 0; ; ++index) {
+    DashToHlsStatus status = GetNeededBoxes(dash_session->is_encrypted_,
+                                            index, track->parser,
+                                            &mdat, &moof, &tfdt, &tfhd,
+                                            &trun, &saio, &saiz, &tenc);
+    if (status == kDashToHlsStatus_NeedMoreData) {
+      return kDashToHlsStatus_OK;
+    }
+    if (status != kDashToHlsStatus_OK) {
+      return status;
+    }
+    TransmuxFragment fragment;
+    status = InitTransmuxFragment(dash_session, mdat, moof, tfhd, trun, saio,
+                                  saiz, tenc, &fragment);
+    if (status != kDashToHlsStatus_OK) {
+      return status;
+    }
+    ClockRescaler clock(dash_session->timescale_, kDtsClock);
+    clock.Reset(tfdt->get_base_media_decode_time());
+    const uint8_t* mdat_data = mdat->get_raw_data();
+    const uint64_t mdat_length = mdat->get_raw_data_length();
+    uint64_t mdat_offset = fragment.mdat_offset;
+    uint32_t sample_number = 0;
+    const std::vector<TrunContents::TrackRun>& track_run =
+        trun->get_track_runs();
+    bool batch_decrypted = false;
+    const size_t decrypted_start = track->decrypted.size();
+    if (fragment.is_encrypted &&
+        dash_session->uses_fragment_handler(fragment.key)) {
+      if (!DecryptFragment(dash_session, trun, fragment.encryption,
+                           fragment.key, mdat, fragment.mdat_offset, 0,
+                           static_cast<uint32_t>(track_run.size()),
+                           &track->decrypted)) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+      batch_decrypted = true;
+    }
+    for (std::vector<TrunContents::TrackRun>::const_iterator
+             iter = track_run.begin(); iter != track_run.end(); ++iter) {
+      uint64_t duration = fragment.default_duration;
+      if (trun->IsSampleDurationPresent()) {
+        duration = iter->sample_duration_;
+        if (duration == 0) {
+          DASH_LOG("No Duration", "Duration must be greater than 0",
+                   (trun->BoxName() + ":" +
+                    trun->PrettyPrintTrackRun(*iter)).c_str());
+          return kDashToHlsStatus_BadDashContents;
+        }
+      }
+      if (mdat_offset + iter->sample_size_ > mdat_length) {
+        DASH_LOG("Buffer overrun.",
+                 "Offset would be past the end of the mdat.", "");
+        return kDashToHlsStatus_BadDashContents;
+      }
+      MuxSample sample;
+      sample.dts = clock.get_time();
+      sample.pts = sample.dts;
+      if (trun->IsSampleCompositionPresent()) {
+        sample.pts = clock.OffsetTime(iter->sample_composition_time_offset_);
+      }
+      clock.Advance(duration);
+      sample.duration = clock.get_time() - sample.dts;
+      sample.is_sync = !dash_session->is_video_ || sample_number == 0;
+      if (batch_decrypted) {
+        sample.data = nullptr;
+        sample.offset = decrypted_start + mdat_offset - fragment.mdat_offset;
+        sample.size = iter->sample_size_;
+      } else if (fragment.is_encrypted) {
+        decrypted.resize(iter->sample_size_);
+        if (!DecryptSample(dash_session, &fragment.encryption, sample_number,
+                           fragment.key, mdat_data + mdat_offset,
+                           iter->sample_size_, decrypted.data())) {
+          return kDashToHlsStatus_BadDashContents;
+        }
+        sample.data = nullptr;
+        sample.offset = track->decrypted.size();
+        sample.size = decrypted.size();
+        track->decrypted.append(decrypted.data(), decrypted.size());
+      } else {
+        sample.data = mdat_data + mdat_offset;
+        sample.offset = 0;
+        sample.size = iter->sample_size_;
+      }
+      track->samples.push_back(sample);
+      mdat_offset += iter->sample_size_;
+      ++sample_number;
+    }
+  }
+}
+
+const uint8_t* GetSampleData(const MuxTrack& track, const MuxSample& sample) {
+  return sample.data ? sample.data : track.decrypted.data() + sample.offset;
+}
+
+}  // namespace
+
+extern "C" DashToHlsStatus
+DashToHls_ParseSidx(DashToHlsSession* session, const uint8_t* bytes,
+                    uint64_t length, DashToHlsIndex** index) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->parser_.Parse(bytes, length) == 0) {
+    DASH_LOG("Bad Dash Content.", "Unable to parse for sidx", "");
+    return kDashToHlsStatus_BadDashContents;
+  }
+  const Box* box = dash_session->parser_.Find(BoxType::kBox_sidx);
+  if (!box) {
+    DASH_LOG("Bad Dash Content.", "Missing sidx box", "");
+    return kDashToHlsStatus_BadDashContents;
+  }
+  const SidxContents* sidx =
+      reinterpret_cast<const SidxContents*>(box->get_contents());
+  if (!sidx) {
+    DASH_LOG("Bad Dash Content.", "Could not retrieve SidxContents", "");
     return kDashToHlsStatus_BadDashContents;
   }
   const std::vector<DashToHlsSegment>& locations(sidx->get_locations());
   dash_session->index_.index_count = static_cast<uint32_t>(locations.size());
   dash_session->index_.segments = &locations[0];
   *index = &dash_session->index_;
+  dash_session->planner_.Clear();
 
   return kDashToHlsStatus_OK;
 }
@@ -684,7 +2006,8 @@ DashToHls_ParseLivePssh(DashToHlsSession* session, const uint8_t* bytes,
       return kDashToHlsStatus_BadConfiguration;
     }
 
-    if (!dash_session->pssh_handler_ || !dash_session->decryption_handler_) {
+    if (dash_session->needs_cenc_callbacks() &&
+        !dash_session->can_decrypt()) {
       DASH_LOG("Bad Configuration.", "Missing required callback for CENC",
                "");
       return kDashToHlsStatus_BadConfiguration;
@@ -696,42 +2019,38 @@ DashToHls_ParseLivePssh(DashToHlsSession* session, const uint8_t* bytes,
   return kDashToHlsStatus_OK;
 }
 
-extern "C" DashToHlsStatus
-DashToHls_ParseLive(DashToHlsSession* session, const uint8_t* bytes,
-                    uint64_t length,
-                    uint64_t segment_number,
-                    const uint8_t** hls_segment,
-                    size_t* hls_length) {
-  Session* dash_session = reinterpret_cast<Session*>(session);
-  if (dash_session->parser_.Parse(bytes, length) == 0) {
-    return kDashToHlsStatus_BadDashContents;
-  }
-
+namespace {
+// Takes the track settings from a live moov already in the session's
+// parser.
+DashToHlsStatus ProcessLiveMoov(Session* dash_session) {
   // Check for CENC.
   const Box* box = dash_session->parser_.FindDeep(BoxType::kBox_tenc);
   if (box) {
     const TencContents* tenc =
         reinterpret_cast<const TencContents*>(box->get_contents());
 
-    box = dash_session->parser_.FindDeep(BoxType::kBox_pssh);
-    if (!box) {
+    const std::vector<const Box*> pssh_boxes =
+        dash_session->parser_.FindDeepAll(BoxType::kBox_pssh);
+    if (pssh_boxes.empty()) {
       DASH_LOG("Missing boxes.", "Missing pssh box", "");
       return kDashToHlsStatus_BadConfiguration;
     }
 
-    if (!dash_session->pssh_handler_ || !dash_session->decryption_handler_) {
+    if (dash_session->needs_cenc_callbacks() &&
+        !dash_session->can_decrypt()) {
       DASH_LOG("Bad Configuration.", "Missing required callback for CENC",
                "");
       return kDashToHlsStatus_BadConfiguration;
     }
-    dash_session->is_encrypted_ = true;
-    // TODO(justsomeguy) support more lengths than 8.
-    if (tenc->get_default_iv_size() != 8) {
-      DASH_LOG("Unimplemented.",
-               "Currently only implements a default IV of 8.",
-               "");
+    // Every live segment repeats the pssh boxes, only new ones, such as a
+    // rotated key's, reach the handler.
+    internal::ProcessPsshBoxes(dash_session, pssh_boxes);
+    DashToHlsStatus status =
+        internal::ProcessProtectionScheme(dash_session, tenc);
+    if (status != kDashToHlsStatus_OK) {
+      return status;
     }
-    dash_session->default_iv_size_ = tenc->get_default_iv_size();
+    dash_session->is_encrypted_ = true;
   }
 
   // See if we have an video box.
@@ -769,23 +2088,7 @@ DashToHls_ParseLive(DashToHlsSession* session, const uint8_t* bytes,
     dash_session->audio_config_[0] = mp4a->get_audio_config()[0];
     dash_session->audio_config_[1] = mp4a->get_audio_config()[1];
   }
-
-  const MdatContents* mdat = nullptr;
-  const BoxContents* moof = nullptr;
-  const TfdtContents* tfdt = nullptr;
-  const TfhdContents* tfhd = nullptr;
-  const TrunContents* trun = nullptr;
-  const SaioContents* saio = nullptr;
-  const SaizContents* saiz = nullptr;
-  const TencContents* tenc = nullptr;
-  DashToHlsStatus result = GetNeededBoxes(dash_session->is_encrypted_,
-                                          0,
-                                          dash_session->parser_,
-                                          &mdat, &moof, &tfdt, &tfhd,
-                                          &trun, &saio, &saiz, &tenc);
-  if (result != kDashToHlsStatus_OK) {
-    return result;
-  }
+  internal::ConfigureSampleWriters(dash_session);
 
   const MvhdContents* mvhd = nullptr;
   box = dash_session->parser_.FindDeep(BoxType::kBox_mvhd);
@@ -807,18 +2110,57 @@ DashToHls_ParseLive(DashToHlsSession* session, const uint8_t* bytes,
         reinterpret_cast<const TrexContents*>(box->get_contents());
     dash_session->trex_default_sample_duration_ =
         trex->get_default_sample_duration();
+    dash_session->trex_default_sample_flags_ =
+        trex->get_default_sample_flags();
   }
 
   if (dash_session->timescale_ == 0) {
     DASH_LOG("Bad Dash Content.", "mvhd or mdhd needs a timescale.", "");
     return kDashToHlsStatus_BadDashContents;
   }
+  return kDashToHlsStatus_OK;
+}
+}  // namespace
+
+extern "C" DashToHlsStatus
+DashToHls_ParseLive(DashToHlsSession* session, const uint8_t* bytes,
+                    uint64_t length,
+                    uint64_t segment_number,
+                    const uint8_t** hls_segment,
+                    size_t* hls_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->parser_.Parse(bytes, length) == 0) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+
+  DashToHlsStatus result = ProcessLiveMoov(dash_session);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+
+  const MdatContents* mdat = nullptr;
+  const BoxContents* moof = nullptr;
+  const TfdtContents* tfdt = nullptr;
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  const SaioContents* saio = nullptr;
+  const SaizContents* saiz = nullptr;
+  const TencContents* tenc = nullptr;
+  result = GetNeededBoxes(dash_session->is_encrypted_,
+                          0,
+                          dash_session->parser_,
+                          &mdat, &moof, &tfdt, &tfhd,
+                          &trun, &saio, &saiz, &tenc);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
 
-  result = TransmuxToTS(dash_session, mdat, moof, tfdt,
-                        tfhd, trun, saio, saiz, tenc,
-                        &dash_session->output_[segment_number]);
+  result = ConvertFragment(dash_session,
+                           ++dash_session->fmp4_sequence_number_,
+                           mdat, moof, tfdt, tfhd, trun, saio, saiz, tenc,
+                           &dash_session->output_[segment_number]);
   if (result == kDashToHlsStatus_OK) {
-    *hls_segment = &dash_session->output_[segment_number][0];
+    *hls_segment = dash_session->output_[segment_number].data();
     *hls_length = dash_session->output_[segment_number].size();
   }
   return result;
@@ -858,33 +2200,46 @@ DashToHls_ConvertDashSegmentData(DashToHlsSession* session,
     return result;
   }
 
-  result = TransmuxToTS(dash_session, mdat,  moof, tfdt, tfhd,
-                        trun, saio, saiz, tenc,
-                        &dash_session->output_[segment_number]);
+  result = ConvertFragment(dash_session,
+                           ++dash_session->fmp4_sequence_number_, mdat, moof,
+                           tfdt, tfhd, trun, saio, saiz, tenc,
+                           &dash_session->output_[segment_number]);
   if (result == kDashToHlsStatus_OK) {
-    *hls_segment = &dash_session->output_[segment_number][0];
+    *hls_segment = dash_session->output_[segment_number].data();
     *hls_length = dash_session->output_[segment_number].size();
   }
   return result;
 }
 
-extern "C" DashToHlsStatus
-DashToHls_ConvertDashSegment(DashToHlsSession* session,
-                             uint32_t segment_number,
-                             const uint8_t* dash_segment,
-                             size_t dash_segment_size,
-                             const uint8_t** hls_segment,
-                             size_t* hls_length) {
-  Session* dash_session = reinterpret_cast<Session*>(session);
-  DashParser parser;
-  // The parser relies on offsets from the beginning of the file.
-  parser.set_current_position(
-      dash_session->index_.segments[segment_number].location);
-  if (parser.Parse(dash_segment,
-          dash_session->index_.segments[segment_number].length) == 0) {
-    return kDashToHlsStatus_BadDashContents;
+namespace {
+// The flags of samples the trun has no flags for.
+uint32_t GetDefaultSampleFlags(const Session* dash_session,
+                               const TfhdContents* tfhd) {
+  if (tfhd->IsDefaultSampleFlagsPresent()) {
+    return tfhd->get_default_sample_flags();
   }
+  return dash_session->trex_default_sample_flags_;
+}
 
+// Converts the samples of |span| through |ts_out|, appending to |output|.
+// |dash_segments| holds the DASH segments up to |last_dash_segment| from
+// |location| in the file.  Moofs after the first get PAT/PMT and parameter
+// sets again only if they start with a sync sample.  The span is encrypted
+// as one segment.
+DashToHlsStatus TransmuxSpan(const Session* dash_session,
+                             const SegmentPlanner::Span& span,
+                             uint32_t last_dash_segment,
+                             const uint8_t* dash_segments,
+                             uint64_t location,
+                             TransportStreamOut* ts_out,
+                             ByteBuffer* output) {
+  TransmuxRange range;
+  range.ts_out = ts_out;
+  HlsEncrypter encrypter;
+  if (!StartEncryption(dash_session, *output, &encrypter)) {
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  range.encrypter = &encrypter;
   const MdatContents* mdat = nullptr;
   const BoxContents* moof = nullptr;
   const TfdtContents* tfdt = nullptr;
@@ -893,31 +2248,1143 @@ DashToHls_ConvertDashSegment(DashToHlsSession* session,
   const SaioContents* saio = nullptr;
   const SaizContents* saiz = nullptr;
   const TencContents* tenc = nullptr;
-
-  size_t segment_count = 0;
-
-  while (true) {
+  for (uint32_t segment_number = span.start.segment;
+       segment_number <= last_dash_segment; ++segment_number) {
+    const DashToHlsSegment& segment =
+        dash_session->index_.segments[segment_number];
+    DashParser parser;
+    DashToHlsStatus result = ParseIndexedSegment(
+        dash_session, segment_number,
+        dash_segments + (segment.location - location), &parser);
+    if (result != kDashToHlsStatus_OK) {
+      return result;
+    }
+    // The samples of this DASH segment in the span.
+    uint32_t first_sample =
+        segment_number == span.start.segment ? span.start.sample : 0;
+    uint32_t end_sample = segment_number == span.end.segment ?
+        span.end.sample : std::numeric_limits<uint32_t>::max();
+    uint32_t sample_base = 0;
+    for (size_t index = 0; ; ++index) {
+      result = GetNeededBoxes(dash_session->is_encrypted_, index, parser,
+                              &mdat, &moof, &tfdt, &tfhd, &trun, &saio,
+                              &saiz, &tenc);
+      if (result == kDashToHlsStatus_NeedMoreData) {
+        break;
+      }
+      if (result != kDashToHlsStatus_OK) {
+        return result;
+      }
+      uint32_t samples = static_cast<uint32_t>(trun->get_track_runs().size());
+      if (sample_base + samples > first_sample && sample_base < end_sample) {
+        range.first_sample =
+            first_sample > sample_base ? first_sample - sample_base : 0;
+        range.end_sample = end_sample - sample_base;
+        range.first_sample_is_sync = range.starts_segment ||
+            trun->IsSyncSample(range.first_sample,
+                               GetDefaultSampleFlags(dash_session, tfhd));
+        result = TransmuxToTS(dash_session, mdat, moof, tfdt, tfhd, trun,
+                              saio, saiz, tenc, range, output);
+        if (result != kDashToHlsStatus_OK) {
+          return result;
+        }
+        range.starts_segment = false;
+      }
+      sample_base += samples;
+    }
+  }
+  if (encrypter.is_initialized()) {
+    FinishEncryption(&encrypter, output);
+    if (dash_session->output_sink_) {
+      return FlushToSink(dash_session, output);
+    }
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// Packetizes only the sync samples of one moof/mdat, each into a PAT, a
+// PMT and one PES through |ts_out|, and appends them to |output|.  Other
+// samples are skipped without being decrypted or copied.  Each I-frame's
+// time and place in the I-frame file is added to |iframes|, with
+// |file_offset| the position of |output| in the file.  The duration of an
+// I-frame runs to the next one, which fixes up the previous entry.  Returns
+// the time at the end of the fragment in |end_time|.
+DashToHlsStatus ExtractSyncSamples(const Session* dash_session,
+                                   const MdatContents* mdat,
+                                   const BoxContents* moof,
+                                   const TfdtContents* tfdt,
+                                   const TfhdContents* tfhd,
+                                   const TrunContents* trun,
+                                   const SaioContents* saio,
+                                   const SaizContents* saiz,
+                                   const TencContents* tenc,
+                                   uint64_t file_offset,
+                                   TransportStreamOut* ts_out,
+                                   ByteBuffer* output,
+                                   std::vector<DashToHlsSegment>* iframes,
+                                   uint64_t* end_time) {
+  TransmuxFragment fragment;
+  DashToHlsStatus status = InitTransmuxFragment(dash_session, mdat, moof,
+                                                tfhd, trun, saio, saiz, tenc,
+                                                &fragment);
+  if (status != kDashToHlsStatus_OK) {
+    return status;
+  }
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  const uint8_t* mdat_data = mdat->get_raw_data();
+  const uint64_t mdat_length = mdat->get_raw_data_length();
+  const bool is_encrypted = fragment.is_encrypted;
+  const uint32_t default_sample_flags =
+      GetDefaultSampleFlags(dash_session, tfhd);
+  ClockRescaler clock(dash_session->timescale_, kDtsClock);
+  clock.Reset(tfdt->get_base_media_decode_time());
+  uint64_t time = tfdt->get_base_media_decode_time();
+  ByteBuffer packets;
+  // Decrypted or copied once, the NALUs are rewritten in place.
+  std::vector<uint8_t> pes_data;
+  for (uint32_t sample_number = 0; sample_number < track_run.size();
+       ++sample_number) {
+    const TrunContents::TrackRun& run = track_run[sample_number];
+    uint64_t duration = trun->IsSampleDurationPresent() ?
+        run.sample_duration_ : fragment.default_duration;
+    if (fragment.mdat_offset + run.sample_size_ > mdat_length) {
+      DASH_LOG("Buffer overrun.", "Offset would be past the end of the mdat.",
+               "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+    if (trun->IsSyncSample(sample_number, default_sample_flags)) {
+      const uint8_t* sample = mdat_data + fragment.mdat_offset;
+      if (is_encrypted) {
+        pes_data.resize(run.sample_size_);
+        if (!DecryptSample(dash_session, &fragment.encryption, sample_number,
+                           fragment.key, sample, run.sample_size_,
+                           pes_data.data())) {
+          return kDashToHlsStatus_BadDashContents;
+        }
+      } else {
+        pes_data.assign(sample, sample + run.sample_size_);
+      }
+      uint64_t dts = clock.get_time();
+      uint64_t pts = dts;
+      if (trun->IsSampleCompositionPresent()) {
+        pts = clock.OffsetTime(run.sample_composition_time_offset_);
+      }
+      ts_out->ProcessSample(&pes_data, true, true, pts, dts, dts,
+                            clock.Rescale(duration), &packets);
+      if (!iframes->empty()) {
+        iframes->back().duration = time - iframes->back().start_time;
+      }
+      // Each I-frame is a byte range of its own, so it is encrypted on its
+      // own, padding included.
+      size_t start = output->size();
+      HlsEncrypter encrypter;
+      if (!StartEncryption(dash_session, *output, &encrypter)) {
+        return kDashToHlsStatus_BadConfiguration;
+      }
+      output->append(packets.data(), packets.size());
+      FinishEncryption(&encrypter, output);
+      DashToHlsSegment iframe;
+      iframe.start_time = time;
+      iframe.duration = 0;
+      iframe.timescale = static_cast<uint32_t>(dash_session->timescale_);
+      iframe.location = file_offset + start;
+      iframe.length = output->size() - start;
+      iframes->push_back(iframe);
+    }
+    fragment.mdat_offset += run.sample_size_;
+    clock.Advance(duration);
+    time += duration;
+  }
+  *end_time = time;
+  return kDashToHlsStatus_OK;
+}
+}  // namespace
+
+extern "C" DashToHlsStatus
+DashToHls_ConvertLiveChunk(DashToHlsSession* session,
+                           const uint8_t* chunk,
+                           size_t chunk_length,
+                           const uint8_t** hls_part,
+                           size_t* hls_length,
+                           DashToHlsPart* part) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  DashParser chunk_parser;
+  if (chunk_parser.Parse(chunk, chunk_length) == 0) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+  // Live segments repeat the moov, only the first one is used.
+  if (dash_session->timescale_ == 0 &&
+      chunk_parser.Find(BoxType::kBox_moov)) {
+    if (dash_session->parser_.Parse(chunk, chunk_length) == 0) {
+      return kDashToHlsStatus_BadDashContents;
+    }
+    DashToHlsStatus result = ProcessLiveMoov(dash_session);
+    if (result != kDashToHlsStatus_OK) {
+      return result;
+    }
+  }
+  if (dash_session->timescale_ == 0) {
+    DASH_LOG("Part unavailable.", "No moov has been parsed.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  ByteBuffer* output = &dash_session->live_part_;
+  if (!chunk_parser.Find(BoxType::kBox_moof)) {
+    // Nothing but the init.
+    *hls_part = output->data();
+    *hls_length = 0;
+    part->duration = 0;
+    part->independent = 0;
+    return kDashToHlsStatus_OK;
+  }
+
+  const MdatContents* mdat = nullptr;
+  const BoxContents* moof = nullptr;
+  const TfdtContents* tfdt = nullptr;
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  const SaioContents* saio = nullptr;
+  const SaizContents* saiz = nullptr;
+  const TencContents* tenc = nullptr;
+  const Box* box = dash_session->parser_.FindDeep(BoxType::kBox_tenc);
+  if (box) {
+    tenc = reinterpret_cast<const TencContents*>(box->get_contents());
+  }
+  DashToHlsStatus result = GetNeededBoxes(dash_session->is_encrypted_,
+                                          0, chunk_parser,
+                                          &mdat, &moof, &tfdt, &tfhd,
+                                          &trun, &saio, &saiz, nullptr);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+
+  const std::vector<TrunContents::TrackRun>& track_run =
+      trun->get_track_runs();
+  uint64_t duration = 0;
+  if (trun->IsSampleDurationPresent()) {
+    for (size_t count = 0; count < track_run.size(); ++count) {
+      duration += track_run[count].sample_duration_;
+    }
+  } else {
+    duration = track_run.size() *
+        internal::GetDuration(trun, nullptr, tfhd,
+                              dash_session->trex_default_sample_duration_);
+  }
+  // Audio frames are all sync samples.
+  bool independent = !track_run.empty() &&
+      (!dash_session->is_video_ ||
+       trun->IsSyncSample(0, GetDefaultSampleFlags(dash_session, tfhd)));
+
+  ++dash_session->part_count_;
+  TransmuxRange range;
+  range.first_sample_is_sync = independent;
+  HlsEncrypter encrypter;
+  switch (dash_session->output_format_) {
+    case kDashToHlsFormat_TransportStream:
+      if (!dash_session->output_sink_) {
+        output->clear();
+      }
+      range.ts_out = &dash_session->live_ts_out_;
+      if (!StartEncryption(dash_session, *output, &encrypter)) {
+        return kDashToHlsStatus_BadConfiguration;
+      }
+      range.encrypter = &encrypter;
+      result = TransmuxToTS(dash_session, mdat, moof, tfdt, tfhd, trun, saio,
+                            saiz, tenc, range, output);
+      if (result == kDashToHlsStatus_OK && encrypter.is_initialized()) {
+        // Each part is encrypted on its own.
+        FinishEncryption(&encrypter, output);
+        if (dash_session->output_sink_) {
+          result = FlushToSink(dash_session, output);
+        }
+      }
+      break;
+    case kDashToHlsFormat_ProgramStream:
+      result = TransmuxToTS(dash_session, mdat, moof, tfdt, tfhd, trun, saio,
+                            saiz, tenc, range, output);
+      break;
+    default:
+      result = RemuxToFmp4(dash_session, dash_session->part_count_, mdat,
+                           moof, tfdt, tfhd, trun, saio, saiz, tenc, nullptr,
+                           output);
+      break;
+  }
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+  dash_session->last_part_.duration =
+      static_cast<double>(duration) / dash_session->timescale_;
+  dash_session->last_part_.independent = independent;
+  *part = dash_session->last_part_;
+  *hls_part = output->data();
+  *hls_length = output->size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_ConvertDashSegment(DashToHlsSession* session,
+                             uint32_t segment_number,
+                             const uint8_t* dash_segment,
+                             size_t dash_segment_size,
+                             const uint8_t** hls_segment,
+                             size_t* hls_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  DashParser parser;
+  // The parser relies on offsets from the beginning of the file.
+  parser.set_current_position(
+      dash_session->index_.segments[segment_number].location);
+  if (parser.Parse(dash_segment,
+          dash_session->index_.segments[segment_number].length) == 0) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+
+  const MdatContents* mdat = nullptr;
+  const BoxContents* moof = nullptr;
+  const TfdtContents* tfdt = nullptr;
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  const SaioContents* saio = nullptr;
+  const SaizContents* saiz = nullptr;
+  const TencContents* tenc = nullptr;
+
+  // Every moof/mdat of the segment is appended to one output, with the TS
+  // state and the encryption carried from one to the next.  When
+  // streaming, anything still in |output| was refused by the sink and has
+  // to be offered again before the new data.
+  ByteBuffer* output = &dash_session->output_[segment_number];
+  if (!dash_session->output_sink_ || IsEncryptingSegments(dash_session)) {
+    output->clear();
+  }
+  bool is_fmp4 =
+      dash_session->output_format_ != kDashToHlsFormat_TransportStream &&
+      dash_session->output_format_ != kDashToHlsFormat_ProgramStream;
+  HlsEncrypter encrypter;
+  if (!(is_fmp4 && KeepsSamplesEncrypted(dash_session)) &&
+      !StartEncryption(dash_session, *output, &encrypter)) {
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  TransportStreamOut ts_out;
+  if (dash_session->is_video_) {
+    ts_out.set_sps_pps(dash_session->sps_pps_);
+    ts_out.set_nalu_length(dash_session->nalu_length_);
+  }
+  ts_out.set_sample_aes(dash_session->get_sample_aes());
+  TransmuxRange range;
+  range.ts_out = &ts_out;
+  range.encrypter = &encrypter;
+
+  for (size_t index = 0; ; ++index) {
     DashToHlsStatus result = GetNeededBoxes(dash_session->is_encrypted_,
-                                            segment_count, parser,
+                                            index, parser,
                                             &mdat, &moof, &tfdt, &tfhd,
                                             &trun, &saio, &saiz, &tenc);
+    if (result == kDashToHlsStatus_NeedMoreData) {
+      break;
+    }
     if (result != kDashToHlsStatus_OK) {
-      if (result == kDashToHlsStatus_NeedMoreData) {
-        *hls_segment = &dash_session->output_[segment_number][0];
-        *hls_length = dash_session->output_[segment_number].size();
-        return kDashToHlsStatus_OK;
+      return result;
+    }
+    if (is_fmp4) {
+      result = RemuxToFmp4(dash_session,
+                           ++dash_session->fmp4_sequence_number_, mdat, moof,
+                           tfdt, tfhd, trun, saio, saiz, tenc, &encrypter,
+                           output);
+    } else {
+      range.first_sample_is_sync = range.starts_segment ||
+          trun->IsSyncSample(0, GetDefaultSampleFlags(dash_session, tfhd));
+      result = TransmuxToTS(dash_session, mdat, moof, tfdt, tfhd, trun, saio,
+                            saiz, tenc, range, output);
+      range.starts_segment = false;
+    }
+    if (result != kDashToHlsStatus_OK) {
+      return result;
+    }
+  }
+  if (encrypter.is_initialized()) {
+    FinishEncryption(&encrypter, output);
+    if (dash_session->output_sink_) {
+      DashToHlsStatus result = FlushToSink(dash_session, output);
+      if (result != kDashToHlsStatus_OK) {
+        return result;
       }
+    }
+  }
+  *hls_segment = output->data();
+  *hls_length = output->size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_AddSegmentToPlan(DashToHlsSession* session,
+                           uint32_t segment_number,
+                           const uint8_t* dash_segment,
+                           size_t dash_segment_size) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->timescale_ == 0) {
+    DASH_LOG("Plan unavailable.", "No moov has been parsed.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  if (segment_number < dash_session->index_.index_count &&
+      dash_segment_size <
+      dash_session->index_.segments[segment_number].length) {
+    return kDashToHlsStatus_NeedMoreData;
+  }
+  DashParser parser;
+  DashToHlsStatus result = ParseIndexedSegment(dash_session, segment_number,
+                                               dash_segment, &parser);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+  const DashToHlsSegment& segment =
+      dash_session->index_.segments[segment_number];
+  // Sample durations are in the track timescale, the plan is in the index
+  // timescale.
+  ClockRescaler clock(dash_session->timescale_, segment.timescale);
+  clock.Reset(0);
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  uint32_t sample_base = 0;
+  size_t fragments = parser.FindAll(BoxType::kBox_moof).size();
+  for (size_t index = 0; index < fragments; ++index) {
+    result = GetNeededBoxes(false, index, parser, nullptr, nullptr, nullptr,
+                            &tfhd, &trun, nullptr, nullptr, nullptr);
+    if (result != kDashToHlsStatus_OK) {
       return result;
     }
-    ++segment_count;
+    const std::vector<TrunContents::TrackRun>& track_run =
+        trun->get_track_runs();
+    uint64_t duration = 0;
+    if (!trun->IsSampleDurationPresent()) {
+      duration = internal::GetDuration(
+          trun, nullptr, tfhd, dash_session->trex_default_sample_duration_);
+      if (duration == 0) {
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+    uint32_t default_sample_flags = GetDefaultSampleFlags(dash_session, tfhd);
+    for (size_t count = 0; count < track_run.size(); ++count) {
+      // Audio frames are all sync samples.
+      if (!dash_session->is_video_ ||
+          trun->IsSyncSample(count, default_sample_flags)) {
+        dash_session->planner_.AddSyncSample(
+            segment_number, sample_base + static_cast<uint32_t>(count),
+            segment.start_time + clock.get_time());
+      }
+      clock.Advance(trun->IsSampleDurationPresent() ?
+                    track_run[count].sample_duration_ : duration);
+    }
+    sample_base += static_cast<uint32_t>(track_run.size());
+  }
+  return kDashToHlsStatus_OK;
+}
 
-    result = TransmuxToTS(dash_session, mdat,  moof, tfdt, tfhd,
-                          trun, saio, saiz, tenc,
-                          &dash_session->output_[segment_number]);
+extern "C" DashToHlsStatus
+DashToHls_PlanSegments(DashToHlsSession* session,
+                       double target_duration,
+                       DashToHlsPlan** plan) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  const DashToHlsIndex& index = dash_session->index_;
+  if (index.index_count == 0) {
+    DASH_LOG("Plan unavailable.", "No sidx has been parsed.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  if (target_duration <= 0) {
+    DASH_LOG("Bad Configuration.", "Target duration must be positive.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  uint32_t timescale = index.segments[0].timescale;
+  dash_session->planner_.Plan(
+      index.segments, index.index_count,
+      static_cast<uint64_t>(target_duration * timescale + 0.5),
+      &dash_session->plan_spans_);
+
+  const std::vector<SegmentPlanner::Span>& spans = dash_session->plan_spans_;
+  std::vector<DashToHlsPlannedSegment>& planned =
+      dash_session->planned_segments_;
+  planned.resize(spans.size());
+  for (size_t count = 0; count < spans.size(); ++count) {
+    const SegmentPlanner::Span& span = spans[count];
+    uint32_t last = span.end.sample ? span.end.segment : span.end.segment - 1;
+    planned[count].start_time = span.start.time;
+    planned[count].duration = span.end.time - span.start.time;
+    planned[count].timescale = timescale;
+    planned[count].location = index.segments[span.start.segment].location;
+    planned[count].length = index.segments[last].location +
+        index.segments[last].length - planned[count].location;
+    planned[count].first_dash_segment = span.start.segment;
+    planned[count].last_dash_segment = last;
+  }
+  dash_session->plan_.segment_count = static_cast<uint32_t>(planned.size());
+  dash_session->plan_.segments = planned.empty() ? nullptr : &planned[0];
+  *plan = &dash_session->plan_;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_ConvertPlannedSegment(DashToHlsSession* session,
+                                uint32_t planned_segment_number,
+                                const uint8_t* dash_segments,
+                                size_t dash_segments_size,
+                                const uint8_t** hls_segment,
+                                size_t* hls_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (planned_segment_number >= dash_session->plan_spans_.size()) {
+    DASH_LOG("Bad segment number.", "Segment is not in the plan.",
+             PrettyPrintValue(planned_segment_number).c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (dash_session->output_format_ != kDashToHlsFormat_TransportStream &&
+      dash_session->output_format_ != kDashToHlsFormat_ProgramStream) {
+    DASH_LOG("Bad output format.",
+             "Only transport and program streams can be planned.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  const SegmentPlanner::Span& span =
+      dash_session->plan_spans_[planned_segment_number];
+  const DashToHlsPlannedSegment& planned =
+      dash_session->planned_segments_[planned_segment_number];
+  if (dash_segments_size < planned.length) {
+    return kDashToHlsStatus_NeedMoreData;
+  }
+
+  ByteBuffer* output = &dash_session->output_[planned_segment_number];
+  if (!dash_session->output_sink_) {
+    output->clear();
+  }
+  // One TransportStreamOut for every moof keeps the continuity counters
+  // running.
+  TransportStreamOut ts_out;
+  if (dash_session->is_video_) {
+    ts_out.set_sps_pps(dash_session->sps_pps_);
+    ts_out.set_nalu_length(dash_session->nalu_length_);
+  }
+  ts_out.set_sample_aes(dash_session->get_sample_aes());
+  DashToHlsStatus result = TransmuxSpan(dash_session, span,
+                                        planned.last_dash_segment,
+                                        dash_segments, planned.location,
+                                        &ts_out, output);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+  *hls_segment = output->data();
+  *hls_length = output->size();
+  return kDashToHlsStatus_OK;
+}
+
+namespace {
+// Writes a media playlist with one EXTINF and EXT-X-BYTERANGE into the file
+// at |uri| for each of |ranges|.  A |complete| playlist is VOD and ends with
+// EXT-X-ENDLIST.
+void WriteByteRangePlaylist(const std::vector<DashToHlsSegment>& ranges,
+                            bool complete, bool iframes_only,
+                            const char* uri, std::string* text) {
+  // Each EXTINF rounded to the nearest second must fit in the target
+  // duration.
+  uint64_t target_duration = 0;
+  for (size_t count = 0; count < ranges.size(); ++count) {
+    uint64_t rounded = (ranges[count].duration * 2 + ranges[count].timescale) /
+        (static_cast<uint64_t>(ranges[count].timescale) * 2);
+    target_duration = std::max(target_duration, rounded);
+  }
+  char line[128];
+  *text = "#EXTM3U\n#EXT-X-VERSION:4\n";
+  snprintf(line, sizeof(line), "#EXT-X-TARGETDURATION:%llu\n",
+           static_cast<unsigned long long>(target_duration));
+  *text += line;
+  *text += "#EXT-X-MEDIA-SEQUENCE:0\n";
+  *text += complete ? "#EXT-X-PLAYLIST-TYPE:VOD\n" :
+      "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+  if (iframes_only) {
+    *text += "#EXT-X-I-FRAMES-ONLY\n";
+  }
+  for (size_t count = 0; count < ranges.size(); ++count) {
+    snprintf(line, sizeof(line), "#EXTINF:%.5f,\n#EXT-X-BYTERANGE:%llu@%llu\n",
+             static_cast<double>(ranges[count].duration) /
+             ranges[count].timescale,
+             static_cast<unsigned long long>(ranges[count].length),
+             static_cast<unsigned long long>(ranges[count].location));
+    *text += line;
+    *text += uri;
+    *text += "\n";
+  }
+  if (complete) {
+    *text += "#EXT-X-ENDLIST\n";
+  }
+}
+}  // namespace
+
+extern "C" DashToHlsStatus
+DashToHls_AppendToSingleFile(DashToHlsSession* session,
+                             uint32_t segment_number,
+                             const uint8_t* dash_segment,
+                             size_t dash_segment_size,
+                             const uint8_t** hls_data,
+                             size_t* hls_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  std::vector<DashToHlsSegment>& ranges = dash_session->single_file_ranges_;
+  if (segment_number != ranges.size() ||
+      segment_number >= dash_session->index_.index_count) {
+    DASH_LOG("Bad segment number.",
+             "Single file segments are appended in index order.",
+             PrettyPrintValue(segment_number).c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (dash_session->output_format_ != kDashToHlsFormat_TransportStream &&
+      dash_session->output_format_ != kDashToHlsFormat_ProgramStream) {
+    DASH_LOG("Bad output format.",
+             "Only transport and program streams can be a single file.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (dash_session->output_sink_) {
+    DASH_LOG("Bad Configuration.",
+             "Single file output does not use the output sink.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  const DashToHlsSegment& segment =
+      dash_session->index_.segments[segment_number];
+  if (dash_segment_size < segment.length) {
+    return kDashToHlsStatus_NeedMoreData;
+  }
+
+  ByteBuffer* output = &dash_session->single_file_segment_;
+  output->clear();
+  SegmentPlanner::Span span = {
+    {segment_number, 0, segment.start_time},
+    {segment_number + 1, 0, segment.start_time + segment.duration}};
+  DashToHlsStatus result = TransmuxSpan(dash_session, span, segment_number,
+                                        dash_segment, segment.location,
+                                        &dash_session->single_file_ts_out_,
+                                        output);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+  DashToHlsSegment range = segment;
+  range.location = ranges.empty() ? 0 :
+      ranges.back().location + ranges.back().length;
+  range.length = output->size();
+  ranges.push_back(range);
+  *hls_data = output->data();
+  *hls_length = output->size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetByteRangePlaylist(DashToHlsSession* session,
+                               const char* uri,
+                               const char** playlist,
+                               size_t* playlist_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  const std::vector<DashToHlsSegment>& ranges =
+      dash_session->single_file_ranges_;
+  if (ranges.empty()) {
+    DASH_LOG("Playlist unavailable.", "No segment has been appended.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  std::string& text = dash_session->single_file_playlist_;
+  WriteByteRangePlaylist(ranges,
+                         ranges.size() == dash_session->index_.index_count,
+                         false, uri, &text);
+  *playlist = text.c_str();
+  *playlist_length = text.size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_AppendIFrames(DashToHlsSession* session,
+                        uint32_t segment_number,
+                        const uint8_t* dash_segment,
+                        size_t dash_segment_size,
+                        const uint8_t** hls_data,
+                        size_t* hls_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (segment_number != dash_session->iframe_segment_count_) {
+    DASH_LOG("Bad segment number.",
+             "I-frame segments are appended in index order.",
+             PrettyPrintValue(segment_number).c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (!dash_session->is_video_) {
+    DASH_LOG("Bad Configuration.", "Only video has I-frames.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if (segment_number < dash_session->index_.index_count &&
+      dash_segment_size <
+      dash_session->index_.segments[segment_number].length) {
+    return kDashToHlsStatus_NeedMoreData;
+  }
+  DashParser parser;
+  DashToHlsStatus result = ParseIndexedSegment(dash_session, segment_number,
+                                               dash_segment, &parser);
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+
+  std::vector<DashToHlsSegment>& iframes = dash_session->iframes_;
+  uint64_t file_offset = iframes.empty() ? 0 :
+      iframes.back().location + iframes.back().length;
+  ByteBuffer* output = &dash_session->iframe_output_;
+  output->clear();
+  const MdatContents* mdat = nullptr;
+  const BoxContents* moof = nullptr;
+  const TfdtContents* tfdt = nullptr;
+  const TfhdContents* tfhd = nullptr;
+  const TrunContents* trun = nullptr;
+  const SaioContents* saio = nullptr;
+  const SaizContents* saiz = nullptr;
+  const TencContents* tenc = nullptr;
+  uint64_t end_time = 0;
+  for (size_t index = 0; ; ++index) {
+    result = GetNeededBoxes(dash_session->is_encrypted_, index, parser,
+                            &mdat, &moof, &tfdt, &tfhd, &trun, &saio, &saiz,
+                            &tenc);
+    if (result == kDashToHlsStatus_NeedMoreData) {
+      break;
+    }
+    if (result != kDashToHlsStatus_OK) {
+      return result;
+    }
+    result = ExtractSyncSamples(dash_session, mdat, moof, tfdt, tfhd, trun,
+                                saio, saiz, tenc, file_offset,
+                                &dash_session->iframe_ts_out_, output,
+                                &iframes, &end_time);
     if (result != kDashToHlsStatus_OK) {
       return result;
     }
   }
+  // Until the next segment says otherwise the last I-frame runs to the end
+  // of this one.
+  if (!iframes.empty()) {
+    iframes.back().duration = end_time - iframes.back().start_time;
+  }
+  ++dash_session->iframe_segment_count_;
+  *hls_data = output->data();
+  *hls_length = output->size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetIFramePlaylist(DashToHlsSession* session,
+                            const char* uri,
+                            const char** playlist,
+                            size_t* playlist_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  const std::vector<DashToHlsSegment>& iframes = dash_session->iframes_;
+  if (iframes.empty()) {
+    DASH_LOG("Playlist unavailable.", "No I-frame has been extracted.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  std::string& text = dash_session->iframe_playlist_;
+  WriteByteRangePlaylist(
+      iframes,
+      dash_session->iframe_segment_count_ == dash_session->index_.index_count,
+      true, uri, &text);
+  *playlist = text.c_str();
+  *playlist_length = text.size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_ConvertMuxedSegment(DashToHlsSession* video_session,
+                              uint32_t video_segment_number,
+                              const uint8_t* video_segment,
+                              size_t video_segment_size,
+                              DashToHlsSession* audio_session,
+                              uint32_t audio_segment_number,
+                              const uint8_t* audio_segment,
+                              size_t audio_segment_size,
+                              const uint8_t** hls_segment,
+                              size_t* hls_length) {
+  Session* video = reinterpret_cast<Session*>(video_session);
+  const Session* audio = reinterpret_cast<const Session*>(audio_session);
+  if (!video->is_video_ || audio->is_video_) {
+    DASH_LOG("Bad muxed sessions.",
+             "Needs one video session and one audio session.", "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  if ((video_segment_number < video->index_.index_count &&
+       video_segment_size <
+       video->index_.segments[video_segment_number].length) ||
+      (audio_segment_number < audio->index_.index_count &&
+       audio_segment_size <
+       audio->index_.segments[audio_segment_number].length)) {
+    return kDashToHlsStatus_NeedMoreData;
+  }
+  MuxTrack video_track;
+  MuxTrack audio_track;
+  DashToHlsStatus result = ParseIndexedSegment(video, video_segment_number,
+                                               video_segment,
+                                               &video_track.parser);
+  if (result == kDashToHlsStatus_OK) {
+    result = ParseIndexedSegment(audio, audio_segment_number, audio_segment,
+                                 &audio_track.parser);
+  }
+  if (result == kDashToHlsStatus_OK) {
+    result = CollectSamples(video, &video_track);
+  }
+  if (result == kDashToHlsStatus_OK) {
+    result = CollectSamples(audio, &audio_track);
+  }
+  if (result != kDashToHlsStatus_OK) {
+    return result;
+  }
+
+  TransportStreamOut ts_out;
+  ts_out.set_has_video(true);
+  ts_out.set_has_audio(true);
+  ts_out.set_sps_pps(video->sps_pps_);
+  ts_out.set_nalu_length(video->nalu_length_);
+  ts_out.set_audio_object_type(audio->audio_object_type_);
+  ts_out.set_sampling_frequency_index(audio->sampling_frequency_index_);
+  ts_out.set_channel_config(audio->channel_config_);
+  ts_out.set_audio_config(audio->audio_config_);
+  ts_out.set_audio_aggregation_duration(kMuxedAudioPesDuration);
+  ts_out.set_sample_aes(video->get_sample_aes());
+
+  ByteBuffer* ts_output = &video->output_[video_segment_number];
+  // With a sink, anything still in |ts_output| was refused by it and has to
+  // be offered again before the new data.
+  if (!video->output_sink_) {
+    ts_output->clear();
+  }
+  size_t payload = ts_output->size() + video_track.decrypted.size() +
+      audio_track.decrypted.size() + video->sps_pps_.size();
+  for (size_t count = 0; count < video_track.samples.size(); ++count) {
+    if (video_track.samples[count].data) {
+      payload += video_track.samples[count].size + kVideoSampleOverhead;
+    }
+  }
+  for (size_t count = 0; count < audio_track.samples.size(); ++count) {
+    if (audio_track.samples[count].data) {
+      payload += audio_track.samples[count].size + AdtsOut::kHeaderSize;
+    }
+  }
+  ts_output->reserve_exact((payload / kTsPayloadSize +
+                            video_track.samples.size() + kTsPsiPackets) *
+                           kTsPacketSize + Aes128::kBlockSize);
+  // The video session's key encrypts the muxed segment.
+  HlsEncrypter encrypter;
+  if (!StartEncryption(video, *ts_output, &encrypter)) {
+    return kDashToHlsStatus_BadConfiguration;
+  }
+
+  // Interleave by dts, video first on ties so a key frame's PAT/PMT lead.
+  ByteBuffer output;
+  size_t video_index = 0;
+  size_t audio_index = 0;
+  while (video_index < video_track.samples.size() ||
+         audio_index < audio_track.samples.size()) {
+    bool is_video = audio_index == audio_track.samples.size() ||
+        (video_index < video_track.samples.size() &&
+         video_track.samples[video_index].dts <=
+         audio_track.samples[audio_index].dts);
+    const MuxTrack& track = is_video ? video_track : audio_track;
+    const MuxSample& sample =
+        is_video ? track.samples[video_index++] :
+        track.samples[audio_index++];
+    ts_out.ProcessSample(GetSampleData(track, sample), sample.size, is_video,
+                         sample.is_sync, sample.pts, sample.dts, sample.dts,
+                         sample.duration, &output);
+    ts_output->append(output.data(), output.size());
+    EncryptAppended(&encrypter, ts_output);
+  }
+  output.clear();
+  ts_out.Flush(&output);
+  ts_output->append(output.data(), output.size());
+  FinishEncryption(&encrypter, ts_output);
+
+  if (video->output_sink_) {
+    result = FlushToSink(video, ts_output);
+    if (result != kDashToHlsStatus_OK) {
+      return result;
+    }
+  }
+  *hls_segment = ts_output->data();
+  *hls_length = ts_output->size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetOutputFormat(DashToHlsSession* session,
+                          DashToHlsFormat format) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (format != kDashToHlsFormat_TransportStream &&
+      format != kDashToHlsFormat_Fmp4 &&
+      format != kDashToHlsFormat_EncryptedFmp4 &&
+      format != kDashToHlsFormat_CbcsFmp4 &&
+      format != kDashToHlsFormat_ProgramStream) {
+    DASH_LOG("Bad output format.", "Unknown DashToHlsFormat.",
+             PrettyPrintValue(static_cast<uint32_t>(format)).c_str());
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  dash_session->output_format_ = format;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetInitSegment(DashToHlsSession* session,
+                         const uint8_t** init_segment,
+                         size_t* init_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->timescale_ == 0) {
+    DASH_LOG("Init segment unavailable.", "No moov has been parsed.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  Fmp4Out fmp4_out;
+  fmp4_out.set_timescale(static_cast<uint32_t>(dash_session->timescale_));
+  const Box* box = dash_session->parser_.FindDeep(BoxType::kBox_trex);
+  if (box) {
+    const TrexContents* trex =
+        reinterpret_cast<const TrexContents*>(box->get_contents());
+    fmp4_out.set_trex_defaults(trex->get_default_sample_duration(),
+                               trex->get_default_sample_flags());
+  }
+  if (dash_session->is_video_) {
+    box = dash_session->parser_.FindDeep(BoxType::kBox_avc1);
+    if (!box) {
+      box = dash_session->parser_.FindDeep(BoxType::kBox_encv);
+    }
+    const Box* avcc_box = dash_session->parser_.FindDeep(BoxType::kBox_avcC);
+    if (!box || !avcc_box) {
+      DASH_LOG("Bad Dash Content.", "No avc1 or avcC", "");
+      return kDashToHlsStatus_BadDashContents;
+    }
+    const Avc1Contents* avc1 =
+        reinterpret_cast<const Avc1Contents*>(box->get_contents());
+    const AvcCContents* avcc =
+        reinterpret_cast<const AvcCContents*>(avcc_box->get_contents());
+    fmp4_out.set_video(avc1->get_width(), avc1->get_height(),
+                       avcc->GetNaluLength(),
+                       avcc->get_sequence_parameter_sets(),
+                       avcc->get_picture_parameter_sets());
+  } else {
+    box = dash_session->parser_.FindDeep(BoxType::kBox_mp4a);
+    if (!box) {
+      box = dash_session->parser_.FindDeep(BoxType::kBox_enca);
+      if (!box) {
+        DASH_LOG("Bad Dash Content.", "No mp4a", "");
+        return kDashToHlsStatus_BadDashContents;
+      }
+    }
+    const Mp4aContents* mp4a =
+        reinterpret_cast<const Mp4aContents*>(box->get_contents());
+    fmp4_out.set_audio(mp4a->get_channel_count(), mp4a->get_sample_size(),
+                       mp4a->get_sample_rate(), mp4a->get_audio_config());
+  }
+  if (dash_session->is_passthrough()) {
+    box = dash_session->parser_.FindDeep(BoxType::kBox_tenc);
+    if (box) {
+      const TencContents* tenc =
+          reinterpret_cast<const TencContents*>(box->get_contents());
+      fmp4_out.set_encryption(tenc->get_default_kid(),
+                              static_cast<uint8_t>(
+                                  tenc->get_default_iv_size()));
+      if (dash_session->is_cbcs()) {
+        // The pattern and constant IV of the source.
+        fmp4_out.set_cbcs(tenc->get_default_constant_iv(),
+                          tenc->get_default_constant_iv_size(),
+                          tenc->get_default_crypt_byte_block(),
+                          tenc->get_default_skip_byte_block());
+      }
+      const std::vector<const Box*> pssh_boxes =
+          dash_session->parser_.FindDeepAll(BoxType::kBox_pssh);
+      std::vector<std::vector<uint8_t> > pssh_data;
+      for (auto iter = pssh_boxes.begin(); iter != pssh_boxes.end(); ++iter) {
+        const PsshContents* pssh =
+            reinterpret_cast<const PsshContents*>((*iter)->get_contents());
+        pssh_data.push_back(pssh->get_full_box());
+      }
+      fmp4_out.set_pssh_boxes(pssh_data);
+    }
+  } else if (dash_session->output_format_ == kDashToHlsFormat_CbcsFmp4 &&
+             dash_session->parser_.FindDeep(BoxType::kBox_tenc)) {
+    const CbcsTranscrypter& transcrypter = dash_session->cbcs_transcrypter_;
+    if (!transcrypter.is_initialized()) {
+      DASH_LOG("Bad Configuration.", "Missing cbcs keys",
+               "See DashToHls_SetCbcsKeys.");
+      return kDashToHlsStatus_BadConfiguration;
+    }
+    fmp4_out.set_encryption(dash_session->cbcs_key_id_, 0);
+    fmp4_out.set_cbcs(transcrypter.get_cbcs_iv(), Fmp4Out::kConstantIvSize,
+                      transcrypter.get_crypt_byte_block(),
+                      transcrypter.get_skip_byte_block());
+  }
+  dash_session->init_segment_.clear();
+  if (!fmp4_out.WriteInitSegment(&dash_session->init_segment_)) {
+    return kDashToHlsStatus_BadDashContents;
+  }
+  *init_segment = dash_session->init_segment_.data();
+  *init_length = dash_session->init_segment_.size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCbcsKeys(DashToHlsSession* session,
+                      const uint8_t* cenc_key,
+                      const uint8_t* cbcs_key_id,
+                      const uint8_t* cbcs_key,
+                      const uint8_t* cbcs_iv) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->timescale_ == 0) {
+    DASH_LOG("cbcs keys too early.", "No moov has been parsed.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  // Video uses the 1:9 pattern, audio is encrypted in full.
+  dash_session->cbcs_transcrypter_.Init(
+      cenc_key, cbcs_key, cbcs_iv, kCbcsCryptByteBlock,
+      dash_session->is_video_ ? kCbcsVideoSkipByteBlock : 0);
+  memcpy(dash_session->cbcs_key_id_, cbcs_key_id,
+         sizeof(dash_session->cbcs_key_id_));
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetHlsEncryptionKey(DashToHlsSession* session,
+                              const uint8_t* key,
+                              const uint8_t* iv) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (!key) {
+    dash_session->hls_encrypter_ = HlsEncrypter();
+    return kDashToHlsStatus_OK;
+  }
+  if (!iv) {
+    DASH_LOG("Bad Configuration.", "Missing IV.",
+             "See DashToHls_SetHlsEncryptionKey.");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  dash_session->hls_encrypter_.Init(key, iv);
+  // Segments are encrypted one way or the other, never both.
+  DashToHls_SetSampleAesKey(session, nullptr, nullptr);
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetSampleAesKey(DashToHlsSession* session,
+                          const uint8_t* key,
+                          const uint8_t* iv) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (!key) {
+    dash_session->sample_aes_ = SampleAesEncrypter();
+  } else if (!iv) {
+    DASH_LOG("Bad Configuration.", "Missing IV.",
+             "See DashToHls_SetSampleAesKey.");
+    return kDashToHlsStatus_BadConfiguration;
+  } else {
+    dash_session->sample_aes_.Init(key, iv);
+    dash_session->hls_encrypter_ = HlsEncrypter();
+  }
+  const SampleAesEncrypter* encrypter = dash_session->get_sample_aes();
+  dash_session->adts_out_.set_sample_aes(encrypter);
+  dash_session->live_ts_out_.set_sample_aes(encrypter);
+  dash_session->single_file_ts_out_.set_sample_aes(encrypter);
+  dash_session->iframe_ts_out_.set_sample_aes(encrypter);
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetHlsKeyTag(DashToHlsSession* session,
+                       const char* uri,
+                       const char** tag,
+                       size_t* tag_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  std::string& key_tag = dash_session->hls_key_tag_;
+  const uint8_t* iv = nullptr;
+  if (dash_session->sample_aes_.is_initialized()) {
+    key_tag = "#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"";
+    iv = dash_session->sample_aes_.get_iv();
+  } else if (dash_session->hls_encrypter_.is_initialized()) {
+    key_tag = "#EXT-X-KEY:METHOD=AES-128,URI=\"";
+    iv = dash_session->hls_encrypter_.get_iv();
+  } else {
+    return kDashToHlsStatus_ClearContent;
+  }
+  key_tag += uri;
+  key_tag += "\",IV=0x";
+  key_tag += HexEncode(iv, Aes128::kBlockSize);
+  key_tag += "\n";
+  *tag = key_tag.c_str();
+  *tag_length = key_tag.size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetKeyTags(DashToHlsSession* session,
+                     DashToHlsKeyTag tag,
+                     const char** tags,
+                     size_t* tags_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  const std::vector<const Box*> pssh_boxes =
+      dash_session->parser_.FindDeepAll(BoxType::kBox_pssh);
+  if (pssh_boxes.empty()) {
+    return kDashToHlsStatus_ClearContent;
+  }
+  const uint8_t* key_id = dash_session->key_id_;
+  const Box* box = dash_session->parser_.FindDeep(BoxType::kBox_tenc);
+  if (box) {
+    key_id = reinterpret_cast<const TencContents*>(
+        box->get_contents())->get_default_kid();
+  }
+  // AES-CBC with a pattern, passed through or transcrypted, is SAMPLE-AES.
+  const char* method = "SAMPLE-AES-CTR";
+  if (dash_session->output_format_ == kDashToHlsFormat_CbcsFmp4) {
+    method = "SAMPLE-AES";
+    key_id = dash_session->cbcs_key_id_;
+  } else if (dash_session->is_cbcs()) {
+    method = "SAMPLE-AES";
+  }
+  std::string& key_tags = dash_session->key_tags_;
+  key_tags.clear();
+  for (auto iter = pssh_boxes.begin(); iter != pssh_boxes.end(); ++iter) {
+    const PsshContents* pssh =
+        reinterpret_cast<const PsshContents*>((*iter)->get_contents());
+    // The system id as a uuid, 8-4-4-4-12 hex digits.
+    std::string system_id = HexEncode(pssh->get_system_id(),
+                                      PsshContents::kSystemIdSize);
+    system_id.insert(20, "-");
+    system_id.insert(16, "-");
+    system_id.insert(12, "-");
+    system_id.insert(8, "-");
+    key_tags += tag == kDashToHlsKeyTag_SessionKey ? "#EXT-X-SESSION-KEY:" :
+        "#EXT-X-KEY:";
+    key_tags += "METHOD=";
+    key_tags += method;
+    key_tags += ",URI=\"data:text/plain;base64,";
+    key_tags += Base64Encode(pssh->get_full_box().data(),
+                             pssh->get_full_box().size());
+    key_tags += "\",KEYID=0x";
+    key_tags += HexEncode(key_id, TencContents::kKidSize);
+    key_tags += ",KEYFORMAT=\"urn:uuid:" + system_id;
+    key_tags += "\",KEYFORMATVERSIONS=\"1\"\n";
+  }
+  *tags = key_tags.c_str();
+  *tags_length = key_tags.size();
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_GetPartTag(DashToHlsSession* session,
+                     const char* uri,
+                     const char** tag,
+                     size_t* tag_length) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  if (dash_session->part_count_ == 0) {
+    DASH_LOG("Part tag unavailable.", "No part has been converted.", "");
+    return kDashToHlsStatus_NotEnoughParsed;
+  }
+  char duration[32];
+  snprintf(duration, sizeof(duration), "%.5f",
+           dash_session->last_part_.duration);
+  std::string& part_tag = dash_session->part_tag_;
+  part_tag = "#EXT-X-PART:DURATION=";
+  part_tag += duration;
+  part_tag += ",URI=\"";
+  part_tag += uri;
+  part_tag += "\"";
+  if (dash_session->last_part_.independent) {
+    part_tag += ",INDEPENDENT=YES";
+  }
+  part_tag += "\n";
+  *tag = part_tag.c_str();
+  *tag_length = part_tag.size();
   return kDashToHlsStatus_OK;
 }
 
@@ -926,7 +3393,7 @@ DashToHlsStatus DashToHls_ReleaseHlsSegment(DashToHlsSession* session,
                                             uint32_t hls_segment_number) {
   Session* dash_session = reinterpret_cast<Session*>(session);
   // Only way to reset capacity is to swap.
-  std::vector<uint8_t>().swap(dash_session->output_[hls_segment_number]);
+  ByteBuffer().swap(dash_session->output_[hls_segment_number]);
   return kDashToHlsStatus_OK;
 }
 
@@ -952,6 +3419,7 @@ DashToHlsStatus DashToHls_SetCenc_PsshHandler(DashToHlsSession* session,
   Session* dash_session = reinterpret_cast<Session*>(session);
   dash_session->pssh_handler_ = pssh_handler;
   dash_session->pssh_context_ = context;
+  dash_session->handled_pssh_.clear();
   return kDashToHlsStatus_OK;
 }
 
@@ -963,6 +3431,99 @@ DashToHls_SetCenc_DecryptSample(DashToHlsSession* session,
   Session* dash_session = reinterpret_cast<Session*>(session);
   dash_session->decryption_handler_ = decryption_handler;
   dash_session->decryption_context_ = context;
+  dash_session->use_sample_entries_ = use_sample_entries;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCenc_DecryptInPlace(
+    DashToHlsSession* session, DashToHlsContext context,
+    CENC_DecryptInPlaceHandler decrypt_in_place_handler) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  dash_session->decrypt_in_place_handler_ = decrypt_in_place_handler;
+  dash_session->decrypt_in_place_context_ = context;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCenc_DecryptFragment(
+    DashToHlsSession* session, DashToHlsContext context,
+    CENC_DecryptFragmentHandler decrypt_fragment_handler) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  dash_session->decrypt_fragment_handler_ = decrypt_fragment_handler;
+  dash_session->decrypt_fragment_context_ = context;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCenc_DecryptAsync(
+    DashToHlsSession* session, DashToHlsContext context,
+    CENC_DecryptAsyncHandler decrypt_async_handler, size_t max_in_flight) {
+  if (decrypt_async_handler && max_in_flight == 0) {
+    DASH_LOG("Bad Configuration.", "At least one sample has to be in flight.",
+             "");
+    return kDashToHlsStatus_BadConfiguration;
+  }
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  dash_session->decrypt_async_handler_ = decrypt_async_handler;
+  dash_session->decrypt_async_context_ = context;
+  dash_session->decrypt_async_limit_ =
+      decrypt_async_handler ? max_in_flight : 0;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_FinishDecryption(DashToHlsDecryption* decryption,
+                           DashToHlsStatus status) {
+  AsyncDecrypter::Complete(decryption, status);
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCenc_KeyContextHandler(
+    DashToHlsSession* session, DashToHlsContext context,
+    CENC_KeyContextHandler key_context_handler,
+    CENC_ReleaseKeyContextHandler release_key_context_handler) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  // The old contexts go back to the old handler.
+  dash_session->ClearDecryptionKeys();
+  dash_session->key_context_handler_ = key_context_handler;
+  dash_session->release_key_context_handler_ = release_key_context_handler;
+  dash_session->key_context_context_ = context;
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetCenc_ContentKey(DashToHlsSession* session,
+                             const uint8_t* key_id,
+                             const uint8_t* key) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  // The looked up keys point into content_keys_.
+  dash_session->ClearDecryptionKeys();
+  for (size_t count = 0; count < dash_session->content_keys_.size();
+       ++count) {
+    Session::ContentKey& content_key = dash_session->content_keys_[count];
+    if (memcmp(content_key.key_id, key_id, sizeof(content_key.key_id)) == 0) {
+      content_key.aes.SetKey(key);
+      return kDashToHlsStatus_OK;
+    }
+  }
+  Session::ContentKey content_key;
+  memcpy(content_key.key_id, key_id, sizeof(content_key.key_id));
+  content_key.aes.SetKey(key);
+  dash_session->content_keys_.push_back(content_key);
+  return kDashToHlsStatus_OK;
+}
+
+extern "C" DashToHlsStatus
+DashToHls_SetOutputSink(DashToHlsSession* session,
+                        DashToHlsContext context,
+                        HLS_OutputSink sink,
+                        size_t flush_size) {
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  dash_session->output_sink_ = sink;
+  dash_session->output_sink_context_ = context;
+  dash_session->output_sink_flush_size_ = flush_size;
   return kDashToHlsStatus_OK;
 }
 }  // namespace dash2hls
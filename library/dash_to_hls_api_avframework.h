@@ -17,16 +17,15 @@
 #ifndef DASHTOHLS_DASHTOHLS_API_AVFRAMEWORK_H_
 #define DASHTOHLS_DASHTOHLS_API_AVFRAMEWORK_H_
 
-#include <vector>
-
-struct DashToHlsSession;
+#include <stdint.h>
 
 namespace dash2hls {
   // Have we set up a key to cause reencryption?
   bool is_encrypting();
-  // Encrypt one segment with the global key or return false if encryption
-  // failed.
-  bool Encrypt(const DashToHlsSession* session, std::vector<uint8_t>* segment);
+  // Copies the global key and IV, 16 bytes each, for sessions without a key
+  // of their own, or returns false if there is none.  The segments are
+  // encrypted by the library.
+  bool GetEncryptionKey(uint8_t* key, uint8_t* iv);
 }  // namespace dash2hls
 
 #endif  // DASHTOHLS_DASHTOHLS_API_AVFRAMEWORK_H_
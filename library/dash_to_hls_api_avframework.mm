@@ -14,7 +14,6 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-#include "CommonCrypto/CommonCrypto.h"
 #include "Security/Security.h"
 
 #include "include/DashToHlsApiAVFramework.h"
@@ -154,29 +153,14 @@ bool is_encrypting() {
 #endif  // OEMCRYPTO_DYLIB
 }
 
-bool Encrypt(const DashToHlsSession* session, std::vector<uint8_t>* block) {
+bool GetEncryptionKey(uint8_t* key, uint8_t* iv) {
   if (s_key.empty()) {
-    NSLog(@"DashToHls_InitializeEncryption must be called before Encrypt");
+    NSLog(@"DashToHls_InitializeEncryption must be called before "
+          @"GetEncryptionKey");
     return false;
   }
-
-  std::vector<uint8_t> encrypted_data;
-  size_t encrypted_length = block->size() + kKeySize;
-  encrypted_data.resize(encrypted_length);
-  CCCryptorStatus status = CCCrypt(kCCEncrypt,
-                                   kCCAlgorithmAES128,
-                                   kCCOptionPKCS7Padding,
-                                   s_key.data(),
-                                   s_key.size(),
-                                   s_iv.data(),
-                                   block->data(),
-                                   block->size(),
-                                   encrypted_data.data(),
-                                   encrypted_length,
-                                   &encrypted_length);
-  encrypted_data.resize(encrypted_length);
-  block->resize(encrypted_length);
-  memcpy(block->data(), encrypted_data.data(), block->size());
+  memcpy(key, s_key.data(), kKeySize);
+  memcpy(iv, s_iv.data(), kKeySize);
   return true;
 }
 }  // namespace dash2hls
@@ -14,22 +14,34 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "include/DashToHlsApi.h"
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_decrypter.h"
 #include "library/dash/avcc_contents.h"
 #include "library/dash/box_type.h"
 #include "library/dash/dash_parser.h"
 #include "library/dash/mdat_contents.h"
+#include "library/dash/pssh_contents.h"
 #include "library/dash/saio_contents.h"
 #include "library/dash/saiz_contents.h"
+#include "library/dash/schm_contents.h"
+#include "library/dash/senc_contents.h"
+#include "library/dash/sgpd_contents.h"
 #include "library/dash/tenc_contents.h"
 #include "library/dash/tfdt_contents.h"
 #include "library/dash/tfhd_contents.h"
 #include "library/dash/trex_contents.h"
 #include "library/dash/trun_contents.h"
 #include "library/dash_to_hls_session.h"
+#include "library/fmp4/fmp4_out.h"
 #include "library/mac_test_files.h"
 #include "library/utilities.h"
 #include "library/utilities_gmock.h"
@@ -173,6 +185,2093 @@ TEST(DashToHlsApi, ParseAudioDash) {
   EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
 }
 
+namespace {
+struct SinkContext {
+  SinkContext() : calls(0), refuse(0) {}
+  std::vector<uint8_t> received;
+  size_t calls;
+  size_t refuse;
+};
+
+DashToHlsStatus OutputSink(DashToHlsContext context, const uint8_t* data,
+                           size_t length) {
+  SinkContext* sink = reinterpret_cast<SinkContext*>(context);
+  ++sink->calls;
+  if (sink->refuse > 0) {
+    --sink->refuse;
+    return kDashToHlsStatus_Backpressure;
+  }
+  EXPECT_EQ(0, length % 188);
+  sink->received.insert(sink->received.end(), data, data + length);
+  return kDashToHlsStatus_OK;
+}
+
+// Converts the first segment of the test video, streaming through |sink|
+// when it is not nullptr.
+void ConvertFirstVideoSegment(SinkContext* sink, size_t flush_size,
+                              std::vector<uint8_t>* hls_output) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  if (sink) {
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_SetOutputSink(session, sink, OutputSink, flush_size));
+  }
+  FILE* file = Dash2HLS_GetTestVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  ASSERT_EQ(kDashHeaderRead, bytes_read);
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(session, buffer, bytes_read, &index));
+  std::vector<uint8_t> dash_buffer(index->segments[0].length);
+  fseek(file, index->segments[0].location, SEEK_SET);
+  bytes_read = fread(&dash_buffer[0], 1, dash_buffer.size(), file);
+  fclose(file);
+  ASSERT_EQ(dash_buffer.size(), bytes_read);
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                         dash_buffer.size(), &hls_segment,
+                                         &hls_length));
+  hls_output->assign(hls_segment, hls_segment + hls_length);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+}  // namespace
+
+TEST(DashToHlsApi, OutputSink) {
+  std::vector<uint8_t> expected;
+  ConvertFirstVideoSegment(nullptr, 0, &expected);
+  ASSERT_FALSE(expected.empty());
+
+  SinkContext sink;
+  std::vector<uint8_t> leftover;
+  ConvertFirstVideoSegment(&sink, 188 * 7, &leftover);
+  EXPECT_TRUE(leftover.empty());
+  EXPECT_LT(1, sink.calls);
+  EXPECT_EQ(expected, sink.received);
+}
+
+TEST(DashToHlsApi, OutputSinkBackpressure) {
+  std::vector<uint8_t> expected;
+  ConvertFirstVideoSegment(nullptr, 0, &expected);
+
+  // Refused data is offered again on the next flush.
+  SinkContext sink;
+  sink.refuse = 3;
+  std::vector<uint8_t> leftover;
+  ConvertFirstVideoSegment(&sink, 0, &leftover);
+  EXPECT_TRUE(leftover.empty());
+  EXPECT_EQ(expected, sink.received);
+
+  // Data still refused at the end of the segment is returned to the caller.
+  SinkContext full_sink;
+  full_sink.refuse = static_cast<size_t>(-1);
+  ConvertFirstVideoSegment(&full_sink, 0, &leftover);
+  EXPECT_TRUE(full_sink.received.empty());
+  EXPECT_EQ(expected, leftover);
+}
+
+namespace {
+// Parses |file| with a new |session| and reads its first segment.
+void ReadFirstSegment(FILE* file, DashToHlsSession** session,
+                      std::vector<uint8_t>* dash_buffer) {
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(session));
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  ASSERT_EQ(kDashHeaderRead, bytes_read);
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(*session, buffer, bytes_read, &index));
+  dash_buffer->resize(index->segments[0].length);
+  fseek(file, index->segments[0].location, SEEK_SET);
+  bytes_read = fread(&(*dash_buffer)[0], 1, dash_buffer->size(), file);
+  fclose(file);
+  ASSERT_EQ(dash_buffer->size(), bytes_read);
+}
+
+// Returns the TS payload of the packets on |pid|, checking the continuity
+// counters on the way.
+std::vector<uint8_t> ExtractPid(const uint8_t* ts, size_t length,
+                                uint16_t pid) {
+  std::vector<uint8_t> payload;
+  int continuity_counter = -1;
+  for (size_t packet = 0; packet + 188 <= length; packet += 188) {
+    EXPECT_EQ(0x47, ts[packet]);
+    if ((ntohsFromBuffer(&ts[packet + 1]) & 0x1fff) != pid) {
+      continue;
+    }
+    if (continuity_counter >= 0) {
+      EXPECT_EQ((continuity_counter + 1) & 0x0f, ts[packet + 3] & 0x0f);
+    }
+    continuity_counter = ts[packet + 3] & 0x0f;
+    size_t start = packet + 4;
+    if (ts[packet + 3] & 0x20) {
+      start += ts[packet + 4] + 1;
+    }
+    payload.insert(payload.end(), ts + start, ts + packet + 188);
+  }
+  return payload;
+}
+}  // namespace
+
+TEST(DashToHlsApi, ConvertMuxedSegment) {
+  DashToHlsSession* video_session = nullptr;
+  std::vector<uint8_t> video_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &video_session,
+                   &video_buffer);
+  DashToHlsSession* audio_session = nullptr;
+  std::vector<uint8_t> audio_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestAudioFile(), &audio_session,
+                   &audio_buffer);
+
+  // Sessions passed the wrong way around.
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_ConvertMuxedSegment(audio_session, 0, &audio_buffer[0],
+                                          audio_buffer.size(), video_session,
+                                          0, &video_buffer[0],
+                                          video_buffer.size(), &hls_segment,
+                                          &hls_length));
+  // Either segment cut short.
+  EXPECT_EQ(kDashToHlsStatus_NeedMoreData,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size() - 1,
+                                          audio_session, 0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  EXPECT_EQ(kDashToHlsStatus_NeedMoreData,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size() - 1,
+                                          &hls_segment, &hls_length));
+
+  // The video PES packets are the same ones the video only segment has.
+  const uint8_t* video_segment = nullptr;
+  size_t video_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &video_segment,
+                                         &video_length));
+  std::vector<uint8_t> expected_video =
+      ExtractPid(video_segment, video_length, 0x21);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  ASSERT_EQ(0, hls_length % 188);
+  ASSERT_LT(188 * 2, hls_length);
+  // PAT then the single PMT listing both streams with the PCR on video.
+  EXPECT_EQ(0x00, ntohsFromBuffer(&hls_segment[1]) & 0x1fff);
+  EXPECT_EQ(0x20, ntohsFromBuffer(&hls_segment[188 + 1]) & 0x1fff);
+  std::vector<uint8_t> pmt_payload =
+      ExtractPid(&hls_segment[188], 188, 0x20);
+  // Skip the pointer field.
+  const uint8_t* pmt = &pmt_payload[1];
+  size_t section_length = ntohsFromBuffer(&pmt[1]) & 0x0fff;
+  EXPECT_EQ(0x21, ntohsFromBuffer(&pmt[8]) & 0x1fff);
+  size_t program_info_length = ntohsFromBuffer(&pmt[10]) & 0x0fff;
+  const uint8_t* streams = &pmt[12 + program_info_length];
+  EXPECT_EQ(0x1b, streams[0]);
+  EXPECT_EQ(0x21, ntohsFromBuffer(&streams[1]) & 0x1fff);
+  EXPECT_EQ(0x0f, streams[5]);
+  EXPECT_EQ(0x22, ntohsFromBuffer(&streams[6]) & 0x1fff);
+  EXPECT_EQ(section_length, 9 + program_info_length + 10 + 4);
+
+  EXPECT_EQ(expected_video, ExtractPid(hls_segment, hls_length, 0x21));
+  std::vector<uint8_t> audio = ExtractPid(hls_segment, hls_length, 0x22);
+  ASSERT_LT(9u, audio.size());
+  EXPECT_EQ(0xc0, audio[3]);
+  // Every ADTS frame of the audio only segment is in the muxed one.
+  const uint8_t* audio_segment = nullptr;
+  size_t audio_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(audio_session, 0, &audio_buffer[0],
+                                         audio_buffer.size(), &audio_segment,
+                                         &audio_length));
+  size_t adts_frames = 0;
+  for (size_t count = 0; count + 1 < audio_length; ++count) {
+    if (audio_segment[count] == 0xff && (audio_segment[count + 1] & 0xf6) ==
+        0xf0) {
+      ++adts_frames;
+    }
+  }
+  size_t muxed_frames = 0;
+  for (size_t count = 0; count + 1 < audio.size(); ++count) {
+    if (audio[count] == 0xff && (audio[count + 1] & 0xf6) == 0xf0) {
+      ++muxed_frames;
+    }
+  }
+  EXPECT_EQ(adts_frames, muxed_frames);
+
+  // Data the sink refused is offered again with the next segment.
+  std::vector<uint8_t> muxed(hls_segment, hls_segment + hls_length);
+  SinkContext sink;
+  sink.refuse = 1;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputSink(video_session, &sink, OutputSink, 0));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  EXPECT_EQ(muxed.size() * 2, hls_length);
+  EXPECT_TRUE(sink.received.empty());
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  EXPECT_EQ(0u, hls_length);
+  EXPECT_EQ(muxed.size() * 3, sink.received.size());
+
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(video_session));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(audio_session));
+}
+
+namespace {
+// Decrypts an AES-128 HLS segment and strips the PKCS7 padding.
+std::vector<uint8_t> DecryptHlsSegment(const uint8_t* key, const uint8_t* iv,
+                                       const uint8_t* segment,
+                                       size_t length) {
+  EXPECT_EQ(0u, length % 16);
+  std::vector<uint8_t> clear(segment, segment + length);
+  if (clear.empty()) {
+    return clear;
+  }
+  Aes128 aes;
+  aes.SetKey(key);
+  // A skip of 0 is plain CBC.
+  CbcsDecrypter decrypter(aes, iv, 16, 1, 0);
+  decrypter.DecryptRange(&clear[0], clear.size());
+  uint8_t padding = clear.back();
+  EXPECT_LT(0, padding);
+  EXPECT_GE(16, padding);
+  for (size_t count = clear.size() - padding; count < clear.size();
+       ++count) {
+    EXPECT_EQ(padding, clear[count]);
+  }
+  clear.resize(clear.size() - padding);
+  return clear;
+}
+}  // namespace
+
+TEST(DashToHlsApi, HlsEncryptionKey) {
+  const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                          0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+  const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                         0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  DashToHlsSession* video_session = nullptr;
+  std::vector<uint8_t> video_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &video_session,
+                   &video_buffer);
+  DashToHlsSession* audio_session = nullptr;
+  std::vector<uint8_t> audio_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestAudioFile(), &audio_session,
+                   &audio_buffer);
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  std::vector<uint8_t> expected(hls_segment, hls_segment + hls_length);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  std::vector<uint8_t> expected_muxed(hls_segment, hls_segment + hls_length);
+
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_SetHlsEncryptionKey(video_session, kKey, nullptr));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetHlsEncryptionKey(video_session, kKey, kIv));
+  // Converting the same segment twice gives the same output, every segment
+  // starts from the IV.
+  for (int pass = 0; pass < 2; ++pass) {
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                           video_buffer.size(), &hls_segment,
+                                           &hls_length));
+    EXPECT_EQ((expected.size() / 16 + 1) * 16, hls_length);
+    EXPECT_NE(0x47, hls_segment[0]);
+    EXPECT_EQ(expected,
+              DecryptHlsSegment(kKey, kIv, hls_segment, hls_length));
+  }
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertMuxedSegment(video_session, 0, &video_buffer[0],
+                                          video_buffer.size(), audio_session,
+                                          0, &audio_buffer[0],
+                                          audio_buffer.size(), &hls_segment,
+                                          &hls_length));
+  EXPECT_EQ(expected_muxed,
+            DecryptHlsSegment(kKey, kIv, hls_segment, hls_length));
+
+  // The key is per session, packed audio still starts with its ID3 tag.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(audio_session, 0, &audio_buffer[0],
+                                         audio_buffer.size(), &hls_segment,
+                                         &hls_length));
+  ASSERT_LT(3u, hls_length);
+  EXPECT_EQ(0, memcmp("ID3", hls_segment, 3));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetHlsEncryptionKey(video_session, nullptr, nullptr));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  EXPECT_EQ(expected,
+            std::vector<uint8_t>(hls_segment, hls_segment + hls_length));
+
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(video_session));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(audio_session));
+}
+
+TEST(DashToHlsApi, SampleAesKey) {
+  const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                          0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+  const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                         0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  DashToHlsSession* video_session = nullptr;
+  std::vector<uint8_t> video_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &video_session,
+                   &video_buffer);
+  DashToHlsSession* audio_session = nullptr;
+  std::vector<uint8_t> audio_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestAudioFile(), &audio_session,
+                   &audio_buffer);
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  const char* tag = nullptr;
+  size_t tag_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_GetHlsKeyTag(video_session, "skd://key", &tag,
+                                   &tag_length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  std::vector<uint8_t> expected(hls_segment, hls_segment + hls_length);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(audio_session, 0, &audio_buffer[0],
+                                         audio_buffer.size(), &hls_segment,
+                                         &hls_length));
+  size_t expected_audio_length = hls_length;
+
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_SetSampleAesKey(video_session, kKey, nullptr));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetHlsEncryptionKey(video_session, kKey, kIv));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetSampleAesKey(video_session, kKey, kIv));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetHlsKeyTag(video_session, "skd://key", &tag,
+                                   &tag_length));
+  EXPECT_EQ("#EXT-X-KEY:METHOD=SAMPLE-AES,URI=\"skd://key\","
+            "IV=0x000102030405060708090a0b0c0d0e0f\n",
+            std::string(tag, tag_length));
+
+  // Still a TS, with the SAMPLE-AES stream type in the PMT.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  ASSERT_LT(188u * 2, hls_length);
+  EXPECT_EQ(0u, hls_length % 188);
+  EXPECT_EQ(0x47, hls_segment[0]);
+  const uint8_t* pmt = hls_segment + 188;
+  EXPECT_TRUE(memchr(pmt, 0xdb, 188) != nullptr);
+  EXPECT_NE(expected,
+            std::vector<uint8_t>(hls_segment, hls_segment + hls_length));
+
+  // So is the I-frame file.
+  const uint8_t* iframes = nullptr;
+  size_t iframes_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_AppendIFrames(video_session, 0, &video_buffer[0],
+                                    video_buffer.size(), &iframes,
+                                    &iframes_length));
+  ASSERT_LT(188u * 2, iframes_length);
+  EXPECT_EQ(0x47, iframes[0]);
+  EXPECT_TRUE(memchr(iframes + 188, 0xdb, 188) != nullptr);
+
+  // Packed audio grows by the audio description in its ID3 tag.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetSampleAesKey(audio_session, kKey, kIv));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(audio_session, 0, &audio_buffer[0],
+                                         audio_buffer.size(), &hls_segment,
+                                         &hls_length));
+  EXPECT_EQ(expected_audio_length + 57, hls_length);
+  EXPECT_EQ(0, memcmp("ID3", hls_segment, 3));
+
+  // Only TS output can be SAMPLE-AES.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(video_session,
+                                      kDashToHlsFormat_ProgramStream));
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(video_session,
+                                      kDashToHlsFormat_TransportStream));
+
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetSampleAesKey(video_session, nullptr, nullptr));
+  EXPECT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_GetHlsKeyTag(video_session, "skd://key", &tag,
+                                   &tag_length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(video_session, 0, &video_buffer[0],
+                                         video_buffer.size(), &hls_segment,
+                                         &hls_length));
+  EXPECT_EQ(expected,
+            std::vector<uint8_t>(hls_segment, hls_segment + hls_length));
+
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(video_session));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(audio_session));
+}
+
+TEST(DashToHlsApi, ConvertFmp4Segment) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  const uint8_t* init_segment = nullptr;
+  size_t init_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_NotEnoughParsed,
+            DashToHls_GetInitSegment(session, &init_segment, &init_length));
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_Last));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+
+  std::vector<uint8_t> dash_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &session, &dash_buffer);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_Fmp4));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetInitSegment(session, &init_segment, &init_length));
+  DashParser init_parser;
+  ASSERT_EQ(init_length, init_parser.Parse(init_segment, init_length));
+  EXPECT_NE(nullptr, init_parser.Find(BoxType::kBox_ftyp));
+  const Box* box = init_parser.FindDeep(BoxType::kBox_avcC);
+  ASSERT_NE(nullptr, box);
+  std::vector<uint8_t> sps_pps;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            internal::ProcessAvcc(
+                reinterpret_cast<const AvcCContents*>(box->get_contents()),
+                &sps_pps));
+  EXPECT_EQ(reinterpret_cast<Session*>(session)->sps_pps_, sps_pps);
+
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                         dash_buffer.size(), &hls_segment,
+                                         &hls_length));
+  DashParser dash_parser;
+  dash_parser.Parse(&dash_buffer[0], dash_buffer.size());
+  DashParser hls_parser;
+  ASSERT_EQ(hls_length, hls_parser.Parse(hls_segment, hls_length));
+  EXPECT_EQ(nullptr, hls_parser.FindDeep(BoxType::kBox_saio));
+  EXPECT_EQ(nullptr, hls_parser.FindDeep(BoxType::kBox_saiz));
+  const std::vector<const Box*> dash_truns =
+      dash_parser.FindDeepAll(BoxType::kBox_trun);
+  const std::vector<const Box*> hls_truns =
+      hls_parser.FindDeepAll(BoxType::kBox_trun);
+  const std::vector<const Box*> dash_tfdts =
+      dash_parser.FindDeepAll(BoxType::kBox_tfdt);
+  const std::vector<const Box*> hls_tfdts =
+      hls_parser.FindDeepAll(BoxType::kBox_tfdt);
+  const std::vector<const Box*> hls_mdats =
+      hls_parser.FindDeepAll(BoxType::kBox_mdat);
+  ASSERT_LT(0u, dash_truns.size());
+  ASSERT_EQ(dash_truns.size(), hls_truns.size());
+  ASSERT_EQ(dash_truns.size(), hls_tfdts.size());
+  ASSERT_EQ(dash_truns.size(), hls_mdats.size());
+  for (size_t count = 0; count < dash_truns.size(); ++count) {
+    const TrunContents* dash_trun =
+        reinterpret_cast<const TrunContents*>(dash_truns[count]->
+                                              get_contents());
+    const TrunContents* hls_trun =
+        reinterpret_cast<const TrunContents*>(hls_truns[count]->
+                                              get_contents());
+    ASSERT_EQ(dash_trun->get_track_runs().size(),
+              hls_trun->get_track_runs().size());
+    size_t payload = 0;
+    for (size_t sample = 0; sample < dash_trun->get_track_runs().size();
+         ++sample) {
+      EXPECT_EQ(dash_trun->get_track_runs()[sample].sample_size_,
+                hls_trun->get_track_runs()[sample].sample_size_);
+      payload += dash_trun->get_track_runs()[sample].sample_size_;
+    }
+    EXPECT_EQ(reinterpret_cast<const TfdtContents*>(
+                  dash_tfdts[count]->get_contents())->
+              get_base_media_decode_time(),
+              reinterpret_cast<const TfdtContents*>(
+                  hls_tfdts[count]->get_contents())->
+              get_base_media_decode_time());
+    EXPECT_EQ(payload, reinterpret_cast<const MdatContents*>(
+        hls_mdats[count]->get_contents())->get_raw_data_length());
+  }
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+namespace {
+// Returns the mfhd sequence numbers of the moofs in an fmp4 segment.
+std::vector<uint32_t> GetSequenceNumbers(const uint8_t* segment,
+                                         size_t length) {
+  // The mfhd is the first box in the moof.
+  const size_t kSequenceNumberOffset = 8 + 8 + 4;
+  std::vector<uint32_t> sequence_numbers;
+  size_t position = 0;
+  while (position + 8 <= length) {
+    size_t size = ntohlFromBuffer(segment + position);
+    if (size < 8 || size > length - position) {
+      ADD_FAILURE() << "Bad box size " << size;
+      break;
+    }
+    if (memcmp(segment + position + 4, "moof", 4) == 0 &&
+        size >= kSequenceNumberOffset + sizeof(uint32_t)) {
+      sequence_numbers.push_back(
+          ntohlFromBuffer(segment + position + kSequenceNumberOffset));
+    }
+    position += size;
+  }
+  return sequence_numbers;
+}
+}  // namespace
+
+TEST(DashToHlsApi, ConvertMultipleFragmentSegment) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  FILE* file = Dash2HLS_GetTestVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  ASSERT_EQ(kDashHeaderRead, bytes_read);
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(session, buffer, bytes_read, &index));
+  // The first two segments read as one segment of two moof/mdats.
+  ASSERT_LT(1u, index->index_count);
+  DashToHlsSegment segment = index->segments[0];
+  ASSERT_EQ(segment.location + segment.length, index->segments[1].location);
+  segment.length += index->segments[1].length;
+  std::vector<uint8_t> dash_buffer(segment.length);
+  fseek(file, segment.location, SEEK_SET);
+  bytes_read = fread(&dash_buffer[0], 1, dash_buffer.size(), file);
+  fclose(file);
+  ASSERT_EQ(dash_buffer.size(), bytes_read);
+
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  std::vector<uint8_t> expected_video;
+  for (uint32_t segment_number = 0; segment_number < 2; ++segment_number) {
+    const DashToHlsSegment& one_segment = index->segments[segment_number];
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(
+                  session, segment_number,
+                  &dash_buffer[one_segment.location - segment.location],
+                  one_segment.length, &hls_segment, &hls_length));
+    std::vector<uint8_t> video = ExtractPid(hls_segment, hls_length, 0x21);
+    expected_video.insert(expected_video.end(), video.begin(), video.end());
+  }
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  const DashToHlsSegment* segments = dash_session->index_.segments;
+  dash_session->index_.segments = &segment;
+
+  // Both fragments, with the continuity counters running on.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                         dash_buffer.size(), &hls_segment,
+                                         &hls_length));
+  EXPECT_EQ(0u, hls_length % 188);
+  EXPECT_EQ(expected_video, ExtractPid(hls_segment, hls_length, 0x21));
+
+  // The sequence numbers keep increasing when a segment is converted again.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_Fmp4));
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                           dash_buffer.size(), &hls_segment,
+                                           &hls_length));
+    std::vector<uint32_t> sequence_numbers =
+        GetSequenceNumbers(hls_segment, hls_length);
+    ASSERT_EQ(2u, sequence_numbers.size());
+    EXPECT_EQ(pass * 2 + 1, sequence_numbers[0]);
+    EXPECT_EQ(pass * 2 + 2, sequence_numbers[1]);
+  }
+  dash_session->index_.segments = segments;
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+namespace {
+// Counts the packs in a program stream holding one PES per pack, and the
+// ones with a system header.  Returns false if |data| is not one.
+bool CountProgramStreamPacks(const uint8_t* data, size_t length,
+                             uint8_t stream_id, size_t* packs,
+                             size_t* sync_packs) {
+  const uint8_t kStartCode[] = {0x00, 0x00, 0x01};
+  const size_t kPackHeaderSize = 14;
+  const size_t kStartCodeAndLength = 6;
+  *packs = 0;
+  *sync_packs = 0;
+  size_t position = 0;
+  while (position < length) {
+    if (length - position < kPackHeaderSize ||
+        memcmp(data + position, kStartCode, sizeof(kStartCode)) != 0 ||
+        data[position + 3] != 0xba) {
+      return false;
+    }
+    position += kPackHeaderSize;
+    bool has_pes = false;
+    while (!has_pes) {
+      if (length - position < kStartCodeAndLength ||
+          memcmp(data + position, kStartCode, sizeof(kStartCode)) != 0) {
+        return false;
+      }
+      uint8_t id = data[position + 3];
+      size_t size = ntohsFromBuffer(data + position + 4);
+      if (id == 0xbb) {
+        ++*sync_packs;
+      } else if (id == stream_id) {
+        has_pes = true;
+      } else if (id != 0xbc) {
+        return false;
+      }
+      position += kStartCodeAndLength + size;
+    }
+    ++*packs;
+  }
+  return position == length;
+}
+}  // namespace
+
+TEST(DashToHlsApi, ConvertProgramStreamSegment) {
+  FILE* files[] = {Dash2HLS_GetTestVideoFile(),
+                   Dash2HLS_GetTestAudioFile()};
+  const uint8_t stream_ids[] = {0xe0, 0xc0};
+  for (size_t file = 0; file < 2; ++file) {
+    DashToHlsSession* session = nullptr;
+    std::vector<uint8_t> dash_buffer;
+    ReadFirstSegment(files[file], &session, &dash_buffer);
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_SetOutputFormat(session,
+                                        kDashToHlsFormat_ProgramStream));
+    const uint8_t* hls_segment = nullptr;
+    size_t hls_length = 0;
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                           dash_buffer.size(), &hls_segment,
+                                           &hls_length));
+
+    DashParser dash_parser;
+    dash_parser.Parse(&dash_buffer[0], dash_buffer.size());
+    const std::vector<const Box*> dash_truns =
+        dash_parser.FindDeepAll(BoxType::kBox_trun);
+    size_t samples = 0;
+    for (size_t count = 0; count < dash_truns.size(); ++count) {
+      samples += reinterpret_cast<const TrunContents*>(
+          dash_truns[count]->get_contents())->get_track_runs().size();
+    }
+    size_t packs = 0;
+    size_t sync_packs = 0;
+    ASSERT_TRUE(CountProgramStreamPacks(hls_segment, hls_length,
+                                        stream_ids[file], &packs,
+                                        &sync_packs));
+    EXPECT_EQ(samples, packs);
+    EXPECT_EQ(dash_truns.size(), sync_packs);
+    EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+  }
+}
+
+TEST(DashToHlsApi, ConvertLiveChunk) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  const uint8_t* hls_part = nullptr;
+  size_t hls_length = 0;
+  DashToHlsPart part;
+  const char* tag = nullptr;
+  size_t tag_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_NotEnoughParsed,
+            DashToHls_GetPartTag(session, "part0.ts", &tag, &tag_length));
+
+  FILE* file = Dash2HLS_GetTestVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  ASSERT_EQ(kDashHeaderRead, fread(buffer, 1, kDashHeaderRead, file));
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(session, buffer, kDashHeaderRead, &index));
+  ASSERT_LE(2u, index->index_count);
+  std::vector<uint8_t> chunks[2];
+  for (size_t count = 0; count < 2; ++count) {
+    chunks[count].resize(index->segments[count].length);
+    fseek(file, index->segments[count].location, SEEK_SET);
+    ASSERT_EQ(chunks[count].size(),
+              fread(&chunks[count][0], 1, chunks[count].size(), file));
+  }
+  fclose(file);
+
+  // The first part is what the whole segment converts to.
+  DashToHlsSession* segment_session = nullptr;
+  std::vector<uint8_t> dash_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &segment_session,
+                   &dash_buffer);
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_segment_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(segment_session, 0, &dash_buffer[0],
+                                         dash_buffer.size(), &hls_segment,
+                                         &hls_segment_length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertLiveChunk(session, &chunks[0][0],
+                                       chunks[0].size(), &hls_part,
+                                       &hls_length, &part));
+  EXPECT_THAT(std::make_pair(hls_part, hls_length),
+              testing::MemEq(hls_segment, hls_segment_length));
+  EXPECT_EQ(1, part.independent);
+  EXPECT_LT(0.0, part.duration);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(segment_session));
+
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetPartTag(session, "part0.ts", &tag, &tag_length));
+  char expected_tag[128];
+  snprintf(expected_tag, sizeof(expected_tag),
+           "#EXT-X-PART:DURATION=%.5f,URI=\"part0.ts\",INDEPENDENT=YES\n",
+           part.duration);
+  EXPECT_EQ(std::string(expected_tag), std::string(tag, tag_length));
+
+  // The continuity counters carry on into the next part.
+  std::vector<uint8_t> parts(hls_part, hls_part + hls_length);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertLiveChunk(session, &chunks[1][0],
+                                       chunks[1].size(), &hls_part,
+                                       &hls_length, &part));
+  EXPECT_LT(0u, hls_length);
+  parts.insert(parts.end(), hls_part, hls_part + hls_length);
+  EXPECT_LT(0u, ExtractPid(&parts[0], parts.size(), 0x00).size());
+  EXPECT_LT(0u, ExtractPid(&parts[0], parts.size(), 0x21).size());
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+TEST(DashToHlsApi, ConvertPlannedSegment) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  FILE* file = Dash2HLS_GetTestVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  ASSERT_EQ(kDashHeaderRead, fread(buffer, 1, kDashHeaderRead, file));
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(session, buffer, kDashHeaderRead, &index));
+  ASSERT_LE(3u, index->index_count);
+  // The first two segments, back to back as in the file.
+  std::vector<uint8_t> dash_segments(index->segments[1].location +
+                                     index->segments[1].length -
+                                     index->segments[0].location);
+  fseek(file, index->segments[0].location, SEEK_SET);
+  ASSERT_EQ(dash_segments.size(),
+            fread(&dash_segments[0], 1, dash_segments.size(), file));
+  fclose(file);
+  double segment_duration =
+      static_cast<double>(index->segments[0].duration) /
+      index->segments[0].timescale;
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+
+  // Twice the DASH duration stitches the first two segments into one with
+  // the continuity counters running on.
+  DashToHlsPlan* plan = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_PlanSegments(session, segment_duration * 2, &plan));
+  ASSERT_LE(1u, plan->segment_count);
+  EXPECT_EQ(0u, plan->segments[0].first_dash_segment);
+  EXPECT_EQ(1u, plan->segments[0].last_dash_segment);
+  EXPECT_EQ(dash_segments.size(), plan->segments[0].length);
+  EXPECT_EQ(kDashToHlsStatus_NeedMoreData,
+            DashToHls_ConvertPlannedSegment(session, 0, &dash_segments[0],
+                                            index->segments[0].length,
+                                            &hls_segment, &hls_length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertPlannedSegment(session, 0, &dash_segments[0],
+                                            dash_segments.size(),
+                                            &hls_segment, &hls_length));
+  std::vector<uint8_t> video = ExtractPid(hls_segment, hls_length, 0x21);
+  EXPECT_LT(dash_segments.size() / 2, video.size());
+
+  // Half the DASH duration splits the first segment at its second sync
+  // sample, the next planned segment starts there with its own PAT.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_AddSegmentToPlan(session, 0, &dash_segments[0],
+                                       index->segments[0].length));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_PlanSegments(session, segment_duration / 2, &plan));
+  ASSERT_LE(3u, plan->segment_count);
+  EXPECT_EQ(0u, plan->segments[0].last_dash_segment);
+  EXPECT_EQ(0u, plan->segments[1].first_dash_segment);
+  EXPECT_EQ(index->segments[0].duration,
+            plan->segments[0].duration + plan->segments[1].duration);
+  EXPECT_EQ(index->segments[1].start_time, plan->segments[2].start_time);
+  size_t split_length = 0;
+  for (uint32_t count = 0; count < 2; ++count) {
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertPlannedSegment(session, count,
+                                              &dash_segments[0],
+                                              dash_segments.size(),
+                                              &hls_segment, &hls_length));
+    ASSERT_LT(0u, hls_length);
+    EXPECT_EQ(0, ntohsFromBuffer(hls_segment + 1) & 0x1fff);
+    split_length += ExtractPid(hls_segment, hls_length, 0x21).size();
+  }
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(session, 0, &dash_segments[0],
+                                         index->segments[0].length,
+                                         &hls_segment, &hls_length));
+  EXPECT_LT(ExtractPid(hls_segment, hls_length, 0x21).size(), split_length);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+TEST(DashToHlsApi, AppendToSingleFile) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  FILE* file = Dash2HLS_GetTestVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  ASSERT_EQ(kDashHeaderRead, fread(buffer, 1, kDashHeaderRead, file));
+  DashToHlsIndex* index;
+  ASSERT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_ParseDash(session, buffer, kDashHeaderRead, &index));
+  const char* playlist = nullptr;
+  size_t playlist_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_NotEnoughParsed,
+            DashToHls_GetByteRangePlaylist(session, "title.ts", &playlist,
+                                           &playlist_length));
+
+  std::vector<uint8_t> single_file;
+  std::vector<uint8_t> dash_segment;
+  const uint8_t* hls_data = nullptr;
+  size_t hls_length = 0;
+  for (uint32_t count = 0; count < index->index_count; ++count) {
+    dash_segment.resize(index->segments[count].length);
+    fseek(file, index->segments[count].location, SEEK_SET);
+    ASSERT_EQ(dash_segment.size(),
+              fread(&dash_segment[0], 1, dash_segment.size(), file));
+    if (count == 1) {
+      // Segments go in order.
+      EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+                DashToHls_AppendToSingleFile(session, 2, &dash_segment[0],
+                                             dash_segment.size(), &hls_data,
+                                             &hls_length));
+    }
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_AppendToSingleFile(session, count, &dash_segment[0],
+                                           dash_segment.size(), &hls_data,
+                                           &hls_length));
+    single_file.insert(single_file.end(), hls_data, hls_data + hls_length);
+  }
+  fclose(file);
+  // The continuity counters run through the whole file.
+  EXPECT_LT(0u, ExtractPid(&single_file[0], single_file.size(), 0x21).size());
+
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetByteRangePlaylist(session, "title.ts", &playlist,
+                                           &playlist_length));
+  std::string text(playlist, playlist_length);
+  EXPECT_EQ(0u, text.find("#EXTM3U\n#EXT-X-VERSION:4\n"));
+  EXPECT_NE(std::string::npos, text.find("#EXT-X-PLAYLIST-TYPE:VOD\n"));
+  EXPECT_EQ(text.size() - strlen("#EXT-X-ENDLIST\n"),
+            text.find("#EXT-X-ENDLIST\n"));
+  // The byte ranges tile the file.
+  uint64_t offset = 0;
+  size_t position = 0;
+  for (uint32_t count = 0; count < index->index_count; ++count) {
+    position = text.find("#EXT-X-BYTERANGE:", position);
+    ASSERT_NE(std::string::npos, position);
+    unsigned long long length = 0;
+    unsigned long long location = 0;
+    ASSERT_EQ(2, sscanf(text.c_str() + position,
+                        "#EXT-X-BYTERANGE:%llu@%llu", &length, &location));
+    EXPECT_EQ(offset, location);
+    EXPECT_EQ(0x47, single_file[location]);
+    offset += length;
+    ++position;
+  }
+  EXPECT_EQ(single_file.size(), offset);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+TEST(DashToHlsApi, AppendIFrames) {
+  DashToHlsSession* session = nullptr;
+  std::vector<uint8_t> dash_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &session, &dash_buffer);
+  const char* playlist = nullptr;
+  size_t playlist_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_NotEnoughParsed,
+            DashToHls_GetIFramePlaylist(session, "iframes.ts", &playlist,
+                                        &playlist_length));
+  const uint8_t* hls_data = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_AppendIFrames(session, 0, &dash_buffer[0],
+                                    dash_buffer.size(), &hls_data,
+                                    &hls_length));
+  std::vector<uint8_t> iframes(hls_data, hls_data + hls_length);
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_AppendIFrames(session, 0, &dash_buffer[0],
+                                    dash_buffer.size(), &hls_data,
+                                    &hls_length));
+
+  // Every I-frame is a byte range starting with a PAT, and together they
+  // are much smaller than the whole segment.
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetIFramePlaylist(session, "iframes.ts", &playlist,
+                                        &playlist_length));
+  std::string text(playlist, playlist_length);
+  EXPECT_NE(std::string::npos, text.find("#EXT-X-I-FRAMES-ONLY\n"));
+  EXPECT_EQ(std::string::npos, text.find("#EXT-X-ENDLIST"));
+  uint64_t offset = 0;
+  size_t iframe_count = 0;
+  for (size_t position = text.find("#EXT-X-BYTERANGE:");
+       position != std::string::npos;
+       position = text.find("#EXT-X-BYTERANGE:", position + 1)) {
+    unsigned long long length = 0;
+    unsigned long long location = 0;
+    ASSERT_EQ(2, sscanf(text.c_str() + position,
+                        "#EXT-X-BYTERANGE:%llu@%llu", &length, &location));
+    EXPECT_EQ(offset, location);
+    ASSERT_LT(location, iframes.size());
+    EXPECT_EQ(0, ntohsFromBuffer(&iframes[location + 1]) & 0x1fff);
+    offset += length;
+    ++iframe_count;
+  }
+  EXPECT_EQ(iframes.size(), offset);
+  EXPECT_LE(1u, iframe_count);
+  std::vector<uint8_t> video = ExtractPid(&iframes[0], iframes.size(), 0x21);
+  EXPECT_LT(0u, video.size());
+  EXPECT_GT(dash_buffer.size() / 2, iframes.size());
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+TEST(DashToHlsApi, AppendEncryptedIFrames) {
+  const uint8_t kKey[] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                          0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+  const uint8_t kIv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                         0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  DashToHlsSession* clear_session = nullptr;
+  std::vector<uint8_t> dash_buffer;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &clear_session,
+                   &dash_buffer);
+  const uint8_t* hls_data = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_AppendIFrames(clear_session, 0, &dash_buffer[0],
+                                    dash_buffer.size(), &hls_data,
+                                    &hls_length));
+  std::vector<uint8_t> expected(hls_data, hls_data + hls_length);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(clear_session));
+
+  DashToHlsSession* session = nullptr;
+  ReadFirstSegment(Dash2HLS_GetTestVideoFile(), &session, &dash_buffer);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetHlsEncryptionKey(session, kKey, kIv));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_AppendIFrames(session, 0, &dash_buffer[0],
+                                    dash_buffer.size(), &hls_data,
+                                    &hls_length));
+  std::vector<uint8_t> iframes(hls_data, hls_data + hls_length);
+
+  // Every byte range is encrypted and padded on its own, and decrypts to
+  // the clear I-frame.
+  const char* playlist = nullptr;
+  size_t playlist_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetIFramePlaylist(session, "iframes.ts", &playlist,
+                                        &playlist_length));
+  std::string text(playlist, playlist_length);
+  std::vector<uint8_t> clear;
+  uint64_t offset = 0;
+  for (size_t position = text.find("#EXT-X-BYTERANGE:");
+       position != std::string::npos;
+       position = text.find("#EXT-X-BYTERANGE:", position + 1)) {
+    unsigned long long length = 0;
+    unsigned long long location = 0;
+    ASSERT_EQ(2, sscanf(text.c_str() + position,
+                        "#EXT-X-BYTERANGE:%llu@%llu", &length, &location));
+    EXPECT_EQ(offset, location);
+    ASSERT_LE(location + length, iframes.size());
+    EXPECT_NE(0x47, iframes[location]);
+    std::vector<uint8_t> iframe =
+        DecryptHlsSegment(kKey, kIv, &iframes[location], length);
+    clear.insert(clear.end(), iframe.begin(), iframe.end());
+    offset += length;
+  }
+  EXPECT_EQ(iframes.size(), offset);
+  EXPECT_EQ(expected, clear);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+namespace {
+// Stands in for AES-CTR in the decryption tests.  XOR is its own inverse
+// and only depends on the IV, so every mode must produce the same output.
+struct XorDecryptor {
+  size_t sample_calls;
+  size_t fragment_calls;
+  size_t fragment_samples;
+  size_t in_place_calls;
+  size_t async_calls;
+};
+
+void XorBytes(const uint8_t* in, uint8_t* out, size_t length,
+              const uint8_t* iv) {
+  for (size_t count = 0; count < length; ++count) {
+    out[count] = in[count] ^ iv[0] ^ 0x5a;
+  }
+}
+
+// Copies the clear bytes and XORs the cipher bytes of one sample.
+void XorSubsamples(const uint8_t* in, uint8_t* out, size_t length,
+                   const uint8_t* iv, const SampleEntry* entries,
+                   size_t entry_count) {
+  size_t position = 0;
+  for (size_t count = 0; count < entry_count; ++count) {
+    memcpy(out + position, in + position, entries[count].clear_bytes);
+    position += entries[count].clear_bytes;
+    XorBytes(in + position, out + position, entries[count].cipher_bytes, iv);
+    position += entries[count].cipher_bytes;
+  }
+  memcpy(out + position, in + position, length - position);
+}
+
+DashToHlsStatus XorDecryptSample(DashToHlsContext context,
+                                 const uint8_t* encrypted, uint8_t* clear,
+                                 size_t length, uint8_t* iv,
+                                 size_t iv_length, const uint8_t* key_id,
+                                 SampleEntry* entries, size_t entry_count) {
+  ++reinterpret_cast<XorDecryptor*>(context)->sample_calls;
+  EXPECT_EQ(16u, iv_length);
+  if (entries) {
+    XorSubsamples(encrypted, clear, length, iv, entries, entry_count);
+  } else {
+    XorBytes(encrypted, clear, length, iv);
+  }
+  return kDashToHlsStatus_OK;
+}
+
+DashToHlsStatus XorDecryptFragment(DashToHlsContext context,
+                                   const uint8_t* encrypted, uint8_t* clear,
+                                   size_t length, const uint8_t* key_id,
+                                   const FragmentSample* samples,
+                                   size_t sample_count) {
+  XorDecryptor* decryptor = reinterpret_cast<XorDecryptor*>(context);
+  ++decryptor->fragment_calls;
+  decryptor->fragment_samples += sample_count;
+  size_t offset = 0;
+  for (size_t count = 0; count < sample_count; ++count) {
+    EXPECT_EQ(offset, samples[count].offset);
+    XorSubsamples(encrypted + samples[count].offset,
+                  clear + samples[count].offset, samples[count].length,
+                  samples[count].iv, samples[count].entries,
+                  samples[count].entry_count);
+    offset += samples[count].length;
+  }
+  EXPECT_EQ(length, offset);
+  return kDashToHlsStatus_OK;
+}
+
+DashToHlsStatus XorDecryptInPlace(DashToHlsContext context, uint8_t* buffer,
+                                  size_t length, const uint8_t* iv,
+                                  const uint8_t* key_id,
+                                  const DecryptRange* ranges,
+                                  size_t range_count) {
+  ++reinterpret_cast<XorDecryptor*>(context)->in_place_calls;
+  size_t end = 0;
+  for (size_t count = 0; count < range_count; ++count) {
+    EXPECT_LE(end, ranges[count].offset);
+    end = ranges[count].offset + ranges[count].length;
+    EXPECT_LE(end, length);
+    XorBytes(buffer + ranges[count].offset, buffer + ranges[count].offset,
+             ranges[count].length, iv);
+  }
+  return kDashToHlsStatus_OK;
+}
+
+DashToHlsStatus IgnorePssh(void* context, const uint8_t* pssh,
+                           size_t pssh_length) {
+  return kDashToHlsStatus_OK;
+}
+
+// Parses the CENC test video with |session|, whose decryption is set up,
+// and converts its first segment with |expected| as the result.  Releases
+// |session|.
+std::vector<uint8_t> ConvertFirstCencSegment(DashToHlsSession* session,
+                                             DashToHlsStatus expected) {
+  std::vector<uint8_t> hls;
+  FILE* file = Dash2HLS_GetTestCencVideoFile();
+  EXPECT_NE(reinterpret_cast<FILE*>(0), file);
+  if (!file) {
+    DashToHls_ReleaseSession(session);
+    return hls;
+  }
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  DashToHlsIndex* index = nullptr;
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseDash(session, buffer, bytes_read, &index));
+  std::vector<uint8_t> dash_buffer(index->segments[0].length);
+  fseek(file, index->segments[0].location, SEEK_SET);
+  EXPECT_EQ(dash_buffer.size(),
+            fread(&dash_buffer[0], 1, dash_buffer.size(), file));
+  fclose(file);
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  EXPECT_EQ(expected,
+            DashToHls_ConvertDashSegment(session, 0, &dash_buffer[0],
+                                         dash_buffer.size(), &hls_segment,
+                                         &hls_length));
+  if (expected == kDashToHlsStatus_OK) {
+    hls.assign(hls_segment, hls_segment + hls_length);
+  }
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+  return hls;
+}
+
+// Decrypts the samples of the async handler on its own thread, all those
+// started so far at a time.
+class XorWorker {
+ public:
+  explicit XorWorker(XorDecryptor* decryptor)
+      : decryptor_(decryptor), stop_(false),
+        thread_(&XorWorker::Run, this) {}
+  ~XorWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    added_.notify_all();
+    thread_.join();
+  }
+
+  static DashToHlsStatus Decrypt(DashToHlsContext context,
+                                 const uint8_t* encrypted, uint8_t* clear,
+                                 size_t length, const uint8_t* iv,
+                                 const uint8_t* key_id,
+                                 const SampleEntry* entries,
+                                 size_t entry_count,
+                                 DashToHlsDecryption* decryption) {
+    XorWorker* worker = reinterpret_cast<XorWorker*>(context);
+    Job job = {encrypted, clear, length, iv[0], entries, entry_count,
+               decryption};
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex_);
+      worker->jobs_.push_back(job);
+    }
+    worker->added_.notify_all();
+    return kDashToHlsStatus_OK;
+  }
+
+ private:
+  struct Job {
+    const uint8_t* encrypted;
+    uint8_t* clear;
+    size_t length;
+    uint8_t iv;
+    const SampleEntry* entries;
+    size_t entry_count;
+    DashToHlsDecryption* decryption;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (jobs_.empty() && !stop_) {
+        added_.wait(lock);
+      }
+      if (jobs_.empty()) {
+        return;
+      }
+      std::vector<Job> jobs;
+      jobs.swap(jobs_);
+      lock.unlock();
+      for (size_t count = 0; count < jobs.size(); ++count) {
+        ++decryptor_->async_calls;
+        XorSubsamples(jobs[count].encrypted, jobs[count].clear,
+                      jobs[count].length, &jobs[count].iv,
+                      jobs[count].entries, jobs[count].entry_count);
+        DashToHls_FinishDecryption(jobs[count].decryption,
+                                   kDashToHlsStatus_OK);
+      }
+      lock.lock();
+    }
+  }
+
+  XorDecryptor* decryptor_;
+  bool stop_;
+  std::vector<Job> jobs_;
+  std::mutex mutex_;
+  std::condition_variable added_;
+  std::thread thread_;
+};
+
+// Converts the first segment of the CENC test video with the decryption
+// callbacks in |mode|: 0 gathers the encrypted bytes, 1 uses sample entries,
+// 2 decrypts whole fragments, 3 decrypts in place and 4 decrypts
+// asynchronously on another thread.
+std::vector<uint8_t> ConvertCencSegment(int mode, DashToHlsFormat format,
+                                        XorDecryptor* decryptor) {
+  DashToHlsSession* session = nullptr;
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  if (mode == 3) {
+    DashToHls_SetCenc_DecryptInPlace(session, decryptor, XorDecryptInPlace);
+  } else {
+    DashToHls_SetCenc_DecryptSample(session, decryptor, XorDecryptSample,
+                                    mode == 1);
+  }
+  if (mode == 2) {
+    DashToHls_SetCenc_DecryptFragment(session, decryptor,
+                                      XorDecryptFragment);
+  }
+  XorWorker worker(decryptor);
+  if (mode == 4) {
+    EXPECT_EQ(kDashToHlsStatus_OK,
+              DashToHls_SetCenc_DecryptAsync(session, &worker,
+                                             XorWorker::Decrypt, 4));
+  }
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_SetOutputFormat(session, format));
+  return ConvertFirstCencSegment(session, kDashToHlsStatus_OK);
+}
+
+// AES-CTR a block at a time with Aes128, to check the built-in decryptor
+// against.
+DashToHlsStatus AesDecryptSample(DashToHlsContext context,
+                                 const uint8_t* encrypted, uint8_t* clear,
+                                 size_t length, uint8_t* iv,
+                                 size_t iv_length, const uint8_t* key_id,
+                                 SampleEntry* entries, size_t entry_count) {
+  const Aes128* aes = reinterpret_cast<const Aes128*>(context);
+  uint8_t counter[Aes128::kBlockSize];
+  memcpy(counter, iv, sizeof(counter));
+  for (size_t position = 0; position < length;
+       position += Aes128::kBlockSize) {
+    uint8_t keystream[Aes128::kBlockSize];
+    aes->EncryptBlock(counter, keystream);
+    htonllToBuffer(ntohllFromBuffer(counter + 8) + 1, counter + 8);
+    for (size_t count = 0;
+         count < Aes128::kBlockSize && position + count < length; ++count) {
+      clear[position + count] = encrypted[position + count] ^
+          keystream[count];
+    }
+  }
+  return kDashToHlsStatus_OK;
+}
+
+// The default key id of the CENC test video.
+void GetCencKeyId(uint8_t* key_id) {
+  FILE* file = Dash2HLS_GetTestCencVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  fclose(file);
+  DashParser parser;
+  parser.Parse(buffer, bytes_read);
+  const Box* box = parser.FindDeep(BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, box);
+  memcpy(key_id, reinterpret_cast<const TencContents*>(
+      box->get_contents())->get_default_kid(), TencContents::kKidSize);
+}
+
+// Everything before the first segment of the CENC test video, and the
+// first segment.
+void ReadCencMoovAndSegment(std::vector<uint8_t>* moov,
+                            std::vector<uint8_t>* segment) {
+  FILE* file = Dash2HLS_GetTestCencVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetOutputFormat(session, kDashToHlsFormat_EncryptedFmp4);
+  DashToHlsIndex* index = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseDash(session, buffer, bytes_read, &index));
+  moov->assign(buffer, buffer + index->segments[0].location);
+  segment->resize(index->segments[0].length);
+  fseek(file, index->segments[0].location, SEEK_SET);
+  EXPECT_EQ(segment->size(), fread(&(*segment)[0], 1, segment->size(), file));
+  fclose(file);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+// Converts a live |segment| to a transport stream with |session|, set up
+// for decryption, and releases it.
+std::vector<uint8_t> ConvertLiveSegment(DashToHlsSession* session,
+                                        const std::vector<uint8_t>& segment,
+                                        DashToHlsStatus expected) {
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  std::vector<uint8_t> hls;
+  EXPECT_EQ(expected,
+            DashToHls_ParseLive(session, &segment[0], segment.size(), 0,
+                                &hls_segment, &hls_length));
+  if (expected == kDashToHlsStatus_OK) {
+    hls.assign(hls_segment, hls_segment + hls_length);
+  }
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+  return hls;
+}
+}  // namespace
+
+TEST(DashToHlsApi, DecryptFragment) {
+  const DashToHlsFormat kFormats[] = {kDashToHlsFormat_TransportStream,
+                                      kDashToHlsFormat_Fmp4};
+  for (size_t format = 0; format < 2; ++format) {
+    XorDecryptor gathered = {};
+    std::vector<uint8_t> expected =
+        ConvertCencSegment(0, kFormats[format], &gathered);
+    ASSERT_LT(0u, expected.size());
+    EXPECT_LT(0u, gathered.sample_calls);
+
+    XorDecryptor entries = {};
+    EXPECT_EQ(expected, ConvertCencSegment(1, kFormats[format], &entries));
+    EXPECT_EQ(gathered.sample_calls, entries.sample_calls);
+
+    // One call per moof/mdat covering every sample.
+    XorDecryptor fragments = {};
+    EXPECT_EQ(expected, ConvertCencSegment(2, kFormats[format], &fragments));
+    EXPECT_EQ(0u, fragments.sample_calls);
+    EXPECT_EQ(gathered.sample_calls, fragments.fragment_samples);
+    EXPECT_GT(fragments.fragment_samples, fragments.fragment_calls);
+  }
+}
+
+TEST(DashToHlsApi, DecryptInPlace) {
+  XorDecryptor gathered = {};
+  std::vector<uint8_t> expected =
+      ConvertCencSegment(0, kDashToHlsFormat_TransportStream, &gathered);
+  ASSERT_LT(0u, expected.size());
+  // No DecryptSample handler is needed.
+  XorDecryptor in_place = {};
+  EXPECT_EQ(expected, ConvertCencSegment(3, kDashToHlsFormat_TransportStream,
+                                         &in_place));
+  EXPECT_EQ(0u, in_place.sample_calls);
+  EXPECT_EQ(gathered.sample_calls, in_place.in_place_calls);
+}
+
+namespace {
+// Hands out |decryptor| as the context of every key id.
+struct KeyLookup {
+  size_t calls;
+  DashToHlsStatus status;
+  XorDecryptor* decryptor;
+  uint8_t key_id[TencContents::kKidSize];
+  size_t releases;
+};
+
+DashToHlsStatus LookUpKey(DashToHlsContext context, const uint8_t* key_id,
+                          DashToHlsContext* key_context) {
+  KeyLookup* lookup = reinterpret_cast<KeyLookup*>(context);
+  ++lookup->calls;
+  memcpy(lookup->key_id, key_id, sizeof(lookup->key_id));
+  *key_context = lookup->decryptor;
+  return lookup->status;
+}
+
+void ReleaseKey(DashToHlsContext context, DashToHlsContext key_context) {
+  KeyLookup* lookup = reinterpret_cast<KeyLookup*>(context);
+  EXPECT_EQ(lookup->decryptor, key_context);
+  ++lookup->releases;
+}
+}  // namespace
+
+TEST(DashToHlsApi, KeyContextHandler) {
+  uint8_t key_id[TencContents::kKidSize];
+  GetCencKeyId(key_id);
+  FILE* file = Dash2HLS_GetTestCencVideoFile();
+  ASSERT_NE(reinterpret_cast<FILE*>(0), file);
+  uint8_t buffer[kDashHeaderRead];
+  size_t bytes_read = fread(buffer, 1, kDashHeaderRead, file);
+  // Each of the decryption modes of ConvertCencSegment.
+  for (int mode = 0; mode < 4; ++mode) {
+    XorDecryptor gathered = {};
+    std::vector<uint8_t> expected =
+        ConvertCencSegment(mode, kDashToHlsFormat_TransportStream, &gathered);
+    ASSERT_LT(0u, expected.size());
+
+    // The handlers have no context of their own, they get the decryptor
+    // from the key lookup.
+    XorDecryptor decryptor = {};
+    KeyLookup lookup = {0, kDashToHlsStatus_BadConfiguration, &decryptor,
+                        {0}, 0};
+    DashToHlsSession* session = nullptr;
+    ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+    DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+    DashToHls_SetCenc_KeyContextHandler(session, &lookup, LookUpKey,
+                                        ReleaseKey);
+    if (mode == 3) {
+      DashToHls_SetCenc_DecryptInPlace(session, nullptr, XorDecryptInPlace);
+    } else {
+      DashToHls_SetCenc_DecryptSample(session, nullptr, XorDecryptSample,
+                                      mode == 1);
+    }
+    if (mode == 2) {
+      DashToHls_SetCenc_DecryptFragment(session, nullptr, XorDecryptFragment);
+    }
+    DashToHlsIndex* index = nullptr;
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ParseDash(session, buffer, bytes_read, &index));
+    ASSERT_LE(2u, index->index_count);
+    std::vector<std::vector<uint8_t> > segments(2);
+    for (size_t count = 0; count < segments.size(); ++count) {
+      segments[count].resize(index->segments[count].length);
+      fseek(file, index->segments[count].location, SEEK_SET);
+      ASSERT_EQ(segments[count].size(), fread(&segments[count][0], 1,
+                                              segments[count].size(), file));
+    }
+    const uint8_t* hls_segment = nullptr;
+    size_t hls_length = 0;
+    // A failed lookup fails the segment and is tried again.
+    EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+              DashToHls_ConvertDashSegment(session, 0, &segments[0][0],
+                                           segments[0].size(), &hls_segment,
+                                           &hls_length));
+    EXPECT_EQ(1u, lookup.calls);
+    lookup.status = kDashToHlsStatus_OK;
+    ASSERT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(session, 0, &segments[0][0],
+                                           segments[0].size(), &hls_segment,
+                                           &hls_length));
+    EXPECT_EQ(expected,
+              std::vector<uint8_t>(hls_segment, hls_segment + hls_length));
+    EXPECT_EQ(0, memcmp(key_id, lookup.key_id, sizeof(key_id)));
+    // The key id is only looked up once.
+    EXPECT_EQ(kDashToHlsStatus_OK,
+              DashToHls_ConvertDashSegment(session, 1, &segments[1][0],
+                                           segments[1].size(), &hls_segment,
+                                           &hls_length));
+    EXPECT_EQ(2u, lookup.calls);
+    EXPECT_LT(0u, decryptor.sample_calls + decryptor.fragment_calls +
+              decryptor.in_place_calls);
+    // Only the key context of the lookup that worked is handed back.
+    EXPECT_EQ(0u, lookup.releases);
+    EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+    EXPECT_EQ(1u, lookup.releases);
+  }
+  fclose(file);
+}
+
+TEST(DashToHlsApi, ReleaseKeyContexts) {
+  XorDecryptor decryptor = {};
+  KeyLookup lookup = {0, kDashToHlsStatus_OK, &decryptor, {0}, 0};
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  DashToHls_SetCenc_DecryptSample(session, nullptr, XorDecryptSample, false);
+  DashToHls_SetCenc_KeyContextHandler(session, &lookup, LookUpKey,
+                                      ReleaseKey);
+  // The session already remembers as many key ids as it keeps.
+  Session::DecryptionKey key;
+  memset(key.key_id, 0xff, sizeof(key.key_id));
+  key.content_key = nullptr;
+  key.context = &decryptor;
+  key.has_key_context = true;
+  for (size_t count = 0; count < Session::kMaxDecryptionKeys; ++count) {
+    key.key_id[0] = static_cast<uint8_t>(count);
+    reinterpret_cast<Session*>(session)->decryption_keys_.push_back(key);
+  }
+
+  // The key id of the segment pushes out the oldest, and the rest go with
+  // the session.
+  EXPECT_LT(0u, ConvertFirstCencSegment(session, kDashToHlsStatus_OK).size());
+  EXPECT_EQ(1u, lookup.calls);
+  EXPECT_EQ(Session::kMaxDecryptionKeys + 1, lookup.releases);
+
+  // Setting the handler again hands the contexts back to the old one.
+  XorDecryptor other = {};
+  KeyLookup other_lookup = {0, kDashToHlsStatus_OK, &other, {0}, 0};
+  lookup.releases = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_KeyContextHandler(session, &lookup, LookUpKey,
+                                      ReleaseKey);
+  reinterpret_cast<Session*>(session)->decryption_keys_.push_back(key);
+  DashToHls_SetCenc_KeyContextHandler(session, &other_lookup, LookUpKey,
+                                      ReleaseKey);
+  EXPECT_EQ(1u, lookup.releases);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+  EXPECT_EQ(0u, other_lookup.releases);
+}
+
+TEST(DashToHlsApi, DecryptAsync) {
+  const DashToHlsFormat kFormats[] = {kDashToHlsFormat_TransportStream,
+                                      kDashToHlsFormat_ProgramStream,
+                                      kDashToHlsFormat_Fmp4};
+  for (size_t format = 0; format < 3; ++format) {
+    XorDecryptor gathered = {};
+    std::vector<uint8_t> expected =
+        ConvertCencSegment(0, kFormats[format], &gathered);
+    ASSERT_LT(0u, expected.size());
+    XorDecryptor async = {};
+    EXPECT_EQ(expected, ConvertCencSegment(4, kFormats[format], &async));
+    EXPECT_EQ(0u, async.sample_calls);
+    EXPECT_EQ(gathered.sample_calls, async.async_calls);
+  }
+
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_SetCenc_DecryptAsync(session, nullptr,
+                                           XorWorker::Decrypt, 0));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+TEST(DashToHlsApi, ContentKey) {
+  uint8_t key_id[TencContents::kKidSize];
+  GetCencKeyId(key_id);
+  Aes128 aes;
+  aes.SetKey(video_key);
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  DashToHls_SetCenc_DecryptSample(session, &aes, AesDecryptSample, false);
+  std::vector<uint8_t> expected =
+      ConvertFirstCencSegment(session, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, expected.size());
+
+  // No callbacks at all.
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  const uint8_t kWrongKey[16] = {0};
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetCenc_ContentKey(session, key_id, kWrongKey));
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetCenc_ContentKey(session, key_id, video_key));
+  EXPECT_EQ(1u, reinterpret_cast<Session*>(session)->content_keys_.size());
+  EXPECT_EQ(expected, ConvertFirstCencSegment(session, kDashToHlsStatus_OK));
+
+  // A key for another key id and no callback cannot decrypt the samples.
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  uint8_t other_key_id[TencContents::kKidSize];
+  memcpy(other_key_id, key_id, sizeof(other_key_id));
+  other_key_id[0] ^= 1;
+  DashToHls_SetCenc_ContentKey(session, other_key_id, video_key);
+  ConvertFirstCencSegment(session, kDashToHlsStatus_BadDashContents);
+}
+
+namespace {
+const uint8_t kCbcsKeyId[16] = {0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+                                0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd,
+                                0xce, 0xcf};
+const uint8_t kCbcsKey[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd,
+                              0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54,
+                              0x32, 0x10};
+const uint8_t kCbcsIv[16] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                             0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee,
+                             0xff, 0x00};
+
+// The CENC |moov| and |segment| as a live segment in the cbcs scheme, 1:9
+// with a constant IV, from kDashToHlsFormat_CbcsFmp4.  Its init segment has
+// no pssh, which live content needs, so the one from the CENC moov is
+// added.
+void ConvertToCbcs(const std::vector<uint8_t>& moov,
+                   const std::vector<uint8_t>& segment,
+                   std::vector<uint8_t>* cbcs) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_CbcsFmp4));
+  DashToHlsIndex* index = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseDash(session, &moov[0], moov.size(), &index));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetCbcsKeys(session, video_key, kCbcsKeyId, kCbcsKey,
+                                  kCbcsIv));
+  const uint8_t* init_segment = nullptr;
+  size_t init_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetInitSegment(session, &init_segment, &init_length));
+  cbcs->assign(init_segment, init_segment + init_length);
+  const Box* pssh = reinterpret_cast<Session*>(session)->parser_.FindDeep(
+      BoxType::kBox_pssh);
+  ASSERT_NE(nullptr, pssh);
+  const std::vector<uint8_t>& pssh_box = reinterpret_cast<
+      const PsshContents*>(pssh->get_contents())->get_full_box();
+  cbcs->insert(cbcs->end(), pssh_box.begin(), pssh_box.end());
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ConvertDashSegment(session, 0, &segment[0],
+                                         segment.size(), &hls_segment,
+                                         &hls_length));
+  cbcs->insert(cbcs->end(), hls_segment, hls_segment + hls_length);
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+}  // namespace
+
+namespace {
+const uint8_t kRotatedKeyId[16] = {0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
+                                   0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd,
+                                   0xde, 0xdf};
+
+// Rewrites the moofs of |fragments|, moof/mdat pairs from
+// kDashToHlsFormat_EncryptedFmp4, for samples encrypted with |key_id|, the
+// way a packager signals a key rotation.  The |iv_size| byte IVs are zero
+// padded to |padded_iv_size| bytes, which decrypt the same in CTR mode.  A
+// |padded_iv_size| of 0 drops them for a constant IV of zeros instead.
+void RotateKey(const std::vector<uint8_t>& fragments, const uint8_t* key_id,
+               size_t iv_size, size_t padded_iv_size,
+               std::vector<uint8_t>* rotated) {
+  DashParser parser;
+  ASSERT_EQ(fragments.size(), parser.Parse(&fragments[0], fragments.size()));
+  const std::vector<const Box*> moofs = parser.FindAll(BoxType::kBox_moof);
+  const std::vector<const Box*> mdats = parser.FindAll(BoxType::kBox_mdat);
+  ASSERT_LT(0u, moofs.size());
+  ASSERT_EQ(moofs.size(), mdats.size());
+  uint8_t default_key_id[TencContents::kKidSize] = {0};
+  Fmp4Out fmp4_out;
+  fmp4_out.set_encryption(default_key_id, static_cast<uint8_t>(iv_size));
+  const uint8_t kConstantIv[16] = {0};
+  if (padded_iv_size == 0) {
+    fmp4_out.set_fragment_encryption(key_id, 0, kConstantIv,
+                                     sizeof(kConstantIv));
+  } else {
+    fmp4_out.set_fragment_encryption(key_id,
+                                     static_cast<uint8_t>(padded_iv_size),
+                                     nullptr, 0);
+  }
+  ByteBuffer out;
+  for (size_t count = 0; count < moofs.size(); ++count) {
+    const DashParser* moof = moofs[count]->get_contents()->get_dash_parser();
+    const TfdtContents* tfdt = reinterpret_cast<const TfdtContents*>(
+        moof->FindDeep(BoxType::kBox_tfdt)->get_contents());
+    const TfhdContents* tfhd = reinterpret_cast<const TfhdContents*>(
+        moof->FindDeep(BoxType::kBox_tfhd)->get_contents());
+    const TrunContents* trun = reinterpret_cast<const TrunContents*>(
+        moof->FindDeep(BoxType::kBox_trun)->get_contents());
+    const SencContents* senc = reinterpret_cast<const SencContents*>(
+        moof->FindDeep(BoxType::kBox_senc)->get_contents());
+    const SaizContents* saiz = reinterpret_cast<const SaizContents*>(
+        moof->FindDeep(BoxType::kBox_saiz)->get_contents());
+    const MdatContents* mdat =
+        reinterpret_cast<const MdatContents*>(mdats[count]->get_contents());
+    uint32_t duration = tfhd->IsDefaultSampleDurationPresent() ?
+        tfhd->get_default_sample_duration() : 0;
+    std::vector<uint8_t> aux_info;
+    std::vector<uint8_t> sizes(saiz->get_sizes());
+    const uint8_t* sample_data = senc->get_sample_data();
+    for (size_t sample = 0; sample < sizes.size(); ++sample) {
+      if (padded_iv_size) {
+        aux_info.insert(aux_info.end(), sample_data, sample_data + iv_size);
+        aux_info.resize(aux_info.size() + padded_iv_size - iv_size);
+      }
+      aux_info.insert(aux_info.end(), sample_data + iv_size,
+                      sample_data + sizes[sample]);
+      sample_data += sizes[sample];
+      sizes[sample] = static_cast<uint8_t>(
+          sizes[sample] + padded_iv_size - iv_size);
+    }
+    ASSERT_TRUE(fmp4_out.WriteFragmentHeader(
+        static_cast<uint32_t>(count + 1), tfdt->get_base_media_decode_time(),
+        *tfhd, *trun, duration,
+        static_cast<uint32_t>(mdat->get_raw_data_length()), &aux_info[0],
+        &sizes, &out));
+    out.append(mdat->get_raw_data(), mdat->get_raw_data_length());
+  }
+  rotated->assign(out.data(), out.data() + out.size());
+}
+}  // namespace
+
+TEST(DashToHlsApi, KeyRotation) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  ASSERT_LT(0u, segment.size());
+  std::vector<uint8_t> live(moov);
+  live.insert(live.end(), segment.begin(), segment.end());
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  std::vector<uint8_t> fragments =
+      ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, fragments.size());
+  // The tenc key id needs no sample group.
+  DashParser parser;
+  ASSERT_EQ(fragments.size(), parser.Parse(&fragments[0], fragments.size()));
+  EXPECT_EQ(nullptr, parser.FindDeep(BoxType::kBox_sgpd));
+
+  DashParser moov_parser;
+  moov_parser.Parse(&moov[0], moov.size());
+  const Box* tenc = moov_parser.FindDeep(BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, tenc);
+  size_t iv_size = reinterpret_cast<const TencContents*>(
+      tenc->get_contents())->get_default_iv_size();
+  std::vector<uint8_t> rotated;
+  RotateKey(fragments, kRotatedKeyId, iv_size, iv_size, &rotated);
+  ASSERT_FALSE(rotated.empty());
+  live = moov;
+  live.insert(live.end(), rotated.begin(), rotated.end());
+
+  // Passed through, the fragments keep the rotated key id.
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  std::vector<uint8_t> output =
+      ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  EXPECT_EQ(rotated, output);
+  DashParser output_parser;
+  ASSERT_EQ(output.size(), output_parser.Parse(&output[0], output.size()));
+  const std::vector<const Box*> sgpds =
+      output_parser.FindDeepAll(BoxType::kBox_sgpd);
+  EXPECT_EQ(parser.FindAll(BoxType::kBox_moof).size(), sgpds.size());
+  for (auto iter = sgpds.begin(); iter != sgpds.end(); ++iter) {
+    const SgpdContents* sgpd =
+        reinterpret_cast<const SgpdContents*>((*iter)->get_contents());
+    ASSERT_EQ(1u, sgpd->get_seig_entries().size());
+    EXPECT_TRUE(sgpd->get_seig_entries()[0].is_protected);
+    EXPECT_EQ(0, memcmp(kRotatedKeyId, sgpd->get_seig_entries()[0].kid,
+                        sizeof(kRotatedKeyId)));
+  }
+
+  // Decrypted, the samples are looked up with the rotated key id.
+  XorDecryptor decryptor = {};
+  KeyLookup lookup = {0, kDashToHlsStatus_OK, &decryptor, {0}, 0};
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  DashToHls_SetCenc_KeyContextHandler(session, &lookup, LookUpKey, nullptr);
+  DashToHls_SetCenc_DecryptSample(session, nullptr, XorDecryptSample, false);
+  ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  EXPECT_EQ(1u, lookup.calls);
+  EXPECT_EQ(0, memcmp(kRotatedKeyId, lookup.key_id, sizeof(kRotatedKeyId)));
+}
+
+namespace {
+// Transcrypts |fragments|, live moof/mdat pairs for |moov|, to
+// kDashToHlsFormat_CbcsFmp4.
+std::vector<uint8_t> TranscryptFragments(
+    const std::vector<uint8_t>& moov, const std::vector<uint8_t>& fragments,
+    DashToHlsStatus expected) {
+  DashToHlsSession* session = nullptr;
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_CbcsFmp4));
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  // The keys need the moov.
+  DashToHlsIndex* index = nullptr;
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseDash(session, &moov[0], moov.size(), &index));
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetCbcsKeys(session, video_key, kCbcsKeyId, kCbcsKey,
+                                  kCbcsIv));
+  return ConvertLiveSegment(session, fragments, expected);
+}
+}  // namespace
+
+TEST(DashToHlsApi, TranscryptKeyRotation) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  ASSERT_LT(0u, segment.size());
+  std::vector<uint8_t> live(moov);
+  live.insert(live.end(), segment.begin(), segment.end());
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  std::vector<uint8_t> fragments =
+      ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, fragments.size());
+  uint8_t key_id[TencContents::kKidSize];
+  GetCencKeyId(key_id);
+  DashParser moov_parser;
+  moov_parser.Parse(&moov[0], moov.size());
+  const Box* tenc = moov_parser.FindDeep(BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, tenc);
+  size_t iv_size = reinterpret_cast<const TencContents*>(
+      tenc->get_contents())->get_default_iv_size();
+
+  // A sample group with the default key id transcrypts with the cenc key.
+  std::vector<uint8_t> grouped;
+  RotateKey(fragments, key_id, iv_size, iv_size, &grouped);
+  EXPECT_LT(0u, TranscryptFragments(moov, grouped,
+                                    kDashToHlsStatus_OK).size());
+
+  // The cenc key cannot decrypt the samples of a rotated key.
+  std::vector<uint8_t> rotated;
+  RotateKey(fragments, kRotatedKeyId, iv_size, iv_size, &rotated);
+  TranscryptFragments(moov, rotated, kDashToHlsStatus_BadConfiguration);
+}
+
+TEST(DashToHlsApi, TranscryptIvSize) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  ASSERT_LT(0u, segment.size());
+  std::vector<uint8_t> live(moov);
+  live.insert(live.end(), segment.begin(), segment.end());
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  std::vector<uint8_t> fragments =
+      ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, fragments.size());
+  uint8_t key_id[TencContents::kKidSize];
+  GetCencKeyId(key_id);
+  DashParser moov_parser;
+  moov_parser.Parse(&moov[0], moov.size());
+  const Box* tenc = moov_parser.FindDeep(BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, tenc);
+  size_t iv_size = reinterpret_cast<const TencContents*>(
+      tenc->get_contents())->get_default_iv_size();
+  ASSERT_GT(16u, iv_size);
+
+  // Sample groups with 16 byte IVs instead of the tenc's shorter ones
+  // transcrypt to the same output.
+  std::vector<uint8_t> grouped;
+  RotateKey(fragments, key_id, iv_size, iv_size, &grouped);
+  std::vector<uint8_t> expected =
+      TranscryptFragments(moov, grouped, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, expected.size());
+  std::vector<uint8_t> padded;
+  RotateKey(fragments, key_id, iv_size, 16, &padded);
+  EXPECT_EQ(expected, TranscryptFragments(moov, padded, kDashToHlsStatus_OK));
+
+  // Without IVs there is nothing to decrypt the cenc samples with.
+  std::vector<uint8_t> constant_iv;
+  RotateKey(fragments, key_id, iv_size, 0, &constant_iv);
+  TranscryptFragments(moov, constant_iv, kDashToHlsStatus_BadDashContents);
+}
+
+TEST(DashToHlsApi, CbcsContentKey) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  ASSERT_LT(0u, segment.size());
+  uint8_t key_id[TencContents::kKidSize];
+  GetCencKeyId(key_id);
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_ContentKey(session, key_id, video_key);
+  std::vector<uint8_t> live(moov);
+  live.insert(live.end(), segment.begin(), segment.end());
+  std::vector<uint8_t> expected =
+      ConvertLiveSegment(session, live, kDashToHlsStatus_OK);
+  ASSERT_LT(0u, expected.size());
+
+  // The same segment in the cbcs scheme.
+  std::vector<uint8_t> cbcs;
+  ConvertToCbcs(moov, segment, &cbcs);
+  ASSERT_FALSE(cbcs.empty());
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  DashToHls_SetCenc_ContentKey(session, kCbcsKeyId, kCbcsKey);
+  EXPECT_EQ(expected, ConvertLiveSegment(session, cbcs, kDashToHlsStatus_OK));
+
+  // The CENC callbacks cannot decrypt cbcs.
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  XorDecryptor decryptor = {};
+  DashToHls_SetCenc_PsshHandler(session, nullptr, IgnorePssh);
+  DashToHls_SetCenc_DecryptSample(session, &decryptor, XorDecryptSample,
+                                  false);
+  ConvertLiveSegment(session, cbcs, kDashToHlsStatus_BadConfiguration);
+}
+
+TEST(DashToHlsApi, CbcsPassthrough) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  std::vector<uint8_t> cbcs;
+  ConvertToCbcs(moov, segment, &cbcs);
+  ASSERT_FALSE(cbcs.empty());
+
+  // No keys or callbacks, the samples stay encrypted.
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  const uint8_t* hls_segment = nullptr;
+  size_t hls_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseLive(session, &cbcs[0], cbcs.size(), 0,
+                                &hls_segment, &hls_length));
+  DashParser source;
+  source.Parse(&cbcs[0], cbcs.size());
+  DashParser output;
+  ASSERT_EQ(hls_length, output.Parse(hls_segment, hls_length));
+  const Box* source_mdat = source.FindDeep(BoxType::kBox_mdat);
+  const Box* output_mdat = output.FindDeep(BoxType::kBox_mdat);
+  ASSERT_NE(nullptr, source_mdat);
+  ASSERT_NE(nullptr, output_mdat);
+  const MdatContents* source_samples =
+      reinterpret_cast<const MdatContents*>(source_mdat->get_contents());
+  const MdatContents* output_samples =
+      reinterpret_cast<const MdatContents*>(output_mdat->get_contents());
+  ASSERT_EQ(source_samples->get_raw_data_length(),
+            output_samples->get_raw_data_length());
+  EXPECT_EQ(0, memcmp(source_samples->get_raw_data(),
+                      output_samples->get_raw_data(),
+                      source_samples->get_raw_data_length()));
+
+  // The init segment keeps the scheme, the pattern and the constant IV.
+  const uint8_t* init_segment = nullptr;
+  size_t init_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetInitSegment(session, &init_segment, &init_length));
+  DashParser init;
+  ASSERT_EQ(init_length, init.Parse(init_segment, init_length));
+  const Box* box = init.FindDeep(BoxType::kBox_schm);
+  ASSERT_NE(nullptr, box);
+  EXPECT_EQ(SchmContents::kSchemeCbcs,
+            reinterpret_cast<const SchmContents*>(
+                box->get_contents())->get_scheme_type());
+  box = init.FindDeep(BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, box);
+  const TencContents* tenc =
+      reinterpret_cast<const TencContents*>(box->get_contents());
+  EXPECT_EQ(0, memcmp(kCbcsKeyId, tenc->get_default_kid(),
+                      sizeof(kCbcsKeyId)));
+  EXPECT_EQ(1, tenc->get_default_crypt_byte_block());
+  EXPECT_EQ(9, tenc->get_default_skip_byte_block());
+  EXPECT_EQ(0u, tenc->get_default_iv_size());
+  ASSERT_EQ(sizeof(kCbcsIv), tenc->get_default_constant_iv_size());
+  EXPECT_EQ(0, memcmp(kCbcsIv, tenc->get_default_constant_iv(),
+                      sizeof(kCbcsIv)));
+
+  const char* tags = nullptr;
+  size_t tags_length = 0;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetKeyTags(session, kDashToHlsKeyTag_Key, &tags,
+                                 &tags_length));
+  EXPECT_EQ(0u, std::string(tags, tags_length).find(
+      "#EXT-X-KEY:METHOD=SAMPLE-AES,"));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+
+  // cbcs is not transcrypted again.
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session, kDashToHlsFormat_CbcsFmp4));
+  EXPECT_EQ(kDashToHlsStatus_BadConfiguration,
+            DashToHls_ParseLive(session, &cbcs[0], cbcs.size(), 0,
+                                &hls_segment, &hls_length));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
+namespace {
+struct PsshCounter {
+  size_t calls;
+  DashToHlsStatus status;
+};
+
+DashToHlsStatus CountPssh(void* context, const uint8_t* pssh,
+                          size_t pssh_length) {
+  PsshCounter* counter = reinterpret_cast<PsshCounter*>(context);
+  ++counter->calls;
+  return counter->status;
+}
+}  // namespace
+
+TEST(DashToHlsApi, PsshHandlerCache) {
+  std::vector<uint8_t> moov;
+  std::vector<uint8_t> segment;
+  ReadCencMoovAndSegment(&moov, &segment);
+  ASSERT_LT(0u, moov.size());
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  PsshCounter counter = {0, kDashToHlsStatus_BadConfiguration};
+  DashToHls_SetCenc_PsshHandler(session, &counter, CountPssh);
+  XorDecryptor decryptor = {};
+  DashToHls_SetCenc_DecryptSample(session, &decryptor, XorDecryptSample,
+                                  false);
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_ParseLivePssh(session, &moov[0], moov.size()));
+  size_t pssh_count = reinterpret_cast<Session*>(session)->parser_.
+      FindDeepAll(BoxType::kBox_pssh).size();
+  ASSERT_LT(0u, pssh_count);
+  EXPECT_EQ(pssh_count, counter.calls);
+
+  // Boxes the handler failed on are passed again, the others only once.
+  counter.status = kDashToHlsStatus_OK;
+  DashToHls_ParseLivePssh(session, &moov[0], moov.size());
+  EXPECT_EQ(2 * pssh_count, counter.calls);
+  DashToHls_ParseLivePssh(session, &moov[0], moov.size());
+  EXPECT_EQ(2 * pssh_count, counter.calls);
+
+  // Setting the handler again forgets the boxes.
+  DashToHls_SetCenc_PsshHandler(session, &counter, CountPssh);
+  DashToHls_ParseLivePssh(session, &moov[0], moov.size());
+  EXPECT_EQ(3 * pssh_count, counter.calls);
+
+  // A changed box, like a rotated key, is new.
+  std::vector<uint8_t> rotated(moov);
+  const uint8_t kPssh[] = {'p', 's', 's', 'h'};
+  std::vector<uint8_t>::iterator type =
+      std::search(rotated.begin(), rotated.end(), kPssh,
+                  kPssh + sizeof(kPssh));
+  ASSERT_NE(rotated.end(), type);
+  size_t box_size = ntohlFromBuffer(&*(type - sizeof(uint32_t)));
+  uint8_t* last_byte = &*(type - sizeof(uint32_t) + box_size - 1);
+  *last_byte ^= 0xff;
+  DashToHls_ParseLivePssh(session, &rotated[0], rotated.size());
+  EXPECT_EQ(3 * pssh_count + 1, counter.calls);
+
+  // Live segments only pass their new boxes.
+  *last_byte ^= 0x0f;
+  rotated.insert(rotated.end(), segment.begin(), segment.end());
+  ConvertLiveSegment(session, rotated, kDashToHlsStatus_OK);
+  EXPECT_EQ(3 * pssh_count + 2, counter.calls);
+}
+
+TEST(DashToHlsApi, GetKeyTags) {
+  DashToHlsSession* session = nullptr;
+  ASSERT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
+  const char* tags = nullptr;
+  size_t tags_length = 0;
+  EXPECT_EQ(kDashToHlsStatus_ClearContent,
+            DashToHls_GetKeyTags(session, kDashToHlsKeyTag_Key, &tags,
+                                 &tags_length));
+  EXPECT_EQ(kDashToHlsStatus_OK,
+            DashToHls_SetOutputFormat(session,
+                                      kDashToHlsFormat_EncryptedFmp4));
+  Session* dash_session = reinterpret_cast<Session*>(session);
+  ASSERT_EQ(sizeof(kExpectedPssh),
+            dash_session->parser_.Parse(kExpectedPssh,
+                                        sizeof(kExpectedPssh)));
+  memset(dash_session->key_id_, 0xab, sizeof(dash_session->key_id_));
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetKeyTags(session, kDashToHlsKeyTag_SessionKey, &tags,
+                                 &tags_length));
+  std::string expected = "#EXT-X-SESSION-KEY:METHOD=SAMPLE-AES-CTR,"
+      "URI=\"data:text/plain;base64," +
+      Base64Encode(kExpectedPssh, sizeof(kExpectedPssh)) +
+      "\",KEYID=0xabababababababababababababababab,"
+      "KEYFORMAT=\"urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed\","
+      "KEYFORMATVERSIONS=\"1\"\n";
+  EXPECT_EQ(expected, std::string(tags, tags_length));
+
+  // cbcs is SAMPLE-AES.
+  dash_session->protection_scheme_ = SchmContents::kSchemeCbcs;
+  ASSERT_EQ(kDashToHlsStatus_OK,
+            DashToHls_GetKeyTags(session, kDashToHlsKeyTag_SessionKey, &tags,
+                                 &tags_length));
+  expected.replace(expected.find("SAMPLE-AES-CTR"), 14, "SAMPLE-AES");
+  EXPECT_EQ(expected, std::string(tags, tags_length));
+  EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_ReleaseSession(session));
+}
+
 TEST(DashToHlsApi, ParseDashList) {
   DashToHlsSession* session = nullptr;
   EXPECT_EQ(kDashToHlsStatus_OK, DashToHls_CreateSession(&session));
@@ -18,10 +18,21 @@ limitations under the License.
 #define DASHTOHLS_DASHTOHLS_SESSION_H_
 
 #include <map>
+#include <string>
 
 #include "include/DashToHlsApi.h"
+#include "library/adts/adts_out.h"
+#include "library/byte_buffer.h"
+#include "library/crypto/aes.h"
+#include "library/crypto/cbcs_transcrypter.h"
+#include "library/crypto/hls_encrypter.h"
+#include "library/crypto/sample_aes_encrypter.h"
 #include "library/dash/dash_parser.h"
+#include "library/dash/schm_contents.h"
 #include "library/dash/tenc_contents.h"
+#include "library/ps/program_stream_out.h"
+#include "library/segment_planner.h"
+#include "library/ts/transport_stream_out.h"
 
 namespace dash2hls {
 // Internal Session object.  Tracks all information used by the calls.
@@ -29,10 +40,29 @@ class Session {
  public:
   Session() :
       is_video_(false), is_encrypted_(false), pssh_handler_(nullptr),
-      decryption_handler_(nullptr), default_iv_size_(0), nalu_length_(0),
+      decryption_handler_(nullptr), use_sample_entries_(false),
+      decrypt_in_place_handler_(nullptr), decrypt_in_place_context_(nullptr),
+      decrypt_fragment_handler_(nullptr), decrypt_fragment_context_(nullptr),
+      decrypt_async_handler_(nullptr), decrypt_async_context_(nullptr),
+      decrypt_async_limit_(0),
+      default_iv_size_(0), protection_scheme_(SchmContents::kSchemeCenc),
+      crypt_byte_block_(0), skip_byte_block_(0), constant_iv_size_(0),
+      nalu_length_(0),
       audio_object_type_(0), sampling_frequency_index_(0), channel_config_(0),
-      pssh_context_(nullptr), decryption_context_(nullptr), timescale_(0),
-      trex_default_sample_duration_(0) {
+      pssh_context_(nullptr), decryption_context_(nullptr),
+      key_context_handler_(nullptr), release_key_context_handler_(nullptr),
+      key_context_context_(nullptr),
+      timescale_(0),
+      trex_default_sample_duration_(0), trex_default_sample_flags_(0),
+      output_sink_(nullptr), output_sink_context_(nullptr),
+      output_sink_flush_size_(0),
+      output_format_(kDashToHlsFormat_TransportStream),
+      fmp4_sequence_number_(0), part_count_(0),
+      iframe_segment_count_(0) {
+    memset(constant_iv_, 0, sizeof(constant_iv_));
+    memset(key_id_, 0, sizeof(key_id_));
+    memset(&last_part_, 0, sizeof(last_part_));
+    memset(&plan_, 0, sizeof(plan_));
   }
   bool is_video_;
   DashParser parser_;
@@ -40,10 +70,29 @@ class Session {
   bool is_encrypted_;
   CENC_PsshHandler pssh_handler_;
   CENC_DecryptionHandler decryption_handler_;
-  std::vector<uint8_t> reencryption_key;
+  bool use_sample_entries_;
+  // When set, used instead of decryption_handler_.
+  CENC_DecryptInPlaceHandler decrypt_in_place_handler_;
+  DashToHlsContext decrypt_in_place_context_;
+  // When set, used instead of the handlers above for everything but
+  // I-frame extraction.
+  CENC_DecryptFragmentHandler decrypt_fragment_handler_;
+  DashToHlsContext decrypt_fragment_context_;
+  // When set, used instead of the sample handlers by the per-sample loops,
+  // with up to decrypt_async_limit_ samples in flight.
+  CENC_DecryptAsyncHandler decrypt_async_handler_;
+  DashToHlsContext decrypt_async_context_;
+  size_t decrypt_async_limit_;
   size_t default_iv_size_;
+  // From the schm and tenc boxes.  The pattern and the constant IV are only
+  // used by the 'cbcs' scheme.
+  uint32_t protection_scheme_;
+  uint8_t crypt_byte_block_;
+  uint8_t skip_byte_block_;
+  size_t constant_iv_size_;
+  uint8_t constant_iv_[TencContents::kMaxConstantIvSize];
 
-  std::map<uint32_t, std::vector<uint8_t> > output_;
+  std::map<uint32_t, ByteBuffer> output_;
 
   // Video specific settings.
   std::vector<uint8_t> sps_pps_;
@@ -54,11 +103,206 @@ class Session {
   uint8_t sampling_frequency_index_;
   uint8_t channel_config_;
   uint8_t audio_config_[2];
+  // ADTS header template for the audio config above.
+  AdtsOut adts_out_;
+  // Keeps the system header and PSM for kDashToHlsFormat_ProgramStream.
+  ProgramStreamOut ps_out_;
   DashToHlsContext pssh_context_;
   DashToHlsContext decryption_context_;
+  // See DashToHls_SetCenc_KeyContextHandler.
+  CENC_KeyContextHandler key_context_handler_;
+  CENC_ReleaseKeyContextHandler release_key_context_handler_;
+  DashToHlsContext key_context_context_;
   uint64_t timescale_;
   uint8_t key_id_[TencContents::kKidSize];
   uint64_t trex_default_sample_duration_;
+  uint32_t trex_default_sample_flags_;
+
+  // Optional streaming output, see DashToHls_SetOutputSink.
+  HLS_OutputSink output_sink_;
+  DashToHlsContext output_sink_context_;
+  size_t output_sink_flush_size_;
+
+  // See DashToHls_SetOutputFormat.
+  DashToHlsFormat output_format_;
+  ByteBuffer init_segment_;
+  // The mfhd sequence number of the last fmp4 fragment of a segment, they
+  // have to increase from fragment to fragment.
+  uint32_t fmp4_sequence_number_;
+  // See DashToHls_GetKeyTags.
+  std::string key_tags_;
+
+  // See DashToHls_ConvertLiveChunk.  Parts are packetized by one
+  // TransportStreamOut so the continuity counters run on from part to part.
+  TransportStreamOut live_ts_out_;
+  ByteBuffer live_part_;
+  uint32_t part_count_;
+  DashToHlsPart last_part_;
+  std::string part_tag_;
+
+  // See DashToHls_PlanSegments.  |plan_spans_| and |planned_segments_| run
+  // in parallel, the spans say which samples to convert.
+  SegmentPlanner planner_;
+  std::vector<SegmentPlanner::Span> plan_spans_;
+  std::vector<DashToHlsPlannedSegment> planned_segments_;
+  DashToHlsPlan plan_;
+
+  // See DashToHls_AppendToSingleFile.  |single_file_ranges_| has the
+  // location and length of each segment within the file.
+  TransportStreamOut single_file_ts_out_;
+  ByteBuffer single_file_segment_;
+  std::vector<DashToHlsSegment> single_file_ranges_;
+  std::string single_file_playlist_;
+
+  // See DashToHls_AppendIFrames.  |iframes_| has the time, location and
+  // length of each I-frame within the I-frame file.
+  TransportStreamOut iframe_ts_out_;
+  ByteBuffer iframe_output_;
+  std::vector<DashToHlsSegment> iframes_;
+  uint32_t iframe_segment_count_;
+  std::string iframe_playlist_;
+
+  // See DashToHls_SetCbcsKeys.
+  CbcsTranscrypter cbcs_transcrypter_;
+  uint8_t cbcs_key_id_[TencContents::kKidSize];
+
+  // See DashToHls_SetHlsEncryptionKey.  Each segment encrypts with a copy
+  // so it has its own CBC chain.
+  HlsEncrypter hls_encrypter_;
+  // See DashToHls_SetSampleAesKey.  The writers keep a pointer to it.
+  SampleAesEncrypter sample_aes_;
+  // See DashToHls_GetHlsKeyTag.
+  std::string hls_key_tag_;
+
+  // See DashToHls_SetCenc_ContentKey.  There are only ever a few.
+  struct ContentKey {
+    uint8_t key_id[TencContents::kKidSize];
+    Aes128 aes;
+  };
+  std::vector<ContentKey> content_keys_;
+  const Aes128* FindContentKey(const uint8_t* key_id) const {
+    for (size_t count = 0; count < content_keys_.size(); ++count) {
+      if (memcmp(content_keys_[count].key_id, key_id,
+                 sizeof(content_keys_[count].key_id)) == 0) {
+        return &content_keys_[count].aes;
+      }
+    }
+    return nullptr;
+  }
+
+  // See DashToHls_SetCenc_PsshHandler.  The pssh boxes the handler has
+  // taken, so it is only called again for new ones.  Found by the CRC of
+  // the box, system ID included, and then compared whole.
+  enum {
+    kMaxHandledPssh = 16,
+  };
+  struct HandledPssh {
+    uint32_t crc;
+    std::vector<uint8_t> box;
+  };
+  std::vector<HandledPssh> handled_pssh_;
+  bool IsPsshHandled(uint32_t crc, const std::vector<uint8_t>& box) const {
+    for (size_t count = 0; count < handled_pssh_.size(); ++count) {
+      if (handled_pssh_[count].crc == crc &&
+          handled_pssh_[count].box == box) {
+        return true;
+      }
+    }
+    return false;
+  }
+  // Live content that rotates keys keeps bringing new boxes, the oldest are
+  // forgotten.
+  void AddHandledPssh(uint32_t crc, const std::vector<uint8_t>& box) {
+    if (handled_pssh_.size() == kMaxHandledPssh) {
+      handled_pssh_.erase(handled_pssh_.begin());
+    }
+    HandledPssh handled = {crc, box};
+    handled_pssh_.push_back(handled);
+  }
+
+  // What the samples of a key id are decrypted with, looked up once per key
+  // id instead of for every sample.  Fragments keep a copy.
+  enum {
+    kMaxDecryptionKeys = 16,
+  };
+  struct DecryptionKey {
+    uint8_t key_id[TencContents::kKidSize];
+    // nullptr unless there is a content key for the key id.
+    const Aes128* content_key;
+    // From the key context handler.
+    DashToHlsContext context;
+    // Set if the key context handler was called, context then goes back to
+    // the release handler.
+    bool has_key_context;
+  };
+  // The conversions only read the session, the keys are added as they come
+  // across new key ids.
+  mutable std::vector<DecryptionKey> decryption_keys_;
+  const DecryptionKey* FindDecryptionKey(const uint8_t* key_id) const {
+    for (size_t count = 0; count < decryption_keys_.size(); ++count) {
+      if (memcmp(decryption_keys_[count].key_id, key_id,
+                 sizeof(decryption_keys_[count].key_id)) == 0) {
+        return &decryption_keys_[count];
+      }
+    }
+    return nullptr;
+  }
+  // Forgets the oldest |count| keys, handing their key contexts back.
+  void DropDecryptionKeys(size_t count) const {
+    for (size_t index = 0; index < count; ++index) {
+      const DecryptionKey& key = decryption_keys_[index];
+      if (key.has_key_context && release_key_context_handler_) {
+        release_key_context_handler_(key_context_context_, key.context);
+      }
+    }
+    decryption_keys_.erase(decryption_keys_.begin(),
+                           decryption_keys_.begin() + count);
+  }
+  void ClearDecryptionKeys() const {
+    DropDecryptionKeys(decryption_keys_.size());
+  }
+  // The context a decryption handler set with |handler_context| gets for
+  // the samples of |key|.
+  DashToHlsContext GetDecryptionContext(
+      const DecryptionKey& key, DashToHlsContext handler_context) const {
+    return key_context_handler_ ? key.context : handler_context;
+  }
+
+  // nullptr unless segments are encrypted for SAMPLE-AES.
+  const SampleAesEncrypter* get_sample_aes() const {
+    return sample_aes_.is_initialized() ? &sample_aes_ : nullptr;
+  }
+  // Encrypted samples are passed through instead of decrypted.
+  bool is_passthrough() const {
+    return output_format_ == kDashToHlsFormat_EncryptedFmp4;
+  }
+  bool has_decryption_handler() const {
+    return decryption_handler_ || decrypt_in_place_handler_;
+  }
+  // Content keys make the CENC callbacks optional.
+  bool can_decrypt() const {
+    return !content_keys_.empty() ||
+        (pssh_handler_ && has_decryption_handler());
+  }
+  // cbcs samples can only be decrypted with a content key, the CENC
+  // callbacks are AES-CTR only.
+  bool is_cbcs() const {
+    return protection_scheme_ == SchmContents::kSchemeCbcs;
+  }
+  // The fragment handler is not used for samples with a content key.
+  bool uses_fragment_handler(const DecryptionKey& key) const {
+    return decrypt_fragment_handler_ && !is_cbcs() && !key.content_key;
+  }
+  // Like the fragment handler, the async handler is not used for samples
+  // with a content key.
+  bool uses_async_handler(const DecryptionKey& key) const {
+    return decrypt_async_handler_ && !is_cbcs() && !key.content_key;
+  }
+  // Whether samples are decrypted by the CENC callbacks.
+  bool needs_cenc_callbacks() const {
+    return output_format_ != kDashToHlsFormat_EncryptedFmp4 &&
+        output_format_ != kDashToHlsFormat_CbcsFmp4;
+  }
 };
 }  // namespace dash2hls
 
@@ -0,0 +1,79 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/fmp4/box_writer.h"
+
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+void BoxWriter::StartBox(uint32_t type) {
+  open_boxes_.push_back(out_->size());
+  // Size is filled in by EndBox.
+  Write32(0);
+  Write32(type);
+}
+
+void BoxWriter::StartFullBox(uint32_t type, uint8_t version,
+                             uint32_t flags) {
+  StartBox(type);
+  Write8(version);
+  Write24(flags);
+}
+
+void BoxWriter::EndBox() {
+  if (open_boxes_.empty()) {
+    DASH_LOG("Bad box.", "EndBox without StartBox.", "");
+    return;
+  }
+  size_t start = open_boxes_.back();
+  open_boxes_.pop_back();
+  Patch32(start, static_cast<uint32_t>(out_->size() - start));
+}
+
+void BoxWriter::Write16(uint16_t value) {
+  size_t position = out_->size();
+  out_->resize(position + sizeof(value));
+  htonsToBuffer(value, out_->data() + position);
+}
+
+void BoxWriter::Write24(uint32_t value) {
+  Write8(static_cast<uint8_t>(value >> 16));
+  Write16(static_cast<uint16_t>(value));
+}
+
+void BoxWriter::Write32(uint32_t value) {
+  size_t position = out_->size();
+  out_->resize(position + sizeof(value));
+  htonlToBuffer(value, out_->data() + position);
+}
+
+void BoxWriter::Write64(uint64_t value) {
+  size_t position = out_->size();
+  out_->resize(position + sizeof(value));
+  htonllToBuffer(value, out_->data() + position);
+}
+
+void BoxWriter::WriteZeros(size_t length) {
+  size_t position = out_->size();
+  out_->resize(position + length);
+  memset(out_->data() + position, 0, length);
+}
+
+void BoxWriter::Patch32(size_t position, uint32_t value) {
+  htonlToBuffer(value, out_->data() + position);
+}
+}  // namespace dash2hls
@@ -0,0 +1,71 @@
+#ifndef _DASH2HLS_BOX_WRITER_H_
+#define _DASH2HLS_BOX_WRITER_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// BoxWriter serializes mp4 boxes, the counterpart to the dash/ parsers.
+//
+// Boxes nest.  StartBox writes a header with a placeholder size and EndBox
+// fills in the size of the most recently started box once its contents are
+// written.  All values are written in network byte order.
+//
+// EXAMPLE:
+//   ByteBuffer out;
+//   BoxWriter writer(&out);
+//   writer.StartBox(BoxType::kBox_moof);
+//   writer.StartFullBox(BoxType::kBox_mfhd, 0, 0);
+//   writer.Write32(sequence_number);
+//   writer.EndBox();
+//   writer.EndBox();
+
+#include <vector>
+
+#include "library/byte_buffer.h"
+
+namespace dash2hls {
+
+class BoxWriter {
+ public:
+  explicit BoxWriter(ByteBuffer* out) : out_(out) {}
+
+  void StartBox(uint32_t type);
+  void StartFullBox(uint32_t type, uint8_t version, uint32_t flags);
+  void EndBox();
+
+  void Write8(uint8_t value) {out_->push_back(value);}
+  void Write16(uint16_t value);
+  void Write24(uint32_t value);
+  void Write32(uint32_t value);
+  void Write64(uint64_t value);
+  void WriteBytes(const uint8_t* data, size_t length) {
+    out_->append(data, length);
+  }
+  void WriteZeros(size_t length);
+
+  // Offset in the output of the next byte written.
+  size_t get_position() const {return out_->size();}
+  // Overwrites 4 bytes already written at |position|.
+  void Patch32(size_t position, uint32_t value);
+  size_t get_open_boxes() const {return open_boxes_.size();}
+
+ private:
+  ByteBuffer* out_;
+  std::vector<size_t> open_boxes_;
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_BOX_WRITER_H_
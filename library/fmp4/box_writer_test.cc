@@ -0,0 +1,68 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include "library/dash/box_type.h"
+#include "library/fmp4/box_writer.h"
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+TEST(BoxWriter, NestedBoxes) {
+  const uint8_t kExpected[] = {
+    0x00, 0x00, 0x00, 0x24, 'm', 'o', 'o', 'f',
+    0x00, 0x00, 0x00, 0x10, 'm', 'f', 'h', 'd',
+    0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x07,
+    0x00, 0x00, 0x00, 0x0c, 't', 'r', 'a', 'f',
+    0xab, 0xcd, 0x00, 0x00};
+  ByteBuffer out;
+  BoxWriter writer(&out);
+  writer.StartBox(BoxType::kBox_moof);
+  writer.StartFullBox(BoxType::kBox_mfhd, 1, 2);
+  writer.Write32(7);
+  writer.EndBox();
+  writer.StartBox(BoxType::kBox_traf);
+  writer.Write16(0xabcd);
+  writer.WriteZeros(2);
+  EXPECT_EQ(2u, writer.get_open_boxes());
+  writer.EndBox();
+  writer.EndBox();
+  EXPECT_EQ(0u, writer.get_open_boxes());
+  ASSERT_EQ(sizeof(kExpected), out.size());
+  EXPECT_EQ(0, memcmp(kExpected, out.data(), sizeof(kExpected)));
+}
+
+TEST(BoxWriter, Values) {
+  const uint8_t kExpected[] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+    0x11, 0x12};
+  ByteBuffer out;
+  BoxWriter writer(&out);
+  writer.Write8(0x01);
+  writer.Write16(0x0203);
+  writer.Write24(0x040506);
+  writer.Write32(0x0708090a);
+  writer.Write64(0x0b0c0d0e0f101112ULL);
+  ASSERT_EQ(sizeof(kExpected), out.size());
+  EXPECT_EQ(0, memcmp(kExpected, out.data(), sizeof(kExpected)));
+
+  writer.Patch32(1, 0xffeeddcc);
+  EXPECT_EQ(0xffeeddcc, ntohlFromBuffer(out.data() + 1));
+  EXPECT_EQ(sizeof(kExpected), writer.get_position());
+}
+}  // namespace dash2hls
@@ -0,0 +1,578 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/fmp4/fmp4_out.h"
+
+#include "library/dash/box_type.h"
+#include "library/fmp4/box_writer.h"
+#include "library/utilities.h"
+
+namespace {
+const uint32_t kBrandIso6 = 'iso6';
+const uint32_t kBrandCmfc = 'cmfc';
+const uint32_t kHandlerVideo = 'vide';
+const uint32_t kHandlerSound = 'soun';
+const uint8_t kHandlerVideoName[] = "VideoHandler";
+const uint8_t kHandlerSoundName[] = "SoundHandler";
+// 'und' packed as three 5 bit letters.
+const uint16_t kLanguageUndetermined = 0x55c4;
+const uint32_t kFixedOne = 0x00010000;
+const uint16_t kFixedOneVolume = 0x0100;
+const uint32_t kMatrix[9] = {
+  0x00010000, 0, 0,
+  0, 0x00010000, 0,
+  0, 0, 0x40000000,
+};
+const uint32_t kTrackEnabledInMovie = 0x000003;
+const uint32_t kDataEntrySelfContained = 0x000001;
+const uint32_t kVmhdFlags = 0x000001;
+const uint32_t kResolution72Dpi = 0x00480000;
+const size_t kCompressorNameSize = 32;
+const uint16_t kDepth24 = 0x0018;
+
+const uint32_t kTfhdDefaultSampleDuration = 0x000008;
+const uint32_t kTfhdDefaultSampleFlags = 0x000020;
+const uint32_t kTfhdDefaultBaseIsMoof = 0x020000;
+const uint32_t kTrunDataOffset = 0x000001;
+const uint32_t kTrunFirstSampleFlags = 0x000004;
+const uint32_t kTrunSampleDuration = 0x000100;
+const uint32_t kTrunSampleSize = 0x000200;
+const uint32_t kTrunSampleFlags = 0x000400;
+const uint32_t kTrunSampleComposition = 0x000800;
+const size_t kMdatHeaderSize = 8;
+
+// Common encryption, ISO/IEC 23001-7.
+const uint32_t kSchemeCenc = 'cenc';
+const uint32_t kSchemeCbcs = 'cbcs';
+const uint32_t kSchemeVersion = 0x00010000;
+const uint32_t kSeigGrouping = 'seig';
+const uint32_t kSencSubsamples = 0x000002;
+// Size of a CencSampleEncryptionInformationGroupEntry.
+const uint32_t kSeigEntrySize = 20;
+// Group description indexes above 0x10000 refer to the sgpd in the traf.
+const uint32_t kFragmentLocalGroup = 0x10001;
+const size_t kSubsampleCountSize = 2;
+
+// ISO/IEC 14496-1 descriptors in the esds.
+const uint8_t kEsDescriptorTag = 0x03;
+const uint8_t kDecoderConfigDescriptorTag = 0x04;
+const uint8_t kDecoderSpecificInfoTag = 0x05;
+const uint8_t kSlConfigDescriptorTag = 0x06;
+const uint8_t kObjectTypeAac = 0x40;
+// streamType 5 (audio) and the reserved bit.
+const uint8_t kStreamTypeAudio = 0x15;
+const uint8_t kSlConfigPredefinedMp4 = 0x02;
+const size_t kDecoderConfigSize = 13;
+// Descriptor sizes are written in one byte, which holds up to 127.
+const size_t kMaxAudioConfigSize = 100;
+}  // namespace
+
+namespace dash2hls {
+
+bool Fmp4Out::WriteInitSegment(ByteBuffer* out) const {
+  if (timescale_ == 0) {
+    DASH_LOG("Bad fmp4 configuration.", "No timescale.", "");
+    return false;
+  }
+  if (is_video_) {
+    if (sps_.empty() || pps_.empty() || sps_[0].size() < 4 ||
+        nalu_length_ == 0 || nalu_length_ > 4) {
+      DASH_LOG("Bad fmp4 configuration.", "Incomplete avc configuration.",
+               "");
+      return false;
+    }
+  } else if (audio_config_.empty() ||
+             audio_config_.size() > kMaxAudioConfigSize) {
+    DASH_LOG("Bad fmp4 configuration.", "Unsupported audio configuration.",
+             "");
+    return false;
+  }
+
+  BoxWriter writer(out);
+  writer.StartBox(BoxType::kBox_ftyp);
+  writer.Write32(kBrandIso6);
+  writer.Write32(0);
+  writer.Write32(kBrandIso6);
+  writer.Write32(kBrandCmfc);
+  writer.EndBox();
+
+  writer.StartBox(BoxType::kBox_moov);
+  writer.StartFullBox(BoxType::kBox_mvhd, 0, 0);
+  writer.Write32(0);  // creation_time
+  writer.Write32(0);  // modification_time
+  writer.Write32(timescale_);
+  writer.Write32(0);  // duration, unknown for fragmented content.
+  writer.Write32(kFixedOne);  // rate
+  writer.Write16(kFixedOneVolume);
+  writer.WriteZeros(2 + 4 * 2);
+  for (size_t count = 0; count < sizeof(kMatrix) / sizeof(kMatrix[0]);
+       ++count) {
+    writer.Write32(kMatrix[count]);
+  }
+  writer.WriteZeros(4 * 6);  // pre_defined
+  writer.Write32(kTrackId + 1);  // next_track_ID
+  writer.EndBox();
+
+  WriteTrak(&writer);
+
+  writer.StartBox(BoxType::kBox_mvex);
+  writer.StartFullBox(BoxType::kBox_trex, 0, 0);
+  writer.Write32(kTrackId);
+  writer.Write32(1);  // default_sample_description_index
+  writer.Write32(default_sample_duration_);
+  writer.Write32(0);  // default_sample_size
+  writer.Write32(default_sample_flags_);
+  writer.EndBox();
+  writer.EndBox();
+  if (is_encrypted_) {
+    for (size_t count = 0; count < pssh_boxes_.size(); ++count) {
+      writer.WriteBytes(pssh_boxes_[count].data(), pssh_boxes_[count].size());
+    }
+  }
+  writer.EndBox();
+  return true;
+}
+
+void Fmp4Out::WriteTrak(BoxWriter* writer) const {
+  writer->StartBox(BoxType::kBox_trak);
+  writer->StartFullBox(BoxType::kBox_tkhd, 0, kTrackEnabledInMovie);
+  writer->Write32(0);  // creation_time
+  writer->Write32(0);  // modification_time
+  writer->Write32(kTrackId);
+  writer->Write32(0);  // reserved
+  writer->Write32(0);  // duration
+  writer->WriteZeros(4 * 2 + 2 + 2);  // reserved, layer, alternate_group
+  writer->Write16(is_video_ ? 0 : kFixedOneVolume);
+  writer->Write16(0);  // reserved
+  for (size_t count = 0; count < sizeof(kMatrix) / sizeof(kMatrix[0]);
+       ++count) {
+    writer->Write32(kMatrix[count]);
+  }
+  writer->Write32(static_cast<uint32_t>(width_) << 16);
+  writer->Write32(static_cast<uint32_t>(height_) << 16);
+  writer->EndBox();
+
+  writer->StartBox(BoxType::kBox_mdia);
+  writer->StartFullBox(BoxType::kBox_mdhd, 0, 0);
+  writer->Write32(0);  // creation_time
+  writer->Write32(0);  // modification_time
+  writer->Write32(timescale_);
+  writer->Write32(0);  // duration
+  writer->Write16(kLanguageUndetermined);
+  writer->Write16(0);  // pre_defined
+  writer->EndBox();
+
+  writer->StartFullBox(BoxType::kBox_hdlr, 0, 0);
+  writer->Write32(0);  // pre_defined
+  writer->Write32(is_video_ ? kHandlerVideo : kHandlerSound);
+  writer->WriteZeros(4 * 3);  // reserved
+  if (is_video_) {
+    writer->WriteBytes(kHandlerVideoName, sizeof(kHandlerVideoName));
+  } else {
+    writer->WriteBytes(kHandlerSoundName, sizeof(kHandlerSoundName));
+  }
+  writer->EndBox();
+
+  writer->StartBox(BoxType::kBox_minf);
+  if (is_video_) {
+    writer->StartFullBox(BoxType::kBox_vmhd, 0, kVmhdFlags);
+    writer->WriteZeros(2 + 2 * 3);  // graphicsmode, opcolor
+  } else {
+    writer->StartFullBox(BoxType::kBox_smhd, 0, 0);
+    writer->WriteZeros(2 + 2);  // balance, reserved
+  }
+  writer->EndBox();
+
+  writer->StartBox(BoxType::kBox_dinf);
+  writer->StartFullBox(BoxType::kBox_dref, 0, 0);
+  writer->Write32(1);  // entry_count
+  writer->StartFullBox(BoxType::kBox_url, 0, kDataEntrySelfContained);
+  writer->EndBox();
+  writer->EndBox();
+  writer->EndBox();
+
+  // Every sample is in the fragments, so the sample table is empty apart
+  // from the sample description.
+  writer->StartBox(BoxType::kBox_stbl);
+  writer->StartFullBox(BoxType::kBox_stsd, 0, 0);
+  writer->Write32(1);  // entry_count
+  WriteSampleEntry(writer);
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_stts, 0, 0);
+  writer->Write32(0);
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_stsc, 0, 0);
+  writer->Write32(0);
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_stsz, 0, 0);
+  writer->Write32(0);  // sample_size
+  writer->Write32(0);  // sample_count
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_stco, 0, 0);
+  writer->Write32(0);
+  writer->EndBox();
+  writer->EndBox();  // stbl
+
+  writer->EndBox();  // minf
+  writer->EndBox();  // mdia
+  writer->EndBox();  // trak
+}
+
+void Fmp4Out::WriteSampleEntry(BoxWriter* writer) const {
+  if (is_video_) {
+    WriteAvc1(writer);
+  } else {
+    WriteMp4a(writer);
+  }
+}
+
+void Fmp4Out::WriteAvc1(BoxWriter* writer) const {
+  writer->StartBox(is_encrypted_ ? BoxType::kBox_encv : BoxType::kBox_avc1);
+  writer->WriteZeros(6);  // reserved
+  writer->Write16(1);  // data_reference_index
+  writer->WriteZeros(2 + 2 + 4 * 3);  // pre_defined and reserved
+  writer->Write16(width_);
+  writer->Write16(height_);
+  writer->Write32(kResolution72Dpi);
+  writer->Write32(kResolution72Dpi);
+  writer->Write32(0);  // reserved
+  writer->Write16(1);  // frame_count
+  writer->WriteZeros(kCompressorNameSize);
+  writer->Write16(kDepth24);
+  writer->Write16(0xffff);  // pre_defined
+
+  // Profile, compatibility and level are the three bytes after the nal unit
+  // header of the SPS.
+  writer->StartBox(BoxType::kBox_avcC);
+  writer->Write8(1);  // configurationVersion
+  writer->WriteBytes(&sps_[0][1], 3);
+  writer->Write8(0xfc | static_cast<uint8_t>(nalu_length_ - 1));
+  writer->Write8(0xe0 | static_cast<uint8_t>(sps_.size()));
+  for (size_t count = 0; count < sps_.size(); ++count) {
+    writer->Write16(static_cast<uint16_t>(sps_[count].size()));
+    writer->WriteBytes(sps_[count].data(), sps_[count].size());
+  }
+  writer->Write8(static_cast<uint8_t>(pps_.size()));
+  for (size_t count = 0; count < pps_.size(); ++count) {
+    writer->Write16(static_cast<uint16_t>(pps_[count].size()));
+    writer->WriteBytes(pps_[count].data(), pps_[count].size());
+  }
+  writer->EndBox();
+  if (is_encrypted_) {
+    WriteSinf(BoxType::kBox_avc1, writer);
+  }
+  writer->EndBox();
+}
+
+void Fmp4Out::WriteMp4a(BoxWriter* writer) const {
+  writer->StartBox(is_encrypted_ ? BoxType::kBox_enca : BoxType::kBox_mp4a);
+  writer->WriteZeros(6);  // reserved
+  writer->Write16(1);  // data_reference_index
+  writer->WriteZeros(4 * 2);  // reserved
+  writer->Write16(channel_count_);
+  writer->Write16(sample_size_);
+  writer->Write32(0);  // pre_defined and reserved
+  writer->Write32(sample_rate_ << 16);
+
+  uint8_t specific_info_size = static_cast<uint8_t>(audio_config_.size());
+  uint8_t decoder_config_size =
+      kDecoderConfigSize + 2 + specific_info_size;
+  uint8_t es_size = 3 + 2 + decoder_config_size + 2 + 1;
+  writer->StartFullBox(BoxType::kBox_esds, 0, 0);
+  writer->Write8(kEsDescriptorTag);
+  writer->Write8(es_size);
+  writer->Write16(0);  // ES_ID
+  writer->Write8(0);  // No dependency, URL or OCR stream.
+  writer->Write8(kDecoderConfigDescriptorTag);
+  writer->Write8(decoder_config_size);
+  writer->Write8(kObjectTypeAac);
+  writer->Write8(kStreamTypeAudio);
+  writer->Write24(0);  // bufferSizeDB
+  writer->Write32(0);  // maxBitrate
+  writer->Write32(0);  // avgBitrate
+  writer->Write8(kDecoderSpecificInfoTag);
+  writer->Write8(specific_info_size);
+  writer->WriteBytes(audio_config_.data(), audio_config_.size());
+  writer->Write8(kSlConfigDescriptorTag);
+  writer->Write8(1);
+  writer->Write8(kSlConfigPredefinedMp4);
+  writer->EndBox();
+  if (is_encrypted_) {
+    WriteSinf(BoxType::kBox_mp4a, writer);
+  }
+  writer->EndBox();
+}
+
+void Fmp4Out::WriteSinf(uint32_t original_format, BoxWriter* writer) const {
+  writer->StartBox(BoxType::kBox_sinf);
+  writer->StartBox(BoxType::kBox_frma);
+  writer->Write32(original_format);
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_schm, 0, 0);
+  writer->Write32(is_cbcs_ ? kSchemeCbcs : kSchemeCenc);
+  writer->Write32(kSchemeVersion);
+  writer->EndBox();
+  writer->StartBox(BoxType::kBox_schi);
+  // Version 1 adds the pattern and the constant IV.
+  writer->StartFullBox(BoxType::kBox_tenc, is_cbcs_ ? 1 : 0, 0);
+  writer->Write8(0);  // reserved
+  writer->Write8(is_cbcs_ ?
+                 static_cast<uint8_t>((crypt_byte_block_ << 4) |
+                                      (skip_byte_block_ & 0x0f)) : 0);
+  writer->Write8(1);  // default_isProtected
+  writer->Write8(iv_size_);
+  writer->WriteBytes(key_id_, sizeof(key_id_));
+  if (is_cbcs_ && iv_size_ == 0) {
+    writer->Write8(constant_iv_size_);
+    writer->WriteBytes(constant_iv_, constant_iv_size_);
+  }
+  writer->EndBox();
+  writer->EndBox();
+  writer->EndBox();
+}
+
+bool Fmp4Out::WriteSampleEncryption(size_t sample_count,
+                                    const uint8_t* aux_info,
+                                    const std::vector<uint8_t>& aux_info_sizes,
+                                    size_t moof_start,
+                                    BoxWriter* writer) const {
+  if (aux_info_sizes.size() != sample_count) {
+    DASH_LOG("Unsupported saiz.", "Only supports CENC for ALL samples.", "");
+    return false;
+  }
+  // A senc either has a subsample map for every sample or for none.
+  bool subsamples = false;
+  bool same_size = true;
+  size_t total_size = 0;
+  for (size_t count = 0; count < sample_count; ++count) {
+    uint8_t size = aux_info_sizes[count];
+    if ((size > fragment_iv_size_) != (aux_info_sizes[0] > fragment_iv_size_) ||
+        (size > fragment_iv_size_ &&
+         size < fragment_iv_size_ + kSubsampleCountSize) ||
+        size < fragment_iv_size_) {
+      DASH_LOG("Bad saiz.", "Sample auxiliary information does not fit a senc.",
+               PrettyPrintValue(size).c_str());
+      return false;
+    }
+    subsamples = size > fragment_iv_size_;
+    same_size = same_size && size == aux_info_sizes[0];
+    total_size += size;
+  }
+  // Constant IVs and no subsamples leave nothing to describe.
+  if (total_size == 0) {
+    return true;
+  }
+
+  writer->StartFullBox(BoxType::kBox_saiz, 0, 0);
+  writer->Write8(same_size && sample_count ? aux_info_sizes[0] : 0);
+  writer->Write32(static_cast<uint32_t>(sample_count));
+  if (!same_size) {
+    writer->WriteBytes(aux_info_sizes.data(), sample_count);
+  }
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_saio, 0, 0);
+  writer->Write32(1);  // entry_count
+  size_t offset_position = writer->get_position();
+  writer->Write32(0);  // Patched below to point into the senc.
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_senc, 0,
+                       subsamples ? kSencSubsamples : 0);
+  writer->Write32(static_cast<uint32_t>(sample_count));
+  writer->Patch32(offset_position,
+                  static_cast<uint32_t>(writer->get_position() - moof_start));
+  writer->WriteBytes(aux_info, total_size);
+  writer->EndBox();
+  return true;
+}
+
+bool Fmp4Out::IsFragmentEncryptionDefault() const {
+  return memcmp(fragment_key_id_, key_id_, sizeof(key_id_)) == 0 &&
+      fragment_iv_size_ == iv_size_ &&
+      (iv_size_ != 0 ||
+       (fragment_constant_iv_size_ == constant_iv_size_ &&
+        memcmp(fragment_constant_iv_, constant_iv_, constant_iv_size_) == 0));
+}
+
+// A 'seig' sample group overrides the tenc for all the samples of a
+// fragment.  Samples before the first encrypted fragment are clear, and
+// after a key rotation the key id and IVs are those of the fragment.
+void Fmp4Out::WriteSampleGroup(size_t sample_count, bool is_protected,
+                               BoxWriter* writer) const {
+  uint8_t constant_iv_size =
+      is_protected && fragment_iv_size_ == 0 ? fragment_constant_iv_size_ : 0;
+  uint32_t entry_size = kSeigEntrySize;
+  if (constant_iv_size) {
+    entry_size += sizeof(constant_iv_size) + constant_iv_size;
+  }
+  writer->StartFullBox(BoxType::kBox_sbgp, 0, 0);
+  writer->Write32(kSeigGrouping);
+  writer->Write32(1);  // entry_count
+  writer->Write32(static_cast<uint32_t>(sample_count));
+  writer->Write32(kFragmentLocalGroup);
+  writer->EndBox();
+  writer->StartFullBox(BoxType::kBox_sgpd, 1, 0);
+  writer->Write32(kSeigGrouping);
+  writer->Write32(entry_size);  // default_length
+  writer->Write32(1);  // entry_count
+  if (!is_protected) {
+    writer->WriteZeros(kSeigEntrySize);  // Not protected, no IV, no key id.
+  } else {
+    writer->Write8(0);  // reserved
+    writer->Write8(is_cbcs_ ?
+                   static_cast<uint8_t>((crypt_byte_block_ << 4) |
+                                        (skip_byte_block_ & 0x0f)) : 0);
+    writer->Write8(1);  // isProtected
+    writer->Write8(fragment_iv_size_);
+    writer->WriteBytes(fragment_key_id_, sizeof(fragment_key_id_));
+    if (constant_iv_size) {
+      writer->Write8(constant_iv_size);
+      writer->WriteBytes(fragment_constant_iv_, constant_iv_size);
+    }
+  }
+  writer->EndBox();
+}
+
+bool Fmp4Out::WriteFragmentHeader(uint32_t sequence_number,
+                                  uint64_t base_media_decode_time,
+                                  const TfhdContents& tfhd,
+                                  const TrunContents& trun,
+                                  uint32_t default_sample_duration,
+                                  uint32_t payload_size,
+                                  const uint8_t* aux_info,
+                                  const std::vector<uint8_t>* aux_info_sizes,
+                                  ByteBuffer* out) const {
+  size_t moof_start = out->size();
+  BoxWriter writer(out);
+  writer.StartBox(BoxType::kBox_moof);
+  writer.StartFullBox(BoxType::kBox_mfhd, 0, 0);
+  writer.Write32(sequence_number);
+  writer.EndBox();
+
+  const std::vector<TrunContents::TrackRun>& track_runs =
+      trun.get_track_runs();
+  // Packagers often write a duration for every sample even when they are
+  // all the same, and composition offsets that are all 0.  Either costs 4
+  // bytes per sample, as much as an AAC frame's ADTS header.
+  bool sample_durations = trun.IsSampleDurationPresent();
+  bool sample_compositions = trun.IsSampleCompositionPresent();
+  if (sample_durations && !track_runs.empty()) {
+    sample_durations = false;
+    default_sample_duration = track_runs[0].sample_duration_;
+    for (size_t count = 1; count < track_runs.size(); ++count) {
+      if (track_runs[count].sample_duration_ != default_sample_duration) {
+        sample_durations = true;
+        break;
+      }
+    }
+  }
+  if (sample_compositions) {
+    sample_compositions = false;
+    for (size_t count = 0; count < track_runs.size(); ++count) {
+      if (track_runs[count].sample_composition_time_offset_ != 0) {
+        sample_compositions = true;
+        break;
+      }
+    }
+  }
+
+  writer.StartBox(BoxType::kBox_traf);
+  // Offsets are relative to the moof, the source base_data_offset does not
+  // apply any more.
+  uint32_t tfhd_flags = kTfhdDefaultBaseIsMoof;
+  bool write_duration = !sample_durations && default_sample_duration != 0;
+  bool write_flags =
+      !trun.IsSampleFlagsPresent() && tfhd.IsDefaultSampleFlagsPresent();
+  if (write_duration) {
+    tfhd_flags |= kTfhdDefaultSampleDuration;
+  }
+  if (write_flags) {
+    tfhd_flags |= kTfhdDefaultSampleFlags;
+  }
+  writer.StartFullBox(BoxType::kBox_tfhd, 0, tfhd_flags);
+  writer.Write32(kTrackId);
+  if (write_duration) {
+    writer.Write32(default_sample_duration);
+  }
+  if (write_flags) {
+    writer.Write32(tfhd.get_default_sample_flags());
+  }
+  writer.EndBox();
+
+  writer.StartFullBox(BoxType::kBox_tfdt, 1, 0);
+  writer.Write64(base_media_decode_time);
+  writer.EndBox();
+
+  // Sizes are always written.  A trun without them relies on defaults in a
+  // tfhd or trex this output does not carry over.
+  uint32_t trun_flags = kTrunDataOffset | kTrunSampleSize;
+  if (sample_durations) {
+    trun_flags |= kTrunSampleDuration;
+  }
+  if (trun.IsSampleFlagsPresent()) {
+    trun_flags |= kTrunSampleFlags;
+  } else if (trun.IsFirstSampleFlagsPresent()) {
+    trun_flags |= kTrunFirstSampleFlags;
+  }
+  if (sample_compositions) {
+    trun_flags |= kTrunSampleComposition;
+  }
+  writer.StartFullBox(BoxType::kBox_trun,
+                      static_cast<uint8_t>(trun.get_version()), trun_flags);
+  writer.Write32(static_cast<uint32_t>(track_runs.size()));
+  size_t data_offset_position = writer.get_position();
+  writer.Write32(0);  // data_offset, patched once the moof size is known.
+  if (trun_flags & kTrunFirstSampleFlags) {
+    writer.Write32(trun.get_first_sample_flags());
+  }
+  for (std::vector<TrunContents::TrackRun>::const_iterator
+           iter = track_runs.begin(); iter != track_runs.end(); ++iter) {
+    if (trun_flags & kTrunSampleDuration) {
+      writer.Write32(iter->sample_duration_);
+    }
+    writer.Write32(iter->sample_size_);
+    if (trun_flags & kTrunSampleFlags) {
+      writer.Write32(iter->sample_flags_);
+    }
+    if (trun_flags & kTrunSampleComposition) {
+      writer.Write32(iter->sample_composition_time_offset_);
+    }
+  }
+  writer.EndBox();  // trun
+  if (is_encrypted_) {
+    if (aux_info && aux_info_sizes) {
+      if (!WriteSampleEncryption(track_runs.size(), aux_info,
+                                 *aux_info_sizes, moof_start, &writer)) {
+        out->resize(moof_start);
+        return false;
+      }
+      if (!IsFragmentEncryptionDefault()) {
+        WriteSampleGroup(track_runs.size(), true, &writer);
+      }
+    } else {
+      WriteSampleGroup(track_runs.size(), false, &writer);
+    }
+  }
+  writer.EndBox();  // traf
+  writer.EndBox();  // moof
+
+  writer.Patch32(data_offset_position,
+                 static_cast<uint32_t>(out->size() - moof_start +
+                                       kMdatHeaderSize));
+  writer.Write32(static_cast<uint32_t>(payload_size + kMdatHeaderSize));
+  writer.Write32(BoxType::kBox_mdat);
+  return true;
+}
+}  // namespace dash2hls
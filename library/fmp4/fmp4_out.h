@@ -0,0 +1,221 @@
+#ifndef _DASH2HLS_FMP4_OUT_H_
+#define _DASH2HLS_FMP4_OUT_H_
+
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Fmp4Out writes fragmented mp4 (CMAF) for HLS, the alternative to
+// TransportStreamOut.
+//
+// The samples are not touched at all.  WriteInitSegment writes the
+// EXT-X-MAP segment, an ftyp and a moov with a single track and an empty
+// sample table.  WriteFragmentHeader writes a moof describing the samples of
+// a trun followed by the mdat header, and the caller appends the sample data.
+//
+// By default the output is clear: no senc, saio or saiz, and the sample
+// entries are avc1 and mp4a.  After set_encryption the samples are expected
+// to still be encrypted with the 'cenc' scheme.  The sample entries become
+// encv and enca with a sinf, the pssh boxes go in the moov, and each
+// fragment carries its IVs and subsample maps in a senc with matching saiz
+// and saio.  set_cbcs switches the scheme to 'cbcs' with a pattern, and
+// with a constant IV the senc only holds subsample maps.  Fragments whose
+// key id or IVs differ from the tenc, after a key rotation, get a 'seig'
+// sample group, see set_fragment_encryption.
+
+#include <algorithm>
+#include <vector>
+
+#include "library/byte_buffer.h"
+#include "library/dash/tenc_contents.h"
+#include "library/dash/tfhd_contents.h"
+#include "library/dash/trun_contents.h"
+
+namespace dash2hls {
+
+class BoxWriter;
+
+class Fmp4Out {
+ public:
+  Fmp4Out() : is_video_(false),
+              timescale_(0),
+              width_(0),
+              height_(0),
+              nalu_length_(0),
+              channel_count_(0),
+              sample_size_(0),
+              sample_rate_(0),
+              default_sample_duration_(0),
+              default_sample_flags_(0),
+              is_encrypted_(false),
+              iv_size_(0),
+              is_cbcs_(false),
+              constant_iv_size_(0),
+              crypt_byte_block_(0),
+              skip_byte_block_(0),
+              fragment_iv_size_(0),
+              fragment_constant_iv_size_(0) {
+    memset(key_id_, 0, sizeof(key_id_));
+    memset(constant_iv_, 0, sizeof(constant_iv_));
+    memset(fragment_key_id_, 0, sizeof(fragment_key_id_));
+    memset(fragment_constant_iv_, 0, sizeof(fragment_constant_iv_));
+  }
+
+  // The output always has one track with this id.
+  enum {
+    kTrackId = 1,
+    kConstantIvSize = 16,
+  };
+
+  void set_timescale(uint32_t timescale) {timescale_ = timescale;}
+  void set_trex_defaults(uint32_t duration, uint32_t flags) {
+    default_sample_duration_ = duration;
+    default_sample_flags_ = flags;
+  }
+
+  // Parameter sets include the nal unit header, as in the avcC.
+  void set_video(uint16_t width, uint16_t height, size_t nalu_length,
+                 const std::vector<std::vector<uint8_t> >& sps,
+                 const std::vector<std::vector<uint8_t> >& pps) {
+    is_video_ = true;
+    width_ = width;
+    height_ = height;
+    nalu_length_ = nalu_length;
+    sps_ = sps;
+    pps_ = pps;
+  }
+  // |audio_config| is the AudioSpecificConfig from the esds.
+  void set_audio(uint16_t channel_count, uint16_t sample_size,
+                 uint32_t sample_rate,
+                 const std::vector<uint8_t>& audio_config) {
+    is_video_ = false;
+    channel_count_ = channel_count;
+    sample_size_ = sample_size;
+    sample_rate_ = sample_rate;
+    audio_config_ = audio_config;
+  }
+
+  // |key_id| is TencContents::kKidSize bytes.
+  void set_encryption(const uint8_t* key_id, uint8_t iv_size) {
+    is_encrypted_ = true;
+    memcpy(key_id_, key_id, sizeof(key_id_));
+    iv_size_ = iv_size;
+    set_fragment_encryption(key_id, iv_size, constant_iv_, constant_iv_size_);
+  }
+  // Use 'cbcs' instead of 'cenc', call after set_encryption.  The
+  // |constant_iv_size| bytes at |constant_iv|, 8 or kConstantIvSize, are
+  // only used with an |iv_size| of 0.
+  void set_cbcs(const uint8_t* constant_iv, size_t constant_iv_size,
+                uint8_t crypt_byte_block, uint8_t skip_byte_block) {
+    is_cbcs_ = true;
+    constant_iv_size_ = static_cast<uint8_t>(
+        std::min(constant_iv_size, sizeof(constant_iv_)));
+    memcpy(constant_iv_, constant_iv, constant_iv_size_);
+    crypt_byte_block_ = crypt_byte_block;
+    skip_byte_block_ = skip_byte_block;
+    set_fragment_encryption(key_id_, iv_size_, constant_iv_,
+                            constant_iv_size_);
+  }
+  // The key id and IVs of the fragments written next, the set_encryption
+  // and set_cbcs ones unless the source rotated its key.  Call after those.
+  // |constant_iv| can be nullptr if |constant_iv_size| is 0.
+  void set_fragment_encryption(const uint8_t* key_id, uint8_t iv_size,
+                               const uint8_t* constant_iv,
+                               size_t constant_iv_size) {
+    memcpy(fragment_key_id_, key_id, sizeof(fragment_key_id_));
+    fragment_iv_size_ = iv_size;
+    fragment_constant_iv_size_ = static_cast<uint8_t>(
+        std::min(constant_iv_size, sizeof(fragment_constant_iv_)));
+    if (fragment_constant_iv_size_) {
+      memcpy(fragment_constant_iv_, constant_iv, fragment_constant_iv_size_);
+    }
+  }
+  // Complete pssh boxes, header included, for the init segment.
+  void set_pssh_boxes(const std::vector<std::vector<uint8_t> >& boxes) {
+    pssh_boxes_ = boxes;
+  }
+
+  // Returns false if the track is not configured well enough to describe.
+  bool WriteInitSegment(ByteBuffer* out) const;
+
+  // Appends a moof for the samples in |trun| and the header of an mdat
+  // holding |payload_size| bytes.  The caller appends exactly |payload_size|
+  // bytes of samples.  A non zero |default_sample_duration| goes in the tfhd
+  // for truns without per sample durations.  Per sample durations that are
+  // all equal move to the tfhd as well, and composition offsets that are all
+  // 0 are dropped.  Default sample flags are kept from |tfhd|.
+  //
+  // With set_encryption, |aux_info| holds the sample auxiliary information
+  // of every sample back to back, |aux_info_sizes| long each, and goes in a
+  // senc.  A nullptr |aux_info| marks the fragment as clear lead.  Returns
+  // false if the auxiliary information cannot be described.
+  bool WriteFragmentHeader(uint32_t sequence_number,
+                           uint64_t base_media_decode_time,
+                           const TfhdContents& tfhd,
+                           const TrunContents& trun,
+                           uint32_t default_sample_duration,
+                           uint32_t payload_size,
+                           const uint8_t* aux_info,
+                           const std::vector<uint8_t>* aux_info_sizes,
+                           ByteBuffer* out) const;
+
+ protected:
+  void WriteTrak(BoxWriter* writer) const;
+  void WriteSampleEntry(BoxWriter* writer) const;
+  void WriteAvc1(BoxWriter* writer) const;
+  void WriteMp4a(BoxWriter* writer) const;
+  void WriteSinf(uint32_t original_format, BoxWriter* writer) const;
+  bool WriteSampleEncryption(size_t sample_count, const uint8_t* aux_info,
+                             const std::vector<uint8_t>& aux_info_sizes,
+                             size_t moof_start, BoxWriter* writer) const;
+  bool IsFragmentEncryptionDefault() const;
+  void WriteSampleGroup(size_t sample_count, bool is_protected,
+                        BoxWriter* writer) const;
+
+ private:
+  bool is_video_;
+  uint32_t timescale_;
+
+  uint16_t width_;
+  uint16_t height_;
+  size_t nalu_length_;
+  std::vector<std::vector<uint8_t> > sps_;
+  std::vector<std::vector<uint8_t> > pps_;
+
+  uint16_t channel_count_;
+  uint16_t sample_size_;
+  uint32_t sample_rate_;
+  std::vector<uint8_t> audio_config_;
+
+  uint32_t default_sample_duration_;
+  uint32_t default_sample_flags_;
+
+  bool is_encrypted_;
+  uint8_t key_id_[TencContents::kKidSize];
+  uint8_t iv_size_;
+  std::vector<std::vector<uint8_t> > pssh_boxes_;
+  bool is_cbcs_;
+  uint8_t constant_iv_size_;
+  uint8_t constant_iv_[kConstantIvSize];
+  uint8_t crypt_byte_block_;
+  uint8_t skip_byte_block_;
+  uint8_t fragment_key_id_[TencContents::kKidSize];
+  uint8_t fragment_iv_size_;
+  uint8_t fragment_constant_iv_size_;
+  uint8_t fragment_constant_iv_[kConstantIvSize];
+};
+}  // namespace dash2hls
+
+#endif  // _DASH2HLS_FMP4_OUT_H_
@@ -0,0 +1,534 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "library/dash/avc1_contents.h"
+#include "library/dash/avcc_contents.h"
+#include "library/dash/box.h"
+#include "library/dash/box_type.h"
+#include "library/dash/dash_parser.h"
+#include "library/dash/mdat_contents.h"
+#include "library/dash/mdhd_contents.h"
+#include "library/dash/mp4a_contents.h"
+#include "library/dash/pssh_contents.h"
+#include "library/dash/saio_contents.h"
+#include "library/dash/saiz_contents.h"
+#include "library/dash/sbgp_contents.h"
+#include "library/dash/schm_contents.h"
+#include "library/dash/sgpd_contents.h"
+#include "library/dash/tenc_contents.h"
+#include "library/dash/tfdt_contents.h"
+#include "library/dash/tfhd_contents.h"
+#include "library/dash/trex_contents.h"
+#include "library/dash/trun_contents.h"
+#include "library/fmp4/box_writer.h"
+#include "library/fmp4/fmp4_out.h"
+#include "library/utilities.h"
+
+namespace {
+const uint8_t kSps[] = {0x27, 0x42, 0xe0, 0x0d, 0xa9, 0x18, 0x28, 0x3f,
+                        0x60, 0x0d, 0x41, 0x80, 0x41, 0xad, 0xb7, 0xa0,
+                        0x2f, 0x01, 0xe9, 0x7b, 0xdf, 0x01};
+const uint8_t kPps[] = {0x28, 0xce, 0x09, 0x88};
+const uint8_t kAudioConfig[] = {0x11, 0x90};
+const uint32_t kTimescale = 15360;
+const uint32_t kSampleSizes[] = {1000, 200, 300};
+const uint32_t kSampleDurations[] = {256, 256, 512};
+const uint32_t kConstantDurations[] = {256, 256, 256};
+const uint32_t kDefaultSampleFlags = 0x01010000;
+const uint8_t kKeyId[] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                          0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+const uint8_t kIvSize = 8;
+// Per sample IV, subsample count of 1 and one subsample entry.
+const uint8_t kAuxInfoSize = kIvSize + 2 + 6;
+
+// A moof like a DASH packager writes, with a base_data_offset the output
+// must not keep.  |durations| is nullptr for a trun without durations.
+void WriteSourceMoof(const uint32_t* durations, dash2hls::ByteBuffer* out) {
+  dash2hls::BoxWriter writer(out);
+  writer.StartBox(dash2hls::BoxType::kBox_moof);
+  writer.StartBox(dash2hls::BoxType::kBox_traf);
+  writer.StartFullBox(dash2hls::BoxType::kBox_tfhd, 0, 0x000021);
+  writer.Write32(2);  // track_ID
+  writer.Write64(5000);  // base_data_offset
+  writer.Write32(kDefaultSampleFlags);
+  writer.EndBox();
+  uint32_t flags = 0x000a01 | (durations ? 0x000100 : 0);
+  writer.StartFullBox(dash2hls::BoxType::kBox_trun, 0, flags);
+  writer.Write32(3);
+  writer.Write32(1234);  // data_offset
+  for (size_t count = 0; count < 3; ++count) {
+    if (durations) {
+      writer.Write32(durations[count]);
+    }
+    writer.Write32(kSampleSizes[count]);
+    writer.Write32(static_cast<uint32_t>(count) * 512);
+  }
+  writer.EndBox();
+  writer.EndBox();
+  writer.EndBox();
+}
+
+template <typename Contents>
+const Contents* FindContents(const dash2hls::DashParser& parser,
+                             dash2hls::BoxType::Type type) {
+  const dash2hls::Box* box = parser.FindDeep(type);
+  if (!box) {
+    return nullptr;
+  }
+  return reinterpret_cast<const Contents*>(box->get_contents());
+}
+}  // namespace
+
+namespace dash2hls {
+
+TEST(Fmp4Out, VideoInitSegment) {
+  Fmp4Out fmp4_out;
+  ByteBuffer out;
+  // Nothing to describe yet.
+  EXPECT_FALSE(fmp4_out.WriteInitSegment(&out));
+
+  std::vector<std::vector<uint8_t> > sps(1);
+  sps[0].assign(kSps, kSps + sizeof(kSps));
+  std::vector<std::vector<uint8_t> > pps(1);
+  pps[0].assign(kPps, kPps + sizeof(kPps));
+  fmp4_out.set_timescale(kTimescale);
+  fmp4_out.set_trex_defaults(256, kDefaultSampleFlags);
+  fmp4_out.set_video(1280, 720, 4, sps, pps);
+  out.clear();
+  ASSERT_TRUE(fmp4_out.WriteInitSegment(&out));
+  EXPECT_EQ(BoxType::kBox_ftyp, ntohlFromBuffer(out.data() + 4));
+
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  ASSERT_NE(nullptr, parser.Find(BoxType::kBox_moov));
+  const Avc1Contents* avc1 =
+      FindContents<Avc1Contents>(parser, BoxType::kBox_avc1);
+  ASSERT_NE(nullptr, avc1);
+  EXPECT_EQ(1280, avc1->get_width());
+  EXPECT_EQ(720, avc1->get_height());
+  const AvcCContents* avcc =
+      FindContents<AvcCContents>(parser, BoxType::kBox_avcC);
+  ASSERT_NE(nullptr, avcc);
+  EXPECT_EQ(4u, avcc->GetNaluLength());
+  EXPECT_EQ(sps, avcc->get_sequence_parameter_sets());
+  EXPECT_EQ(pps, avcc->get_picture_parameter_sets());
+  const MdhdContents* mdhd =
+      FindContents<MdhdContents>(parser, BoxType::kBox_mdhd);
+  ASSERT_NE(nullptr, mdhd);
+  EXPECT_EQ(kTimescale, mdhd->get_timescale());
+  const TrexContents* trex =
+      FindContents<TrexContents>(parser, BoxType::kBox_trex);
+  ASSERT_NE(nullptr, trex);
+  EXPECT_EQ(static_cast<uint32_t>(Fmp4Out::kTrackId), trex->get_track_id());
+  EXPECT_EQ(256u, trex->get_default_sample_duration());
+  EXPECT_EQ(kDefaultSampleFlags, trex->get_default_sample_flags());
+  EXPECT_EQ(nullptr, parser.FindDeep(BoxType::kBox_encv));
+}
+
+TEST(Fmp4Out, AudioInitSegment) {
+  Fmp4Out fmp4_out;
+  fmp4_out.set_timescale(48000);
+  fmp4_out.set_audio(2, 16, 48000,
+                     std::vector<uint8_t>(kAudioConfig,
+                                          kAudioConfig +
+                                          sizeof(kAudioConfig)));
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteInitSegment(&out));
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const Mp4aContents* mp4a =
+      FindContents<Mp4aContents>(parser, BoxType::kBox_mp4a);
+  ASSERT_NE(nullptr, mp4a);
+  EXPECT_EQ(2, mp4a->get_channel_count());
+  EXPECT_EQ(16, mp4a->get_sample_size());
+  EXPECT_EQ(48000u, mp4a->get_sample_rate());
+  EXPECT_EQ(2, mp4a->get_audio_object_type());
+  EXPECT_EQ(3, mp4a->get_sampling_frequency_index());
+  EXPECT_EQ(2, mp4a->get_channel_config());
+  ASSERT_EQ(sizeof(kAudioConfig), mp4a->get_audio_config().size());
+  EXPECT_EQ(0, memcmp(kAudioConfig, &mp4a->get_audio_config()[0],
+                      sizeof(kAudioConfig)));
+}
+
+TEST(Fmp4Out, FragmentHeader) {
+  ByteBuffer source;
+  WriteSourceMoof(kSampleDurations, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  uint32_t payload_size = kSampleSizes[0] + kSampleSizes[1] +
+      kSampleSizes[2];
+  std::vector<uint8_t> payload(payload_size);
+  for (size_t count = 0; count < payload.size(); ++count) {
+    payload[count] = static_cast<uint8_t>(count);
+  }
+  Fmp4Out fmp4_out;
+  ByteBuffer out;
+  fmp4_out.WriteFragmentHeader(7, 0x123456789ULL, *tfhd, *trun, 0,
+                               payload_size, nullptr, nullptr, &out);
+  size_t header_size = out.size();
+  out.append(&payload[0], payload.size());
+
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const Box* moof = parser.Find(BoxType::kBox_moof);
+  ASSERT_NE(nullptr, moof);
+  const TfhdContents* out_tfhd =
+      FindContents<TfhdContents>(parser, BoxType::kBox_tfhd);
+  ASSERT_NE(nullptr, out_tfhd);
+  EXPECT_FALSE(out_tfhd->IsBaseDataOffsetPresent());
+  EXPECT_FALSE(out_tfhd->IsDefaultSampleDurationPresent());
+  ASSERT_TRUE(out_tfhd->IsDefaultSampleFlagsPresent());
+  EXPECT_EQ(kDefaultSampleFlags, out_tfhd->get_default_sample_flags());
+  const TfdtContents* tfdt =
+      FindContents<TfdtContents>(parser, BoxType::kBox_tfdt);
+  ASSERT_NE(nullptr, tfdt);
+  EXPECT_EQ(0x123456789ULL, tfdt->get_base_media_decode_time());
+
+  const TrunContents* out_trun =
+      FindContents<TrunContents>(parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, out_trun);
+  // The data offset is from the start of the moof to the first sample.
+  EXPECT_EQ(static_cast<int32_t>(header_size),
+            out_trun->get_data_offset());
+  EXPECT_TRUE(out_trun->IsSampleDurationPresent());
+  EXPECT_TRUE(out_trun->IsSampleCompositionPresent());
+  EXPECT_FALSE(out_trun->IsSampleFlagsPresent());
+  ASSERT_EQ(3u, out_trun->get_track_runs().size());
+  for (size_t count = 0; count < 3; ++count) {
+    const TrunContents::TrackRun& run = out_trun->get_track_runs()[count];
+    EXPECT_EQ(kSampleDurations[count], run.sample_duration_);
+    EXPECT_EQ(kSampleSizes[count], run.sample_size_);
+    EXPECT_EQ(count * 512, run.sample_composition_time_offset_);
+  }
+
+  const MdatContents* mdat =
+      FindContents<MdatContents>(parser, BoxType::kBox_mdat);
+  ASSERT_NE(nullptr, mdat);
+  ASSERT_EQ(payload.size(), mdat->get_raw_data_length());
+  EXPECT_EQ(0, memcmp(&payload[0], mdat->get_raw_data(), payload.size()));
+}
+
+TEST(Fmp4Out, FragmentHeaderDefaultDuration) {
+  ByteBuffer source;
+  WriteSourceMoof(nullptr, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  Fmp4Out fmp4_out;
+  ByteBuffer out;
+  fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 1024, 0, nullptr, nullptr,
+                               &out);
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const TfhdContents* out_tfhd =
+      FindContents<TfhdContents>(parser, BoxType::kBox_tfhd);
+  ASSERT_NE(nullptr, out_tfhd);
+  ASSERT_TRUE(out_tfhd->IsDefaultSampleDurationPresent());
+  EXPECT_EQ(1024u, out_tfhd->get_default_sample_duration());
+  const TrunContents* out_trun =
+      FindContents<TrunContents>(parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, out_trun);
+  EXPECT_FALSE(out_trun->IsSampleDurationPresent());
+}
+
+TEST(Fmp4Out, FragmentHeaderConstantDuration) {
+  ByteBuffer source;
+  WriteSourceMoof(kConstantDurations, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  // Equal durations move to the tfhd, saving 4 bytes per sample.
+  Fmp4Out fmp4_out;
+  ByteBuffer out;
+  fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 0, 0, nullptr, nullptr,
+                               &out);
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const TfhdContents* out_tfhd =
+      FindContents<TfhdContents>(parser, BoxType::kBox_tfhd);
+  ASSERT_NE(nullptr, out_tfhd);
+  ASSERT_TRUE(out_tfhd->IsDefaultSampleDurationPresent());
+  EXPECT_EQ(256u, out_tfhd->get_default_sample_duration());
+  const TrunContents* out_trun =
+      FindContents<TrunContents>(parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, out_trun);
+  EXPECT_FALSE(out_trun->IsSampleDurationPresent());
+  EXPECT_TRUE(out_trun->IsSampleCompositionPresent());
+}
+
+TEST(Fmp4Out, EncryptedInitSegment) {
+  ByteBuffer pssh_box;
+  BoxWriter writer(&pssh_box);
+  writer.StartFullBox(BoxType::kBox_pssh, 0, 0);
+  writer.WriteBytes(kKeyId, sizeof(kKeyId));  // SystemID
+  writer.Write32(4);
+  writer.Write32(0xdeadbeef);
+  writer.EndBox();
+
+  Fmp4Out fmp4_out;
+  fmp4_out.set_timescale(kTimescale);
+  fmp4_out.set_video(1280, 720, 4,
+                     std::vector<std::vector<uint8_t> >(
+                         1, std::vector<uint8_t>(kSps, kSps + sizeof(kSps))),
+                     std::vector<std::vector<uint8_t> >(
+                         1, std::vector<uint8_t>(kPps, kPps + sizeof(kPps))));
+  fmp4_out.set_encryption(kKeyId, kIvSize);
+  fmp4_out.set_pssh_boxes(std::vector<std::vector<uint8_t> >(
+      1, std::vector<uint8_t>(pssh_box.data(),
+                              pssh_box.data() + pssh_box.size())));
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteInitSegment(&out));
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  EXPECT_EQ(nullptr, parser.FindDeep(BoxType::kBox_avc1));
+  const Avc1Contents* encv =
+      FindContents<Avc1Contents>(parser, BoxType::kBox_encv);
+  ASSERT_NE(nullptr, encv);
+  EXPECT_EQ(1280, encv->get_width());
+  EXPECT_NE(nullptr, parser.FindDeep(BoxType::kBox_avcC));
+  const TencContents* tenc =
+      FindContents<TencContents>(parser, BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, tenc);
+  EXPECT_EQ(kIvSize, tenc->get_default_iv_size());
+  EXPECT_EQ(0, memcmp(kKeyId, tenc->get_default_kid(), sizeof(kKeyId)));
+  const PsshContents* pssh =
+      FindContents<PsshContents>(parser, BoxType::kBox_pssh);
+  ASSERT_NE(nullptr, pssh);
+  ASSERT_EQ(pssh_box.size(), pssh->get_full_box().size());
+  EXPECT_EQ(0, memcmp(pssh_box.data(), pssh->get_full_box().data(),
+                      pssh_box.size()));
+}
+
+TEST(Fmp4Out, CbcsInitSegment) {
+  const uint8_t kConstantIv[Fmp4Out::kConstantIvSize] = {
+    0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd, 0xce, 0xcf};
+  Fmp4Out fmp4_out;
+  fmp4_out.set_timescale(48000);
+  fmp4_out.set_audio(2, 16, 48000,
+                     std::vector<uint8_t>(kAudioConfig,
+                                          kAudioConfig +
+                                          sizeof(kAudioConfig)));
+  fmp4_out.set_encryption(kKeyId, 0);
+  fmp4_out.set_cbcs(kConstantIv, sizeof(kConstantIv), 1, 9);
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteInitSegment(&out));
+  const uint8_t kSchm[] = {'s', 'c', 'h', 'm', 0x00, 0x00, 0x00, 0x00,
+                           'c', 'b', 'c', 's', 0x00, 0x01, 0x00, 0x00};
+  EXPECT_NE(out.data() + out.size(),
+            std::search(out.data(), out.data() + out.size(), kSchm,
+                        kSchm + sizeof(kSchm)));
+  // tenc version 1 with the pattern and the constant IV.
+  const uint8_t kTenc[] = {'t', 'e', 'n', 'c', 0x01, 0x00, 0x00, 0x00,
+                           0x00, 0x19, 0x01, 0x00};
+  const uint8_t* tenc = std::search(out.data(), out.data() + out.size(),
+                                    kTenc, kTenc + sizeof(kTenc));
+  ASSERT_NE(out.data() + out.size(), tenc);
+  EXPECT_EQ(4u + sizeof(kTenc) + sizeof(kKeyId) + 1 + sizeof(kConstantIv),
+            ntohlFromBuffer(tenc - 4));
+  tenc += sizeof(kTenc);
+  EXPECT_EQ(0, memcmp(kKeyId, tenc, sizeof(kKeyId)));
+  EXPECT_EQ(sizeof(kConstantIv), tenc[sizeof(kKeyId)]);
+  EXPECT_EQ(0, memcmp(kConstantIv, tenc + sizeof(kKeyId) + 1,
+                      sizeof(kConstantIv)));
+
+  // And the parser reads them back.
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const SchmContents* schm =
+      FindContents<SchmContents>(parser, BoxType::kBox_schm);
+  ASSERT_NE(nullptr, schm);
+  EXPECT_EQ(static_cast<uint32_t>(SchmContents::kSchemeCbcs),
+            schm->get_scheme_type());
+  EXPECT_EQ(0x10000u, schm->get_scheme_version());
+  const TencContents* tenc_contents =
+      FindContents<TencContents>(parser, BoxType::kBox_tenc);
+  ASSERT_NE(nullptr, tenc_contents);
+  EXPECT_TRUE(tenc_contents->get_default_is_protected());
+  EXPECT_EQ(0u, tenc_contents->get_default_iv_size());
+  EXPECT_EQ(1, tenc_contents->get_default_crypt_byte_block());
+  EXPECT_EQ(9, tenc_contents->get_default_skip_byte_block());
+  ASSERT_EQ(sizeof(kConstantIv),
+            tenc_contents->get_default_constant_iv_size());
+  EXPECT_EQ(0, memcmp(kConstantIv, tenc_contents->get_default_constant_iv(),
+                      sizeof(kConstantIv)));
+}
+
+TEST(Fmp4Out, EncryptedFragmentHeader) {
+  ByteBuffer source;
+  WriteSourceMoof(kSampleDurations, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  std::vector<uint8_t> aux_info_sizes(3, kAuxInfoSize);
+  std::vector<uint8_t> aux_info(3 * kAuxInfoSize);
+  for (size_t count = 0; count < aux_info.size(); ++count) {
+    aux_info[count] = static_cast<uint8_t>(count + 1);
+  }
+  Fmp4Out fmp4_out;
+  fmp4_out.set_encryption(kKeyId, kIvSize);
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 0, 0,
+                                           &aux_info[0], &aux_info_sizes,
+                                           &out));
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  const SaizContents* saiz =
+      FindContents<SaizContents>(parser, BoxType::kBox_saiz);
+  ASSERT_NE(nullptr, saiz);
+  EXPECT_EQ(aux_info_sizes, saiz->get_sizes());
+  const SaioContents* saio =
+      FindContents<SaioContents>(parser, BoxType::kBox_saio);
+  ASSERT_NE(nullptr, saio);
+  ASSERT_EQ(1u, saio->get_offsets().size());
+  // The saio points into the senc, relative to the start of the moof.
+  ASSERT_LE(saio->get_offsets()[0] + aux_info.size(), out.size());
+  EXPECT_EQ(0, memcmp(&aux_info[0], out.data() + saio->get_offsets()[0],
+                      aux_info.size()));
+  EXPECT_NE(nullptr, parser.FindDeep(BoxType::kBox_senc));
+
+  // Mixing samples with and without subsamples cannot go in one senc.
+  aux_info_sizes[1] = kIvSize;
+  out.clear();
+  EXPECT_FALSE(fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 0, 0,
+                                            &aux_info[0], &aux_info_sizes,
+                                            &out));
+  EXPECT_EQ(0u, out.size());
+}
+
+TEST(Fmp4Out, ClearLeadFragmentHeader) {
+  ByteBuffer source;
+  WriteSourceMoof(kSampleDurations, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  Fmp4Out fmp4_out;
+  fmp4_out.set_encryption(kKeyId, kIvSize);
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 0, 0,
+                                           nullptr, nullptr, &out));
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  // Clear samples in an encrypted track are marked with a sample group.
+  EXPECT_EQ(nullptr, parser.FindDeep(BoxType::kBox_senc));
+  EXPECT_NE(nullptr, parser.FindDeep(BoxType::kBox_sbgp));
+  const SgpdContents* sgpd =
+      FindContents<SgpdContents>(parser, BoxType::kBox_sgpd);
+  ASSERT_NE(nullptr, sgpd);
+  ASSERT_EQ(1u, sgpd->get_seig_entries().size());
+  EXPECT_FALSE(sgpd->get_seig_entries()[0].is_protected);
+}
+
+TEST(Fmp4Out, RotatedKeyFragmentHeader) {
+  ByteBuffer source;
+  WriteSourceMoof(kSampleDurations, &source);
+  DashParser source_parser;
+  ASSERT_EQ(source.size(), source_parser.Parse(source.data(),
+                                               source.size()));
+  const TfhdContents* tfhd =
+      FindContents<TfhdContents>(source_parser, BoxType::kBox_tfhd);
+  const TrunContents* trun =
+      FindContents<TrunContents>(source_parser, BoxType::kBox_trun);
+  ASSERT_NE(nullptr, tfhd);
+  ASSERT_NE(nullptr, trun);
+
+  std::vector<uint8_t> aux_info_sizes(3, kAuxInfoSize);
+  std::vector<uint8_t> aux_info(3 * kAuxInfoSize);
+  Fmp4Out fmp4_out;
+  fmp4_out.set_encryption(kKeyId, kIvSize);
+  // The tenc default needs no sample group.
+  fmp4_out.set_fragment_encryption(kKeyId, kIvSize, nullptr, 0);
+  ByteBuffer out;
+  ASSERT_TRUE(fmp4_out.WriteFragmentHeader(1, 0, *tfhd, *trun, 0, 0,
+                                           &aux_info[0], &aux_info_sizes,
+                                           &out));
+  DashParser parser;
+  ASSERT_EQ(out.size(), parser.Parse(out.data(), out.size()));
+  EXPECT_EQ(nullptr, parser.FindDeep(BoxType::kBox_sgpd));
+
+  // Another key id, as after a key rotation, goes in a 'seig' group for
+  // all the samples.
+  uint8_t rotated_key_id[sizeof(kKeyId)];
+  memcpy(rotated_key_id, kKeyId, sizeof(kKeyId));
+  rotated_key_id[0] = 0xff;
+  fmp4_out.set_fragment_encryption(rotated_key_id, kIvSize, nullptr, 0);
+  out.clear();
+  ASSERT_TRUE(fmp4_out.WriteFragmentHeader(2, 0, *tfhd, *trun, 0, 0,
+                                           &aux_info[0], &aux_info_sizes,
+                                           &out));
+  DashParser rotated_parser;
+  ASSERT_EQ(out.size(), rotated_parser.Parse(out.data(), out.size()));
+  EXPECT_NE(nullptr, rotated_parser.FindDeep(BoxType::kBox_senc));
+  const SbgpContents* sbgp =
+      FindContents<SbgpContents>(rotated_parser, BoxType::kBox_sbgp);
+  ASSERT_NE(nullptr, sbgp);
+  EXPECT_EQ(static_cast<uint32_t>(SgpdContents::kGroupingSeig),
+            sbgp->get_grouping_type());
+  ASSERT_EQ(1u, sbgp->get_entries().size());
+  EXPECT_EQ(3u, sbgp->get_entries()[0].sample_count);
+  EXPECT_EQ(static_cast<uint32_t>(SbgpContents::kFragmentLocalIndex + 1),
+            sbgp->get_entries()[0].group_description_index);
+  const SgpdContents* sgpd =
+      FindContents<SgpdContents>(rotated_parser, BoxType::kBox_sgpd);
+  ASSERT_NE(nullptr, sgpd);
+  ASSERT_EQ(1u, sgpd->get_seig_entries().size());
+  const SgpdContents::SeigEntry& seig = sgpd->get_seig_entries()[0];
+  EXPECT_TRUE(seig.is_protected);
+  EXPECT_EQ(kIvSize, seig.iv_size);
+  EXPECT_EQ(0, memcmp(rotated_key_id, seig.kid, sizeof(rotated_key_id)));
+  EXPECT_EQ(0u, seig.constant_iv_size);
+}
+}  // namespace dash2hls
@@ -35,6 +35,8 @@ class PES {
     kVideoStreamId = 0xe0,
     kVideoStreamType = 0x1b,
     kAudioStreamType = 0x0f,
+    // Start code, stream id, length, optional header, pts and dts.
+    kMaxHeaderSize = 19,
   };
 
  public:
@@ -53,6 +55,8 @@ class PES {
     payload_size_ = length;
   }
   size_t GetFreePayloadBytes() const;
+  const uint8_t* get_payload() const {return payload_;}
+  size_t get_payload_size() const {return payload_size_;}
 
   void SetCopyright(bool copyright);
   void SetOriginal(bool original);
@@ -38,8 +38,18 @@ void ProgramStreamOut::ProcessSample(const uint8_t* input, size_t input_length,
                                      bool is_sync_sample,
                                      uint64_t pts, uint64_t dts,
                                      uint64_t scr, uint64_t duration,
-                                     std::vector<uint8_t>* out) {
+                                     ByteBuffer* out) const {
   out->resize(0);
+  AppendSample(input, input_length, is_video, is_sync_sample, pts, dts, scr,
+               duration, out);
+}
+
+void ProgramStreamOut::AppendSample(const uint8_t* input, size_t input_length,
+                                    bool is_video,
+                                    bool is_sync_sample,
+                                    uint64_t pts, uint64_t dts,
+                                    uint64_t scr, uint64_t duration,
+                                    ByteBuffer* out) const {
   PES pes;
   if (is_video) {
     pes.set_stream_id(PES::kVideoStreamId);
@@ -54,21 +64,33 @@ void ProgramStreamOut::ProcessSample(const uint8_t* input, size_t input_length,
     pes.SetDts(dts);
   }
 
-  std::vector<uint8_t> pes_data(input, input + input_length);
-  bool has_aud;
-  nalu::PicType pic_type;
-  PreprocessNalus(&pes_data, &has_aud, &pic_type);
-  if (!has_aud) {
-    AddNeededNalu(&pes_data, pic_type, is_sync_sample);
+  std::vector<uint8_t> pes_data;
+  if (is_video) {
+    // Room for the AUD and parameter sets so AddNeededNalu does not
+    // reallocate.
+    pes_data.reserve(input_length + nalu::kAudNaluSize + sizeof(uint32_t) +
+                     sps_pps_.size());
+    pes_data.assign(input, input + input_length);
+    bool has_aud = false;
+    nalu::PicType pic_type = nalu::kPicType_I;
+    PreprocessNalus(&pes_data, &has_aud, &pic_type);
+    if (!has_aud) {
+      AddNeededNalu(&pes_data, pic_type, is_sync_sample);
+    }
+    ConvertLengthToStartCode(&pes_data);
+  } else {
+    pes_data.resize(input_length + AdtsOut::kHeaderSize);
+    if (!adts_out_.WriteFrame(input, input_length, &pes_data[0])) {
+      return;
+    }
   }
-  ConvertLengthToStartCode(&pes_data);
   pes.AddPayload(&pes_data[0], pes_data.size());
   AddHeaders(pes, is_sync_sample, duration, scr, out);
 }
 
 void ProgramStreamOut::PreprocessNalus(std::vector<uint8_t>* buffer,
                                        bool* has_aud,
-                                       nalu::PicType* pic_type) {
+                                       nalu::PicType* pic_type) const {
   if (nalu_length_ == 0) {
     return;
   }
@@ -78,7 +100,7 @@ void ProgramStreamOut::PreprocessNalus(std::vector<uint8_t>* buffer,
 
 void ProgramStreamOut::AddNeededNalu(std::vector<uint8_t>* buffer,
                                      nalu::PicType pic_type,
-                                     bool is_sync_sample) {
+                                     bool is_sync_sample) const {
   size_t bytes_to_shift = nalu::kAudNaluSize + sizeof(uint32_t);
   if (is_sync_sample) {
     bytes_to_shift += sps_pps_.size();
@@ -99,82 +121,86 @@ void ProgramStreamOut::AddNeededNalu(std::vector<uint8_t>* buffer,
   }
 }
 
-void ProgramStreamOut::ConvertLengthToStartCode(std::vector<uint8_t>* buffer) {
+void ProgramStreamOut::ConvertLengthToStartCode(
+    std::vector<uint8_t>* buffer) const {
   nalu::ReplaceLengthWithStartCode(&(*buffer)[0], buffer->size());
 }
 
+void ProgramStreamOut::UpdateSyncHeaders() {
+  SystemHeader system_header;
+  PSM psm;
+  system_header.AddStream(PES::kPsmStreamId);
+  if (has_video_) {
+    system_header.AddStream(PES::kVideoStreamId);
+    system_header.SetVideoBound(1);
+    system_header.SetVideoLockFlag(true);
+    psm.AddElementaryStream(PES::kVideoStreamId, PES::kVideoStreamType);
+    psm.AddElementaryStreamDescriptor(
+        PES::kVideoStreamId, PSM::kVideoAlignmentDescriptor,
+        sizeof(PSM::kVideoAlignmentDescriptor));
+  }
+  if (has_audio_) {
+    system_header.AddStream(PES::kAudioStreamId);
+    system_header.SetAudioBound(1);
+    system_header.SetAudioLockFlag(true);
+    if (!audio_oid_.empty()) {
+      psm.AddDescriptor(&audio_oid_[0],
+                        static_cast<uint16_t>(audio_oid_.size()));
+    }
+    psm.AddElementaryStream(PES::kAudioStreamId, PES::kAudioStreamType);
+    psm.AddElementaryStreamDescriptor(
+        PES::kAudioStreamId, PSM::kAudioAlignmentDescriptor,
+        sizeof(PSM::kAudioAlignmentDescriptor));
+  }
+  // These defaults should work in most cases.
+  system_header.SetFixedFlag(false);
+  system_header.SetCspsFlag(false);
+  system_header.SetPacketRestrictionFlag(false);
+
+  psm.set_current_next_indicator(true);
+  psm.set_psm_version(0);
+
+  sync_headers_.resize(system_header.GetSize() + psm.GetSize());
+  uint8_t* buffer = sync_headers_.data();
+  uint8_t* end_ptr = buffer + sync_headers_.size();
+  buffer += system_header.Write(buffer,
+                                static_cast<uint32_t>(end_ptr - buffer));
+  buffer += psm.Write(buffer, static_cast<uint32_t>(end_ptr - buffer));
+  if (buffer != end_ptr) {
+    DASH_LOG("ProgramStream UpdateSyncHeaders failed.",
+             "System header and PSM did not match their sizes.",
+             "");
+  }
+}
+
 void ProgramStreamOut::AddHeaders(const PES& pes,
                                   bool is_sync_sample,
                                   uint64_t duration, uint64_t scr,
-                                  std::vector<uint8_t>* out) {
+                                  ByteBuffer* out) const {
+  size_t size = GetSizeOfSyncPacket(is_sync_sample, pes);
+  size_t position = out->size();
+  out->resize(position + size);
+  uint8_t *buffer = out->data() + position;
+  uint8_t *end_ptr = buffer + size;
+  uint32_t mux_rate =
+      static_cast<uint32_t>((size * kClockRate) / (50 * duration));
+  buffer += WriteHeader(buffer, scr * kScrRatio, mux_rate);
   if (is_sync_sample) {
-    SystemHeader system_header;
-    PSM psm;
-    system_header.AddStream(PES::kPsmStreamId);
-    if (has_video_) {
-      system_header.AddStream(PES::kVideoStreamId);
-      system_header.SetVideoBound(1);
-      system_header.SetVideoLockFlag(true);
-      psm.AddElementaryStream(PES::kVideoStreamId, PES::kVideoStreamType);
-      psm.AddElementaryStreamDescriptor(
-          PES::kVideoStreamId, PSM::kVideoAlignmentDescriptor,
-          sizeof(PSM::kVideoAlignmentDescriptor));
-    }
-    if (has_audio_) {
-      system_header.AddStream(PES::kAudioStreamId);
-      system_header.SetAudioBound(1);
-      system_header.SetAudioLockFlag(true);
-      psm.AddDescriptor(&audio_oid_[0], audio_oid_.size());
-      psm.AddElementaryStream(PES::kAudioStreamId, PES::kAudioStreamType);
-      psm.AddElementaryStreamDescriptor(
-          PES::kAudioStreamId, PSM::kAudioAlignmentDescriptor,
-          sizeof(PSM::kAudioAlignmentDescriptor));
-    }
-    // These defaults should work in most cases.
-    system_header.SetFixedFlag(false);
-    system_header.SetCspsFlag(false);
-    system_header.SetPacketRestrictionFlag(false);
-
-    psm.set_current_next_indicator(true);
-    psm.set_psm_version(0);
-
-    size_t size = GetSizeOfSyncPacket(is_sync_sample, system_header, psm, pes);
-    out->resize(size);
-    uint8_t *buffer = &(*out)[0];
-    uint8_t *end_ptr = &(*out)[out->size()];
-    uint32_t mux_rate =
-        static_cast<uint32_t>((size * kClockRate) / (50 * duration));
-    buffer += WriteHeader(buffer, scr * kScrRatio, mux_rate);
-    buffer += system_header.Write(buffer,
-                                  static_cast<uint32_t>(end_ptr - buffer));
-    buffer += psm.Write(buffer, static_cast<uint32_t>(end_ptr - buffer));
-    buffer += pes.Write(buffer, static_cast<uint32_t>(end_ptr - buffer));
-    if (buffer != end_ptr) {
-      DASH_LOG("ProgramStream AddHeaders failed.",
-               "ProgramStream should have added more bytes.",
-               "");
-    }
-  } else {
-    size_t size = GetSize(pes);
-    out->resize(size);
-    uint8_t *buffer = &(*out)[0];
-    uint8_t *end_ptr = &(*out)[out->size()];
-    uint32_t mux_rate =
-        static_cast<uint32_t>((size * kClockRate) / (50 * duration));
-    buffer += WriteHeader(buffer, scr * kScrRatio, mux_rate);
-    buffer += pes.Write(buffer, static_cast<uint32_t>(end_ptr - buffer));
-    if (buffer != end_ptr) {
-      DASH_LOG("ProgramStream AddHeaders failed.",
-               "ProgramStream should have added more bytes.",
-               "");
-    }
+    memcpy(buffer, sync_headers_.data(), sync_headers_.size());
+    buffer += sync_headers_.size();
+  }
+  buffer += pes.Write(buffer, static_cast<uint32_t>(end_ptr - buffer));
+  if (buffer != end_ptr) {
+    DASH_LOG("ProgramStream AddHeaders failed.",
+             "ProgramStream should have added more bytes.",
+             "");
   }
 }
 
 // There are magic numbers in here copied from the Widevine code.
 // TODO(justsomeguy) Track down magic numbers and use constants.
 size_t ProgramStreamOut::WriteHeader(uint8_t* buffer, uint64_t scr,
-                                     uint32_t mux_rate) {
+                                     uint32_t mux_rate) const {
   uint8_t* original_buffer = buffer;
   memcpy(buffer, kPackStartCode, sizeof(kPackStartCode));
   buffer += sizeof(kPackStartCode);
@@ -210,12 +236,10 @@ size_t ProgramStreamOut::WriteHeader(uint8_t* buffer, uint64_t scr,
 }
 
 size_t ProgramStreamOut::GetSizeOfSyncPacket(bool is_sync_sample,
-                                             const SystemHeader& system_header,
-                                             const PSM& psm,
                                              const PES& pes) const {
   size_t result = GetHeaderSize();
   if (is_sync_sample) {
-    result += system_header.GetSize() + psm.GetSize();
+    result += sync_headers_.size();
   }
   result += pes.GetSize();
   return result;
@@ -3,12 +3,18 @@
 //
 // Expected usage is to call ProgramStreamOut::ProcessSample(in, out);
 // All other routines are exposed for unit testing.
+//
+// The system header and PSM that go before every sync sample only depend
+// on the streams, so the setters serialize them once and sync samples copy
+// the bytes.  Audio samples are framed as ADTS, the PSM stream type.
 #ifndef _DASH2HLS_PROGRAM_STREAM_OUT_H_
 #define _DASH2HLS_PROGRAM_STREAM_OUT_H_
 
 #include <vector>
 
 #include "include/DashToHlsApi.h"
+#include "library/adts/adts_out.h"
+#include "library/byte_buffer.h"
 #include "library/dash/box_type.h"
 #include "library/dash/full_box_contents.h"
 #include "library/ps/nalu.h"
@@ -23,6 +29,7 @@ class ProgramStreamOut {
   ProgramStreamOut() : nalu_length_(0),
                        has_video_(false),
                        has_audio_(false) {
+    UpdateSyncHeaders();
   }
 
   // TODO(justsomeguy) this interface requires an extra copy of input because
@@ -32,38 +39,69 @@ class ProgramStreamOut {
                      bool is_sync_sample,
                      uint64_t pts, uint64_t dts, uint64_t scr,
                      uint64_t duration,
-                     std::vector<uint8_t>* out);
+                     ByteBuffer* out) const;
+  // ProcessSample without clearing |out| first, so a whole segment can be
+  // written into one buffer.
+  void AppendSample(const uint8_t* input, size_t input_length,
+                    bool is_video,
+                    bool is_sync_sample,
+                    uint64_t pts, uint64_t dts, uint64_t scr,
+                    uint64_t duration,
+                    ByteBuffer* out) const;
 
   void set_nalu_length(size_t nalu_length) {nalu_length_ = nalu_length;}
   void set_sps_pps(const std::vector<uint8_t>& sps_pps) {sps_pps_ = sps_pps;}
+  const std::vector<uint8_t>& get_sps_pps() const {return sps_pps_;}
   void set_audio_oid(const std::vector<uint8_t>& audio_oid) {
     audio_oid_ = audio_oid;
+    UpdateSyncHeaders();
+  }
+  void set_has_video(bool flag) {
+    has_video_ = flag;
+    UpdateSyncHeaders();
+  }
+  void set_has_audio(bool flag) {
+    has_audio_ = flag;
+    UpdateSyncHeaders();
+  }
+  void set_audio_object_type(uint8_t type) {
+    adts_out_.set_audio_object_type(type);
+  }
+  void set_sampling_frequency_index(uint8_t index) {
+    adts_out_.set_sampling_frequency_index(index);
+  }
+  void set_channel_config(uint8_t config) {
+    adts_out_.set_channel_config(config);
   }
-  void set_has_video(bool flag) {has_video_ = flag;}
-  void set_has_audio(bool flag) {has_audio_ = flag;}
+
+  // Bytes of system header and PSM written before a sync sample.
+  size_t get_sync_headers_size() const {return sync_headers_.size();}
 
  protected:
   void PreprocessNalus(std::vector<uint8_t>* buffer, bool* has_aud,
-                       nalu::PicType* pic_type);
+                       nalu::PicType* pic_type) const;
   void AddNeededNalu(std::vector<uint8_t>* buffer, nalu::PicType pic_type,
-                     bool is_sync_sample);
-  void ConvertLengthToStartCode(std::vector<uint8_t>* buffer);
-  size_t WriteHeader(uint8_t* buffer, uint64_t scr, uint32_t mux_rate);
+                     bool is_sync_sample) const;
+  void ConvertLengthToStartCode(std::vector<uint8_t>* buffer) const;
+  size_t WriteHeader(uint8_t* buffer, uint64_t scr, uint32_t mux_rate) const;
   void AddHeaders(const PES& pes, bool is_sync_sample, uint64_t duration,
-                  uint64_t scr, std::vector<uint8_t>* out);
+                  uint64_t scr, ByteBuffer* out) const;
   size_t GetHeaderSize() const;
   size_t GetSize(const PES& pes) const;
-  size_t GetSizeOfSyncPacket(bool is_sync_sample,
-                           const SystemHeader& system_header,
-                           const PSM& psm, const PES& pes) const;
+  size_t GetSizeOfSyncPacket(bool is_sync_sample, const PES& pes) const;
 
  private:
+  void UpdateSyncHeaders();
+
   static const uint8_t kPackStartCode[4];
   size_t nalu_length_;
   std::vector<uint8_t> sps_pps_;
   std::vector<uint8_t> audio_oid_;
   bool has_video_;
   bool has_audio_;
+  AdtsOut adts_out_;
+  // The serialized SystemHeader and PSM.
+  ByteBuffer sync_headers_;
 };
 }  // namespace dash2hls
 
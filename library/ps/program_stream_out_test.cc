@@ -318,7 +318,7 @@ TEST(ProgramStreamOut, InternalRoutines) {
   EXPECT_THAT(make_pair(&header[0], header.size()),
               testing::MemEq(kExpectedHeader, sizeof(kExpectedHeader)));
 
-  std::vector<uint8_t> final_buffer;
+  ByteBuffer final_buffer;
   ps_out.set_has_audio(true);
   ps_out.set_has_video(true);
   PES pes;
@@ -332,7 +332,7 @@ TEST(ProgramStreamOut, InternalRoutines) {
 }
 
 TEST(ProgramStreamOut, ProcessPacket) {
-  std::vector<uint8_t> output;
+  ByteBuffer output;
   std::vector<uint8_t> sps_pps(kSpsPps, kSpsPps + sizeof(kSpsPps));
 
   ProgramStreamOutTest ps_out;
@@ -0,0 +1,112 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/sample_encryption_table.h"
+
+#include <string.h>
+
+#include <limits>
+#include <string>
+
+#include "library/utilities.h"
+
+namespace dash2hls {
+
+void SampleEncryptionTable::Init(size_t sample_count, size_t iv_size,
+                                 const uint8_t* constant_iv,
+                                 size_t constant_iv_size) {
+  iv_size_ = iv_size;
+  memset(constant_iv_, 0, sizeof(constant_iv_));
+  if (!iv_size) {
+    memcpy(constant_iv_, constant_iv, constant_iv_size);
+  }
+  samples_.clear();
+  samples_.reserve(sample_count);
+  entries_.clear();
+  aux_info_ = nullptr;
+  aux_info_sizes_.clear();
+  aux_info_sizes_.reserve(sample_count);
+  aux_info_sizes_fit_ = true;
+}
+
+bool SampleEncryptionTable::AddSample(const uint8_t** info,
+                                      const uint8_t* end,
+                                      bool has_subsamples,
+                                      uint32_t sample_size) {
+  const uint8_t* position = *info;
+  if (static_cast<size_t>(end - position) < iv_size_) {
+    DASH_LOG("Bad sample encryption.", "IV would run off the end.", "");
+    return false;
+  }
+  samples_.resize(samples_.size() + 1);
+  Sample& sample = samples_.back();
+  if (iv_size_) {
+    memset(sample.iv, 0, sizeof(sample.iv));
+    memcpy(sample.iv, position, iv_size_);
+    position += iv_size_;
+  } else {
+    memcpy(sample.iv, constant_iv_, sizeof(sample.iv));
+  }
+  sample.first_entry = static_cast<uint32_t>(entries_.size());
+  if (!has_subsamples) {
+    SampleEntry entry = {0, static_cast<int32_t>(sample_size)};
+    entries_.push_back(entry);
+    sample.entry_count = 1;
+  } else {
+    if (end - position < kSubsampleCountSize) {
+      DASH_LOG("Bad sample encryption.",
+               "Subsample count would run off the end.", "");
+      samples_.pop_back();
+      return false;
+    }
+    size_t count = ntohsFromBuffer(position);
+    position += kSubsampleCountSize;
+    if (static_cast<size_t>(end - position) < count * kSubsampleSize) {
+      DASH_LOG("Bad sample encryption.",
+               "Subsamples would run off the end.", "");
+      samples_.pop_back();
+      return false;
+    }
+    entries_.resize(sample.first_entry + count);
+    SampleEntry* entry = &entries_[sample.first_entry];
+    uint64_t total = 0;
+    for (size_t subsample = 0; subsample < count; ++subsample) {
+      uint16_t clear_bytes = ntohsFromBuffer(position);
+      uint32_t cipher_bytes = ntohlFromBuffer(position + sizeof(uint16_t));
+      entry[subsample].clear_bytes = clear_bytes;
+      entry[subsample].cipher_bytes = static_cast<int32_t>(cipher_bytes);
+      total += clear_bytes + static_cast<uint64_t>(cipher_bytes);
+      position += kSubsampleSize;
+    }
+    if (total > sample_size) {
+      std::string error_msg =
+          "subsamples(" + std::to_string(total) + ") > sample_size(" +
+          std::to_string(sample_size) + ")";
+      DASH_LOG("Bad sample encryption.", error_msg.c_str(), "");
+      entries_.resize(sample.first_entry);
+      samples_.pop_back();
+      return false;
+    }
+    sample.entry_count = static_cast<uint32_t>(count);
+  }
+  size_t aux_info_size = position - *info;
+  aux_info_sizes_fit_ = aux_info_sizes_fit_ &&
+      aux_info_size <= std::numeric_limits<uint8_t>::max();
+  aux_info_sizes_.push_back(static_cast<uint8_t>(aux_info_size));
+  *info = position;
+  return true;
+}
+}  // namespace dash2hls
@@ -0,0 +1,114 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// The IVs and subsample maps of every sample of one moof/mdat, parsed once
+// from the senc, or the saio/saiz auxiliary information without one, so
+// the decrypt loops only look them up.  The subsample maps of all the
+// samples are in one flat array.  Each sample is checked against its size
+// when it is added, a sample without a subsample map is one entry covering
+// all of it.
+//
+// EXAMPLE:
+//   SampleEncryptionTable table;
+//   table.Init(sample_count, iv_size, constant_iv, constant_iv_size);
+//   const uint8_t* info = senc->get_sample_data();
+//   const uint8_t* end = info + senc->get_sample_data_length();
+//   for (...) {
+//     table.AddSample(&info, end, senc->IsSubsamplePresent(), sample_size);
+//   }
+//   Decrypt(table.get_iv(sample), table.get_entries(sample),
+//           table.get_entry_count(sample));
+
+#ifndef DASHTOHLS_SAMPLE_ENCRYPTION_TABLE_H_
+#define DASHTOHLS_SAMPLE_ENCRYPTION_TABLE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "include/DashToHlsApi.h"
+
+namespace dash2hls {
+class SampleEncryptionTable {
+ public:
+  enum {
+    kIvSize = 16,
+    kSubsampleCountSize = sizeof(uint16_t),
+    kSubsampleSize = sizeof(uint16_t) + sizeof(uint32_t),
+  };
+
+  SampleEncryptionTable()
+      : iv_size_(0), aux_info_(nullptr), aux_info_sizes_fit_(true) {}
+
+  // Empties the table for a fragment of |sample_count| samples that start
+  // with |iv_size| bytes of IV, or use the |constant_iv_size| bytes at
+  // |constant_iv| if it is 0.  Shorter IVs are padded with zeros.
+  void Init(size_t sample_count, size_t iv_size, const uint8_t* constant_iv,
+            size_t constant_iv_size);
+
+  // Adds the next sample, |sample_size| bytes, from the information at
+  // |*info| and moves |*info| past it.  |has_subsamples| says a subsample
+  // map follows the IV.  Returns false if it runs past |end| or the map
+  // covers more than |sample_size|.
+  bool AddSample(const uint8_t** info, const uint8_t* end,
+                 bool has_subsamples, uint32_t sample_size);
+
+  // The auxiliary information the samples were read from, for output that
+  // keeps it, if it was in one block.  The sizes are those a saiz has, so
+  // it is nullptr if a sample has more than fits in a byte.
+  void set_aux_info(const uint8_t* aux_info) {aux_info_ = aux_info;}
+  const uint8_t* get_aux_info() const {
+    return aux_info_sizes_fit_ ? aux_info_ : nullptr;
+  }
+  const std::vector<uint8_t>& get_aux_info_sizes() const {
+    return aux_info_sizes_;
+  }
+
+  size_t size() const {return samples_.size();}
+  bool empty() const {return samples_.empty();}
+  const uint8_t* get_iv(size_t sample) const {return samples_[sample].iv;}
+  // Not const, CENC_DecryptionHandler takes a writable map.  nullptr if
+  // the sample has no entries.
+  SampleEntry* get_entries(size_t sample) {
+    return samples_[sample].entry_count ?
+        &entries_[samples_[sample].first_entry] : nullptr;
+  }
+  const SampleEntry* get_entries(size_t sample) const {
+    return samples_[sample].entry_count ?
+        &entries_[samples_[sample].first_entry] : nullptr;
+  }
+  size_t get_entry_count(size_t sample) const {
+    return samples_[sample].entry_count;
+  }
+
+ private:
+  struct Sample {
+    uint8_t iv[kIvSize];
+    // Where the entries of the sample start in |entries_|.
+    uint32_t first_entry;
+    uint32_t entry_count;
+  };
+
+  size_t iv_size_;
+  uint8_t constant_iv_[kIvSize];
+  std::vector<Sample> samples_;
+  std::vector<SampleEntry> entries_;
+  const uint8_t* aux_info_;
+  std::vector<uint8_t> aux_info_sizes_;
+  bool aux_info_sizes_fit_;
+};  // class SampleEncryptionTable
+}  // namespace dash2hls
+#endif  // DASHTOHLS_SAMPLE_ENCRYPTION_TABLE_H_
@@ -0,0 +1,125 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/sample_encryption_table.h"
+
+#include <gtest/gtest.h>
+
+#include "library/utilities.h"
+
+namespace dash2hls {
+namespace {
+// Appends an 8 byte IV of |iv| and, if |count| is not 0, a subsample map of
+// |count| subsamples of 10 clear and 100 encrypted bytes.
+void AddInfo(uint8_t iv, uint16_t count, std::vector<uint8_t>* info) {
+  info->insert(info->end(), 8, iv);
+  if (!count) {
+    return;
+  }
+  uint8_t buffer[sizeof(uint32_t)];
+  htonsToBuffer(count, buffer);
+  info->insert(info->end(), buffer, buffer + sizeof(uint16_t));
+  for (uint16_t subsample = 0; subsample < count; ++subsample) {
+    htonsToBuffer(10, buffer);
+    info->insert(info->end(), buffer, buffer + sizeof(uint16_t));
+    htonlToBuffer(100, buffer);
+    info->insert(info->end(), buffer, buffer + sizeof(uint32_t));
+  }
+}
+}  // namespace
+
+TEST(Dash2HLS, SampleEncryptionTableSubsamples) {
+  std::vector<uint8_t> info;
+  AddInfo(1, 1, &info);
+  AddInfo(2, 3, &info);
+  AddInfo(3, 2, &info);
+  SampleEncryptionTable table;
+  table.Init(3, 8, nullptr, 0);
+  const uint8_t* position = &info[0];
+  const uint8_t* end = position + info.size();
+  EXPECT_TRUE(table.AddSample(&position, end, true, 110));
+  EXPECT_TRUE(table.AddSample(&position, end, true, 400));
+  EXPECT_TRUE(table.AddSample(&position, end, true, 220));
+  EXPECT_EQ(end, position);
+  ASSERT_EQ(3u, table.size());
+  const uint8_t kIv[16] = {2, 2, 2, 2, 2, 2, 2, 2};
+  EXPECT_EQ(0, memcmp(kIv, table.get_iv(1), sizeof(kIv)));
+  EXPECT_EQ(1u, table.get_entry_count(0));
+  ASSERT_EQ(3u, table.get_entry_count(1));
+  EXPECT_EQ(2u, table.get_entry_count(2));
+  // The maps are back to back.
+  EXPECT_EQ(table.get_entries(0) + 1, table.get_entries(1));
+  EXPECT_EQ(table.get_entries(1) + 3, table.get_entries(2));
+  EXPECT_EQ(10, table.get_entries(1)[2].clear_bytes);
+  EXPECT_EQ(100, table.get_entries(1)[2].cipher_bytes);
+  ASSERT_EQ(3u, table.get_aux_info_sizes().size());
+  EXPECT_EQ(8u + 2 + 3 * 6, table.get_aux_info_sizes()[1]);
+
+  // Subsamples bigger than the sample, or past the end of the information.
+  table.Init(1, 8, nullptr, 0);
+  position = &info[0];
+  EXPECT_FALSE(table.AddSample(&position, end, true, 109));
+  EXPECT_EQ(&info[0], position);
+  EXPECT_FALSE(table.AddSample(&position, position + 15, true, 110));
+  EXPECT_TRUE(table.empty());
+}
+
+TEST(Dash2HLS, SampleEncryptionTableWholeSamples) {
+  // Per sample IVs without subsample maps.
+  std::vector<uint8_t> info;
+  AddInfo(7, 0, &info);
+  AddInfo(8, 0, &info);
+  SampleEncryptionTable table;
+  table.Init(2, 8, nullptr, 0);
+  table.set_aux_info(&info[0]);
+  const uint8_t* position = &info[0];
+  const uint8_t* end = position + info.size();
+  EXPECT_TRUE(table.AddSample(&position, end, false, 50));
+  EXPECT_TRUE(table.AddSample(&position, end, false, 60));
+  EXPECT_EQ(&info[0], table.get_aux_info());
+  ASSERT_EQ(1u, table.get_entry_count(1));
+  EXPECT_EQ(0, table.get_entries(1)->clear_bytes);
+  EXPECT_EQ(60, table.get_entries(1)->cipher_bytes);
+  EXPECT_EQ(8, table.get_iv(1)[0]);
+  EXPECT_EQ(0, table.get_iv(1)[8]);
+
+  // A constant IV and nothing per sample.
+  const uint8_t kConstantIv[16] = {0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+                                   0xc7, 0xc8, 0xc9, 0xca, 0xcb, 0xcc, 0xcd,
+                                   0xce, 0xcf};
+  table.Init(1, 0, kConstantIv, sizeof(kConstantIv));
+  position = &info[0];
+  EXPECT_TRUE(table.AddSample(&position, position, false, 70));
+  EXPECT_EQ(&info[0], position);
+  EXPECT_EQ(0, memcmp(kConstantIv, table.get_iv(0), sizeof(kConstantIv)));
+  EXPECT_EQ(0u, table.get_aux_info_sizes()[0]);
+  EXPECT_EQ(nullptr, table.get_aux_info());
+}
+
+TEST(Dash2HLS, SampleEncryptionTableLargeMap) {
+  // A map too big for a saiz size can be decrypted but not kept.
+  std::vector<uint8_t> info;
+  AddInfo(1, 50, &info);
+  SampleEncryptionTable table;
+  table.Init(1, 8, nullptr, 0);
+  table.set_aux_info(&info[0]);
+  const uint8_t* position = &info[0];
+  EXPECT_TRUE(table.AddSample(&position, position + info.size(), true,
+                              50 * 110));
+  EXPECT_EQ(50u, table.get_entry_count(0));
+  EXPECT_EQ(nullptr, table.get_aux_info());
+}
+}  // namespace dash2hls
@@ -0,0 +1,88 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/segment_planner.h"
+
+#include <algorithm>
+
+namespace dash2hls {
+namespace {
+bool IsBefore(const SegmentPlanner::Cut& left,
+              const SegmentPlanner::Cut& right) {
+  return left.segment < right.segment ||
+      (left.segment == right.segment && left.sample < right.sample);
+}
+}  // namespace
+
+void SegmentPlanner::AddSyncSample(uint32_t segment, uint32_t sample,
+                                   uint64_t time) {
+  if (sample == 0) {
+    return;
+  }
+  Cut cut = {segment, sample, time};
+  std::vector<Cut>::iterator position =
+      std::lower_bound(sync_samples_.begin(), sync_samples_.end(), cut,
+                       IsBefore);
+  if (position != sync_samples_.end() && !IsBefore(cut, *position)) {
+    return;
+  }
+  sync_samples_.insert(position, cut);
+}
+
+void SegmentPlanner::Plan(const DashToHlsSegment* segments, uint32_t count,
+                          uint64_t target_duration,
+                          std::vector<Span>* plan) const {
+  plan->clear();
+  if (count == 0) {
+    return;
+  }
+  // Every place a span can start, in order, then the end of the last
+  // segment.
+  std::vector<Cut> cuts;
+  cuts.reserve(count + sync_samples_.size() + 1);
+  std::vector<Cut>::const_iterator sync = sync_samples_.begin();
+  for (uint32_t segment = 0; segment < count; ++segment) {
+    Cut cut = {segment, 0, segments[segment].start_time};
+    cuts.push_back(cut);
+    for (; sync != sync_samples_.end() && sync->segment <= segment; ++sync) {
+      if (sync->segment == segment) {
+        cuts.push_back(*sync);
+      }
+    }
+  }
+  Cut end = {count, 0,
+             segments[count - 1].start_time + segments[count - 1].duration};
+  cuts.push_back(end);
+
+  size_t start = 0;
+  while (start + 1 < cuts.size()) {
+    uint64_t goal = cuts[start].time + target_duration;
+    size_t next = start + 1;
+    while (next + 1 < cuts.size() && cuts[next].time < goal) {
+      ++next;
+    }
+    // cuts[next] is the first cut at or past |goal|, or the end.  The one
+    // before it can be closer.
+    if (next > start + 1 && cuts[next].time >= goal &&
+        goal - cuts[next - 1].time < cuts[next].time - goal) {
+      --next;
+    }
+    Span span = {cuts[start], cuts[next]};
+    plan->push_back(span);
+    start = next;
+  }
+}
+}  // namespace dash2hls
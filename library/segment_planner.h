@@ -0,0 +1,79 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Plans HLS segments of a target duration over the DASH segments of a sidx
+// index, independently of how long the DASH segments are.  Short DASH
+// segments are stitched together and long ones are split.
+//
+// A planned segment can only start at a sync sample.  Every DASH segment is
+// taken to start with one, as DashToHls_ConvertDashSegment does, and sync
+// samples inside a segment are added with AddSyncSample once its moofs have
+// been seen.  DASH segments without any added sync samples are never split.
+//
+// EXAMPLE:
+//   SegmentPlanner planner;
+//   planner.AddSyncSample(3, 60, time_of_sample_60);
+//   std::vector<SegmentPlanner::Span> plan;
+//   planner.Plan(index.segments, index.index_count, 6 * timescale, &plan);
+
+#ifndef DASHTOHLS_SEGMENT_PLANNER_H_
+#define DASHTOHLS_SEGMENT_PLANNER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "include/DashToHlsApi.h"
+
+namespace dash2hls {
+class SegmentPlanner {
+ public:
+  // A place a planned segment can start or end, sample |sample| of DASH
+  // segment |segment|.  Samples are counted from the start of the DASH
+  // segment across all of its moofs.  |time| is in the index timescale.
+  struct Cut {
+    uint32_t segment;
+    uint32_t sample;
+    uint64_t time;
+  };
+  // Converts the samples from |start| up to, not including, |end|.  An
+  // |end| with a sample of 0 stops at the end of the previous DASH segment.
+  struct Span {
+    Cut start;
+    Cut end;
+  };
+
+  // Sample |sample| of DASH segment |segment| is a sync sample at |time|.
+  // Sample 0 is always one, and adding a sync sample twice does nothing.
+  void AddSyncSample(uint32_t segment, uint32_t sample, uint64_t time);
+
+  // Fills |plan| with spans covering all |count| |segments| whose durations
+  // are as close to |target_duration| as the sync samples allow, in the
+  // index timescale.  Each span ends at the cut closest to its start plus
+  // |target_duration|, which is a greedy choice and not a global optimum.
+  void Plan(const DashToHlsSegment* segments, uint32_t count,
+            uint64_t target_duration, std::vector<Span>* plan) const;
+
+  // DASH segments are numbered by the index, so the sync samples are no
+  // longer valid if it changes.
+  void Clear() {sync_samples_.clear();}
+
+ private:
+  // Sorted by segment and sample, without sample 0.
+  std::vector<Cut> sync_samples_;
+};  // class SegmentPlanner
+}  // namespace dash2hls
+#endif  // DASHTOHLS_SEGMENT_PLANNER_H_
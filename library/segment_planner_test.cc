@@ -0,0 +1,104 @@
+/*
+Copyright 2014 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "library/segment_planner.h"
+
+#include <gtest/gtest.h>
+
+namespace dash2hls {
+namespace {
+// |count| back to back segments of |duration| each, in a timescale of 1000.
+std::vector<DashToHlsSegment> MakeSegments(uint32_t count,
+                                           uint64_t duration) {
+  std::vector<DashToHlsSegment> segments(count);
+  for (uint32_t segment = 0; segment < count; ++segment) {
+    segments[segment].start_time = segment * duration;
+    segments[segment].duration = duration;
+    segments[segment].timescale = 1000;
+    segments[segment].location = 1000 + segment * 5000;
+    segments[segment].length = 5000;
+  }
+  return segments;
+}
+}  // namespace
+
+TEST(Dash2HLS, SegmentPlannerStitch) {
+  // 2s segments planned at 6s become 3 to a segment, the short tail stays.
+  std::vector<DashToHlsSegment> segments = MakeSegments(7, 2000);
+  SegmentPlanner planner;
+  std::vector<SegmentPlanner::Span> plan;
+  planner.Plan(&segments[0], segments.size(), 6000, &plan);
+  ASSERT_EQ(3u, plan.size());
+  EXPECT_EQ(0u, plan[0].start.segment);
+  EXPECT_EQ(3u, plan[0].end.segment);
+  EXPECT_EQ(0u, plan[0].end.sample);
+  EXPECT_EQ(6000u, plan[0].end.time);
+  EXPECT_EQ(3u, plan[1].start.segment);
+  EXPECT_EQ(6u, plan[1].end.segment);
+  EXPECT_EQ(6u, plan[2].start.segment);
+  EXPECT_EQ(7u, plan[2].end.segment);
+  EXPECT_EQ(14000u, plan[2].end.time);
+}
+
+TEST(Dash2HLS, SegmentPlannerSplit) {
+  // 10s segments with sync samples every 2s planned at 4s.
+  std::vector<DashToHlsSegment> segments = MakeSegments(2, 10000);
+  SegmentPlanner planner;
+  for (uint32_t segment = 0; segment < 2; ++segment) {
+    for (uint32_t sample = 60; sample < 300; sample += 60) {
+      planner.AddSyncSample(segment, sample,
+                            segment * 10000 + sample * 100 / 3);
+    }
+  }
+  // Adding the same sync sample again or sample 0 changes nothing.
+  planner.AddSyncSample(0, 120, 4000);
+  planner.AddSyncSample(1, 0, 10000);
+  std::vector<SegmentPlanner::Span> plan;
+  planner.Plan(&segments[0], segments.size(), 4000, &plan);
+  // 0-4, 4-8, 8-12 crossing into the second segment, 12-16, 16-20.
+  ASSERT_EQ(5u, plan.size());
+  EXPECT_EQ(0u, plan[0].start.sample);
+  EXPECT_EQ(0u, plan[0].end.segment);
+  EXPECT_EQ(120u, plan[0].end.sample);
+  EXPECT_EQ(0u, plan[2].start.segment);
+  EXPECT_EQ(240u, plan[2].start.sample);
+  EXPECT_EQ(1u, plan[2].end.segment);
+  EXPECT_EQ(60u, plan[2].end.sample);
+  EXPECT_EQ(12000u, plan[2].end.time);
+  EXPECT_EQ(2u, plan[4].end.segment);
+  EXPECT_EQ(20000u, plan[4].end.time);
+}
+
+TEST(Dash2HLS, SegmentPlannerNearestCut) {
+  // Cuts at 0, 3 and 7s planned at 4s end at 3s, which is closer than 7s.
+  std::vector<DashToHlsSegment> segments = MakeSegments(1, 10000);
+  SegmentPlanner planner;
+  planner.AddSyncSample(0, 90, 3000);
+  planner.AddSyncSample(0, 210, 7000);
+  std::vector<SegmentPlanner::Span> plan;
+  planner.Plan(&segments[0], segments.size(), 4000, &plan);
+  ASSERT_EQ(3u, plan.size());
+  EXPECT_EQ(3000u, plan[0].end.time);
+  EXPECT_EQ(7000u, plan[1].end.time);
+  EXPECT_EQ(10000u, plan[2].end.time);
+
+  // Without sync samples a long segment cannot be split.
+  planner.Clear();
+  planner.Plan(&segments[0], segments.size(), 4000, &plan);
+  ASSERT_EQ(1u, plan.size());
+  EXPECT_EQ(1u, plan[0].end.segment);
+}
+}  // namespace dash2hls
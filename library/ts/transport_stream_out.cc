@@ -30,8 +30,16 @@ const size_t kPcrAdaptationSize = 8;
 const size_t kTsPacketSize = 188;
 const size_t kTsPayloadSize = 184;
 const uint8_t kTsSync = 0x47;
-const size_t kAudioFrameHeaderSize = 7;
-const size_t kMaxAudioFrameLength = 8191;
+const size_t kTsHeaderSize = 4;
+const size_t kTsContinuityOffset = 3;
+// PES_packet_length is 16 bits and counts the 3 optional header bytes and
+// the pts.
+const size_t kMaxAudioPesPayload = 0xffff - 3 - 5;
+
+// TS bytes needed to carry a PES of |pes_size| bytes.
+size_t TsBytesForPes(size_t pes_size) {
+  return ((pes_size + kTsPayloadSize - 1) / kTsPayloadSize) * kTsPacketSize;
+}
 }  // namespace
 
 namespace dash2hls {
@@ -60,54 +68,114 @@ const uint8_t TransportStreamOut::kPmtAudio[59] = {
   0x00, 0x00, 0x0f, 0xe0, 0x22, 0xf0, 0x00, 0x00,
   0x00, 0x00, 0x00};
 const size_t kPmtAudioConfigOffset = 48;
-const size_t kPmtAudioCrcOffset = 55;
 
-// TODO(justsomeguy) Code copied from the Widevine tree has quite a few
-// magic numbers.  This is because it builds up the header by adding bits
-// and shifting, adding bits and shifting.  I want to rewrite this to build
-// in place and use constants.
+// The muxed PMT is the audio PMT with the PCR moved to the video PID and an
+// H.264 stream listed ahead of the audio stream.
+const uint8_t kPmtVideoStream[5] = {0x1b, 0xe0, 0x21, 0xf0, 0x00};
+// A stream entry with no descriptors.
+const size_t kPmtStreamSize = 5;
+const size_t kPmtSectionLengthOffset = 3;
+const size_t kPmtPcrPidOffset = 9;
+const size_t kPmtVideoStreamOffset = 13;
+const size_t kPmtAudioStreamOffset = 50;
+const size_t kPmtCrcSize = 4;
+
+// SAMPLE-AES streams, see the Apple "MPEG-2 Stream Encryption Format for
+// HTTP Live Streaming".  Video is stream type 0xdb with a
+// private_data_indicator_descriptor of 'zavc'.  Audio is 0xcf with 'aacd'
+// and a registration_descriptor of 'apad' holding the
+// audio_setup_information: 'zaac', no priming, version 1 and the 2 byte
+// AudioSpecificConfig at kPmtSampleAesAudioConfigOffset.
+const uint8_t kPmtSampleAesVideoStream[11] = {
+  0xdb, 0xe0, 0x21, 0xf0, 0x06, 0x0f, 0x04, 0x7a,
+  0x61, 0x76, 0x63};
+const uint8_t kPmtSampleAesAudioStream[27] = {
+  0xcf, 0xe0, 0x22, 0xf0, 0x16, 0x0f, 0x04, 0x61,
+  0x61, 0x63, 0x64, 0x05, 0x0e, 0x61, 0x70, 0x61,
+  0x64, 0x7a, 0x61, 0x61, 0x63, 0x00, 0x00, 0x01,
+  0x02, 0x00, 0x00};
+const size_t kPmtSampleAesAudioConfigOffset = 25;
+
+// Replaces the stream entry at |offset| of |pmt|, which has no CRC yet,
+// with the |stream_size| bytes of |stream|.
+void ReplacePmtStream(size_t offset, const uint8_t* stream,
+                      size_t stream_size, std::vector<uint8_t>* pmt) {
+  pmt->erase(pmt->begin() + offset, pmt->begin() + offset + kPmtStreamSize);
+  pmt->insert(pmt->begin() + offset, stream, stream + stream_size);
+  (*pmt)[kPmtSectionLengthOffset] += stream_size - kPmtStreamSize;
+}
+
+void AppendPmtCrc(std::vector<uint8_t>* pmt) {
+  pmt->resize(pmt->size() + kPmtCrcSize);
+  htonlToBuffer(static_cast<uint32_t>(wvcrc32(
+      &(*pmt)[1], static_cast<uint32_t>(pmt->size() - 5))),
+                &(*pmt)[pmt->size() - kPmtCrcSize]);
+}
+
 void TransportStreamOut::FrameAudio(const uint8_t* input, size_t input_length,
-                                    std::vector<uint8_t>* out) const {
-  size_t frame_size = input_length + kAudioFrameHeaderSize;
-  if (frame_size > kMaxAudioFrameLength) {
-    DASH_LOG("Bad audio sample",
-             "Audio frames larger than 8191 bytes not supported.",
-             DumpMemory(input, input_length).c_str());
-    return;
+                                    ByteBuffer* out) const {
+  out->resize(input_length + AdtsOut::kHeaderSize);
+  if (!adts_out_.WriteFrame(input, input_length, out->data())) {
+    out->clear();
   }
-  out->resize(frame_size);
-  uint64_t adts_header = 0xfff;
-  adts_header <<= 4;
-  adts_header |= 0x01;
-  adts_header <<= 2;
-  adts_header |= (audio_object_type_ - 1);
-  adts_header <<= 4;
-  adts_header |= sampling_frequency_index_;
-  adts_header <<= 4;
-  adts_header |= channel_config_;
-  adts_header <<= 4;
-  adts_header |= 0x0c;
-  adts_header <<= 13;
-  adts_header |= frame_size;
-  adts_header <<= 11;
-  adts_header |= 0x7ff;
-  adts_header <<=2;
-  adts_header <<= 8;
-  htonllToBuffer(adts_header, out->data());
-  memcpy(out->data() + kAudioFrameHeaderSize, input, input_length);
 }
 
 // Modifies the audio_pmt_ to be the kPmtAudio with the correct audio_config.
 void TransportStreamOut::set_audio_config(const uint8_t config[2]) {
+  audio_config_[0] = config[0];
+  audio_config_[1] = config[1];
+  has_audio_config_ = true;
   // Only way to reset capacity is to swap.
   std::vector<uint8_t>().swap(audio_pmt_);
   audio_pmt_.insert(audio_pmt_.end(), kPmtAudio,
-                    kPmtAudio + sizeof(kPmtAudio));
+                    kPmtAudio + sizeof(kPmtAudio) - kPmtCrcSize);
   audio_pmt_[kPmtAudioConfigOffset] = config[0];
   audio_pmt_[kPmtAudioConfigOffset + 1] = config[1];
-  htonlToBuffer(static_cast<uint32_t>(wvcrc32(
-      &audio_pmt_[1], static_cast<uint32_t>(audio_pmt_.size() - 5))),
-                &audio_pmt_[kPmtAudioCrcOffset]);
+  if (sample_aes_) {
+    uint8_t stream[sizeof(kPmtSampleAesAudioStream)];
+    memcpy(stream, kPmtSampleAesAudioStream, sizeof(stream));
+    stream[kPmtSampleAesAudioConfigOffset] = config[0];
+    stream[kPmtSampleAesAudioConfigOffset + 1] = config[1];
+    ReplacePmtStream(kPmtAudioStreamOffset, stream, sizeof(stream),
+                     &audio_pmt_);
+  }
+
+  muxed_pmt_.assign(audio_pmt_.begin(), audio_pmt_.end());
+  muxed_pmt_[kPmtPcrPidOffset] = 0xe0;
+  muxed_pmt_[kPmtPcrPidOffset + 1] = kPidVideo;
+  const uint8_t* video_stream = kPmtVideoStream;
+  size_t video_stream_size = sizeof(kPmtVideoStream);
+  if (sample_aes_) {
+    video_stream = kPmtSampleAesVideoStream;
+    video_stream_size = sizeof(kPmtSampleAesVideoStream);
+  }
+  muxed_pmt_[kPmtSectionLengthOffset] += video_stream_size;
+  muxed_pmt_.insert(muxed_pmt_.begin() + kPmtAudioStreamOffset,
+                    video_stream, video_stream + video_stream_size);
+
+  AppendPmtCrc(&audio_pmt_);
+  AppendPmtCrc(&muxed_pmt_);
+  ByteBuffer().swap(audio_pmt_packet_);
+  ByteBuffer().swap(muxed_pmt_packet_);
+}
+
+// SAMPLE-AES changes the stream types and adds descriptors, so every PMT is
+// rebuilt.
+void TransportStreamOut::set_sample_aes(const SampleAesEncrypter* encrypter) {
+  sample_aes_ = encrypter;
+  adts_out_.set_sample_aes(encrypter);
+  video_pmt_.clear();
+  if (sample_aes_) {
+    video_pmt_.assign(kPmtVideo, kPmtVideo + sizeof(kPmtVideo) - kPmtCrcSize);
+    ReplacePmtStream(kPmtVideoStreamOffset, kPmtSampleAesVideoStream,
+                     sizeof(kPmtSampleAesVideoStream), &video_pmt_);
+    AppendPmtCrc(&video_pmt_);
+  }
+  ByteBuffer().swap(video_pmt_packet_);
+  if (has_audio_config_) {
+    uint8_t config[2] = {audio_config_[0], audio_config_[1]};
+    set_audio_config(config);
+  }
 }
 
 void TransportStreamOut::ProcessSample(const uint8_t* input,
@@ -116,17 +184,59 @@ void TransportStreamOut::ProcessSample(const uint8_t* input,
                                        bool is_sync_sample,
                                        uint64_t pts, uint64_t dts,
                                        uint64_t scr, uint64_t duration,
-                                       std::vector<uint8_t>* out) {
+                                       ByteBuffer* out) {
+  if (is_video) {
+    std::vector<uint8_t> pes_data(input, input + input_length);
+    ProcessSample(&pes_data, is_video, is_sync_sample, pts, dts, scr,
+                  duration, out);
+    return;
+  }
   // iOS will NOT play with a pts of 0.  So start playing it 1/90,000 of a
   // a second later.
   ++pts;
   ++dts;
+  if (audio_aggregation_duration_) {
+    out->resize(0);
+    AggregateAudio(input, input_length, is_sync_sample, pts, duration, out);
+    return;
+  }
   PES pes;
-  if (is_video) {
-    pes.set_stream_id(PES::kVideoStreamId);
-  } else {
-    pes.set_stream_id(PES::kAudioStreamId);
+  pes.set_stream_id(PES::kAudioStreamId);
+  if (is_sync_sample) {
+    pes.SetDataAlignmentIndicator(true);
+  }
+  pes.SetPts(pts);
+  if (pts != dts) {
+    pes.SetDts(dts);
+  }
+  ByteBuffer audio_frame;
+  FrameAudio(input, input_length, &audio_frame);
+  pes.AddPayload(audio_frame.data(), audio_frame.size());
+  ReserveOutput(input_length, out);
+  if (NeedsPsi(false, is_sync_sample)) {
+    OutputPsi(false, out);
   }
+  // TODO(justsomeguy) Make sure kNoPcr doesn't cause jitters.
+  OutputPesOverTS(pes, kPidAudio, kNoPcr, &audio_continuity_counter, out);
+}
+
+void TransportStreamOut::ProcessSample(std::vector<uint8_t>* input,
+                                       bool is_video,
+                                       bool is_sync_sample,
+                                       uint64_t pts, uint64_t dts,
+                                       uint64_t scr, uint64_t duration,
+                                       ByteBuffer* out) {
+  if (!is_video) {
+    ProcessSample(input->data(), input->size(), is_video, is_sync_sample,
+                  pts, dts, scr, duration, out);
+    return;
+  }
+  // iOS will NOT play with a pts of 0.  So start playing it 1/90,000 of a
+  // a second later.
+  ++pts;
+  ++dts;
+  PES pes;
+  pes.set_stream_id(PES::kVideoStreamId);
   if (is_sync_sample) {
     pes.SetDataAlignmentIndicator(true);
   }
@@ -135,50 +245,128 @@ void TransportStreamOut::ProcessSample(const uint8_t* input,
     pes.SetDts(dts);
   }
 
-  std::vector<uint8_t> pes_data;
-  if (is_video) {
-    pes_data.insert(pes_data.end(), input, input + input_length);
-    bool has_aud;
-    nalu::PicType pic_type;
-    PreprocessNalus(&pes_data, &has_aud, &pic_type);
-    if (!has_aud) {
-      AddNeededNalu(&pes_data, pic_type, is_sync_sample);
-    }
-    ConvertLengthToStartCode(&pes_data);
-    pes.AddPayload(&pes_data[0], pes_data.size());
-  } else {
-    FrameAudio(input, input_length, &pes_data);
-    pes.AddPayload(&pes_data[0], pes_data.size());
+  size_t input_length = input->size();
+  bool has_aud;
+  nalu::PicType pic_type;
+  PreprocessNalus(input, &has_aud, &pic_type);
+  if (!has_aud) {
+    AddNeededNalu(input, pic_type, is_sync_sample);
+  }
+  ConvertLengthToStartCode(input);
+  pes.AddPayload(input->data(), input->size());
+
+  ReserveOutput(input_length, out);
+  if (NeedsPsi(true, is_sync_sample)) {
+    OutputPsi(true, out);
   }
+  OutputPesOverTS(pes, kPidVideo, dts, &video_continuity_counter, out);
+}
 
-  // out is going to grow a bit, reserve the length now so we don't do any
-  // data copies later.  This is longer than it will grow to but not enough
-  // larger to care about memory usage.  We may need TS packets for the
-  // PAT, PMT, and to finish off the input as well as an extra 4 bytes per
-  // packet.  The PES header might push us into one more, so a total of
-  // 4 extra TS packets are reserved.  The are small enough to be safe.
+// out is going to grow a bit, reserve the length now so we don't do any
+// data copies later.  This is longer than it will grow to but not enough
+// larger to care about memory usage.  We may need TS packets for the
+// PAT, PMT, and to finish off the input as well as an extra 4 bytes per
+// packet.  The PES header might push us into one more, so a total of
+// 4 extra TS packets are reserved.  The are small enough to be safe.
+void TransportStreamOut::ReserveOutput(size_t input_length,
+                                       ByteBuffer* out) const {
   out->resize(0);
   out->reserve(input_length + sizeof(kTsPayloadSize * 4) +
                (input_length / kTsPayloadSize) * 4);
-  if (is_sync_sample) {
-    OutputRawDataOverTS(kPat, sizeof(kPat), kPidPat, &pat_continuity_counter,
-                        out);
-    if (is_video) {
-      OutputRawDataOverTS(kPmtVideo, sizeof(kPmtVideo), kPidPmt,
-                          &pmt_continuity_counter, out);
-    } else {
-      OutputRawDataOverTS(audio_pmt_.data(), audio_pmt_.size(), kPidPmt,
-                          &pmt_continuity_counter, out);
-    }
+}
+
+void TransportStreamOut::AggregateAudio(const uint8_t* input,
+                                        size_t input_length,
+                                        bool is_sync_sample, uint64_t pts,
+                                        uint64_t duration,
+                                        ByteBuffer* out) {
+  ByteBuffer frame;
+  FrameAudio(input, input_length, &frame);
+  if (frame.empty()) {
+    return;
   }
-  if (is_video) {
-    OutputPesOverTS(pes, kPidVideo, dts, &video_continuity_counter,
-                    out);
+  if (!pending_audio_.empty() &&
+      ((pending_audio_duration_ + duration > audio_aggregation_duration_) ||
+       (pending_audio_.size() + frame.size() > kMaxAudioPesPayload))) {
+    OutputPendingAudio(out);
+  }
+  if (pending_audio_.empty()) {
+    pending_audio_pts_ = pts;
+    pending_audio_sync_ = is_sync_sample;
+    pending_audio_duration_ = 0;
+  }
+  pending_audio_.append(frame.data(), frame.size());
+  pending_audio_duration_ += duration;
+
+  // What this frame would have cost in its own PES.
+  PES pes;
+  pes.set_stream_id(PES::kAudioStreamId);
+  pes.SetPts(pts);
+  size_t pes_size = pes.GetHeaderSize() + frame.size();
+  size_t ts_bytes = TsBytesForPes(pes_size);
+  ++audio_aggregation_stats_.frames;
+  audio_aggregation_stats_.bytes_saved += ts_bytes;
+  audio_aggregation_stats_.stuffing_bytes_saved +=
+      static_cast<int64_t>(ts_bytes / kTsPacketSize * kTsPayloadSize -
+                           pes_size);
+}
+
+void TransportStreamOut::OutputPendingAudio(ByteBuffer* out) {
+  if (pending_audio_.empty()) {
+    return;
+  }
+  PES pes;
+  pes.set_stream_id(PES::kAudioStreamId);
+  if (pending_audio_sync_) {
+    pes.SetDataAlignmentIndicator(true);
+  }
+  pes.SetPts(pending_audio_pts_);
+  pes.AddPayload(&pending_audio_[0], pending_audio_.size());
+  if (NeedsPsi(false, pending_audio_sync_)) {
+    OutputPsi(false, out);
+  }
+  OutputPesOverTS(pes, kPidAudio, kNoPcr, &audio_continuity_counter, out);
+
+  size_t ts_bytes = TsBytesForPes(pes.GetSize());
+  size_t stuffing = ts_bytes / kTsPacketSize * kTsPayloadSize - pes.GetSize();
+  ++audio_aggregation_stats_.pes_packets;
+  audio_aggregation_stats_.stuffing_bytes += stuffing;
+  audio_aggregation_stats_.bytes_saved -= ts_bytes;
+  audio_aggregation_stats_.stuffing_bytes_saved -=
+      static_cast<int64_t>(stuffing);
+  pending_audio_.clear();
+}
+
+void TransportStreamOut::Flush(ByteBuffer* out) {
+  OutputPendingAudio(out);
+}
+
+bool TransportStreamOut::NeedsPsi(bool is_video, bool is_sync_sample) const {
+  if (has_video_ && has_audio_) {
+    // Audio frames are all sync samples, repeating the PSI on each would
+    // cost two packets per audio PES.
+    return !psi_written_ || (is_video && is_sync_sample);
+  }
+  return is_sync_sample;
+}
+
+void TransportStreamOut::OutputPsi(bool is_video, ByteBuffer* out) {
+  OutputPsiPacket(kPat, sizeof(kPat), kPidPat, &pat_packet_,
+                  &pat_continuity_counter, out);
+  if (has_video_ && has_audio_) {
+    OutputPsiPacket(muxed_pmt_.data(), muxed_pmt_.size(), kPidPmt,
+                    &muxed_pmt_packet_, &pmt_continuity_counter, out);
+  } else if (is_video && sample_aes_) {
+    OutputPsiPacket(video_pmt_.data(), video_pmt_.size(), kPidPmt,
+                    &video_pmt_packet_, &pmt_continuity_counter, out);
+  } else if (is_video) {
+    OutputPsiPacket(kPmtVideo, sizeof(kPmtVideo), kPidPmt,
+                    &video_pmt_packet_, &pmt_continuity_counter, out);
   } else {
-    // TODO(justsomeguy) Make sure kNoPcr doesn't cause jitters.
-    OutputPesOverTS(pes, kPidAudio, kNoPcr, &audio_continuity_counter,
-                    out);
+    OutputPsiPacket(audio_pmt_.data(), audio_pmt_.size(), kPidPmt,
+                    &audio_pmt_packet_, &pmt_continuity_counter, out);
   }
+  psi_written_ = true;
 }
 
 void TransportStreamOut::PreprocessNalus(std::vector<uint8_t>* buffer,
@@ -218,8 +406,13 @@ void TransportStreamOut::AddNeededNalu(std::vector<uint8_t>* buffer,
   }
 }
 
+// SAMPLE-AES encrypts each slice as its start code is written.
 void TransportStreamOut::ConvertLengthToStartCode(
     std::vector<uint8_t>* buffer) {
+  if (sample_aes_) {
+    sample_aes_->EncryptNalus(buffer);
+    return;
+  }
   nalu::ReplaceLengthWithStartCode(&(*buffer)[0], buffer->size());
 }
 
@@ -228,7 +421,7 @@ void TransportStreamOut::ConvertLengthToStartCode(
 void TransportStreamOut::OutputRawDataOverTS(const uint8_t* data,
                                              size_t length, uint16_t pid,
                                              uint16_t* continuity_counter,
-                                             std::vector<uint8_t>* out) {
+                                             ByteBuffer* out) {
   uint32_t num_packets = static_cast<uint32_t>(length / kTsPayloadSize);
   if (length % kTsPayloadSize) {
     ++num_packets;
@@ -282,16 +475,91 @@ void TransportStreamOut::OutputRawDataOverTS(const uint8_t* data,
   }
 }
 
-// TODO(justsomeguy)  There's still magic numbers in here.  Really need to
-// make them constants.
+// Copies a PSI packet built on first use, patching in the continuity
+// counter.
+void TransportStreamOut::OutputPsiPacket(const uint8_t* data, size_t length,
+                                         uint16_t pid,
+                                         ByteBuffer* packet,
+                                         uint16_t* continuity_counter,
+                                         ByteBuffer* out) {
+  if (packet->empty()) {
+    uint16_t unused_counter = 0;
+    OutputRawDataOverTS(data, length, pid, &unused_counter, packet);
+  }
+  size_t original_out_size = out->size();
+  out->append(packet->data(), packet->size());
+  // PSI tables here always fit in a single packet.
+  uint8_t* continuity = &(*out)[original_out_size + kTsContinuityOffset];
+  *continuity = (*continuity & ~kContinuityMask) |
+      (*continuity_counter & kContinuityMask);
+  ++*continuity_counter;
+}
+
+// Writes the 4 byte TS header and the adaptation field, if any, and returns
+// where the payload goes.  |adaptation_size| counts every byte of the
+// adaptation field including its length byte.  |pcr| is only written if it
+// is not kNoPcr, in which case |adaptation_size| must leave room for it.
+uint8_t* TransportStreamOut::WritePacketHeader(
+    uint8_t* packet, uint16_t pid, bool payload_start, size_t adaptation_size,
+    int64_t pcr, uint16_t* continuity_counter) const {
+  uint32_t header = (kTsSync << 24) | (pid << 8) | kPayloadBit |
+      (*continuity_counter & kContinuityMask);
+  if (payload_start) {
+    header |= kPayloadStartBit << 8;
+  }
+  if (adaptation_size > 0) {
+    header |= kAdaptationBit;
+  }
+  htonlToBuffer(header, packet);
+  ++*continuity_counter;
+  packet += kTsHeaderSize;
+  if (adaptation_size > 0) {
+    *packet = static_cast<uint8_t>(adaptation_size - 1);
+    ++packet;
+    --adaptation_size;
+    if (adaptation_size > 0) {
+      if (pcr != kNoPcr) {
+        *packet = kAdaptationPcr;
+        ++packet;
+        htonlToBuffer(static_cast<uint32_t>(pcr >> 1), packet);
+        packet += sizeof(uint32_t);
+        *packet = (pcr & 0x01) ? 0x80 : 0x00;
+        *packet |= 0x7E;  // 6 reserved bits
+        ++packet;
+        *packet = 0;
+        ++packet;
+        adaptation_size -= kPcrAdaptationSize - 1;
+      } else {
+        *packet = 0;
+        ++packet;
+        --adaptation_size;
+      }
+      memset(packet, kAdaptationFiller, adaptation_size);
+      packet += adaptation_size;
+    }
+  }
+  return packet;
+}
+
+// Only the first packet (PES header and the optional PCR) and the last
+// packet (stuffing) need any thought.  Every packet in between is a header
+// stamped with a single 32 bit store and 184 bytes copied straight out of
+// the payload, so most of the time is spent in memcpy.
 void TransportStreamOut::OutputPesOverTS(const PES& pes, uint16_t pid,
                                          int64_t pcr,
                                          uint16_t* continuity_counter,
-                                         std::vector<uint8_t>* out) {
-  size_t length = pes.GetSize();
-  if (pcr != kNoPcr) {
-    length += kPcrAdaptationSize;
+                                         ByteBuffer* out) {
+  uint8_t pes_header[PES::kMaxHeaderSize];
+  size_t pes_header_size = pes.GetHeaderSize();
+  if (pes_header_size > sizeof(pes_header)) {
+    DASH_LOG("Bad PES", "PES header is too large.", "");
+    return;
   }
+  pes.WriteHeader(pes_header, sizeof(pes_header));
+  const uint8_t* payload = pes.get_payload();
+  size_t payload_left = pes.get_payload_size();
+  size_t pcr_size = (pcr != kNoPcr) ? kPcrAdaptationSize : 0;
+  size_t length = pes_header_size + payload_left + pcr_size;
   uint32_t num_packets = static_cast<uint32_t>(length / kTsPayloadSize);
   if (length % kTsPayloadSize) {
     ++num_packets;
@@ -299,70 +567,43 @@ void TransportStreamOut::OutputPesOverTS(const PES& pes, uint16_t pid,
   size_t original_out_size = out->size();
   out->resize(original_out_size + num_packets * kTsPacketSize);
   uint8_t* write_pointer = &(*out)[original_out_size];
-  bool first_packet = true;
-  size_t pes_position = 0;
-  while (num_packets > 0) {
-    *write_pointer = kTsSync;
-    ++write_pointer;
-    if (first_packet) {
-      htonsToBuffer(kPayloadStartBit | pid, write_pointer);
-    } else {
-      htonsToBuffer(pid, write_pointer);
-    }
-    write_pointer += sizeof(pid);
 
-    size_t adaptation_size = 0;
-    if (first_packet  && (pcr != kNoPcr)) {
-      adaptation_size = kPcrAdaptationSize;
-    }
-    size_t bytes_to_write = 0;
-    if (length < kTsPayloadSize) {
-      adaptation_size += kTsPayloadSize - length;
-      bytes_to_write = length;
-      length = 0;
-    } else {
-      bytes_to_write = kTsPayloadSize - adaptation_size;
-      length -= kTsPayloadSize;
-    }
-    if (adaptation_size > 0) {
-      *write_pointer = kAdaptationBit | kPayloadBit;
-    } else {
-      *write_pointer = kPayloadBit;
-    }
-    *write_pointer |= (*continuity_counter & kContinuityMask);
-    ++*continuity_counter;
-    ++write_pointer;
+  // First packet, the PES header has to fit in it.
+  size_t first_size = kTsPayloadSize - pcr_size;
+  if (pes_header_size + payload_left < first_size) {
+    first_size = pes_header_size + payload_left;
+  }
+  write_pointer = WritePacketHeader(write_pointer, pid, true,
+                                    kTsPayloadSize - first_size, pcr,
+                                    continuity_counter);
+  memcpy(write_pointer, pes_header, pes_header_size);
+  write_pointer += pes_header_size;
+  size_t first_payload = first_size - pes_header_size;
+  memcpy(write_pointer, payload, first_payload);
+  write_pointer += first_payload;
+  payload += first_payload;
+  payload_left -= first_payload;
 
-    if (adaptation_size > 0) {
-      *write_pointer = adaptation_size - 1;
-      ++write_pointer;
-      --adaptation_size;
-      if (adaptation_size > 0) {
-        if (first_packet && (pcr != kNoPcr)) {
-          *write_pointer = kAdaptationPcr;
-          ++write_pointer;
-          htonlToBuffer(static_cast<uint32_t>(pcr >> 1), write_pointer);
-          write_pointer += sizeof(uint32_t);
-          *write_pointer = (pcr & 0x01) ? 0x80 : 0x00;
-          *write_pointer |= 0x7E;  // 6 reserved bits
-          ++write_pointer;
-          *write_pointer = 0;
-          ++write_pointer;
-          adaptation_size -= 7;
-        } else {
-          *write_pointer = 0;
-          ++write_pointer;
-          --adaptation_size;
-        }
-        memset(write_pointer, kAdaptationFiller, adaptation_size);
-        write_pointer += adaptation_size;
-      }
-    }
-    pes.WritePartial(write_pointer, pes_position, bytes_to_write);
-    pes_position += bytes_to_write;
-    write_pointer += bytes_to_write;
-    --num_packets;
-    first_packet = false;
+  // Full packets.
+  const uint32_t header = (kTsSync << 24) | (pid << 8) | kPayloadBit;
+  size_t full_packets = payload_left / kTsPayloadSize;
+  uint16_t counter = *continuity_counter;
+  for (size_t count = 0; count < full_packets; ++count) {
+    htonlToBuffer(header | (counter & kContinuityMask), write_pointer);
+    ++counter;
+    memcpy(write_pointer + kTsHeaderSize, payload, kTsPayloadSize);
+    write_pointer += kTsPacketSize;
+    payload += kTsPayloadSize;
+  }
+  *continuity_counter = counter;
+  payload_left -= full_packets * kTsPayloadSize;
+
+  // Last packet, padded with stuffing.
+  if (payload_left > 0) {
+    write_pointer = WritePacketHeader(write_pointer, pid, false,
+                                      kTsPayloadSize - payload_left, kNoPcr,
+                                      continuity_counter);
+    memcpy(write_pointer, payload, payload_left);
   }
 }
 }  // namespace dash2hls
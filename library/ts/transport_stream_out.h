@@ -21,10 +21,17 @@ limitations under the License.
 //
 // Expected usage is to call TransportStreamOut::ProcessSample.
 // All other routines are exposed for unit testing.
+//
+// With set_sample_aes the samples are encrypted for SAMPLE-AES while they
+// are framed, video as the nalu lengths become start codes, and the PMT
+// lists the encrypted stream types.
 
 #include <vector>
 
 #include "include/DashToHlsApi.h"
+#include "library/adts/adts_out.h"
+#include "library/byte_buffer.h"
+#include "library/crypto/sample_aes_encrypter.h"
 #include "library/dash/box_type.h"
 #include "library/dash/full_box_contents.h"
 #include "library/ps/nalu.h"
@@ -37,15 +44,36 @@ class TransportStreamOut {
   TransportStreamOut() : nalu_length_(0),
                          has_video_(false),
                          has_audio_(false),
-                         audio_object_type_(0),
-                         sampling_frequency_index_(0),
-                         channel_config_(0),
+                         has_audio_config_(false),
+                         sample_aes_(nullptr),
+                         psi_written_(false),
+                         audio_aggregation_duration_(0),
+                         pending_audio_pts_(0),
+                         pending_audio_duration_(0),
+                         pending_audio_sync_(false),
                          pmt_continuity_counter(0),
                          pat_continuity_counter(0),
                          video_continuity_counter(0),
                          audio_continuity_counter(0) {
   }
 
+  // Counters for audio aggregation, see set_audio_aggregation_duration.
+  struct AudioAggregationStats {
+    AudioAggregationStats()
+        : frames(0), pes_packets(0), stuffing_bytes(0),
+          stuffing_bytes_saved(0), bytes_saved(0) {}
+    uint64_t frames;
+    uint64_t pes_packets;
+    // Adaptation field stuffing actually written for audio.
+    uint64_t stuffing_bytes;
+    // Stuffing one PES per frame would have written on top of that.
+    // Negative when frames that fill their packets alone need stuffing
+    // packed together.
+    int64_t stuffing_bytes_saved;
+    // All TS bytes saved: stuffing plus the TS and PES headers.
+    uint64_t bytes_saved;
+  };
+
   enum {
     kPidPat = 0x00,
     kPidPmt = 0x20,
@@ -53,27 +81,65 @@ class TransportStreamOut {
     kPidAudio = 0x22,
   };
 
-  // TODO(justsomeguy) this interface requires an extra copy of input because
-  // it's const.  See about doing it in place.
+  // Video samples are copied once for their NALUs to be rewritten, see the
+  // version below to avoid it.
   void ProcessSample(const uint8_t* input, size_t input_length,
                      bool is_video,
                      bool is_sync_sample,
                      uint64_t pts, uint64_t dts, uint64_t scr,
                      uint64_t duration,
-                     std::vector<uint8_t>* out);
+                     ByteBuffer* out);
+  // The same with a sample the caller has in a buffer of its own, such as
+  // the one it was decrypted into.  Video NALUs are rewritten in |input|,
+  // which is left holding the PES payload.
+  void ProcessSample(std::vector<uint8_t>* input,
+                     bool is_video,
+                     bool is_sync_sample,
+                     uint64_t pts, uint64_t dts, uint64_t scr,
+                     uint64_t duration,
+                     ByteBuffer* out);
+
+  // An AAC frame is usually 200 to 400 bytes, so a PES per frame spends
+  // about half of the TS bytes on headers and stuffing.  With a non zero
+  // |duration| (in 90kHz ticks, 9000 is 100ms) consecutive audio frames are
+  // held back and packed into one PES covering up to |duration|.  The PES
+  // goes out when the next frame would not fit, so ProcessSample often
+  // returns nothing for audio.  Call Flush at the end of a segment.
+  void set_audio_aggregation_duration(uint64_t duration) {
+    audio_aggregation_duration_ = duration;
+  }
+  // Appends to |out| any audio held back for aggregation.
+  void Flush(ByteBuffer* out);
+  const AudioAggregationStats& get_audio_aggregation_stats() const {
+    return audio_aggregation_stats_;
+  }
 
+  // With both set_has_video and set_has_audio one program carries both
+  // streams: a single PMT lists video on kPidVideo and audio on kPidAudio,
+  // video carries the PCR, and PAT/PMT lead the output and repeat on each
+  // video sync sample.  The caller interleaves the samples by dts.
   void set_has_video(bool flag) {has_video_ = flag;}
   void set_nalu_length(size_t nalu_length) {nalu_length_ = nalu_length;}
   void set_sps_pps(const std::vector<uint8_t>& sps_pps) {sps_pps_ = sps_pps;}
 
   void set_has_audio(bool flag) {has_audio_ = flag;}
-  void set_audio_object_type(uint8_t type) {audio_object_type_ = type;}
+  void set_audio_object_type(uint8_t type) {
+    adts_out_.set_audio_object_type(type);
+  }
   void set_sampling_frequency_index(uint8_t index) {
-    sampling_frequency_index_ = index;
+    adts_out_.set_sampling_frequency_index(index);
+  }
+  void set_channel_config(uint8_t config) {
+    adts_out_.set_channel_config(config);
   }
-  void set_channel_config(uint8_t config) {channel_config_ = config;}
   void set_audio_config(const uint8_t config[2]);
   const std::vector<uint8_t>& get_audio_pmt() {return audio_pmt_;}
+  const std::vector<uint8_t>& get_muxed_pmt() {return muxed_pmt_;}
+
+  // |encrypter| must outlive the TransportStreamOut, nullptr writes clear
+  // samples.
+  void set_sample_aes(const SampleAesEncrypter* encrypter);
+  const std::vector<uint8_t>& get_video_pmt() {return video_pmt_;}
 
  protected:
   void PreprocessNalus(std::vector<uint8_t>* buffer, bool* has_aud,
@@ -81,15 +147,29 @@ class TransportStreamOut {
   void AddNeededNalu(std::vector<uint8_t>* buffer, nalu::PicType pic_type,
                      bool is_sync_sample);
   void ConvertLengthToStartCode(std::vector<uint8_t>* buffer);
+  void ReserveOutput(size_t input_length, ByteBuffer* out) const;
   void OutputRawDataOverTS(const uint8_t* data, size_t length, uint16_t pid,
                            uint16_t* continuity_counter,
-                           std::vector<uint8_t>* out);
+                           ByteBuffer* out);
   void OutputPesOverTS(const PES& data, uint16_t pid, int64_t pcr,
                        uint16_t* continuity_counter,
-                       std::vector<uint8_t>* out);
+                       ByteBuffer* out);
+  uint8_t* WritePacketHeader(uint8_t* packet, uint16_t pid,
+                             bool payload_start, size_t adaptation_size,
+                             int64_t pcr, uint16_t* continuity_counter) const;
+  void OutputPsiPacket(const uint8_t* data, size_t length, uint16_t pid,
+                       ByteBuffer* packet,
+                       uint16_t* continuity_counter,
+                       ByteBuffer* out);
   const uint8_t* GetPmtAudio() const;
   void FrameAudio(const uint8_t* input, size_t input_length,
-                  std::vector<uint8_t>* output) const;
+                  ByteBuffer* output) const;
+  void AggregateAudio(const uint8_t* input, size_t input_length,
+                      bool is_sync_sample, uint64_t pts, uint64_t duration,
+                      ByteBuffer* out);
+  void OutputPendingAudio(ByteBuffer* out);
+  bool NeedsPsi(bool is_video, bool is_sync_sample) const;
+  void OutputPsi(bool is_video, ByteBuffer* out);
 
  protected:
   static const uint8_t kID3AudioTimeTag[73];
@@ -104,10 +184,31 @@ class TransportStreamOut {
   std::vector<uint8_t> sps_pps_;
 
   bool has_audio_;
-  uint8_t audio_object_type_;
-  uint8_t sampling_frequency_index_;
-  uint8_t channel_config_;
+  // Frames the audio samples.
+  AdtsOut adts_out_;
   std::vector<uint8_t> audio_pmt_;
+  uint8_t audio_config_[2];
+  bool has_audio_config_;
+
+  const SampleAesEncrypter* sample_aes_;
+  // Only used for SAMPLE-AES, clear video uses kPmtVideo.
+  std::vector<uint8_t> video_pmt_;
+
+  // The PAT and PMT never change, so they are packetized once and only the
+  // continuity counter is patched when they are repeated.
+  ByteBuffer pat_packet_;
+  ByteBuffer video_pmt_packet_;
+  ByteBuffer audio_pmt_packet_;
+  std::vector<uint8_t> muxed_pmt_;
+  ByteBuffer muxed_pmt_packet_;
+  bool psi_written_;
+
+  uint64_t audio_aggregation_duration_;
+  ByteBuffer pending_audio_;
+  uint64_t pending_audio_pts_;
+  uint64_t pending_audio_duration_;
+  bool pending_audio_sync_;
+  AudioAggregationStats audio_aggregation_stats_;
 
   uint16_t pmt_continuity_counter;
   uint16_t pat_continuity_counter;
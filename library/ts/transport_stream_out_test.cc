@@ -17,6 +17,9 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
+#include "library/utilities.h"
 #include "library/utilities_gmock.h"
 #include "library/ts/transport_stream_out.h"
 
@@ -251,11 +254,29 @@ class TransportStreamOutTest : public TransportStreamOut {
   using TransportStreamOut::OutputRawDataOverTS;
   using TransportStreamOut::OutputPesOverTS;
   using TransportStreamOut::FrameAudio;
+  using TransportStreamOut::ConvertLengthToStartCode;
 };
 
+// Strips the TS packet and adaptation headers and returns the payloads.
+std::vector<uint8_t> ExtractTsPayload(const std::vector<uint8_t>& ts,
+                                      uint16_t pid) {
+  std::vector<uint8_t> payload;
+  for (size_t packet = 0; packet + 188 <= ts.size(); packet += 188) {
+    EXPECT_EQ(0x47, ts[packet]);
+    EXPECT_EQ(pid, ntohsFromBuffer(&ts[packet + 1]) & 0x1fff);
+    size_t start = packet + 4;
+    if (ts[packet + 3] & 0x20) {
+      start += ts[packet + 4] + 1;
+    }
+    payload.insert(payload.end(), ts.begin() + start,
+                   ts.begin() + packet + 188);
+  }
+  return payload;
+}
+
 TEST(TransportStreamOut, PAT) {
   TransportStreamOutTest ts_out;
-  std::vector<uint8_t> output;
+  ByteBuffer output;
   uint16_t continuity_counter = 0;
   ts_out.OutputRawDataOverTS(TransportStreamOutTest::kPat,
                              sizeof(TransportStreamOutTest::kPat),
@@ -268,7 +289,7 @@ TEST(TransportStreamOut, PAT) {
 
 TEST(TransportStreamOut, PMT) {
   TransportStreamOutTest ts_out;
-  std::vector<uint8_t> output;
+  ByteBuffer output;
   uint16_t continuity_counter = 0;
   ts_out.OutputRawDataOverTS(TransportStreamOutTest::kPmtVideo,
                              sizeof(TransportStreamOutTest::kPmtVideo),
@@ -281,7 +302,7 @@ TEST(TransportStreamOut, PMT) {
 
 TEST(TransportStreamOut, Video) {
   TransportStreamOutTest ts_out;
-  std::vector<uint8_t> output;
+  ByteBuffer output;
   uint16_t continuity_counter = 0;
   PES pes1;
   pes1.AddPayload(kPes1, sizeof(kPes1));
@@ -304,7 +325,7 @@ TEST(TransportStreamOut, Video) {
   pes2.SetCopyright(true);
   pes2.SetOriginal(true);
   // Only way to reset capacity is to swap.
-  std::vector<uint8_t>().swap(output);
+  ByteBuffer().swap(output);
   ts_out.OutputPesOverTS(pes2, TransportStreamOut::kPidVideo, kPesPcr,
                          &continuity_counter, &output);
   EXPECT_EQ(3, continuity_counter);
@@ -318,7 +339,7 @@ TEST(TransportStreamOut, Video) {
   pes3.SetPts(kPesPts);
   pes3.SetCopyright(true);
   pes3.SetOriginal(true);
-  std::vector<uint8_t>().swap(output);
+  ByteBuffer().swap(output);
   ts_out.OutputPesOverTS(pes3, TransportStreamOut::kPidVideo, kPesPcr,
                          &continuity_counter, &output);
   EXPECT_EQ(4, continuity_counter);
@@ -326,6 +347,91 @@ TEST(TransportStreamOut, Video) {
               testing::MemEq(kPes3Expected, sizeof(kPes3Expected)));
 }
 
+TEST(TransportStreamOut, LargePes) {
+  TransportStreamOutTest ts_out;
+  std::vector<uint8_t> payload(184 * 5 + 17);
+  for (size_t count = 0; count < payload.size(); ++count) {
+    payload[count] = static_cast<uint8_t>(count);
+  }
+  PES pes;
+  pes.AddPayload(&payload[0], payload.size());
+  pes.set_stream_id(PES::kVideoStreamId);
+  pes.SetPts(kPesPts);
+  ByteBuffer output;  // Output is appended.
+  output.resize(188);
+  memset(output.data(), 0xaa, output.size());
+  uint16_t continuity_counter = 14;
+  ts_out.OutputPesOverTS(pes, TransportStreamOut::kPidVideo, kPesPcr,
+                         &continuity_counter, &output);
+  size_t length = pes.GetSize() + 8;
+  size_t packets = (length + 183) / 184;
+  ASSERT_EQ(188 * (packets + 1), output.size());
+  EXPECT_EQ(14 + packets, continuity_counter);
+  std::vector<uint8_t> ts(output.begin() + 188, output.end());
+  for (size_t packet = 0; packet < packets; ++packet) {
+    EXPECT_EQ((14 + packet) & 0x0f, ts[packet * 188 + 3] & 0x0f);
+    EXPECT_EQ(packet == 0, (ts[packet * 188 + 1] & 0x40) != 0);
+  }
+  // PCR only on the first packet.
+  EXPECT_EQ(0x10, ts[5]);
+
+  std::vector<uint8_t> expected(pes.GetSize());
+  pes.Write(&expected[0], expected.size());
+  EXPECT_EQ(expected, ExtractTsPayload(ts, TransportStreamOut::kPidVideo));
+}
+
+TEST(TransportStreamOut, RepeatedPsi) {
+  TransportStreamOutTest ts_out;
+  ts_out.set_nalu_length(4);
+  const uint8_t kSample[] = {0x00, 0x00, 0x00, 0x02, 0x41, 0x9a};
+  ByteBuffer output;
+  for (size_t count = 0; count < 3; ++count) {
+    ts_out.ProcessSample(kSample, sizeof(kSample), true, true, 1000, 1000,
+                         1000, 0, &output);
+    ASSERT_LE(188 * 2, output.size());
+    std::vector<uint8_t> pat(output.begin(), output.begin() + 188);
+    std::vector<uint8_t> pmt(output.begin() + 188, output.begin() + 376);
+    EXPECT_EQ(count, pat[3] & 0x0f);
+    EXPECT_EQ(count, pmt[3] & 0x0f);
+    pat[3] &= 0xf0;
+    pmt[3] &= 0xf0;
+    EXPECT_THAT(std::make_pair(&pat[0], pat.size()),
+                testing::MemEq(kExpectedPatOutput,
+                               sizeof(kExpectedPatOutput)));
+    EXPECT_THAT(std::make_pair(&pmt[0], pmt.size()),
+                testing::MemEq(kExpectedPmtOutput,
+                               sizeof(kExpectedPmtOutput)));
+  }
+}
+
+TEST(TransportStreamOut, VideoSampleInPlace) {
+  const uint8_t kSample[] = {0x00, 0x00, 0x00, 0x02, 0x41, 0x9a,
+                             0x00, 0x00, 0x00, 0x03, 0x41, 0x9b, 0x01};
+  TransportStreamOutTest copied_out;
+  copied_out.set_nalu_length(4);
+  ByteBuffer expected;
+  copied_out.ProcessSample(kSample, sizeof(kSample), true, true, 1000, 1000,
+                           1000, 0, &expected);
+
+  // The NALUs are rewritten in the caller's buffer, with the same output.
+  TransportStreamOutTest ts_out;
+  ts_out.set_nalu_length(4);
+  std::vector<uint8_t> sample(kSample, kSample + sizeof(kSample));
+  ByteBuffer output;
+  ts_out.ProcessSample(&sample, true, true, 1000, 1000, 1000, 0, &output);
+  ASSERT_EQ(expected.size(), output.size());
+  EXPECT_EQ(0, memcmp(expected.data(), output.data(), output.size()));
+  // After the PAT and PMT.
+  ASSERT_LT(188u * 2, output.size());
+  std::vector<uint8_t> video =
+      ExtractTsPayload(std::vector<uint8_t>(output.begin() + 188 * 2,
+                                            output.end()),
+                       TransportStreamOut::kPidVideo);
+  ASSERT_LE(sample.size(), video.size());
+  EXPECT_TRUE(std::equal(sample.begin(), sample.end(),
+                         video.end() - sample.size()));
+}
+
 TEST(TransportStreamOut, AudioPMT) {
   TransportStreamOutTest ts_out;
   ts_out.set_audio_config(kAudioConfig);
@@ -335,15 +441,246 @@ TEST(TransportStreamOut, AudioPMT) {
                              sizeof(kExpectedAudioPmtOutput)));
 }
 
+TEST(TransportStreamOut, SampleAesPmt) {
+  const uint8_t kKey[16] = {1};
+  SampleAesEncrypter encrypter;
+  encrypter.Init(kKey, kKey);
+  TransportStreamOutTest ts_out;
+  ts_out.set_audio_config(kAudioConfig);
+  ts_out.set_sample_aes(&encrypter);
+
+  // Video is listed as 0xdb with 'zavc'.
+  std::vector<uint8_t> video_pmt = ts_out.get_video_pmt();
+  ASSERT_EQ(28u, video_pmt.size());
+  EXPECT_EQ(video_pmt.size() - 4, video_pmt[3]);
+  EXPECT_EQ(0xdb, video_pmt[13]);
+  EXPECT_EQ(0, memcmp("zavc", &video_pmt[20], 4));
+  EXPECT_EQ(wvcrc32(&video_pmt[1], static_cast<uint32_t>(video_pmt.size() -
+                                                          5)),
+            ntohlFromBuffer(&video_pmt[video_pmt.size() - 4]));
+
+  // Audio as 0xcf with 'aacd' and the audio setup information.
+  std::vector<uint8_t> audio_pmt = ts_out.get_audio_pmt();
+  ASSERT_EQ(sizeof(kExpectedAudioPmtOutput) + 22, audio_pmt.size());
+  EXPECT_EQ(audio_pmt.size() - 4, audio_pmt[3]);
+  EXPECT_EQ(0xcf, audio_pmt[50]);
+  EXPECT_EQ(0, memcmp("aacd", &audio_pmt[57], 4));
+  EXPECT_EQ(0, memcmp("apadzaac", &audio_pmt[63], 8));
+  EXPECT_EQ(0, memcmp(kAudioConfig, &audio_pmt[75], 2));
+  EXPECT_EQ(wvcrc32(&audio_pmt[1], static_cast<uint32_t>(audio_pmt.size() -
+                                                          5)),
+            ntohlFromBuffer(&audio_pmt[audio_pmt.size() - 4]));
+
+  const std::vector<uint8_t>& muxed_pmt = ts_out.get_muxed_pmt();
+  ASSERT_EQ(audio_pmt.size() + 11, muxed_pmt.size());
+  EXPECT_EQ(0xdb, muxed_pmt[50]);
+  EXPECT_EQ(0xcf, muxed_pmt[61]);
+
+  // Clearing it brings the clear PMTs back.
+  ts_out.set_sample_aes(nullptr);
+  EXPECT_THAT(std::make_pair(ts_out.get_audio_pmt().data(),
+                             ts_out.get_audio_pmt().size()),
+              testing::MemEq(kExpectedAudioPmtOutput,
+                             sizeof(kExpectedAudioPmtOutput)));
+}
+
+TEST(TransportStreamOut, SampleAesVideo) {
+  const uint8_t kKey[16] = {1};
+  SampleAesEncrypter encrypter;
+  encrypter.Init(kKey, kKey);
+  TransportStreamOutTest ts_out;
+  ts_out.set_nalu_length(4);
+  ts_out.set_sample_aes(&encrypter);
+
+  // A 100 byte slice is written as the encrypter writes it.
+  std::vector<uint8_t> sample(4 + 100, 0x5a);
+  htonlToBuffer(100, &sample[0]);
+  sample[4] = 0x41;
+  std::vector<uint8_t> nalus(sample.begin(), sample.end());
+  ts_out.ConvertLengthToStartCode(&nalus);
+  std::vector<uint8_t> expected(sample.begin(), sample.end());
+  ASSERT_TRUE(encrypter.EncryptNalus(&expected));
+  EXPECT_EQ(expected, nalus);
+  EXPECT_EQ(0, memcmp("\000\000\000\001", &nalus[0], 4));
+  EXPECT_NE(0, memcmp(&sample[4 + 32], &nalus[4 + 32], 16));
+
+  ByteBuffer output;
+  ts_out.ProcessSample(&sample[0], sample.size(), true, true, 0, 0, 0, 3000,
+                       &output);
+  std::vector<uint8_t> pmt = ExtractTsPayload(
+      std::vector<uint8_t>(output.begin() + 188, output.begin() + 376),
+      TransportStreamOut::kPidPmt);
+  const std::vector<uint8_t>& video_pmt = ts_out.get_video_pmt();
+  ASSERT_LE(video_pmt.size(), pmt.size());
+  EXPECT_TRUE(std::equal(video_pmt.begin(), video_pmt.end(), pmt.begin()));
+}
+
 TEST(TransportStreamOut, Audio) {
   TransportStreamOutTest ts_out;
   ts_out.set_audio_object_type(kExpectedAudioObjectType);
   ts_out.set_sampling_frequency_index(kExpectedSampleFrequencyIndex);
   ts_out.set_channel_config(kExpectedChannelConfig);
   ts_out.set_audio_config(kAudioConfig);
-  std::vector<uint8_t> output;
+  ByteBuffer output;
   ts_out.FrameAudio(kAudioIn, sizeof(kAudioIn), &output);
   EXPECT_THAT(std::make_pair(&output[0], output.size()),
               testing::MemEq(kExpectedAudioOut, sizeof(kExpectedAudioOut)));
 }
+
+TEST(TransportStreamOut, AudioAggregation) {
+  const uint64_t kFrameDuration = 1920;  // 1024 samples at 48kHz.
+  const size_t kFrames = 10;
+  std::vector<uint8_t> frame(300, 0x5a);
+  ByteBuffer framed;
+  TransportStreamOutTest ts_out;
+  ts_out.set_audio_object_type(kExpectedAudioObjectType);
+  ts_out.set_sampling_frequency_index(kExpectedSampleFrequencyIndex);
+  ts_out.set_channel_config(kExpectedChannelConfig);
+  ts_out.set_audio_config(kAudioConfig);
+  ts_out.FrameAudio(&frame[0], frame.size(), &framed);
+
+  size_t unaggregated_size = 0;
+  {
+    TransportStreamOutTest plain_out;
+    plain_out.set_audio_config(kAudioConfig);
+    ByteBuffer output;
+    for (size_t count = 0; count < kFrames; ++count) {
+      plain_out.ProcessSample(&frame[0], frame.size(), false, true,
+                              count * kFrameDuration, count * kFrameDuration,
+                              0, kFrameDuration, &output);
+      unaggregated_size += output.size();
+    }
+  }
+
+  // 9000 ticks holds 4 frames, so PES packets of 4, 4 and 2 frames.
+  ts_out.set_audio_aggregation_duration(9000);
+  std::vector<std::vector<uint8_t> > pes_outputs;
+  ByteBuffer output;
+  for (size_t count = 0; count < kFrames; ++count) {
+    ts_out.ProcessSample(&frame[0], frame.size(), false, true,
+                         count * kFrameDuration, count * kFrameDuration, 0,
+                         kFrameDuration, &output);
+    if (!output.empty()) {
+      pes_outputs.push_back(
+          std::vector<uint8_t>(output.begin(), output.end()));
+    }
+  }
+  EXPECT_EQ(2u, pes_outputs.size());
+  output.clear();
+  ts_out.Flush(&output);
+  pes_outputs.push_back(
+      std::vector<uint8_t>(output.begin(), output.end()));
+  output.clear();
+  ts_out.Flush(&output);
+  EXPECT_TRUE(output.empty());
+
+  const size_t kFramesPerPes[] = {4, 4, 2};
+  size_t aggregated_size = 0;
+  size_t first_frame = 0;
+  for (size_t index = 0; index < pes_outputs.size(); ++index) {
+    aggregated_size += pes_outputs[index].size();
+    // Every PES starts on a sync sample so gets a PAT and PMT.
+    ASSERT_LT(188u * 2, pes_outputs[index].size());
+    std::vector<uint8_t> ts(pes_outputs[index].begin() + 188 * 2,
+                            pes_outputs[index].end());
+    std::vector<uint8_t> payload;
+    for (size_t count = 0; count < kFramesPerPes[index]; ++count) {
+      payload.insert(payload.end(), framed.begin(), framed.end());
+    }
+    PES pes;
+    pes.set_stream_id(PES::kAudioStreamId);
+    pes.SetDataAlignmentIndicator(true);
+    pes.SetPts(first_frame * kFrameDuration + 1);
+    pes.AddPayload(&payload[0], payload.size());
+    std::vector<uint8_t> expected(pes.GetSize());
+    pes.Write(&expected[0], expected.size());
+    EXPECT_EQ(expected, ExtractTsPayload(ts, TransportStreamOut::kPidAudio));
+    first_frame += kFramesPerPes[index];
+  }
+
+  const TransportStreamOut::AudioAggregationStats& stats =
+      ts_out.get_audio_aggregation_stats();
+  EXPECT_EQ(kFrames, stats.frames);
+  EXPECT_EQ(3u, stats.pes_packets);
+  EXPECT_LT(0, stats.stuffing_bytes_saved);
+  // PSI is written once per PES either way, so only compare the audio.
+  EXPECT_EQ(unaggregated_size - 188 * 2 * kFrames,
+            aggregated_size - 188 * 2 * 3 + stats.bytes_saved);
+}
+
+TEST(TransportStreamOut, AudioAggregationFullPackets) {
+  // Frames whose PES exactly fills a packet need no stuffing alone, but do
+  // when two of them share a PES header.
+  const uint64_t kFrameDuration = 1920;
+  TransportStreamOutTest ts_out;
+  ts_out.set_audio_config(kAudioConfig);
+  std::vector<uint8_t> frame(1, 0x5a);
+  ByteBuffer framed;
+  ts_out.FrameAudio(&frame[0], frame.size(), &framed);
+  PES pes;
+  pes.set_stream_id(PES::kAudioStreamId);
+  pes.SetPts(1);
+  frame.resize(184 - pes.GetHeaderSize() - (framed.size() - frame.size()),
+               0x5a);
+
+  ts_out.set_audio_aggregation_duration(2 * kFrameDuration);
+  ByteBuffer output;
+  for (size_t count = 0; count < 2; ++count) {
+    ts_out.ProcessSample(&frame[0], frame.size(), false, true,
+                         count * kFrameDuration, count * kFrameDuration, 0,
+                         kFrameDuration, &output);
+    EXPECT_TRUE(output.empty());
+  }
+  ts_out.Flush(&output);
+  // PAT, PMT and the two frames in two audio packets.
+  EXPECT_EQ(188u * 4, output.size());
+
+  const TransportStreamOut::AudioAggregationStats& stats =
+      ts_out.get_audio_aggregation_stats();
+  EXPECT_EQ(2u, stats.frames);
+  EXPECT_EQ(1u, stats.pes_packets);
+  EXPECT_EQ(pes.GetHeaderSize(), stats.stuffing_bytes);
+  EXPECT_EQ(-static_cast<int64_t>(pes.GetHeaderSize()),
+            stats.stuffing_bytes_saved);
+  EXPECT_EQ(0u, stats.bytes_saved);
+}
+
+TEST(TransportStreamOut, MuxedPsi) {
+  TransportStreamOutTest ts_out;
+  ts_out.set_has_video(true);
+  ts_out.set_has_audio(true);
+  ts_out.set_nalu_length(4);
+  ts_out.set_audio_config(kAudioConfig);
+  const uint8_t kVideoSample[] = {0x00, 0x00, 0x00, 0x02, 0x41, 0x9a};
+  const uint8_t kAudioSample[] = {0x21, 0x10, 0x05};
+  ByteBuffer output;
+
+  // PSI leads the output even when audio comes first, and uses the PMT with
+  // both streams.
+  ts_out.ProcessSample(kAudioSample, sizeof(kAudioSample), false, true, 0, 0,
+                       0, 1920, &output);
+  ASSERT_EQ(188u * 3, output.size());
+  EXPECT_EQ(TransportStreamOut::kPidPat,
+            ntohsFromBuffer(&output[1]) & 0x1fff);
+  std::vector<uint8_t> pmt = ExtractTsPayload(
+      std::vector<uint8_t>(output.begin() + 188, output.begin() + 376),
+      TransportStreamOut::kPidPmt);
+  const std::vector<uint8_t>& muxed_pmt = ts_out.get_muxed_pmt();
+  ASSERT_LE(muxed_pmt.size(), pmt.size());
+  EXPECT_TRUE(std::equal(muxed_pmt.begin(), muxed_pmt.end(), pmt.begin()));
+  EXPECT_EQ(ts_out.get_audio_pmt().size() + 5, muxed_pmt.size());
+
+  // Later audio frames do not repeat it, video sync samples do.
+  ts_out.ProcessSample(kAudioSample, sizeof(kAudioSample), false, true, 1920,
+                       1920, 1920, 1920, &output);
+  EXPECT_EQ(188u, output.size());
+  ts_out.ProcessSample(kVideoSample, sizeof(kVideoSample), true, false, 3000,
+                       3000, 3000, 3000, &output);
+  EXPECT_EQ(188u, output.size());
+  ts_out.ProcessSample(kVideoSample, sizeof(kVideoSample), true, true, 6000,
+                       6000, 6000, 3000, &output);
+  ASSERT_EQ(188u * 3, output.size());
+  EXPECT_EQ(TransportStreamOut::kPidVideo,
+            ntohsFromBuffer(&output[376 + 1]) & 0x1fff);
+}
 }  // namespace dash2hls
@@ -102,6 +102,44 @@ string PrettyPrintValue(int64_t value) {
   return buffer;
 }
 
+string Base64Encode(const uint8_t* buffer, size_t length) {
+  static const char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  string result;
+  result.reserve((length + 2) / 3 * 4);
+  size_t count = 0;
+  for (; count + 3 <= length; count += 3) {
+    uint32_t group = (buffer[count] << 16) | (buffer[count + 1] << 8) |
+        buffer[count + 2];
+    result += kAlphabet[(group >> 18) & 0x3f];
+    result += kAlphabet[(group >> 12) & 0x3f];
+    result += kAlphabet[(group >> 6) & 0x3f];
+    result += kAlphabet[group & 0x3f];
+  }
+  if (count < length) {
+    uint32_t group = buffer[count] << 16;
+    if (count + 1 < length) {
+      group |= buffer[count + 1] << 8;
+    }
+    result += kAlphabet[(group >> 18) & 0x3f];
+    result += kAlphabet[(group >> 12) & 0x3f];
+    result += count + 1 < length ? kAlphabet[(group >> 6) & 0x3f] : '=';
+    result += '=';
+  }
+  return result;
+}
+
+string HexEncode(const uint8_t* buffer, size_t length) {
+  static const char kDigits[] = "0123456789abcdef";
+  string result;
+  result.reserve(length * 2);
+  for (size_t count = 0; count < length; ++count) {
+    result += kDigits[buffer[count] >> 4];
+    result += kDigits[buffer[count] & 0x0f];
+  }
+  return result;
+}
+
 // PrettyPrintBuffer does the exact same thing as DumpMemory, but they are
 // used in different ways.  PrettyPrintValue is used for diagnostics and
 // with other PrettyPrintValue calls.  DumpMemory is used in error handling.
@@ -152,7 +190,7 @@ std::string DumpMemory(const uint8_t* memory, size_t length) {
   return result;
 }
 
-size_t wvcrc32(uint8_t* begin, int count) {
+size_t wvcrc32(const uint8_t* begin, int count) {
   return wvrunningcrc32(begin, count, INIT_CRC32);
 }
 
@@ -160,7 +198,7 @@ size_t wvcrc32(uint8_t* begin, int count) {
 // in use as is for many years.
 // TODO(justsomeguy) See if we can remove the table below and just use
 // an algorithm.
-size_t wvrunningcrc32(uint8_t* buffer, int count, uint32_t crc) {
+size_t wvrunningcrc32(const uint8_t* buffer, int count, uint32_t crc) {
   static uint32_t CRC32[256] = {
     0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
     0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
@@ -73,6 +73,11 @@ std::string PrettyPrintValue(size_t);
 std::string PrettyPrintValue(uint64_t);
 std::string PrettyPrintBuffer(const uint8_t* buffer, size_t length);
 
+// Standard base64 (RFC 4648) with padding, used for data: URIs in playlists.
+std::string Base64Encode(const uint8_t* buffer, size_t length);
+// Lower case hex without a prefix.
+std::string HexEncode(const uint8_t* buffer, size_t length);
+
 // verbosity when debugging.
 extern bool g_verbose_pretty_print;
 
@@ -85,8 +90,8 @@ void SendDashLog(const char* file, uint32_t line, const char* message,
 #define DASH_LOG(message, reason, extra_fields) \
   SendDashLog(__FILE__, __LINE__, message, reason, extra_fields);
 
-size_t wvcrc32(uint8_t* begin, int count);
-size_t wvrunningcrc32(uint8_t* begin, int count, uint32_t crc);
+size_t wvcrc32(const uint8_t* begin, int count);
+size_t wvrunningcrc32(const uint8_t* begin, int count, uint32_t crc);
 
 }  // namespace dash2hls
 #endif  // DASHTOHLS_UTILITIES_H_
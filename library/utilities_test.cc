@@ -72,6 +72,19 @@ TEST(Dash2HLS, PrettyPrintValue) {
   EXPECT_EQ("258", PrettyPrintValue(a_size));
 }
 
+TEST(Dash2HLS, Base64Encode) {
+  const uint8_t kData[] = {'f', 'o', 'o', 'b', 'a', 'r'};
+  EXPECT_EQ("", Base64Encode(kData, 0));
+  EXPECT_EQ("Zg==", Base64Encode(kData, 1));
+  EXPECT_EQ("Zm8=", Base64Encode(kData, 2));
+  EXPECT_EQ("Zm9v", Base64Encode(kData, 3));
+  EXPECT_EQ("Zm9vYg==", Base64Encode(kData, 4));
+  EXPECT_EQ("Zm9vYmFy", Base64Encode(kData, 6));
+  const uint8_t kHigh[] = {0xfb, 0xff, 0xbf};
+  EXPECT_EQ("+/+/", Base64Encode(kHigh, sizeof(kHigh)));
+  EXPECT_EQ("fbffbf", HexEncode(kHigh, sizeof(kHigh)));
+}
+
 TEST(Dash2HLS, EnoughBytesToParse) {
   EXPECT_TRUE(EnoughBytesToParse(0, 10, 10));
   EXPECT_TRUE(EnoughBytesToParse(5, 5, 15));